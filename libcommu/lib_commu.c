@@ -25,27 +25,63 @@
  * SOFTWARE.
  */ 
 
+#define _GNU_SOURCE
 #define LIB_COMMU_C_
 #define LIB_COMMU_DB_C_
 
 #include "lib_commu.h"
 #include "lib_commu_db.h"
 #include "lib_commu_bail.h"
+#include "lib_commu_pool.h"
+#include "lib_commu_shm.h"
+#include "lib_commu_uring.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/ip.h>
-#include <sys/select.h>
+#include <sys/timerfd.h>
 #include <arpa/inet.h>
+#include <endian.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <linux/errqueue.h>
+
+/* MSG_ZEROCOPY (linux 4.14) constants, missing from older libc/kernel headers */
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY                 (60)
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY                (0x4000000)
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY       (5)
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED  (1)
+#endif
+
+/* UDP GSO/GRO (linux 4.18/5.0) constants */
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT                 (103)
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO                     (104)
+#endif
 
 #undef  __MODULE__
 #define __MODULE__ LIB_COMMU
@@ -54,20 +90,40 @@
  *  Global variables
  ***********************************************/
 
-pthread_t listener_threads[NUM_OF_LISTENER_THREADS];
-struct listner_exit_event_info listner_exit_event_info_st;
+struct listener_session **listener_sessions = NULL;
 lib_commu_log_cb_t lib_commu_log_cb = NULL;
 /************************************************
  *  Local variables
  ***********************************************/
 
 static uint32_t g_lib_commu_init_done = 0;
+static enum comm_lib_io_engine g_lib_commu_io_engine = IO_ENGINE_SYSCALL;
 /*static uint32_t g_lib_commu_verbosity_level = LCOMMU_VERBOSITY_LEVEL_NOTICE;*/
 static pthread_mutex_t lock_listener_db_access = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t listener_stop_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t lock_tcp_session_db_access =
     PTHREAD_MUTEX_INITIALIZER;
-static int client_connect_exit_event_fd = INVALID_HANDLE_ID;
-static uint32_t client_connect_thread_cnt = 0;
+static pthread_mutex_t lock_tx_queue_alloc = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t lock_zerocopy_alloc = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t lock_handle_reactor_alloc = PTHREAD_MUTEX_INITIALIZER;
+/* the channels, the receive callback, the UDP reassembly and the reliable
+ * peers each take over the receive side of a handle, they are allocated
+ * under one lock */
+static pthread_mutex_t lock_rx_mode_alloc = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t lock_pending_connects = PTHREAD_MUTEX_INITIALIZER;
+static struct pending_connect *pending_connects = NULL;
+static pthread_mutex_t lock_coalesce = PTHREAD_MUTEX_INITIALIZER;
+static struct tx_coalesce *coalesce_list = NULL;
+static pthread_mutex_t lock_coalesce_timer = PTHREAD_MUTEX_INITIALIZER;
+static struct lib_commu_reactor_item coalesce_timer_item = {
+    .fd = INVALID_HANDLE_ID
+};
+static unsigned long long coalesce_timer_ns = 0; /* armed deadline, 0 if disarmed */
+static pthread_mutex_t lock_reliable = PTHREAD_MUTEX_INITIALIZER;
+static struct udp_reliable *reliable_list = NULL;
+static struct lib_commu_reactor_item reliable_timer_item = {
+    .fd = INVALID_HANDLE_ID
+};
 static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
     LCOMMU_VERBOSITY_LEVEL_NOTICE;
 
@@ -75,29 +131,88 @@ static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
  *  Local function declarations
  ***********************************************/
 
-static int lib_db_init();
+static int lib_db_init(const struct comm_lib_init_params *params);
 static int lib_db_deinit();
 static int pseudo_random_gen_uint32_init(void);
 static int pseudo_random_uint32_get(uint32_t *magic);
+static unsigned long long time_ns_get(void);
+static int stream_sockaddr_set(enum stream_transport transport,
+                               uint32_t ipv4_addr, uint16_t port,
+                               struct sockaddr_storage *addr,
+                               socklen_t *addr_len);
+static void stream_sockaddr_addr_info_get(const struct sockaddr_storage *addr,
+                                          struct addr_info *addr_info_st);
+static int unix_stream_path_reclaim(const struct sockaddr_storage *addr,
+                                    socklen_t addr_len);
+static int stream_sock_options_set(int sock_fd,
+                                   enum stream_transport transport,
+                                   int is_ka);
+static int stats_dump_append(char *buffer, uint32_t buffer_len,
+                             uint32_t *offset, const char *format, ...);
 
 static int comm_lib_udp_ll_send(handle_t handle, struct addr_info recipient_st,
-                                uint8_t *buffer, uint32_t *buffer_len);
+                                struct iovec *iov, uint32_t iov_num,
+                                uint32_t *buffer_len);
 
-static int comm_lib_udp_ll_recv(handle_t handle, uint8_t *payload,
-                                uint32_t *payload_size,
+static int comm_lib_udp_ll_recv(handle_t handle, struct iovec *iov,
+                                uint32_t iov_num, uint32_t *buffer_len,
                                 struct addr_info *addresser_st);
 
 static int
-comm_lib_tcp_ll_send_blocking(handle_t handle, uint8_t *buffer,
-                              uint32_t *buffer_len,
-                              enum db_type handle_db_type);
+comm_lib_tcp_ll_sendmsg_blocking(handle_t handle, struct iovec *iov,
+                                 uint32_t iov_num, uint32_t *buffer_len,
+                                 enum db_type handle_db_type,
+                                 struct tcp_zerocopy *tcp_zerocopy);
+
+static int tcp_zerocopy_wait(handle_t handle, uint32_t first_id,
+                             uint32_t sends_num);
+static void tcp_connection_abort(handle_t handle);
+
+static int tcp_zerocopy_get(handle_t handle,
+                            struct handle_info *handle_info_st,
+                            struct tcp_zerocopy **tcp_zerocopy);
+
+static void tcp_zerocopy_stop(struct handle_info *handle_info_st);
+
+static ssize_t tcp_io_sendmsg(handle_t handle, struct msghdr *msg, int flags);
+
+static ssize_t tcp_io_recv(handle_t handle, uint8_t *buffer, size_t len,
+                           int is_all);
 
 static int
 comm_lib_tcp_ll_recv_blocking(handle_t handle, uint8_t *buffer,
                               uint32_t *buffer_len);
 
-static int parse_metadata_from_buffer(uint8_t *payload,
-                                      struct msg_metadata *pkt_metadata_st);
+static int
+comm_lib_tcp_ll_recv_some(handle_t handle, uint8_t *buffer,
+                          uint32_t *buffer_len);
+
+static struct lib_commu_shm_link *handle_shm_link_get(handle_t handle);
+
+static int
+rx_stream_check(handle_t handle, const struct rx_stream *rx_stream);
+
+static int
+rx_stream_fill(handle_t handle, struct rx_stream *rx_stream,
+               uint32_t bytes_needed, int is_exact);
+
+static int
+rx_stream_msgs_parse(handle_t handle, struct handle_info *handle_info_st,
+                     struct recv_payload_data *payload_data,
+                     uint32_t max_msgs_to_recv);
+
+static int
+rx_stream_msgs_parse_pooled(handle_t handle,
+                            struct handle_info *handle_info_st,
+                            struct recv_msg *msgs, uint32_t max_msgs,
+                            uint32_t *msgs_num);
+
+static void handle_msgs_stats_update(handle_t handle, int is_rx,
+                                     uint32_t msgs_num, int err);
+
+static int udp_iov_send(handle_t handle, struct addr_info recipient_st,
+                        const struct iovec *payload_iov, uint32_t iov_num,
+                        uint32_t *payload_len);
 
 static int metadata_set(struct msg_metadata *metadata_st, uint8_t version,
                         uint32_t payload_size,
@@ -108,15 +223,310 @@ validate_metadata_info(struct msg_metadata *metadata_st,
                        uint32_t max_paylod_size,
                        struct handle_info *handle_info_st);
 
-static void * listener_main_thread(void *args);
+static int msg_header_set(struct msg_header *header_st, uint32_t payload_size,
+                          uint32_t max_header_len,
+                          struct handle_info *handle_info_st,
+                          uint32_t *header_len);
+
+static uint32_t msg_header_len(const struct msg_metadata *metadata_st);
+
+static void msg_trace_recv(handle_t handle,
+                           const struct msg_metadata *metadata_st,
+                           uint32_t peer_ipv4_addr, const uint8_t *trace);
+
+static void udp_msg_trace_strip(handle_t handle,
+                                const struct msg_metadata *metadata_st,
+                                uint32_t peer_ipv4_addr,
+                                uint8_t *payload, uint32_t payload_buf_len,
+                                const uint8_t *spill);
+
+static int listener_socket_open(struct sockaddr_storage *addr,
+                                socklen_t addr_len, int is_reuseport,
+                                int *listener_fd);
+
+static void listener_connection_add(struct listener_session *session,
+                                    int new_sock,
+                                    struct sockaddr_storage *client_addr);
+
+static void listener_accept_handler(struct lib_commu_reactor_item *item,
+                                    uint32_t events);
+
+static void listener_event_handler(struct lib_commu_reactor_item *item,
+                                   uint32_t events);
+
+static void listener_release(struct lib_commu_reactor_item *item);
+
+static int handle_reactor_get(handle_t handle,
+                              struct handle_info *handle_info_st,
+                              struct handle_reactor **handle_reactor);
+
+static int handle_reactor_arm(struct handle_reactor *handle_reactor);
+
+static void handle_reactor_handler(struct lib_commu_reactor_item *item,
+                                   uint32_t events);
+
+static void handle_reactor_release(struct lib_commu_reactor_item *item);
+
+static void handle_reactor_free(struct handle_reactor *handle_reactor);
+
+static void handle_reactor_stop(struct handle_info *handle_info_st);
+
+static int tx_queue_get(handle_t handle, struct handle_info *handle_info_st,
+                        struct tx_queue **tx_queue);
+
+static int tx_queue_send_some(struct tx_queue *tx_queue,
+                              struct tx_queue_msg *done_msgs,
+                              uint32_t *done_num);
+
+static void tx_queue_msgs_pop(struct tx_queue *tx_queue,
+                              struct tx_queue_msg *done_msgs,
+                              uint32_t *done_num);
+
+static void tx_queue_msgs_complete(handle_t handle,
+                                   struct tx_queue_msg *done_msgs,
+                                   uint32_t done_num, int rc);
+
+static void tx_queue_handler(struct handle_reactor *handle_reactor,
+                             struct tx_queue *tx_queue);
+
+static void tx_queue_free(struct tx_queue *tx_queue);
+
+static void tx_queue_cancel(struct tx_queue *tx_queue);
+
+static int tcp_iov_send(handle_t handle, struct handle_info *handle_info_st,
+                        struct iovec *iov, uint32_t iov_num,
+                        uint32_t *buffer_len, enum db_type handle_db_type);
+
+static int tcp_iov_is_plain(struct handle_info *handle_info_st);
+
+static void tcp_uring_sends(struct tcp_uring_send *sends,
+                            struct lib_commu_uring_op *ops,
+                            uint32_t sends_num);
+
+static int tcp_batch_frame(struct handle_info *handle_info_st,
+                           struct tcp_send_msg *msgs, uint32_t msgs_num,
+                           struct msg_header *header_st, struct iovec *iov,
+                           uint32_t *total_len);
+
+static uint32_t tcp_batch_msgs_sent(const struct msg_header *header_st,
+                                    const struct tcp_send_msg *msgs,
+                                    uint32_t msgs_num, uint32_t sent_len);
+
+static int tcp_send_batch_linked(handle_t handle,
+                                 struct handle_info *handle_info_st,
+                                 enum db_type handle_db_type,
+                                 struct tcp_send_msg *msgs, uint32_t msgs_num,
+                                 uint32_t *msgs_sent);
+
+static int tcp_multi_msg_cmp(const void *a, const void *b);
+
+static int tcp_multi_msg_frame(struct tcp_multi_msg *multi_msg);
+
+static int tx_coalesce_start(handle_t handle,
+                             struct handle_info *handle_info_st,
+                             uint32_t max_bytes, uint32_t max_delay_usec);
+
+static int tx_coalesce_stop(struct handle_info *handle_info_st);
+
+static int tx_coalesce_send(struct tx_coalesce *tx_coalesce,
+                            struct iovec *iov, uint32_t iov_num,
+                            uint32_t *buffer_len,
+                            enum db_type handle_db_type);
+
+static int tx_coalesce_flush(struct tx_coalesce *tx_coalesce,
+                             int is_blocking);
+
+static int tx_coalesce_drain(struct tx_coalesce *tx_coalesce);
+
+static int tx_coalesce_timer_open(void);
+
+static void tx_coalesce_timer_close(void);
+
+static void tx_coalesce_timer_arm(unsigned long long deadline_ns);
+
+static void tx_coalesce_timer_handler(struct lib_commu_reactor_item *item,
+                                      uint32_t events);
+
+static int tcp_channels_get(handle_t handle,
+                            struct handle_info *handle_info_st,
+                            struct tcp_channels **tcp_channels);
+
+static void tcp_channels_stop(struct handle_info *handle_info_st);
+
+static int tcp_channel_frame_send(handle_t handle,
+                                  struct handle_info *handle_info_st,
+                                  enum db_type handle_db_type,
+                                  uint8_t msg_type, uint8_t *payload,
+                                  uint32_t payload_len, uint32_t offset,
+                                  uint32_t *frame_len);
+
+static int tcp_channel_frame_recv(handle_t handle,
+                                  struct handle_info *handle_info_st,
+                                  struct tcp_channels *tcp_channels,
+                                  uint8_t *msg_type, uint8_t **payload,
+                                  uint32_t *payload_len);
+
+static int tcp_channel_msg_queue(struct tcp_channels *tcp_channels,
+                                 uint8_t msg_type, uint8_t *payload,
+                                 uint32_t payload_len);
+
+static int rx_callback_deliver(struct rx_callback *rx_callback,
+                               struct addr_info addresser_st,
+                               uint8_t *payload, uint32_t payload_len,
+                               uint8_t msg_type);
+
+static int rx_callback_tcp_recv(struct rx_callback *rx_callback,
+                                struct handle_info *handle_info_st,
+                                uint32_t *msgs_num, uint32_t *total_bytes);
+
+static int rx_callback_udp_recv(struct rx_callback *rx_callback,
+                                struct handle_info *handle_info_st,
+                                uint32_t *msgs_num, uint32_t *total_bytes,
+                                uint32_t *dropped_num);
+
+static void rx_callback_handler(struct handle_reactor *handle_reactor,
+                                struct rx_callback *rx_callback);
 
-static void * client_connect_thread(void *args);
+static void rx_callback_free(struct rx_callback *rx_callback);
+
+static void rx_callback_stop(struct handle_info *handle_info_st);
+
+static int udp_fragments_batch_send(handle_t handle,
+                                    struct handle_info *handle_info_st,
+                                    struct sockaddr_in *recipient,
+                                    struct iovec *iov, uint32_t frags_num,
+                                    uint32_t batch_len, uint32_t *retries);
+
+static int udp_fragments_send(handle_t handle,
+                              struct handle_info *handle_info_st,
+                              struct addr_info recipient_st, uint8_t *payload,
+                              uint32_t payload_len, uint32_t *total_bytes);
+
+static int udp_reassembly_get(handle_t handle,
+                              struct handle_info *handle_info_st,
+                              struct udp_reassembly **udp_reassembly);
+
+static void udp_reassembly_stop(struct handle_info *handle_info_st);
+
+static int udp_fragments_get(struct udp_reassembly *udp_reassembly,
+                             struct msg_fragment *fragment_st,
+                             uint32_t *dropped_num,
+                             struct udp_fragments **fragments);
+
+static int udp_reassembly_segment_parse(struct handle_info *handle_info_st,
+                                        struct udp_reassembly *udp_reassembly,
+                                        struct addr_info *addresser_st,
+                                        uint8_t *payload,
+                                        uint32_t *payload_len,
+                                        int *is_msg_done,
+                                        uint32_t *dropped_num);
+
+static int udp_reliable_timer_open(void);
+
+static void udp_reliable_timer_close(void);
+
+static void udp_reliable_timer_handler(struct lib_commu_reactor_item *item,
+                                       uint32_t events);
+
+static void udp_reliable_unlink(struct udp_reliable *udp_reliable);
+
+static void udp_reliable_retransmit(struct udp_reliable *udp_reliable,
+                                    unsigned long long now_ns);
+
+static int udp_reliable_msg_resend(struct udp_reliable *udp_reliable,
+                                   struct udp_reliable_peer *peer,
+                                   struct udp_reliable_msg *msg,
+                                   struct sockaddr_in *recipient);
+
+static void udp_reliable_peer_give_up(struct udp_reliable *udp_reliable,
+                                      struct udp_reliable_peer *peer);
+
+static int udp_reliable_reset_send(struct udp_reliable *udp_reliable,
+                                   struct udp_reliable_peer *peer,
+                                   struct sockaddr_in *recipient);
+
+static void udp_reliable_peers_forget(struct udp_reliable *udp_reliable,
+                                      unsigned long long now_ns);
+
+static void udp_reliable_rto_update(struct udp_reliable_peer *peer,
+                                    unsigned long long rtt_ns);
+
+static uint32_t udp_reliable_peer_bucket(uint32_t ipv4_addr, uint16_t port);
+
+static int udp_reliable_peer_get(struct udp_reliable *udp_reliable,
+                                 uint32_t ipv4_addr, uint16_t port,
+                                 int is_created,
+                                 struct udp_reliable_peer **peer);
+
+static void udp_reliable_peer_restart(struct udp_reliable_peer *peer);
+
+static int udp_reliable_rx_is_pending(struct udp_reliable_peer *peer);
+
+static void udp_reliable_rx_drop(struct udp_reliable_peer *peer);
+
+static int udp_reliable_rx_sync(struct udp_reliable *udp_reliable,
+                                struct udp_reliable_peer *peer,
+                                uint32_t epoch, uint32_t seq);
+
+static void udp_reliable_peer_deliver(struct udp_reliable *udp_reliable,
+                                      struct udp_reliable_peer *peer);
+
+static void udp_reliable_blocked_deliver(struct udp_reliable *udp_reliable,
+                                         struct handle_info *handle_info_st);
+
+static void udp_reliable_ack_recv(struct udp_reliable *udp_reliable,
+                                  struct udp_reliable_peer *peer,
+                                  struct msg_reliable *reliable_st,
+                                  unsigned long long now_ns);
+
+static int udp_reliable_datagram_recv(struct udp_reliable *udp_reliable,
+                                      struct handle_info *handle_info_st,
+                                      struct sockaddr_in *addresser,
+                                      uint8_t *buffer, uint32_t len,
+                                      unsigned long long now_ns,
+                                      struct udp_reliable_peer **peer,
+                                      int *is_new_msg);
+
+static void udp_reliable_acks_send(struct udp_reliable *udp_reliable,
+                                   struct handle_info *handle_info_st,
+                                   struct udp_reliable_peer **peers,
+                                   uint32_t peers_num);
+
+static void udp_reliable_handler(struct lib_commu_reactor_item *item,
+                                 uint32_t events);
+
+static void udp_reliable_release(struct lib_commu_reactor_item *item);
+
+static void udp_reliable_free(struct udp_reliable *udp_reliable);
+
+static void udp_reliable_stop(struct handle_info *handle_info_st);
+
+static void udp_reliable_cancel(struct udp_reliable *udp_reliable);
+
+static void pending_connect_handler(struct lib_commu_reactor_item *item,
+                                    uint32_t events);
+
+static void pending_connect_timeout_handler(struct lib_commu_reactor_item *item,
+                                            uint32_t events);
+
+static void pending_connect_complete(struct pending_connect *connect_st,
+                                     int err);
+
+static void pending_connect_release(struct lib_commu_reactor_item *item);
+
+static void pending_connect_put(struct pending_connect *connect_st);
+
+static void pending_connects_flush(void);
 
 static int close_socket_wrapper(handle_t handle);
 
-static int exit_server_thread(uint16_t idx);
+static int handle_close(struct handle_info *handle_info_st);
+
+static int handle_close_finish(struct handle_info *handle_info_st);
 
-static int create_server_event_socket(int *fd, uint16_t idx);
+static void handle_close_pending_put(struct handle_info *handle_info_st);
+
+static int listener_session_stop_wait(struct listener_session *session);
 
 /*
  * This function sets socket options on recv/send buffer of the socekt to
@@ -139,31 +549,54 @@ static int set_sock_buffer_size(int sock_fd);
  */
 static int set_sock_priority(int sock_fd);
 
-static int handle_new_non_blocking_client(
-    int client_fd, int def_flags, struct connect_thread_args *thread_args,
-    int *is_sock_sent_client);
+/*
+ * This function sets the multicast options of a UDP socket: address reuse
+ * for several members on the host, TTL, loopback and egress interface
+ *
+ * @param[in] - sock_fd - the socket file descriptor
+ * @param[in] - mc_params - the multicast connection parameters
+ *
+ * @return 0 if operation completes successfully
+ * @return errno codes of native setsockopt function
+ */
+static int set_sock_mc_options(int sock_fd,
+                               const struct mc_udp_params *mc_params);
 
-static int
-create_client_connect_event_socket(int *fd);
+/*
+ * This function joins or leaves a multicast group
+ *
+ * @param[in] - sock_fd - the socket file descriptor
+ * @param[in] - group_ipv4_addr - the multicast group (network order)
+ * @param[in] - if_ipv4_addr - the local interface (network order)
+ * @param[in] - is_join - 1 to join, 0 to leave
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if group_ipv4_addr isn't a multicast address
+ * @return errno codes of native setsockopt function
+ */
+static int set_sock_mc_membership(int sock_fd, uint32_t group_ipv4_addr,
+                                  uint32_t if_ipv4_addr, int is_join);
 
-static int
-exit_client_connect_threads(void);
+static int handle_new_non_blocking_client(
+    int client_fd, int def_flags, struct pending_connect *connect_st,
+    int *is_sock_sent_client);
 
 /************************************************
  *  Local function implementations
  ***********************************************/
 
 static int
-lib_db_init()
+lib_db_init(const struct comm_lib_init_params *params)
 {
     int err = 0;
+    struct lib_commu_db_limits limits;
 
-    memset(listener_threads, 0, sizeof(listener_threads));
-    memset(&listner_exit_event_info_st, 0, sizeof(listner_exit_event_info_st));
-
-    client_connect_thread_cnt = 0;
+    limits.max_udp_sessions = params->max_udp_sessions;
+    limits.max_tcp_clients = params->max_tcp_clients;
+    limits.max_servers = params->max_tcp_servers;
+    limits.max_server_connections = params->max_server_connections;
 
-    err = lib_commu_db_init();
+    err = lib_commu_db_init(&limits);
     lib_commu_bail_error(err);
 
 bail:
@@ -176,11 +609,6 @@ lib_db_deinit()
 {
     int err = 0;
 
-    memset(listener_threads, 0, sizeof(listener_threads));
-    memset(&listner_exit_event_info_st, 0, sizeof(listner_exit_event_info_st));
-
-    client_connect_thread_cnt = 0;
-
     err = lib_commu_db_deinit();
     lib_commu_bail_error(err);
 
@@ -255,28 +683,171 @@ bail:
     return err;
 }
 
+/* closes a handle marked closing: the calls blocked on it are woken by shutting
+ * it down, its state is freed once the calls holding it returned, and the fd
+ * is closed after the DB entry was deleted so it isn't reused meanwhile.
+ * Closed from a reactor thread, the entry and the fd are kept till the reactor
+ * released the registrations of the handle, as they may be in use by another
+ * reactor thread */
+static int
+handle_close(struct handle_info *handle_info_st)
+{
+    int err = 0;
+    handle_t handle = handle_info_st->handle;
+    struct lib_commu_shm_link *shm_link =
+        __atomic_load_n(&handle_info_st->shm_link, __ATOMIC_ACQUIRE);
+    struct tx_queue *tx_queue = NULL;
+    struct tx_coalesce *tx_coalesce = NULL;
+    struct udp_reliable *udp_reliable = NULL;
+
+    /* no callback is called on a closed socket */
+    rx_callback_stop(handle_info_st);
+
+    /* complete the messages queued by comm_lib_tcp_send_async */
+    tx_queue = __atomic_load_n(&handle_info_st->tx_queue, __ATOMIC_ACQUIRE);
+    if (tx_queue != NULL) {
+        tx_queue_cancel(tx_queue);
+    }
+
+    /* send the messages coalesced by comm_lib_tcp_send_blocking */
+    tx_coalesce = __atomic_load_n(&handle_info_st->tx_coalesce,
+                                  __ATOMIC_ACQUIRE);
+    if (tx_coalesce != NULL) {
+        (void)tx_coalesce_drain(tx_coalesce);
+    }
+
+    /* wake up the calls blocked on the handle. A UDP sender doesn't block
+     * for long, and an unconnected UDP socket fails with ENOTCONN but its
+     * receivers are woken up too */
+    udp_reliable = __atomic_load_n(&handle_info_st->udp_reliable,
+                                   __ATOMIC_ACQUIRE);
+    if (udp_reliable != NULL) {
+        udp_reliable_cancel(udp_reliable);
+    }
+    if (shm_link != NULL) {
+        lib_commu_shm_link_shutdown(shm_link);
+    }
+    else {
+        (void)shutdown(handle, (handle_info_st->db_type == UDP_HANDLE_DB) ?
+                       SHUT_RD : SHUT_RDWR);
+    }
+
+    lib_commu_db_handle_info_users_wait(handle_info_st);
+
+    /* the state set up meanwhile is released too */
+    rx_callback_stop(handle_info_st);
+    handle_reactor_stop(handle_info_st);
+    (void)tx_coalesce_stop(handle_info_st);
+    tcp_channels_stop(handle_info_st);
+    tcp_zerocopy_stop(handle_info_st);
+    udp_reassembly_stop(handle_info_st);
+    udp_reliable_stop(handle_info_st);
+
+    if (__atomic_add_fetch(&handle_info_st->close_pending,
+                           HANDLE_CLOSE_PENDING_CLOSED, __ATOMIC_ACQ_REL) !=
+        HANDLE_CLOSE_PENDING_CLOSED) {
+        LCM_LOG(LCOMMU_LOG_DEBUG,
+                "handle[%d] is closed once the reactor released it\n", handle);
+        goto bail;
+    }
+
+    err = handle_close_finish(handle_info_st);
+    lib_commu_bail_error(err);
+
+bail:
+    return err;
+}
+
+/* deletes the DB entry of a closed handle and closes its fd */
+static int
+handle_close_finish(struct handle_info *handle_info_st)
+{
+    int err = 0;
+    handle_t handle = handle_info_st->handle;
+    struct lib_commu_shm_link *shm_link =
+        __atomic_load_n(&handle_info_st->shm_link, __ATOMIC_ACQUIRE);
+
+    /* shm sessions are closed with the DB entry */
+    err = lib_commu_db_handle_info_delete(handle_info_st);
+    lib_commu_bail_error(err);
+
+    if (shm_link == NULL) {
+        err = close_socket_wrapper(handle);
+        lib_commu_bail_error(err);
+    }
+
+bail:
+    return err;
+}
+
+/* drops a registration the reactor released after its handle was closed
+ * from a reactor thread, the last one finishes the close */
+static void
+handle_close_pending_put(struct handle_info *handle_info_st)
+{
+    if (__atomic_sub_fetch(&handle_info_st->close_pending, 1,
+                           __ATOMIC_ACQ_REL) == HANDLE_CLOSE_PENDING_CLOSED) {
+        (void)handle_close_finish(handle_info_st);
+    }
+}
+
+/* the rings of a shm session handle, NULL for socket handles */
+static struct lib_commu_shm_link *
+handle_shm_link_get(handle_t handle)
+{
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+
+    if (lib_commu_db_hanlde_info_get(handle, &handle_info_st,
+                                     &handle_db_type, NULL) != 0) {
+        return NULL;
+    }
+    return __atomic_load_n(&handle_info_st->shm_link, __ATOMIC_ACQUIRE);
+}
+
+/* monotonic time of the histograms, 0 if the clock can't be read */
+static unsigned long long
+time_ns_get(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) < 0) {
+        return 0;
+    }
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 static int
 comm_lib_udp_ll_send(handle_t handle, struct addr_info recipient_st,
-                     uint8_t *buffer, uint32_t *buffer_len)
+                     struct iovec *iov, uint32_t iov_num,
+                     uint32_t *buffer_len)
 {
     int err = 0, err_bail = 0;
     struct sockaddr_in recipient;
+    struct msghdr msg;
     int nb_sent = 0;
     enum db_type handle_db_type = UDP_HANDLE_DB;
+    unsigned long long start_ns = 0;
 
     memset((char*) &recipient, 0, sizeof(recipient));
+    memset((char*) &msg, 0, sizeof(msg));
 
     recipient.sin_family = AF_INET;
     recipient.sin_port = recipient_st.port;
     recipient.sin_addr.s_addr = recipient_st.ipv4_addr;
 
-    nb_sent = sendto(handle, buffer, *buffer_len, 0,
-                     (struct sockaddr *)&(recipient), sizeof(recipient));
+    msg.msg_name = &recipient;
+    msg.msg_namelen = sizeof(recipient);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_num;
+
+    start_ns = time_ns_get();
+    nb_sent = sendmsg(handle, &msg, 0);
 
     LCM_LOG(LCOMMU_LOG_DEBUG, "#bytes sent [%d]\n", nb_sent);
 
     if (nb_sent < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "sendto() failed with err(%d): %s\n", errno,
+        LCM_LOG(LCOMMU_LOG_ERROR, "sendmsg() failed with err(%d): %s\n", errno,
                 strerror(errno));
         *buffer_len = 0;
         lib_commu_bail_error(errno);
@@ -289,6 +860,8 @@ comm_lib_udp_ll_send(handle_t handle, struct addr_info recipient_st,
     }
 
 bail:
+    (void)handle_io_hists_update(handle, 0, time_ns_get() - start_ns,
+                                 (nb_sent > 0) ? nb_sent : 0, 0);
     if (nb_sent > 0) {
         err_bail = handle_total_tx_update(handle, &handle_db_type, nb_sent);
         if (err_bail) {
@@ -305,35 +878,50 @@ bail:
 
 
 static int
-comm_lib_udp_ll_recv(handle_t handle, uint8_t *payload,
-                     uint32_t *payload_size, struct addr_info *addresser_st)
+comm_lib_udp_ll_recv(handle_t handle, struct iovec *iov, uint32_t iov_num,
+                     uint32_t *buffer_len, struct addr_info *addresser_st)
 {
     int err = 0, err_bail = 0;
     int nb_recvd = 0;
     enum db_type handle_db_type = UDP_HANDLE_DB;
+    unsigned long long start_ns = 0;
     struct sockaddr_in addresser; /* the sender */
-    socklen_t addresser_size = sizeof(addresser);
+    struct msghdr msg;
 
     memset((char*) &addresser, 0, sizeof(addresser));
+    memset((char*) &msg, 0, sizeof(msg));
+
+    msg.msg_name = &addresser;
+    msg.msg_namelen = sizeof(addresser);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_num;
 
-    nb_recvd = recvfrom(handle, payload, *payload_size, 0,
-                        (struct sockaddr *) &addresser, &addresser_size);
+    start_ns = time_ns_get();
+    nb_recvd = recvmsg(handle, &msg, 0);
 
     LCM_LOG(LCOMMU_LOG_DEBUG, "#bytes received: [%d]\n", nb_recvd);
 
     if (nb_recvd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Failed in recvfrom() with err[%d]: %s",
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed in recvmsg() with err[%d]: %s",
                 errno, strerror(errno));
-        *payload_size = 0;
+        *buffer_len = 0;
         lib_commu_bail_force(errno);
     }
 
-    *payload_size = nb_recvd;
+    *buffer_len = nb_recvd;
 
     addresser_st->ipv4_addr = addresser.sin_addr.s_addr;
     addresser_st->port = addresser.sin_port;
 
+    if (msg.msg_flags & MSG_TRUNC) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Datagram truncated to [%d] bytes\n",
+                nb_recvd);
+        lib_commu_bail_force(EOVERFLOW);
+    }
+
 bail:
+    (void)handle_io_hists_update(handle, 1, time_ns_get() - start_ns,
+                                 (nb_recvd > 0) ? nb_recvd : 0, 0);
     if (nb_recvd > 0) {
         err_bail = handle_total_rx_update(handle, &handle_db_type, nb_recvd);
         if (err_bail) {
@@ -349,16 +937,40 @@ bail:
 }
 
 
+/* tcp_zerocopy, if given, is locked by the caller */
 static int
-comm_lib_tcp_ll_send_blocking(handle_t handle, uint8_t *buffer,
-                              uint32_t *buffer_len,
-                              enum db_type handle_db_type)
+comm_lib_tcp_ll_sendmsg_blocking(handle_t handle, struct iovec *iov,
+                                 uint32_t iov_num, uint32_t *buffer_len,
+                                 enum db_type handle_db_type,
+                                 struct tcp_zerocopy *tcp_zerocopy)
 {
     int err = 0, err_bail = 0;
     uint32_t total_bytes = 0; /* how many bytes we've sent */
-    int bytes_left = *buffer_len; /* how many we have left to send */
-    int nb_sent = 0;
+    ssize_t nb_sent = 0;
     uint16_t repeat_times = 0;
+    uint32_t zerocopy_sends = 0;
+    uint32_t zerocopy_first_id = 0;
+    int send_flags = 0;
+    struct msghdr msg;
+    unsigned long long start_ns = time_ns_get();
+
+    struct lib_commu_shm_link *shm_link = handle_shm_link_get(handle);
+
+    if (shm_link != NULL) {
+        total_bytes = *buffer_len;
+        err = lib_commu_shm_send(shm_link, iov, iov_num, &total_bytes);
+        *buffer_len = total_bytes;
+        goto bail;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_num;
+
+    if (tcp_zerocopy != NULL) {
+        send_flags = MSG_ZEROCOPY;
+        zerocopy_first_id = tcp_zerocopy->next_id;
+    }
 
     while (total_bytes < *buffer_len) {
         if (repeat_times == SEND_REPEAT_NUM) {
@@ -367,17 +979,41 @@ comm_lib_tcp_ll_send_blocking(handle_t handle, uint8_t *buffer,
             *buffer_len = total_bytes;
             lib_commu_bail_error(EIO);
         }
-        nb_sent = send(handle, (buffer + total_bytes), bytes_left, 0);
+        nb_sent = tcp_io_sendmsg(handle, &msg, send_flags);
+        if ((nb_sent < 0) && (errno == ENOBUFS) &&
+            (send_flags & MSG_ZEROCOPY)) {
+            /* out of optmem for the pinned pages, copy the rest */
+            send_flags &= ~MSG_ZEROCOPY;
+            nb_sent = tcp_io_sendmsg(handle, &msg, send_flags);
+        }
         if (nb_sent < 0) {
-            LCM_LOG(LCOMMU_LOG_ERROR, "Failed in send() with err[%d]: %s",
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed in sendmsg() with err[%d]: %s",
                     errno, strerror(errno));
-            *buffer_len = 0;
+            *buffer_len = total_bytes;
             lib_commu_bail_error(errno);
         }
 
+        /* each MSG_ZEROCOPY call which sent bytes gets a completion id */
+        if ((send_flags & MSG_ZEROCOPY) && (nb_sent > 0)) {
+            zerocopy_sends++;
+        }
         total_bytes += nb_sent;
-        bytes_left -= nb_sent;
         repeat_times++;
+
+        /* skip the iovecs sent and adjust the partially sent one */
+        while ((nb_sent > 0) && (msg.msg_iovlen > 0)) {
+            if ((size_t)nb_sent < msg.msg_iov->iov_len) {
+                msg.msg_iov->iov_base = (uint8_t*)msg.msg_iov->iov_base +
+                                        nb_sent;
+                msg.msg_iov->iov_len -= nb_sent;
+                nb_sent = 0;
+            }
+            else {
+                nb_sent -= msg.msg_iov->iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            }
+        }
     }
 
     *buffer_len = total_bytes;
@@ -385,6 +1021,36 @@ comm_lib_tcp_ll_send_blocking(handle_t handle, uint8_t *buffer,
     LCM_LOG(LCOMMU_LOG_DEBUG, "#bytes sent  [%d]\n", total_bytes);
 
 bail:
+    /* the payload can't be returned before the kernel released its pages,
+     * also when the send failed */
+    if (zerocopy_sends > 0) {
+        tcp_zerocopy->next_id += zerocopy_sends;
+        (void)handle_stats_counter_add(handle, HANDLE_STATS_ZEROCOPY_SENDS,
+                                       zerocopy_sends);
+        err_bail = tcp_zerocopy_wait(handle, zerocopy_first_id,
+                                     zerocopy_sends);
+        if (err_bail == ETIMEDOUT) {
+            /* the kernel still reads the payload: drop the queued data,
+             * which releases its pages, and fail the connection */
+            tcp_connection_abort(handle);
+            if (tcp_zerocopy_wait(handle, zerocopy_first_id,
+                                  zerocopy_sends) == ETIMEDOUT) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "handle[%d] MSG_ZEROCOPY pages weren't released after reset\n",
+                        handle);
+            }
+        }
+        if (err == 0) {
+            err = err_bail;
+        }
+    }
+    if (repeat_times > 1) {
+        (void)handle_stats_counter_add(handle, HANDLE_STATS_RETRIES,
+                                       repeat_times - 1);
+    }
+    (void)handle_io_hists_update(handle, 0, time_ns_get() - start_ns,
+                                 total_bytes,
+                                 (repeat_times > 1) ? repeat_times - 1 : 0);
     if (total_bytes > 0) {
         err_bail =
             handle_total_tx_update(handle, &handle_db_type, total_bytes);
@@ -401,1854 +1067,9074 @@ bail:
 }
 
 
-static int
-comm_lib_tcp_ll_recv_blocking(handle_t handle, uint8_t *buffer,
-                              uint32_t *buffer_len)
+/* resets a TCP connection: the data queued on the socket is dropped, and
+ * further sends and receives on the handle fail */
+static void
+tcp_connection_abort(handle_t handle)
 {
-    int err = 0, err_bail = 0;
-    int n_bytes = 0;
-    uint32_t total_bytes = 0;
-    uint16_t repeat_times = 0;
-    enum db_type handle_db_type = ANY_HANLDE_DB;
-
-    while (total_bytes != *buffer_len) {
-        if (repeat_times == RECV_REPEAT_NUM) {
-            LCM_LOG(LCOMMU_LOG_ERROR, "Retry to receive the buffer %d times",
-                    repeat_times);
-            *buffer_len = total_bytes;
-            lib_commu_bail_error(EIO);
-        }
-        n_bytes = recv(handle, (buffer + total_bytes),
-                       (*buffer_len - total_bytes), 0);
-        if (n_bytes == 0) {
-            /*If the remote side has closed the connection, recv() will return 0*/
-            LCM_LOG(LCOMMU_LOG_NOTICE, "Peer reset the connection");
-            *buffer_len = 0;
-            lib_commu_bail_force(ECONNRESET);
-        }
-        else if (n_bytes == -1) {
-            LCM_LOG(LCOMMU_LOG_ERROR, "recv() faild with err(%d): %s", errno, strerror(
-                        errno));
-            *buffer_len = 0;
-            lib_commu_bail_force(errno);
-        }
-
-        repeat_times++;
-        total_bytes += n_bytes;
-    }
-
-    *buffer_len = total_bytes;
+    struct sockaddr unspec_addr;
 
-    LCM_LOG(LCOMMU_LOG_DEBUG, "#bytes recieved [%d]\n", total_bytes);
+    memset(&unspec_addr, 0, sizeof(unspec_addr));
+    unspec_addr.sa_family = AF_UNSPEC;
 
-bail:
-    if (total_bytes > 0) {
-        err_bail =
-            handle_total_rx_update(handle, &handle_db_type, total_bytes);
-        if (err_bail) {
-            LCM_LOG(LCOMMU_LOG_ERROR,
-                    "Failed in to update rx[%d] on handle[%d]\n", total_bytes,
-                    handle);
-            if (err == 0) {
-                lib_commu_return_from_bail(err_bail);
-            }
-        }
+    if (connect(handle, &unspec_addr, sizeof(unspec_addr)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to reset the connection of handle[%d], err[%d]: %s\n",
+                handle, errno, strerror(errno));
     }
-    return err;
 }
 
+
+/* waits for the MSG_ZEROCOPY completions of the sends_num sendmsg() calls
+ * numbered from first_id. The notifications of former calls, which timed
+ * out, are skipped */
 static int
-parse_metadata_from_buffer(uint8_t *payload,
-                           struct msg_metadata *pkt_metadata_st)
+tcp_zerocopy_wait(handle_t handle, uint32_t first_id, uint32_t sends_num)
 {
     int err = 0;
+    uint32_t done_num = 0;
+    uint32_t copied_num = 0;
+    uint32_t lo_id = 0;
+    int is_polled = 0;
+    int poll_rc = 0;
+    int sock_err = 0;
+    socklen_t opt_len = 0;
+    struct timeval send_timeout;
+    unsigned long long deadline_ns = 0;
+    unsigned long long now_ns = 0;
+    unsigned long long timeout_ms = 0;
+    struct msghdr msg;
+    struct cmsghdr *cmsg = NULL;
+    struct sock_extended_err *ee = NULL;
+    struct pollfd poll_fd;
+    char control[ZEROCOPY_CMSG_SIZE];
+
+    /* bounded by the send timeout of the socket, as a send is */
+    memset(&send_timeout, 0, sizeof(send_timeout));
+    opt_len = sizeof(send_timeout);
+    (void)getsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, &opt_len);
+    if ((send_timeout.tv_sec == 0) && (send_timeout.tv_usec == 0)) {
+        send_timeout.tv_sec = ZEROCOPY_WAIT_MSEC / 1000;
+        send_timeout.tv_usec = (ZEROCOPY_WAIT_MSEC % 1000) * 1000;
+    }
+    deadline_ns = time_ns_get() +
+                  (unsigned long long)send_timeout.tv_sec * 1000000000ULL +
+                  (unsigned long long)send_timeout.tv_usec * 1000ULL;
+
+    while (done_num < sends_num) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(handle, &msg, MSG_ERRQUEUE) < 0) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+                (errno != EINTR)) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "recvmsg(MSG_ERRQUEUE) on handle[%d] failed with err[%d]: %s\n",
+                        handle, errno, strerror(errno));
+                lib_commu_bail_force(errno);
+            }
 
-    lib_commu_bail_null(pkt_metadata_st);
-
-    memcpy(pkt_metadata_st, payload, sizeof(*pkt_metadata_st));
-
-    LCM_LOG(LCOMMU_LOG_INFO,
-            "metadata info: msg_type[%u], payload_size[%u], peer_magic[%u], version[%u]\n",
-            pkt_metadata_st->msg_type, pkt_metadata_st->payload_size,
-            pkt_metadata_st->trailer, pkt_metadata_st->version);
+            /* woken up without a notification - the connection failed and
+             * its queued pages were already released */
+            if (is_polled) {
+                opt_len = sizeof(sock_err);
+                if ((getsockopt(handle, SOL_SOCKET, SO_ERROR, &sock_err,
+                                &opt_len) == 0) && (sock_err != 0)) {
+                    lib_commu_bail_force(sock_err);
+                }
+                if (poll_fd.revents & POLLHUP) {
+                    lib_commu_bail_force(EPIPE);
+                }
+            }
+
+            now_ns = time_ns_get();
+            if (now_ns >= deadline_ns) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "handle[%d] MSG_ZEROCOPY completions timed out\n",
+                        handle);
+                lib_commu_bail_force(ETIMEDOUT);
+            }
+
+            /* POLLERR is always polled, it's set by a queued notification */
+            poll_fd.fd = handle;
+            poll_fd.events = 0;
+            poll_fd.revents = 0;
+            timeout_ms = (deadline_ns - now_ns + 999999ULL) / 1000000ULL;
+            poll_rc = poll(&poll_fd, 1,
+                           (timeout_ms > INT_MAX) ? INT_MAX : (int)timeout_ms);
+            if ((poll_rc < 0) && (errno != EINTR)) {
+                lib_commu_bail_force(errno);
+            }
+            is_polled = (poll_rc > 0);
+            continue;
+        }
+        is_polled = 0;
+
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!(((cmsg->cmsg_level == SOL_IP) &&
+                   (cmsg->cmsg_type == IP_RECVERR)) ||
+                  ((cmsg->cmsg_level == SOL_IPV6) &&
+                   (cmsg->cmsg_type == IPV6_RECVERR)))) {
+                continue;
+            }
+            ee = (struct sock_extended_err *)CMSG_DATA(cmsg);
+            if ((ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY) || (ee->ee_errno != 0)) {
+                continue;
+            }
+            /* the notification covers the ids [ee_info, ee_data], the ids
+             * wrap around */
+            if ((int32_t)(ee->ee_data - first_id) < 0) {
+                continue;
+            }
+            lo_id = ((int32_t)(ee->ee_info - first_id) < 0) ? first_id :
+                    ee->ee_info;
+            done_num += ee->ee_data - lo_id + 1;
+            if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                copied_num++;
+            }
+        }
+    }
 
 bail:
+    if (copied_num > 0) {
+        (void)handle_stats_counter_add(handle, HANDLE_STATS_ZEROCOPY_COPIED,
+                                       copied_num);
+    }
     return err;
 }
 
-static int
-metadata_set(struct msg_metadata *metadata_st, uint8_t version,
-             uint32_t payload_size, struct handle_info handle_info_st)
+
+/* the blocking calls of the data path, errors are returned in errno */
+static ssize_t
+tcp_io_sendmsg(handle_t handle, struct msghdr *msg, int flags)
 {
     int err = 0;
+    ssize_t nb_sent = 0;
 
-    lib_commu_bail_null(metadata_st);
+    /* a send racing the close of the handle fails with EPIPE */
+    flags |= MSG_NOSIGNAL;
 
-    metadata_st->version = version;
-    metadata_st->payload_size = htonl(payload_size);
-    metadata_st->trailer = htonl(handle_info_st.socekt_info.local_magic);
-    metadata_st->msg_type = handle_info_st.conn_info.msg_type;
+    if (g_lib_commu_io_engine == IO_ENGINE_SYSCALL) {
+        return sendmsg(handle, msg, flags);
+    }
 
-bail:
-    return err;
+    /* a MSG_ZEROCOPY send must stay a single call, each call which sent
+     * bytes takes a completion id */
+    if (!(flags & MSG_ZEROCOPY)) {
+        flags |= MSG_WAITALL;
+    }
+    err = lib_commu_uring_sendmsg(handle, msg, flags, &nb_sent);
+    if (err) {
+        errno = err;
+        return -1;
+    }
+    return nb_sent;
 }
 
-static int
-validate_metadata_info(struct msg_metadata *metadata_st,
-                       uint32_t max_paylod_size,
-                       struct handle_info *handle_info_st)
+
+/* is_all waits for len bytes, with the io_uring engine only */
+static ssize_t
+tcp_io_recv(handle_t handle, uint8_t *buffer, size_t len, int is_all)
 {
     int err = 0;
+    ssize_t nb_recvd = 0;
 
-    metadata_st->payload_size = ntohl(metadata_st->payload_size);
-    metadata_st->trailer = ntohl(metadata_st->trailer);
-
-    /* check commu lib msg version */
-    if (metadata_st->version != MSG_VERSION) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "comm_lib msg version[%d] != msg version[%u] received\n",
-                MSG_VERSION, metadata_st->version);
-        lib_commu_bail_force(EIO);
+    if (g_lib_commu_io_engine == IO_ENGINE_SYSCALL) {
+        return recv(handle, buffer, len, 0);
     }
 
-    /* if user payload size <  packet size */
-    if ((max_paylod_size < metadata_st->payload_size)
-        || (metadata_st->payload_size == 0)) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
-                metadata_st->payload_size);
-        lib_commu_bail_force(EOVERFLOW);
+    err = lib_commu_uring_recv(handle, buffer, len,
+                               is_all ? MSG_WAITALL : 0, &nb_recvd);
+    if (err) {
+        errno = err;
+        return -1;
     }
+    return nb_recvd;
+}
 
-    /* check proper magic */
-    if (handle_info_st->socekt_info.peer_magic == INVALID_MAGIC) {
-        handle_info_st->socekt_info.peer_magic = metadata_st->trailer;
-    }
-    else if (handle_info_st->socekt_info.is_single_peer
-             && (handle_info_st->socekt_info.peer_magic !=
-                 metadata_st->trailer)) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid peer magic [%u]\n",
-                metadata_st->trailer);
-        lib_commu_bail_force(EBADE);
+
+static int
+comm_lib_tcp_ll_recv_blocking(handle_t handle, uint8_t *buffer,
+                              uint32_t *buffer_len)
+{
+    int err = 0, err_bail = 0;
+    int n_bytes = 0;
+    uint32_t total_bytes = 0;
+    uint16_t repeat_times = 0;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    unsigned long long start_ns = time_ns_get();
+    struct lib_commu_shm_link *shm_link = handle_shm_link_get(handle);
+
+    if (shm_link != NULL) {
+        total_bytes = *buffer_len;
+        err = lib_commu_shm_recv(shm_link, buffer, &total_bytes, 1);
+        *buffer_len = total_bytes;
+        goto bail;
     }
 
-    /* check proper msg type */
-    if (metadata_st->msg_type != handle_info_st->conn_info.msg_type) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Connection default msg_type[%u], msg_type received[%u]\n",
-                metadata_st->msg_type, handle_info_st->conn_info.msg_type);
-        lib_commu_bail_force(EBADE);
+    while (total_bytes != *buffer_len) {
+        if (repeat_times == RECV_REPEAT_NUM) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Retry to receive the buffer %d times",
+                    repeat_times);
+            *buffer_len = total_bytes;
+            lib_commu_bail_error(EIO);
+        }
+        n_bytes = tcp_io_recv(handle, (buffer + total_bytes),
+                              (*buffer_len - total_bytes), 1);
+        if (n_bytes == 0) {
+            /*If the remote side has closed the connection, recv() will return 0*/
+            LCM_LOG(LCOMMU_LOG_NOTICE, "Peer reset the connection");
+            *buffer_len = 0;
+            lib_commu_bail_force(ECONNRESET);
+        }
+        else if (n_bytes == -1) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "recv() faild with err(%d): %s", errno, strerror(
+                        errno));
+            *buffer_len = 0;
+            lib_commu_bail_force(errno);
+        }
+
+        repeat_times++;
+        total_bytes += n_bytes;
     }
 
+    *buffer_len = total_bytes;
+
+    LCM_LOG(LCOMMU_LOG_DEBUG, "#bytes recieved [%d]\n", total_bytes);
 
 bail:
+    if (repeat_times > 1) {
+        (void)handle_stats_counter_add(handle, HANDLE_STATS_RETRIES,
+                                       repeat_times - 1);
+    }
+    (void)handle_io_hists_update(handle, 1, time_ns_get() - start_ns,
+                                 total_bytes,
+                                 (repeat_times > 1) ? repeat_times - 1 : 0);
+    if (total_bytes > 0) {
+        err_bail =
+            handle_total_rx_update(handle, &handle_db_type, total_bytes);
+        if (err_bail) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed in to update rx[%d] on handle[%d]\n", total_bytes,
+                    handle);
+            if (err == 0) {
+                lib_commu_return_from_bail(err_bail);
+            }
+        }
+    }
     return err;
 }
 
 
 static int
-set_sock_buffer_size(int sock_fd)
+comm_lib_tcp_ll_recv_some(handle_t handle, uint8_t *buffer,
+                          uint32_t *buffer_len)
 {
-    int err = 0;
-    int sock_buff_size = 0;
+    int err = 0, err_bail = 0;
+    int n_bytes = 0;
+    uint16_t repeat_times = 0;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    unsigned long long start_ns = time_ns_get();
+    struct lib_commu_shm_link *shm_link = handle_shm_link_get(handle);
 
-    sock_buff_size = MAX_JUMBO_TCP_PAYLOAD;
-    if ((setsockopt(sock_fd, 0, SO_RCVBUF, &sock_buff_size,
-                    sizeof(sock_buff_size))) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [SO_RCVBUF], err[%d]: %s\n", errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    if (shm_link != NULL) {
+        err = lib_commu_shm_recv(shm_link, buffer, buffer_len, 0);
+        n_bytes = *buffer_len;
+        goto bail;
     }
-    if ((setsockopt(sock_fd, 0, SO_SNDBUF, &sock_buff_size,
-                    sizeof(sock_buff_size))) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [SO_SNDBUF], err[%d]: %s\n", errno,
+
+    do {
+        n_bytes = tcp_io_recv(handle, buffer, *buffer_len, 0);
+    } while ((n_bytes == -1) && (errno == EINTR) &&
+             (++repeat_times < RECV_REPEAT_NUM));
+
+    if (repeat_times > 0) {
+        (void)handle_stats_counter_add(handle, HANDLE_STATS_RETRIES,
+                                       repeat_times);
+    }
+
+    if (n_bytes == 0) {
+        /*If the remote side has closed the connection, recv() will return 0*/
+        LCM_LOG(LCOMMU_LOG_NOTICE, "Peer reset the connection");
+        *buffer_len = 0;
+        lib_commu_bail_force(ECONNRESET);
+    }
+    else if (n_bytes == -1) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "recv() faild with err(%d): %s", errno,
                 strerror(errno));
+        *buffer_len = 0;
         lib_commu_bail_force(errno);
     }
 
+    *buffer_len = n_bytes;
+
+    LCM_LOG(LCOMMU_LOG_DEBUG, "#bytes recieved [%d]\n", n_bytes);
+
 bail:
+    (void)handle_io_hists_update(handle, 1, time_ns_get() - start_ns,
+                                 (n_bytes > 0) ? n_bytes : 0, repeat_times);
+    if (n_bytes > 0) {
+        err_bail = handle_total_rx_update(handle, &handle_db_type, n_bytes);
+        if (err_bail) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed in to update rx[%d] on handle[%d]\n", n_bytes,
+                    handle);
+            if (err == 0) {
+                lib_commu_return_from_bail(err_bail);
+            }
+        }
+    }
     return err;
 }
 
+
 static int
-set_sock_priority(int sock_fd)
+rx_stream_check(handle_t handle, const struct rx_stream *rx_stream)
 {
     int err = 0;
-    int priority = 6;
-    int iptos_precedence = 0xc0 /*IPTOS_CLASS_CS6*/;
 
-    /* Set SO_PRIORITY for VRRP traffic */
-    if (setsockopt(sock_fd, SOL_SOCKET, SO_PRIORITY, &priority,
-                   sizeof(priority)) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [SO_PRIORITY], err[%d]: %s\n",
-                errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
-    }
-
-    if (setsockopt(sock_fd, IPPROTO_IP, IP_TOS, &iptos_precedence,
-                   sizeof(iptos_precedence)) < 0) {
+    /* the next message starts at an unknown offset of the stream */
+    if (rx_stream->is_failed) {
         LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [IP_TOS], err[%d]: %s\n", errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+                "handle[%d] stream is out of sync after a failed message\n",
+                handle);
+        lib_commu_bail_force(ECONNABORTED);
     }
 
 bail:
     return err;
 }
 
+
 static int
-set_sock_ka(int sock_fd)
+rx_stream_fill(handle_t handle, struct rx_stream *rx_stream,
+               uint32_t bytes_needed, int is_exact)
 {
     int err = 0;
-    int optval = 1;
-    int keepcnt = 3;
-    int keepidle = 2;
-    int keepintvl = 1;
-
-    if (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPCNT, &keepcnt,
-                   sizeof(keepcnt)) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [TCP_KEEPCNT], err[%d]: %s\n",
-                errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    uint32_t unparsed_len = rx_stream->tail - rx_stream->head;
+    uint32_t read_len = 0;
+
+    /* move the unparsed bytes to the buffer start */
+    if (rx_stream->head > 0) {
+        memmove(rx_stream->buffer, rx_stream->buffer + rx_stream->head,
+                unparsed_len);
+        rx_stream->head = 0;
+        rx_stream->tail = unparsed_len;
     }
 
-    if (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPIDLE, &keepidle,
-                   sizeof(keepidle)) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [TCP_KEEPIDLE], err[%d]: %s\n",
-                errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
-    }
+    /* exact mode never reads beyond the current message, so no bytes are
+     * left in the buffer while the socket looks idle to the user */
+    read_len = is_exact ? bytes_needed : RX_STREAM_BUFFER_SIZE - rx_stream->tail;
 
-    if (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPINTVL, &keepintvl,
-                   sizeof(keepintvl)) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [TCP_KEEPINTVL], err[%d]: %s\n",
-                errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
-    }
+    err = comm_lib_tcp_ll_recv_some(handle,
+                                    rx_stream->buffer + rx_stream->tail,
+                                    &read_len);
+    lib_commu_bail_error(err);
 
-    /* Set SO_KEEPALIVE */
-    if (setsockopt(sock_fd, SOL_SOCKET, SO_KEEPALIVE, &optval,
-                   sizeof(optval)) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [SO_KEEPALIVE], err[%d]: %s\n",
-                errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
-    }
+    rx_stream->tail += read_len;
 
 bail:
     return err;
 }
 
-static void*
-listener_main_thread(void* args)
+
+static int
+rx_stream_msgs_parse(handle_t handle, struct handle_info *handle_info_st,
+                     struct recv_payload_data *payload_data,
+                     uint32_t max_msgs_to_recv)
 {
     int err = 0;
-    int new_sock = INVALID_HANDLE_ID;
-    int fd_max = INVALID_HANDLE_ID;
-    int listener_fd = INVALID_HANDLE_ID;
-    int i = 0;
-    int n_bytes = 0;
-    uint16_t server_id_buff = 0;
-    uint32_t local_magic = INVALID_MAGIC;
-    fd_set read_fds;
-    struct sockaddr_in client_addr;
-    struct sockaddr_un event_addr; /* when thread receiving event */
-    socklen_t event_addr_len = sizeof(event_addr);
-    struct listener_thread_args *thread_args = NULL;
-    int is_db_locked = 0;
-    struct addr_info peer_addr_info;
-    struct addr_info local_addr_info;
-    int is_sock_sent_client = 0;
-
-/*
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 100000;
- */
-
-    memset((char*)&client_addr, 0, sizeof(client_addr));
-    memset((char*)&event_addr, 0, sizeof(event_addr));
-    memset(&peer_addr_info, 0, sizeof(peer_addr_info));
-    memset(&local_addr_info, 0, sizeof(local_addr_info));
-    FD_ZERO(&read_fds);
-
-    lib_commu_bail_null(args);
-
-    thread_args = (struct listener_thread_args*)args;
-    listener_fd = thread_args->listener_fd;
-    if (listener_fd == 0) {
-        lib_commu_bail_force(EINVAL);
+    struct rx_stream *rx_stream = &handle_info_st->rx_stream;
+    struct msg_metadata metadata_st;
+    uint32_t unparsed_len = 0;
+    uint32_t msg_len = 0;
+    uint32_t header_len = 0;
+    uint32_t copy_len = 0;
+    uint32_t left_len = 0;
+    uint32_t idx = 0;
+    int is_exact = (max_msgs_to_recv == 1);
+
+    if (rx_stream->buffer == NULL) {
+        rx_stream->buffer = (uint8_t*)malloc(RX_STREAM_BUFFER_SIZE);
+        if (rx_stream->buffer == NULL) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate rx stream buffer\n");
+            lib_commu_bail_force(ENOMEM);
+        }
+        rx_stream->head = 0;
+        rx_stream->tail = 0;
     }
 
-    local_addr_info.ipv4_addr = thread_args->params.s_ipv4_addr;
-    local_addr_info.ipv4_addr = thread_args->params.port;
-
-    if (listen(listener_fd, PENDING_CONNECTIOS_SIZE) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "listen() failed on listener socket[%d] failed with err(%d): %s\n",
-                listener_fd, errno, strerror(errno));
-
-        lib_commu_bail_force(errno);
-    }
+    while (payload_data->msg_num_recv < max_msgs_to_recv) {
+        unparsed_len = rx_stream->tail - rx_stream->head;
 
-    err = lib_commu_db_server_status_listener_set(thread_args->server_id,
-                                                  listener_fd,
-                                                  HANDLE_STATUS_UP);
-    lib_commu_bail_error(err);
+        /* 1. get a complete metadata */
+        if (unparsed_len < sizeof(metadata_st)) {
+            if (payload_data->msg_num_recv > 0) {
+                break; /* block only till the first message */
+            }
+            err = rx_stream_fill(handle, rx_stream,
+                                 sizeof(metadata_st) - unparsed_len,
+                                 is_exact);
+            lib_commu_bail_error(err);
+            continue;
+        }
 
-    /* set max fd to select on */
-    fd_max = listener_fd > thread_args->event_fd ?
-             listener_fd : thread_args->event_fd;
+        /* the metadata stays in the buffer till the message is complete,
+         * so validate a copy of it */
+        memcpy(&metadata_st, rx_stream->buffer + rx_stream->head,
+               sizeof(metadata_st));
+        err = validate_metadata_info(&metadata_st, MAX_JUMBO_TCP_PAYLOAD,
+                                     handle_info_st);
+        if (err && (payload_data->msg_num_recv > 0)) {
+            /* return the valid messages, error is reported on next call */
+            err = 0;
+            break;
+        }
+        if (err) {
+            /* the message can't be skipped */
+            rx_stream->is_failed = 1;
+        }
+        lib_commu_bail_error(err);
 
-    while (1) {
-        socklen_t sin_size = sizeof(client_addr);
-        FD_ZERO(&read_fds);
-        FD_SET(listener_fd, &read_fds);
-        FD_SET(thread_args->event_fd, &read_fds);
-        is_sock_sent_client = 0;
+        header_len = msg_header_len(&metadata_st);
+        msg_len = header_len + metadata_st.payload_size;
 
-        if (select(fd_max + 1, &read_fds, NULL, NULL, NULL) < 0) {
-            if (errno != EINTR) { /* if select caught signal --> don't exit with error */
-                LCM_LOG(LCOMMU_LOG_ERROR, "select() failed with err(%d): %s\n",
-                        errno, strerror(errno));
-                lib_commu_bail_force(errno);
+        /* the trace of a traced message follows the metadata */
+        if (unparsed_len < header_len) {
+            if (payload_data->msg_num_recv > 0) {
+                break;
             }
+            err = rx_stream_fill(handle, rx_stream, header_len - unparsed_len,
+                                 is_exact);
+            lib_commu_bail_error(err);
+            continue;
         }
 
-        for (i = 0; i <= fd_max; i++) {
-            if (FD_ISSET(i, &read_fds)) { /* socket is read-ready */
-                if (i == listener_fd) {
-                    /* new connection */
-                    new_sock = accept(listener_fd,
-                                      (struct sockaddr *) &client_addr,
-                                      &sin_size);
-                    if (new_sock < 0) {
-                        LCM_LOG(LCOMMU_LOG_ERROR,
-                                "accept() on listener socket[%d] failed with err(%d): %s\n",
-                                listener_fd, errno, strerror(errno));
-                        lib_commu_bail_force(errno);
-                    }
-
-                    /* enlarge soeckt send/recv buffer to max tcp jumbo size */
-                    err = set_sock_buffer_size(new_sock);
-                    lib_commu_bail_error(err);
-
-                    /* set priority on socket */
-                    err = set_sock_priority(new_sock);
-                    lib_commu_bail_error(err);
-
-                    err = set_sock_ka(new_sock);
-                    lib_commu_bail_error(err);
-
-                    /*start update DB*/
-                    err = pseudo_random_uint32_get(&local_magic);   /* get local magic */
-                    lib_commu_bail_error(err);
-
-                    memset(&peer_addr_info, 0, sizeof(peer_addr_info)); /* set peer addr */
-                    peer_addr_info.ipv4_addr = client_addr.sin_addr.s_addr;
-                    peer_addr_info.port = client_addr.sin_port;
-
-                    err = pthread_mutex_lock(&lock_listener_db_access);
-                    lib_commu_bail_error(err);
-                    is_db_locked = 1;
-
-                    err = lib_commu_db_tcp_server_handle_info_set(
-                        thread_args->server_id, new_sock,
-                        thread_args->params.msg_type, local_addr_info,
-                        peer_addr_info, local_magic);
-                    lib_commu_bail_error(err);
-
-                    err = lib_cummo_db_server_status_client_set(
-                        new_sock, &client_addr,
-                        thread_args->params.s_ipv4_addr,
-                        thread_args->params.port,
-                        thread_args->server_id);
-                    lib_commu_bail_error(err);
-
-                    err = pthread_mutex_unlock(&lock_listener_db_access);
-                    lib_commu_bail_error(err);
-                    is_db_locked = 0;
-                    /*finish update DB*/
-
-                    /*send new socket to client*/
-                    err = thread_args->clbk_st.clbk_notify_func(
-                        new_sock, peer_addr_info,
-                        thread_args->clbk_st.data, 0);
-                    lib_commu_bail_error(err);
-
-                    is_sock_sent_client = 1;
+        /* 2. jumbo message - always the last message of the batch */
+        if (metadata_st.payload_size > MAX_TCP_PAYLOAD) {
+            msg_trace_recv(handle, &metadata_st,
+                           handle_info_st->conn_info.d_ipv4_addr,
+                           rx_stream->buffer + rx_stream->head +
+                           sizeof(metadata_st));
+            copy_len = unparsed_len - header_len;
+            if (copy_len > metadata_st.payload_size) {
+                copy_len = metadata_st.payload_size;
+            }
+            memcpy(payload_data->jumbo_payload,
+                   rx_stream->buffer + rx_stream->head + header_len,
+                   copy_len);
+            rx_stream->head += header_len + copy_len;
+
+            /* the rest of the message is read directly to the user buffer */
+            left_len = metadata_st.payload_size - copy_len;
+            if (left_len > 0) {
+                err = comm_lib_tcp_ll_recv_blocking(handle,
+                                                    payload_data->jumbo_payload + copy_len,
+                                                    &left_len);
+                if (err) {
+                    rx_stream->is_failed = 1;
                 }
-                /* Receiving  event */
-                else if (i == thread_args->event_fd) {
-                    n_bytes = recvfrom(i, &server_id_buff,
-                                       sizeof(server_id_buff), 0,
-                                       (struct sockaddr*) &event_addr,
-                                       &event_addr_len);
-                    if (n_bytes < 0) {
-                        LCM_LOG(LCOMMU_LOG_ERROR,
-                                "Fail to receive data on exit event FD, err(%d): %s",
-                                errno, strerror(errno));
-                        lib_commu_bail_force(errno);
-                    }
-
-                    if (thread_args->server_id == server_id_buff) {
-                        err = close_socket_wrapper(listener_fd);
-                        lib_commu_bail_error(err);
-                        err = close_socket_wrapper(thread_args->event_fd);
-                        lib_commu_bail_error(err);
-                        LCM_LOG(LCOMMU_LOG_NOTICE,
-                                "Received exit event on server id[%d]",
-                                thread_args->server_id);
-                        goto bail;
-                    }
-                    /* programming error */
-                    else {
-                        LCM_LOG(LCOMMU_LOG_WARNING,
-                                "got server_id[%d], thread_id[%lu], db_server_id[%u]\n",
-                                server_id_buff, pthread_self(),
-                                thread_args->server_id);
-                    }
-                } /*end receiving event*/
-            }
-        } /*end for*/
-    } /*end while*/
+                lib_commu_bail_error(err);
+            }
 
-bail:
-    if (is_db_locked) {
-        pthread_mutex_unlock(&lock_listener_db_access);
+            payload_data->jumbo_payload_len = metadata_st.payload_size;
+            payload_data->jumbo_msg_type = metadata_st.msg_type;
+            payload_data->msg_num_recv++;
+            break;
+        }
+
+        /* 3. regular message */
+        if (unparsed_len < msg_len) {
+            if (payload_data->msg_num_recv > 0) {
+                break; /* block only till the first message */
+            }
+            err = rx_stream_fill(handle, rx_stream, msg_len - unparsed_len,
+                                 is_exact);
+            lib_commu_bail_error(err);
+            continue;
+        }
+
+        msg_trace_recv(handle, &metadata_st,
+                       handle_info_st->conn_info.d_ipv4_addr,
+                       rx_stream->buffer + rx_stream->head +
+                       sizeof(metadata_st));
+        idx = payload_data->msg_num_recv;
+        memcpy(payload_data->payload[idx],
+               rx_stream->buffer + rx_stream->head + header_len,
+               metadata_st.payload_size);
+        payload_data->payload_len[idx] = metadata_st.payload_size;
+        payload_data->msg_type[idx] = metadata_st.msg_type;
+        payload_data->msg_num_recv++;
+        rx_stream->head += msg_len;
     }
-    LCM_LOG(LCOMMU_LOG_NOTICE,
-            "Exit from listener thread, server id[%u] with err(%d)\n",
-            thread_args->server_id, err);
-    if (err && !is_sock_sent_client && (new_sock != INVALID_HANDLE_ID)) {
-        close_socket_wrapper(new_sock);
+
+    if (rx_stream->head == rx_stream->tail) {
+        rx_stream->head = 0;
+        rx_stream->tail = 0;
+    }
+
+bail:
+    return err;
+}
+
+static int
+rx_stream_msgs_parse_pooled(handle_t handle,
+                            struct handle_info *handle_info_st,
+                            struct recv_msg *msgs, uint32_t max_msgs,
+                            uint32_t *msgs_num)
+{
+    int err = 0;
+    struct rx_stream *rx_stream = &handle_info_st->rx_stream;
+    struct msg_metadata metadata_st;
+    uint32_t unparsed_len = 0;
+    uint32_t header_len = 0;
+    uint32_t copy_len = 0;
+    uint32_t left_len = 0;
+    uint8_t *buffer = NULL;
+    int is_exact = (max_msgs == 1);
+
+    *msgs_num = 0;
+
+    if (rx_stream->buffer == NULL) {
+        rx_stream->buffer = (uint8_t*)malloc(RX_STREAM_BUFFER_SIZE);
+        if (rx_stream->buffer == NULL) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate rx stream buffer\n");
+            lib_commu_bail_force(ENOMEM);
+        }
+        rx_stream->head = 0;
+        rx_stream->tail = 0;
+    }
+
+    while (*msgs_num < max_msgs) {
+        unparsed_len = rx_stream->tail - rx_stream->head;
+
+        /* 1. get a complete metadata */
+        if (unparsed_len < sizeof(metadata_st)) {
+            if (*msgs_num > 0) {
+                break; /* block only till the first message */
+            }
+            err = rx_stream_fill(handle, rx_stream,
+                                 sizeof(metadata_st) - unparsed_len,
+                                 is_exact);
+            lib_commu_bail_error(err);
+            continue;
+        }
+
+        memcpy(&metadata_st, rx_stream->buffer + rx_stream->head,
+               sizeof(metadata_st));
+        err = validate_metadata_info(&metadata_st, MAX_JUMBO_TCP_PAYLOAD,
+                                     handle_info_st);
+        if (err && (*msgs_num > 0)) {
+            /* return the valid messages, error is reported on next call */
+            err = 0;
+            break;
+        }
+        if (err) {
+            /* the message can't be skipped */
+            rx_stream->is_failed = 1;
+        }
+        lib_commu_bail_error(err);
+
+        /* the trace of a traced message follows the metadata */
+        header_len = msg_header_len(&metadata_st);
+        if (unparsed_len < header_len) {
+            if (*msgs_num > 0) {
+                break;
+            }
+            err = rx_stream_fill(handle, rx_stream, header_len - unparsed_len,
+                                 is_exact);
+            lib_commu_bail_error(err);
+            continue;
+        }
+
+        /* 2. a message not received completely is read directly to its
+         * buffer, so only the first message of the batch may block */
+        copy_len = unparsed_len - header_len;
+        if ((copy_len < metadata_st.payload_size) && (*msgs_num > 0)) {
+            break;
+        }
+
+        /* the metadata is consumed only once the message has a buffer */
+        err = lib_commu_pool_buffer_get(metadata_st.payload_size, &buffer);
+        if (err && (*msgs_num > 0)) {
+            err = 0;
+            break;
+        }
+        lib_commu_bail_error(err);
+
+        msg_trace_recv(handle, &metadata_st,
+                       handle_info_st->conn_info.d_ipv4_addr,
+                       rx_stream->buffer + rx_stream->head +
+                       sizeof(metadata_st));
+        if (copy_len > metadata_st.payload_size) {
+            copy_len = metadata_st.payload_size;
+        }
+        memcpy(buffer, rx_stream->buffer + rx_stream->head + header_len,
+               copy_len);
+        rx_stream->head += header_len + copy_len;
+
+        left_len = metadata_st.payload_size - copy_len;
+        if (left_len > 0) {
+            err = comm_lib_tcp_ll_recv_blocking(handle, buffer + copy_len,
+                                                &left_len);
+            if (err) {
+                lib_commu_pool_buffer_put(buffer);
+                rx_stream->is_failed = 1;
+                lib_commu_bail_force(err);
+            }
+        }
+
+        msgs[*msgs_num].payload = buffer;
+        msgs[*msgs_num].payload_len = metadata_st.payload_size;
+        msgs[*msgs_num].msg_type = metadata_st.msg_type;
+        (*msgs_num)++;
     }
-    safe_free(args);
-    pthread_exit(&err);
+
+bail:
+    return err;
 }
 
 
+static void
+handle_msgs_stats_update(handle_t handle, int is_rx, uint32_t msgs_num,
+                         int err)
+{
+    if (!g_lib_commu_init_done) {
+        return;
+    }
+
+    if (msgs_num > 0) {
+        (void)handle_stats_counter_add(handle,
+                                       is_rx ? HANDLE_STATS_RX_MSGS :
+                                       HANDLE_STATS_TX_MSGS, msgs_num);
+    }
+    if (err) {
+        (void)handle_stats_counter_add(handle,
+                                       is_rx ? HANDLE_STATS_RX_ERRORS :
+                                       HANDLE_STATS_TX_ERRORS, 1);
+    }
+}
+
 static int
-create_server_event_socket(int *fd, uint16_t idx)
+udp_iov_send(handle_t handle, struct addr_info recipient_st,
+             const struct iovec *payload_iov, uint32_t iov_num,
+             uint32_t *payload_len)
 {
     int err = 0;
-    int len = 0;
-    struct sockaddr_un s_addr;
 
-    memset(&s_addr, 0, sizeof(s_addr));
+    struct msg_header header_st;
+    struct handle_info *handle_info_st = NULL;
+    struct iovec iov[MAX_UDP_PAYLOAD_IOV + 1];
+    uint32_t buffer_len = 0;
+    uint32_t header_len = 0;
+    uint32_t total_payload_len = 0;
+    uint32_t i = 0;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+
+    memset((char*) &header_st, 0, sizeof(header_st));
 
-    lib_commu_bail_null(fd);
+    for (i = 0; i < iov_num; i++) {
+        total_payload_len += payload_iov[i].iov_len;
+    }
+    *payload_len = 0;
 
-    *fd = 0;
+    if (total_payload_len > MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                total_payload_len);
+        lib_commu_bail_force(EOVERFLOW);
+    }
 
-    /* Create socket from which to read. */
-    *fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (*fd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Could not create socket err(%d) :%s\n",
-                errno, strerror(errno));
-        lib_commu_bail_force(errno);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type,
+                                        NULL);
+    lib_commu_bail_error(err);
+
+    err = msg_header_set(&header_st, total_payload_len,
+                         MAX_UDP_MSG_SIZE - total_payload_len, handle_info_st,
+                         &header_len);
+    lib_commu_bail_error(err);
+
+    /* the header and the payload are gathered by the socket */
+    iov[0].iov_base = &header_st;
+    iov[0].iov_len = header_len;
+    memcpy(&iov[1], payload_iov, iov_num * sizeof(*payload_iov));
+    buffer_len = header_len + total_payload_len;
+
+    /* sending the payload */
+    err = comm_lib_udp_ll_send(handle, recipient_st, iov, iov_num + 1,
+                               &buffer_len);
+    if (buffer_len > header_len) {
+        *payload_len = buffer_len - header_len;
+    }
+    if (err != 0) {
+        lib_commu_bail_force(EIO);
+    }
+
+bail:
+    handle_msgs_stats_update(handle, 0, (err == 0) ? 1 : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
+    return err;
+}
+
+
+static int
+metadata_set(struct msg_metadata *metadata_st, uint8_t version,
+             uint32_t payload_size, struct handle_info handle_info_st)
+{
+    int err = 0;
+
+    lib_commu_bail_null(metadata_st);
+
+    metadata_st->version = version;
+    metadata_st->payload_size = htonl(payload_size);
+    metadata_st->trailer = htonl(handle_info_st.socekt_info.local_magic);
+    metadata_st->msg_type = handle_info_st.conn_info.msg_type;
+
+bail:
+    return err;
+}
+
+static int
+validate_metadata_info(struct msg_metadata *metadata_st,
+                       uint32_t max_paylod_size,
+                       struct handle_info *handle_info_st)
+{
+    int err = 0;
+
+    metadata_st->payload_size = ntohl(metadata_st->payload_size);
+    metadata_st->trailer = ntohl(metadata_st->trailer);
+
+    /* check commu lib msg version, the trace is parsed by the caller */
+    if ((metadata_st->version != MSG_VERSION) &&
+        (metadata_st->version != MSG_TRACE_VERSION)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "comm_lib msg version[%d] != msg version[%u] received\n",
+                MSG_VERSION, metadata_st->version);
+        lib_commu_bail_force(EIO);
+    }
+
+    /* if user payload size <  packet size */
+    if ((max_paylod_size < metadata_st->payload_size)
+        || (metadata_st->payload_size == 0)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                metadata_st->payload_size);
+        lib_commu_bail_force(EOVERFLOW);
+    }
+
+    /* check proper magic */
+    if (handle_info_st->socekt_info.peer_magic == INVALID_MAGIC) {
+        handle_info_st->socekt_info.peer_magic = metadata_st->trailer;
+    }
+    else if (handle_info_st->socekt_info.is_single_peer
+             && (handle_info_st->socekt_info.peer_magic !=
+                 metadata_st->trailer)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid peer magic [%u]\n",
+                metadata_st->trailer);
+        lib_commu_bail_force(EBADE);
+    }
+
+    /* check proper msg type, any type is accepted on general connections */
+    if ((handle_info_st->conn_info.msg_type != GENERAL_MSG_TYPE) &&
+        (metadata_st->msg_type != handle_info_st->conn_info.msg_type)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Connection default msg_type[%u], msg_type received[%u]\n",
+                metadata_st->msg_type, handle_info_st->conn_info.msg_type);
+        lib_commu_bail_force(EBADE);
+    }
+
+
+bail:
+    return err;
+}
+
+
+/* sets the metadata of a message, and its trace on a traced handle if the
+ * header fits max_header_len */
+static int
+msg_header_set(struct msg_header *header_st, uint32_t payload_size,
+               uint32_t max_header_len, struct handle_info *handle_info_st,
+               uint32_t *header_len)
+{
+    int err = 0;
+    enum msg_trace_mode trace_mode = MSG_TRACE_OFF;
+
+    err = metadata_set(&header_st->metadata, MSG_VERSION, payload_size,
+                       *handle_info_st);
+    lib_commu_bail_error(err);
+    *header_len = sizeof(header_st->metadata);
+
+    /* an older peer rejects MSG_TRACE_VERSION, so the trace is sent once
+     * the peers showed they accept it */
+    trace_mode = __atomic_load_n(&handle_info_st->trace_mode,
+                                 __ATOMIC_RELAXED);
+    if ((trace_mode == MSG_TRACE_OFF) ||
+        ((trace_mode == MSG_TRACE_ON_PEER) &&
+         !__atomic_load_n(&handle_info_st->is_peer_traced,
+                          __ATOMIC_RELAXED)) ||
+        (max_header_len < sizeof(*header_st))) {
+        goto bail;
+    }
+
+    header_st->metadata.version = MSG_TRACE_VERSION;
+    header_st->trace.seq =
+        htonl(__atomic_fetch_add(&handle_info_st->trace_tx_seq, 1,
+                                 __ATOMIC_RELAXED));
+    header_st->trace.timestamp_ns = htobe64(time_ns_get());
+    *header_len = sizeof(*header_st);
+
+bail:
+    return err;
+}
+
+
+/* the header length of a validated metadata */
+static uint32_t
+msg_header_len(const struct msg_metadata *metadata_st)
+{
+    return (metadata_st->version == MSG_TRACE_VERSION) ?
+           sizeof(struct msg_header) : sizeof(struct msg_metadata);
+}
+
+
+/* records the trace following a validated metadata of peer_ipv4_addr, trace
+ * may be unaligned */
+static void
+msg_trace_recv(handle_t handle, const struct msg_metadata *metadata_st,
+               uint32_t peer_ipv4_addr, const uint8_t *trace)
+{
+    struct msg_trace trace_st;
+    unsigned long long now_ns = 0;
+    unsigned long long sent_ns = 0;
+
+    if (metadata_st->version != MSG_TRACE_VERSION) {
+        return;
+    }
+
+    now_ns = time_ns_get();
+    memcpy(&trace_st, trace, sizeof(trace_st));
+    sent_ns = be64toh(trace_st.timestamp_ns);
+
+    (void)handle_trace_rx_update(handle, metadata_st->trailer,
+                                 peer_ipv4_addr, ntohl(trace_st.seq),
+                                 (long long)(now_ns - sent_ns));
+}
+
+
+/* a datagram was received after its metadata to payload_buf_len bytes of
+ * payload and a msg_trace sized spill, NULL if the datagram fits payload.
+ * The trace of a traced datagram is recorded and removed from the start
+ * of payload */
+static void
+udp_msg_trace_strip(handle_t handle, const struct msg_metadata *metadata_st,
+                    uint32_t peer_ipv4_addr,
+                    uint8_t *payload, uint32_t payload_buf_len,
+                    const uint8_t *spill)
+{
+    uint8_t trace[sizeof(struct msg_trace)];
+    uint32_t len = sizeof(trace);
+    uint32_t moved_len = 0;
+
+    if (metadata_st->version != MSG_TRACE_VERSION) {
+        return;
+    }
+
+    if (payload_buf_len < len) {
+        len = payload_buf_len;
+    }
+    memcpy(trace, payload, len);
+    if (len < sizeof(trace)) {
+        memcpy(trace + len, spill, sizeof(trace) - len);
+    }
+    msg_trace_recv(handle, metadata_st, peer_ipv4_addr, trace);
+
+    /* the payload follows the trace, its end may be in the spill */
+    if (len == sizeof(trace)) {
+        moved_len = payload_buf_len - len;
+        if (moved_len > metadata_st->payload_size) {
+            moved_len = metadata_st->payload_size;
+        }
+        memmove(payload, payload + len, moved_len);
+        if (moved_len < metadata_st->payload_size) {
+            memcpy(payload + moved_len, spill,
+                   metadata_st->payload_size - moved_len);
+        }
+    }
+    else {
+        memcpy(payload, spill + (sizeof(trace) - len),
+               metadata_st->payload_size);
     }
+}
 
-    s_addr.sun_family = AF_UNIX;
-    strcpy(s_addr.sun_path, listner_exit_event_info_st.event_socket_path[idx]);
-    unlink(s_addr.sun_path);
 
-    len = strlen(s_addr.sun_path) + sizeof(s_addr.sun_family);
-    if (bind(*fd, (struct sockaddr *)&s_addr, len) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to bind socket[%d] err(%d): %s\n",
-                *fd, errno, strerror(
-                    errno));
+static int
+set_sock_buffer_size(int sock_fd)
+{
+    int err = 0;
+    int sock_buff_size = 0;
+
+    sock_buff_size = MAX_JUMBO_TCP_PAYLOAD;
+    if ((setsockopt(sock_fd, 0, SO_RCVBUF, &sock_buff_size,
+                    sizeof(sock_buff_size))) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_RCVBUF], err[%d]: %s\n", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+    if ((setsockopt(sock_fd, 0, SO_SNDBUF, &sock_buff_size,
+                    sizeof(sock_buff_size))) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_SNDBUF], err[%d]: %s\n", errno,
+                strerror(errno));
         lib_commu_bail_force(errno);
     }
 
-    listner_exit_event_info_st.event_fd[idx] = *fd;
+bail:
+    return err;
+}
+
+static int
+set_sock_priority(int sock_fd)
+{
+    int err = 0;
+    int priority = 6;
+    int iptos_precedence = 0xc0 /*IPTOS_CLASS_CS6*/;
+
+    /* Set SO_PRIORITY for VRRP traffic */
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_PRIORITY, &priority,
+                   sizeof(priority)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_PRIORITY], err[%d]: %s\n",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
 
+    if (setsockopt(sock_fd, IPPROTO_IP, IP_TOS, &iptos_precedence,
+                   sizeof(iptos_precedence)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [IP_TOS], err[%d]: %s\n", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
 
 bail:
     return err;
 }
 
 static int
-exit_server_thread(uint16_t idx)
+set_sock_mc_options(int sock_fd, const struct mc_udp_params *mc_params)
 {
     int err = 0;
-    int n_bytes = 0;
-    int send_event_fd = INVALID_HANDLE_ID;
-    struct sockaddr_un s_addr;
-    socklen_t sock_len = 0;
+    int optval = 1;
+    uint8_t ttl = mc_params->ttl ? mc_params->ttl : DEFAULT_MC_TTL;
+    uint8_t is_loopback = mc_params->is_loopback ? 1 : 0;
+    struct in_addr if_addr;
 
-    memset(&s_addr, 0, sizeof(s_addr));
+    if_addr.s_addr = mc_params->ip_udp_params.session_params.s_ipv4_addr;
 
-    send_event_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (send_event_fd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Could not create socket err(%d) :%s\n",
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_REUSEADDR, &optval,
+                   sizeof(optval)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_REUSEADDR], err[%d]: %s\n",
                 errno, strerror(errno));
         lib_commu_bail_force(errno);
     }
 
-    s_addr.sun_family = AF_UNIX;
-    strcpy(s_addr.sun_path, listner_exit_event_info_st.event_socket_path[idx]);
-    sock_len = strlen(s_addr.sun_path) + sizeof(s_addr.sun_family);
+    /* deliver only the groups joined on this socket, not on any socket of
+     * the host bound to the port */
+    optval = 0;
+    if (setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_ALL, &optval,
+                   sizeof(optval)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [IP_MULTICAST_ALL], err[%d]: %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
 
-    n_bytes = sendto(send_event_fd, &idx, sizeof(idx), 0,
-                     (const struct sockaddr*) &s_addr, sock_len);
-    if (n_bytes < 0) {
+    if (setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl,
+                   sizeof(ttl)) < 0) {
         LCM_LOG(LCOMMU_LOG_ERROR,
-                "Writing to socket[%d] on path: %s, failed with err(%d): %s\n",
-                listner_exit_event_info_st.event_fd[idx], s_addr.sun_path,
+                "Fail setting sock options [IP_MULTICAST_TTL], err[%d]: %s\n",
                 errno, strerror(errno));
         lib_commu_bail_force(errno);
     }
 
-    listner_exit_event_info_st.event_fd[idx] = INVALID_HANDLE_ID;
+    if (setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_LOOP, &is_loopback,
+                   sizeof(is_loopback)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [IP_MULTICAST_LOOP], err[%d]: %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
 
+    if ((if_addr.s_addr != INADDR_ANY) &&
+        (setsockopt(sock_fd, IPPROTO_IP, IP_MULTICAST_IF, &if_addr,
+                    sizeof(if_addr)) < 0)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [IP_MULTICAST_IF], err[%d]: %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
 
 bail:
-    close_socket_wrapper(send_event_fd);
     return err;
 }
 
+static int
+set_sock_mc_membership(int sock_fd, uint32_t group_ipv4_addr,
+                       uint32_t if_ipv4_addr, int is_join)
+{
+    int err = 0;
+    struct ip_mreq mreq;
+
+    if (!IN_MULTICAST(ntohl(group_ipv4_addr))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid multicast group [0x%x]\n",
+                ntohl(group_ipv4_addr));
+        lib_commu_bail_force(EINVAL);
+    }
+
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = group_ipv4_addr;
+    mreq.imr_interface.s_addr = if_ipv4_addr;
+
+    if (setsockopt(sock_fd, IPPROTO_IP,
+                   is_join ? IP_ADD_MEMBERSHIP : IP_DROP_MEMBERSHIP,
+                   &mreq, sizeof(mreq)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [%s] group[0x%x], err[%d]: %s\n",
+                is_join ? "IP_ADD_MEMBERSHIP" : "IP_DROP_MEMBERSHIP",
+                ntohl(group_ipv4_addr), errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+bail:
+    return err;
+}
+
+static int
+set_sock_ka(int sock_fd)
+{
+    int err = 0;
+    int optval = 1;
+    int keepcnt = 3;
+    int keepidle = 2;
+    int keepintvl = 1;
+
+    if (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPCNT, &keepcnt,
+                   sizeof(keepcnt)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [TCP_KEEPCNT], err[%d]: %s\n",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    if (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPIDLE, &keepidle,
+                   sizeof(keepidle)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [TCP_KEEPIDLE], err[%d]: %s\n",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    if (setsockopt(sock_fd, IPPROTO_TCP, TCP_KEEPINTVL, &keepintvl,
+                   sizeof(keepintvl)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [TCP_KEEPINTVL], err[%d]: %s\n",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* Set SO_KEEPALIVE */
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_KEEPALIVE, &optval,
+                   sizeof(optval)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_KEEPALIVE], err[%d]: %s\n",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+bail:
+    return err;
+}
+
+/* the address to bind/connect a stream socket of the transport */
+static int
+stream_sockaddr_set(enum stream_transport transport, uint32_t ipv4_addr,
+                    uint16_t port, struct sockaddr_storage *addr,
+                    socklen_t *addr_len)
+{
+    int err = 0;
+    struct sockaddr_in *in_addr = (struct sockaddr_in*)addr;
+    struct sockaddr_un *un_addr = (struct sockaddr_un*)addr;
+
+    memset(addr, 0, sizeof(*addr));
+
+    switch (transport) {
+        case STREAM_TRANSPORT_TCP:
+            in_addr->sin_family = AF_INET;
+            in_addr->sin_port = port;
+            in_addr->sin_addr.s_addr = ipv4_addr;
+            *addr_len = sizeof(*in_addr);
+            break;
+
+        case STREAM_TRANSPORT_UNIX:
+            un_addr->sun_family = AF_UNIX;
+            snprintf(un_addr->sun_path, sizeof(un_addr->sun_path),
+                     UNIX_STREAM_SOCK_PATH, ntohs(port));
+            *addr_len = sizeof(*un_addr);
+            break;
+
+        default:
+            LCM_LOG(LCOMMU_LOG_ERROR, "Invalid stream transport[%d]\n",
+                    transport);
+            lib_commu_bail_force(EINVAL);
+    }
+
+bail:
+    return err;
+}
+
+/* unlinks the path of a UNIX server only if no server accepts on it */
+static int
+unix_stream_path_reclaim(const struct sockaddr_storage *addr,
+                         socklen_t addr_len)
+{
+    int err = 0;
+    int sock_fd = INVALID_HANDLE_ID;
+    const struct sockaddr_un *un_addr = (const struct sockaddr_un*)addr;
+
+    /* non blocking: connect of a full backlog waits instead of failing */
+    sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock_fd < 0) {
+        err = errno;
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to open UNIX socket, err[%s]\n",
+                strerror(err));
+        goto bail;
+    }
+
+    if (connect(sock_fd, (const struct sockaddr*)addr, addr_len) == 0) {
+        err = EADDRINUSE;
+    }
+    else if (errno == ECONNREFUSED) {
+        /* a path left by a server which wasn't stopped */
+        unlink(un_addr->sun_path);
+    }
+    else if (errno != ENOENT) {
+        /* EAGAIN is a live server with a full backlog */
+        err = EADDRINUSE;
+    }
+
+    if (err) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "UNIX path[%s] is used by a server\n",
+                un_addr->sun_path);
+    }
+
+bail:
+    if (sock_fd >= 0) {
+        close(sock_fd);
+    }
+    return err;
+}
+
+/* UNIX domain peers are reported as the loopback address */
+static void
+stream_sockaddr_addr_info_get(const struct sockaddr_storage *addr,
+                              struct addr_info *addr_info_st)
+{
+    const struct sockaddr_in *in_addr = (const struct sockaddr_in*)addr;
+
+    if (addr->ss_family == AF_INET) {
+        addr_info_st->ipv4_addr = in_addr->sin_addr.s_addr;
+        addr_info_st->port = in_addr->sin_port;
+    }
+    else {
+        addr_info_st->ipv4_addr = htonl(INADDR_LOOPBACK);
+        addr_info_st->port = 0;
+    }
+}
+
+/* the TCP/IP socket options don't apply to UNIX domain sockets */
+static int
+stream_sock_options_set(int sock_fd, enum stream_transport transport,
+                        int is_ka)
+{
+    int err = 0;
+    int sock_buff_size = MAX_JUMBO_TCP_PAYLOAD;
+
+    if (transport == STREAM_TRANSPORT_UNIX) {
+        /* UNIX stream sockets queue the sent bytes on the peer up to SO_SNDBUF */
+        if (setsockopt(sock_fd, SOL_SOCKET, SO_SNDBUF, &sock_buff_size,
+                       sizeof(sock_buff_size)) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Fail setting sock options [SO_SNDBUF], err[%d]: %s\n",
+                    errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+        goto bail;
+    }
+
+    /* enlarge soeckt send/recv buffer to max tcp jumbo size */
+    err = set_sock_buffer_size(sock_fd);
+    lib_commu_bail_error(err);
+
+    /* set priority on socket */
+    err = set_sock_priority(sock_fd);
+    lib_commu_bail_error(err);
+
+    if (is_ka) {
+        /* set keepalive on socket */
+        err = set_sock_ka(sock_fd);
+        lib_commu_bail_error(err);
+    }
+
+bail:
+    return err;
+}
+
+static int
+listener_socket_open(struct sockaddr_storage *addr, socklen_t addr_len,
+                     int is_reuseport, int *listener_fd)
+{
+    int err = 0;
+    int listener = INVALID_HANDLE_ID;
+    int optval = 0;
+    int fd_flags = 0;
+
+    listener = socket(addr->ss_family, SOCK_STREAM, 0);
+    if (-1 == listener) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Can't create socket, err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /*binding the listener socket*/
+    optval = 1; /* Set the option active */
+    if (-1 == setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &optval,
+                         sizeof(optval))) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_REUSEADDR], err[%d]: %s\n",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* the kernel spreads the incoming connections between the listeners */
+    if (is_reuseport &&
+        (-1 == setsockopt(listener, SOL_SOCKET, SO_REUSEPORT, &optval,
+                          sizeof(optval)))) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_REUSEPORT], err[%d]: %s\n",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    if (bind(listener, (struct sockaddr *) addr, addr_len) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Bind listener socket[%d] failed err(%u): %s\n",
+                listener, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* the reactor thread is shared by all servers - never block on accept */
+    if (((fd_flags = fcntl(listener, F_GETFL, 0)) < 0) ||
+        (fcntl(listener, F_SETFL, fd_flags | O_NONBLOCK) < 0)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "fcntl failed: on socket[%d] err(%u): %s",
+                listener, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    if (listen(listener, PENDING_CONNECTIOS_SIZE) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "listen() failed on listener socket[%d] failed with err(%d): %s\n",
+                listener, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    *listener_fd = listener;
+
+bail:
+    if (err && (listener != INVALID_HANDLE_ID)) {
+        close_socket_wrapper(listener);
+    }
+    return err;
+}
+
+
+static void
+listener_connection_add(struct listener_session *session, int new_sock,
+                        struct sockaddr_storage *client_addr)
+{
+    int err = 0;
+    uint32_t local_magic = INVALID_MAGIC;
+    int is_db_locked = 0;
+    int is_db_set = 0;
+    struct addr_info peer_addr_info;
+    struct addr_info local_addr_info;
+    int is_sock_sent_client = 0;
+
+    memset(&peer_addr_info, 0, sizeof(peer_addr_info));
+    memset(&local_addr_info, 0, sizeof(local_addr_info));
+
+    local_addr_info.ipv4_addr = session->params.s_ipv4_addr;
+    local_addr_info.port = session->params.port;
+
+    err = stream_sock_options_set(new_sock, session->params.transport, 1);
+    lib_commu_bail_error(err);
+
+    /*start update DB*/
+    err = pseudo_random_uint32_get(&local_magic);   /* get local magic */
+    lib_commu_bail_error(err);
+
+    stream_sockaddr_addr_info_get(client_addr, &peer_addr_info); /* set peer addr */
+
+    err = pthread_mutex_lock(&lock_listener_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    err = lib_commu_db_tcp_server_handle_info_set(session->server_id,
+                                                  new_sock,
+                                                  session->params.msg_type,
+                                                  local_addr_info,
+                                                  peer_addr_info, local_magic);
+    lib_commu_bail_error(err);
+    is_db_set = 1;
+
+    err = pthread_mutex_unlock(&lock_listener_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 0;
+    /*finish update DB*/
+
+    /*send new socket to client*/
+    err = session->clbk_st.clbk_notify_func(new_sock, peer_addr_info,
+                                            session->clbk_st.data, 0);
+    is_sock_sent_client = 1;
+    lib_commu_bail_error(err);
+
+bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_listener_db_access);
+    }
+    if (err) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to accept connection on server id[%u] with err(%d)\n",
+                session->server_id, err);
+        if (!is_sock_sent_client) {
+            if (is_db_set) {
+                lib_commu_db_tcp_handle_info_delete(new_sock);
+            }
+            close_socket_wrapper(new_sock);
+        }
+    }
+}
+
+
+static void
+listener_accept_handler(struct lib_commu_reactor_item *item, uint32_t events)
+{
+    int new_sock = INVALID_HANDLE_ID;
+    uint32_t i = 0;
+    struct sockaddr_storage client_addr;
+    socklen_t sin_size = 0;
+    struct listener_acceptor *acceptor = NULL;
+
+    UNUSED_PARAM(events);
+
+    acceptor = (struct listener_acceptor*)item->ctx;
+
+    /* drain up to a batch of new connections, the listener is level
+     * triggered so a longer backlog is served on the next event */
+    for (i = 0; i < ACCEPT_BATCH_NUM; i++) {
+        memset((char*)&client_addr, 0, sizeof(client_addr));
+        sin_size = sizeof(client_addr);
+
+        new_sock = accept4(acceptor->listener_fd,
+                           (struct sockaddr *) &client_addr, &sin_size,
+                           SOCK_CLOEXEC);
+        if (new_sock < 0) {
+            if ((errno == EINTR) || (errno == ECONNABORTED)) {
+                /* connection was reset before accept, try the next one */
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "accept4() on listener socket[%d] failed with err(%d): %s\n",
+                        acceptor->listener_fd, errno, strerror(errno));
+            }
+            break;
+        }
+
+        listener_connection_add(acceptor->session, new_sock, &client_addr);
+    }
+}
+
+
+static void
+listener_event_handler(struct lib_commu_reactor_item *item, uint32_t events)
+{
+    int err = 0;
+    struct sockaddr_storage listener_addr;
+    socklen_t listener_addr_len = 0;
+    struct sockaddr_un *unix_addr = NULL;
+    struct listener_acceptor *acceptor = NULL;
+    struct listener_session *session = NULL;
+
+    UNUSED_PARAM(events);
+
+    acceptor = (struct listener_acceptor*)item->ctx;
+    session = acceptor->session;
+
+    /* the eventfd isn't read: it stays readable for the other acceptors */
+    LCM_LOG(LCOMMU_LOG_NOTICE, "Received exit event on server id[%d]",
+            session->server_id);
+
+    /* session is released once the reactor is done with the current batch */
+    if (acceptor->is_listening) {
+        lib_commu_reactor_item_remove(&acceptor->listener_item);
+    }
+    lib_commu_reactor_item_remove(&acceptor->event_item);
+
+    err = close_socket_wrapper(acceptor->listener_fd);
+    lib_commu_bail_error(err);
+
+    if (session->params.transport == STREAM_TRANSPORT_UNIX) {
+        unix_addr = (struct sockaddr_un*)&listener_addr;
+        if (stream_sockaddr_set(STREAM_TRANSPORT_UNIX, 0, session->params.port,
+                                &listener_addr, &listener_addr_len) == 0) {
+            unlink(unix_addr->sun_path);
+        }
+    }
+
+bail:
+    return;
+}
+
+
+static void
+listener_release(struct lib_commu_reactor_item *item)
+{
+    struct listener_acceptor *acceptor = (struct listener_acceptor*)item->ctx;
+    struct listener_session *session = acceptor->session;
+
+    pthread_mutex_lock(&lock_listener_db_access);
+    session->released_num++;
+    if (session->released_num == session->started_num) {
+        LCM_LOG(LCOMMU_LOG_NOTICE, "Exit from listener, server id[%u]\n",
+                session->server_id);
+        session->is_stopped = 1;
+        pthread_cond_broadcast(&listener_stop_cond);
+    }
+    pthread_mutex_unlock(&lock_listener_db_access);
+}
+
+
+/*
+ * Signals the exit event to all the acceptors of a session and waits till
+ * the reactor released them. Listener sockets of acceptors which weren't
+ * started are closed here.
+ */
+static int
+listener_session_stop_wait(struct listener_session *session)
+{
+    int err = 0;
+    uint32_t i = 0;
+
+    if (session->started_num > 0) {
+        if (eventfd_write(session->event_fd, 1) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Writing to exit eventfd[%d] failed with err(%d): %s\n",
+                    session->event_fd, errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+
+        err = pthread_mutex_lock(&lock_listener_db_access);
+        lib_commu_bail_error(err);
+        while (!session->is_stopped) {
+            pthread_cond_wait(&listener_stop_cond, &lock_listener_db_access);
+        }
+        err = pthread_mutex_unlock(&lock_listener_db_access);
+        lib_commu_bail_error(err);
+    }
+
+    for (i = session->started_num; i < session->acceptors_num; i++) {
+        if (session->acceptors[i].listener_fd != INVALID_HANDLE_ID) {
+            close_socket_wrapper(session->acceptors[i].listener_fd);
+            session->acceptors[i].listener_fd = INVALID_HANDLE_ID;
+        }
+    }
+
+    if (session->event_fd != INVALID_HANDLE_ID) {
+        close_socket_wrapper(session->event_fd);
+        session->event_fd = INVALID_HANDLE_ID;
+    }
+
+bail:
+    return err;
+}
+
+
+static int
+handle_reactor_get(handle_t handle, struct handle_info *handle_info_st,
+                   struct handle_reactor **handle_reactor)
+{
+    int err = 0;
+    int is_db_locked = 0;
+    int is_reactor_init = 0;
+    struct handle_reactor *new_reactor = NULL;
+
+    *handle_reactor = __atomic_load_n(&handle_info_st->handle_reactor,
+                                      __ATOMIC_ACQUIRE);
+    if (*handle_reactor != NULL) {
+        goto bail;
+    }
+
+    err = pthread_mutex_lock(&lock_handle_reactor_alloc);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    /* allocated by another thread meanwhile */
+    if (handle_info_st->handle_reactor != NULL) {
+        *handle_reactor = handle_info_st->handle_reactor;
+        goto bail;
+    }
+
+    new_reactor = (struct handle_reactor *)calloc(1, sizeof(*new_reactor));
+    if (new_reactor == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to allocate reactor registration of handle[%d]\n",
+                handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    pthread_mutex_init(&new_reactor->lock, NULL);
+    pthread_cond_init(&new_reactor->handler_cond, NULL);
+    is_reactor_init = 1;
+    new_reactor->handle = handle;
+    new_reactor->handle_info_st = handle_info_st;
+    new_reactor->item.fd = handle;
+    new_reactor->item.handler = handle_reactor_handler;
+    new_reactor->item.release = handle_reactor_release;
+    new_reactor->item.ctx = new_reactor;
+
+    /* disarmed till a callback is set or a message is queued */
+    err = lib_commu_reactor_item_add(&new_reactor->item, EPOLLONESHOT,
+                                     REACTOR_ANY_THREAD);
+    lib_commu_bail_error(err);
+
+    __atomic_store_n(&handle_info_st->handle_reactor, new_reactor,
+                     __ATOMIC_RELEASE);
+    *handle_reactor = new_reactor;
+    new_reactor = NULL;
+
+bail:
+    if (new_reactor != NULL) {
+        if (is_reactor_init) {
+            pthread_cond_destroy(&new_reactor->handler_cond);
+            pthread_mutex_destroy(&new_reactor->lock);
+        }
+        safe_free(new_reactor);
+    }
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_handle_reactor_alloc);
+    }
+    return err;
+}
+
+
+/* arms the one shot item with the events wanted, none disarms it.
+ * Called under handle_reactor->lock */
+static int
+handle_reactor_arm(struct handle_reactor *handle_reactor)
+{
+    if (handle_reactor->is_removed) {
+        return 0;
+    }
+    return lib_commu_reactor_item_modify(&handle_reactor->item,
+                                         handle_reactor->events |
+                                         EPOLLONESHOT);
+}
+
+
+/* delivers the messages received to the callback and sends the messages
+ * queued, an error is reported to both as it's polled on either event */
+static void
+handle_reactor_handler(struct lib_commu_reactor_item *item, uint32_t events)
+{
+    struct handle_reactor *handle_reactor = (struct handle_reactor*)item->ctx;
+    struct rx_callback *rx_callback = NULL;
+    struct tx_queue *tx_queue = NULL;
+    int is_detached = 0;
+
+    pthread_mutex_lock(&handle_reactor->lock);
+    /* closed by another thread in this batch of events */
+    if (handle_reactor->is_removed) {
+        pthread_mutex_unlock(&handle_reactor->lock);
+        return;
+    }
+    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) &&
+        (handle_reactor->rx_callback != NULL) &&
+        !handle_reactor->rx_callback->is_stopped) {
+        rx_callback = handle_reactor->rx_callback;
+    }
+    if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+        tx_queue = handle_reactor->tx_queue;
+    }
+    handle_reactor->rx_running = rx_callback;
+    handle_reactor->handler_thread = pthread_self();
+    handle_reactor->is_in_handler = 1;
+    pthread_mutex_unlock(&handle_reactor->lock);
+
+    if (rx_callback != NULL) {
+        rx_callback_handler(handle_reactor, rx_callback);
+
+        pthread_mutex_lock(&handle_reactor->lock);
+        handle_reactor->rx_running = NULL;
+        is_detached = rx_callback->is_detached;
+        pthread_cond_broadcast(&handle_reactor->handler_cond);
+        pthread_mutex_unlock(&handle_reactor->lock);
+
+        if (is_detached) {
+            rx_callback_free(rx_callback);
+        }
+    }
+
+    if (tx_queue != NULL) {
+        tx_queue_handler(handle_reactor, tx_queue);
+    }
+
+    pthread_mutex_lock(&handle_reactor->lock);
+    handle_reactor->is_in_handler = 0;
+    if (handle_reactor->events != 0) {
+        (void)handle_reactor_arm(handle_reactor);
+    }
+    pthread_mutex_unlock(&handle_reactor->lock);
+}
+
+
+static void
+handle_reactor_release(struct lib_commu_reactor_item *item)
+{
+    struct handle_reactor *handle_reactor = (struct handle_reactor*)item->ctx;
+    struct handle_info *handle_info_st = handle_reactor->handle_info_st;
+    int is_detached = 0;
+
+    pthread_mutex_lock(&handle_reactor->lock);
+    handle_reactor->is_released = 1;
+    is_detached = handle_reactor->is_detached;
+    pthread_cond_broadcast(&handle_reactor->handler_cond);
+    pthread_mutex_unlock(&handle_reactor->lock);
+
+    if (is_detached) {
+        handle_reactor_free(handle_reactor);
+        handle_close_pending_put(handle_info_st);
+    }
+}
+
+
+/* completes the messages still queued with ECANCELED */
+static void
+handle_reactor_free(struct handle_reactor *handle_reactor)
+{
+    if (handle_reactor->tx_queue != NULL) {
+        tx_queue_free(handle_reactor->tx_queue);
+    }
+    if (handle_reactor->rx_callback != NULL) {
+        rx_callback_free(handle_reactor->rx_callback);
+    }
+    pthread_cond_destroy(&handle_reactor->handler_cond);
+    pthread_mutex_destroy(&handle_reactor->lock);
+    safe_free(handle_reactor);
+}
+
+
+/* removes the socket from the reactor, after the receive callback was
+ * stopped. Called before the handle is closed. A reactor thread doesn't wait
+ * for the release, which may be its own or wait for it, the reactor frees
+ * the registration and closes the handle then, see handle_close */
+static void
+handle_reactor_stop(struct handle_info *handle_info_st)
+{
+    struct handle_reactor *handle_reactor = NULL;
+    int err = 0;
+
+    handle_reactor = __atomic_exchange_n(&handle_info_st->handle_reactor, NULL,
+                                         __ATOMIC_ACQ_REL);
+    if (handle_reactor == NULL) {
+        return;
+    }
+    __atomic_store_n(&handle_info_st->tx_queue, NULL, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&handle_reactor->lock);
+    if (handle_reactor->is_in_handler &&
+        pthread_equal(handle_reactor->handler_thread, pthread_self())) {
+        err = lib_commu_reactor_item_remove(&handle_reactor->item);
+    }
+    else {
+        err = lib_commu_reactor_item_remove_async(&handle_reactor->item);
+    }
+    handle_reactor->is_removed = 1;
+
+    /* the item is released, or not referenced if removing it failed */
+    if ((err == 0) && lib_commu_reactor_thread_is_current()) {
+        __atomic_add_fetch(&handle_info_st->close_pending, 1,
+                           __ATOMIC_ACQ_REL);
+        handle_reactor->is_detached = 1;
+        pthread_mutex_unlock(&handle_reactor->lock);
+        return;
+    }
+    while ((err == 0) && !handle_reactor->is_released) {
+        pthread_cond_wait(&handle_reactor->handler_cond,
+                          &handle_reactor->lock);
+    }
+    pthread_mutex_unlock(&handle_reactor->lock);
+
+    handle_reactor_free(handle_reactor);
+}
+
+
+static int
+tx_queue_get(handle_t handle, struct handle_info *handle_info_st,
+             struct tx_queue **tx_queue)
+{
+    int err = 0;
+    int is_db_locked = 0;
+    struct handle_reactor *handle_reactor = NULL;
+    struct tx_queue *new_queue = NULL;
+
+    *tx_queue = __atomic_load_n(&handle_info_st->tx_queue, __ATOMIC_ACQUIRE);
+    if (*tx_queue != NULL) {
+        goto bail;
+    }
+
+    err = pthread_mutex_lock(&lock_tx_queue_alloc);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    /* allocated by another thread meanwhile */
+    if (handle_info_st->tx_queue != NULL) {
+        *tx_queue = handle_info_st->tx_queue;
+        goto bail;
+    }
+
+    err = handle_reactor_get(handle, handle_info_st, &handle_reactor);
+    lib_commu_bail_error(err);
+
+    new_queue = (struct tx_queue *)calloc(1, sizeof(*new_queue) +
+                                          MAX_TX_QUEUE_MSGS *
+                                          sizeof(new_queue->msgs[0]));
+    if (new_queue == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate tx queue of handle[%d]\n",
+                handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    pthread_mutex_init(&new_queue->lock, NULL);
+    new_queue->handle = handle;
+
+    /* the handler drains it once a message is queued */
+    pthread_mutex_lock(&handle_reactor->lock);
+    handle_reactor->tx_queue = new_queue;
+    pthread_mutex_unlock(&handle_reactor->lock);
+
+    __atomic_store_n(&handle_info_st->tx_queue, new_queue, __ATOMIC_RELEASE);
+    *tx_queue = new_queue;
+
+bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_tx_queue_alloc);
+    }
+    return err;
+}
+
+
+static int
+tx_queue_send_some(struct tx_queue *tx_queue, struct tx_queue_msg *done_msgs,
+                   uint32_t *done_num)
+{
+    int err = 0;
+    struct iovec iov[TX_QUEUE_BATCH_MSGS * 2];
+    struct msghdr msg;
+    struct tx_queue_msg *queue_msg = NULL;
+    uint32_t iov_num = 0;
+    uint32_t msg_len = 0;
+    uint32_t header_len = 0;
+    uint32_t skip = tx_queue->head_sent;
+    uint32_t i = 0;
+    ssize_t nb_sent = 0;
+    uint32_t repeat_times = 0;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+
+    *done_num = 0;
+    memset(&msg, 0, sizeof(msg));
+
+    /* gather the queued messages, skipping the bytes already sent */
+    for (i = 0; (i < tx_queue->msgs_num) && (i < TX_QUEUE_BATCH_MSGS); i++) {
+        queue_msg =
+            &tx_queue->msgs[(tx_queue->head + i) % MAX_TX_QUEUE_MSGS];
+        header_len = msg_header_len(&queue_msg->header.metadata);
+        if (skip < header_len) {
+            iov[iov_num].iov_base = (uint8_t*)&queue_msg->header + skip;
+            iov[iov_num].iov_len = header_len - skip;
+            iov_num++;
+            skip = 0;
+        }
+        else {
+            skip -= header_len;
+        }
+        iov[iov_num].iov_base = queue_msg->payload + skip;
+        iov[iov_num].iov_len = queue_msg->payload_len - skip;
+        iov_num++;
+        skip = 0;
+    }
+
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_num;
+
+    do {
+        nb_sent = sendmsg(tx_queue->handle, &msg,
+                          MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while ((nb_sent < 0) && (errno == EINTR) &&
+             (++repeat_times < SEND_REPEAT_NUM));
+
+    if (repeat_times > 0) {
+        (void)handle_stats_counter_add(tx_queue->handle, HANDLE_STATS_RETRIES,
+                                       repeat_times);
+    }
+
+    if (nb_sent < 0) {
+        if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+            /* wait for the socket to be writable */
+            goto bail;
+        }
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed in sendmsg() on handle[%d] with err[%d]: %s",
+                tx_queue->handle, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    (void)handle_total_tx_update(tx_queue->handle, &handle_db_type, nb_sent);
+
+    /* pop the messages sent completely */
+    while ((nb_sent > 0) && (tx_queue->msgs_num > 0)) {
+        queue_msg = &tx_queue->msgs[tx_queue->head];
+        msg_len = msg_header_len(&queue_msg->header.metadata) +
+                  queue_msg->payload_len - tx_queue->head_sent;
+        if ((size_t)nb_sent < msg_len) {
+            tx_queue->head_sent += nb_sent;
+            break;
+        }
+        nb_sent -= msg_len;
+        memcpy(&done_msgs[(*done_num)++], queue_msg, sizeof(*queue_msg));
+        tx_queue->head = (tx_queue->head + 1) % MAX_TX_QUEUE_MSGS;
+        tx_queue->msgs_num--;
+        tx_queue->head_sent = 0;
+    }
+
+bail:
+    handle_msgs_stats_update(tx_queue->handle, 0, *done_num, err);
+    return err;
+}
+
+
+static void
+tx_queue_msgs_pop(struct tx_queue *tx_queue, struct tx_queue_msg *done_msgs,
+                  uint32_t *done_num)
+{
+    *done_num = 0;
+
+    while ((tx_queue->msgs_num > 0) && (*done_num < TX_QUEUE_BATCH_MSGS)) {
+        memcpy(&done_msgs[(*done_num)++], &tx_queue->msgs[tx_queue->head],
+               sizeof(tx_queue->msgs[tx_queue->head]));
+        tx_queue->head = (tx_queue->head + 1) % MAX_TX_QUEUE_MSGS;
+        tx_queue->msgs_num--;
+    }
+    tx_queue->head_sent = 0;
+}
+
+
+static void
+tx_queue_msgs_complete(handle_t handle, struct tx_queue_msg *done_msgs,
+                       uint32_t done_num, int rc)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < done_num; i++) {
+        done_msgs[i].clbk_st.clbk_send_done_func(handle, done_msgs[i].payload,
+                                                 done_msgs[i].payload_len,
+                                                 done_msgs[i].clbk_st.data,
+                                                 rc);
+    }
+}
+
+
+static void
+tx_queue_handler(struct handle_reactor *handle_reactor,
+                 struct tx_queue *tx_queue)
+{
+    struct tx_queue_msg done_msgs[TX_QUEUE_BATCH_MSGS];
+    uint32_t done_num = 0;
+    int is_more = 0;
+    int rc = 0;
+
+    /* a non empty queue is either waited for or drained here, the callbacks
+     * are called without the lock so they may queue more messages */
+    do {
+        pthread_mutex_lock(&tx_queue->lock);
+
+        rc = 0;
+        done_num = 0;
+        if ((tx_queue->err == 0) && (tx_queue->msgs_num > 0)) {
+            tx_queue->err = tx_queue_send_some(tx_queue, done_msgs,
+                                               &done_num);
+        }
+        if ((tx_queue->err != 0) && (done_num == 0)) {
+            tx_queue_msgs_pop(tx_queue, done_msgs, &done_num);
+            rc = -tx_queue->err;
+        }
+
+        is_more = (tx_queue->msgs_num > 0) &&
+                  ((tx_queue->err != 0) || (done_num == TX_QUEUE_BATCH_MSGS));
+
+        /* the handler arms the socket on its way out */
+        pthread_mutex_lock(&handle_reactor->lock);
+        if ((tx_queue->msgs_num > 0) && (tx_queue->err == 0)) {
+            handle_reactor->events |= EPOLLOUT;
+        }
+        else {
+            handle_reactor->events &= ~EPOLLOUT;
+        }
+        pthread_mutex_unlock(&handle_reactor->lock);
+
+        pthread_mutex_unlock(&tx_queue->lock);
+
+        tx_queue_msgs_complete(tx_queue->handle, done_msgs, done_num, rc);
+    } while (is_more);
+}
+
+
+/* completes the messages not sent yet with ECANCELED and frees the queue,
+ * once the reactor released it */
+static void
+tx_queue_free(struct tx_queue *tx_queue)
+{
+    struct tx_queue_msg done_msgs[TX_QUEUE_BATCH_MSGS];
+    uint32_t done_num = 0;
+
+    do {
+        tx_queue_msgs_pop(tx_queue, done_msgs, &done_num);
+        tx_queue_msgs_complete(tx_queue->handle, done_msgs, done_num,
+                               -ECANCELED);
+    } while (done_num > 0);
+
+    pthread_mutex_destroy(&tx_queue->lock);
+    safe_free(tx_queue);
+}
+
+
+/* completes the messages not sent yet with ECANCELED, the later sends fail
+ * with ECANCELED. The queue is freed with the reactor registration */
+static void
+tx_queue_cancel(struct tx_queue *tx_queue)
+{
+    struct tx_queue_msg done_msgs[TX_QUEUE_BATCH_MSGS];
+    uint32_t done_num = 0;
+
+    do {
+        pthread_mutex_lock(&tx_queue->lock);
+        if (tx_queue->err == 0) {
+            tx_queue->err = ECANCELED;
+        }
+        tx_queue_msgs_pop(tx_queue, done_msgs, &done_num);
+        pthread_mutex_unlock(&tx_queue->lock);
+
+        tx_queue_msgs_complete(tx_queue->handle, done_msgs, done_num,
+                               -ECANCELED);
+    } while (done_num > 0);
+}
+
+
+/* sends the framed messages of a TCP handle, through its coalescing buffer
+ * if it has one */
+static int
+tcp_iov_send(handle_t handle, struct handle_info *handle_info_st,
+             struct iovec *iov, uint32_t iov_num, uint32_t *buffer_len,
+             enum db_type handle_db_type)
+{
+    struct tx_coalesce *tx_coalesce =
+        __atomic_load_n(&handle_info_st->tx_coalesce, __ATOMIC_ACQUIRE);
+    uint32_t zerocopy_min_bytes =
+        __atomic_load_n(&handle_info_st->zerocopy_min_bytes, __ATOMIC_ACQUIRE);
+    struct tcp_zerocopy *tcp_zerocopy = NULL;
+    int err = 0;
+
+    if (tx_coalesce != NULL) {
+        return tx_coalesce_send(tx_coalesce, iov, iov_num, buffer_len,
+                                handle_db_type);
+    }
+    if ((zerocopy_min_bytes > 0) && (*buffer_len >= zerocopy_min_bytes)) {
+        /* set before zerocopy_min_bytes */
+        tcp_zerocopy = __atomic_load_n(&handle_info_st->tcp_zerocopy,
+                                       __ATOMIC_ACQUIRE);
+    }
+    if (tcp_zerocopy == NULL) {
+        return comm_lib_tcp_ll_sendmsg_blocking(handle, iov, iov_num,
+                                                buffer_len, handle_db_type,
+                                                NULL);
+    }
+
+    pthread_mutex_lock(&tcp_zerocopy->lock);
+    err = comm_lib_tcp_ll_sendmsg_blocking(handle, iov, iov_num, buffer_len,
+                                           handle_db_type, tcp_zerocopy);
+    pthread_mutex_unlock(&tcp_zerocopy->lock);
+    return err;
+}
+
+
+/* the sends of the TCP handle are single sendmsg() calls, without shared
+ * memory, coalescing or zerocopy */
+static int
+tcp_iov_is_plain(struct handle_info *handle_info_st)
+{
+    return (__atomic_load_n(&handle_info_st->shm_link,
+                            __ATOMIC_ACQUIRE) == NULL) &&
+           (__atomic_load_n(&handle_info_st->tx_coalesce,
+                            __ATOMIC_ACQUIRE) == NULL) &&
+           (__atomic_load_n(&handle_info_st->zerocopy_min_bytes,
+                            __ATOMIC_ACQUIRE) == 0);
+}
+
+
+/* sends the framed messages of plain TCP handles through the io_uring of the
+ * calling thread, up to URING_ENTRIES_NUM sendmsg() per io_uring_enter.
+ * Adjacent sends of a handle are linked to keep their order, the bytes a
+ * short or a canceled send left are sent by the blocking path */
+static void
+tcp_uring_sends(struct tcp_uring_send *sends, struct lib_commu_uring_op *ops,
+                uint32_t sends_num)
+{
+    int chain_err = 0;
+    int err_bail = 0;
+    uint32_t rest_len = 0;
+    uint32_t i = 0;
+    ssize_t nb_sent = 0;
+    struct msghdr *msg = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    unsigned long long start_ns = time_ns_get();
+    unsigned long long elapsed_ns = 0;
+
+    memset(ops, 0, sends_num * sizeof(*ops));
+    for (i = 0; i < sends_num; i++) {
+        ops[i].type = LIB_COMMU_URING_OP_SENDMSG;
+        ops[i].fd = sends[i].handle;
+        /* a send racing the close of the handle fails with EPIPE, a short
+         * send fails the link with MSG_WAITALL only */
+        ops[i].flags = MSG_NOSIGNAL | MSG_WAITALL;
+        ops[i].msg = &sends[i].msg;
+        ops[i].is_linked = ((i + 1) < sends_num) &&
+                           (sends[i + 1].handle == sends[i].handle);
+    }
+
+    /* a ring failure is the err of the sends which didn't complete */
+    (void)lib_commu_uring_submit(ops, sends_num);
+    elapsed_ns = time_ns_get() - start_ns;
+
+    for (i = 0; i < sends_num; i++) {
+        if ((i == 0) || !ops[i - 1].is_linked) {
+            chain_err = 0;
+        }
+        handle_db_type = sends[i].db_type;
+        nb_sent = ops[i].nb;
+        sends[i].err = 0;
+
+        /* a send after a failed one of its handle isn't tried */
+        if (chain_err) {
+            sends[i].err = chain_err;
+            sends[i].total_len = 0;
+            continue;
+        }
+        if ((ops[i].err != 0) && (ops[i].err != ECANCELED)) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed in sendmsg() on handle[%d] with err[%d]: %s",
+                    sends[i].handle, ops[i].err, strerror(ops[i].err));
+            sends[i].err = ops[i].err;
+            sends[i].total_len = 0;
+            chain_err = sends[i].err;
+            continue;
+        }
+
+        if (nb_sent > 0) {
+            (void)handle_io_hists_update(sends[i].handle, 0, elapsed_ns,
+                                         nb_sent, 0);
+            err_bail = handle_total_tx_update(sends[i].handle,
+                                              &handle_db_type, nb_sent);
+            if (err_bail) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "Failed in to update tx[%zd] on handle[%d]\n",
+                        nb_sent, sends[i].handle);
+                sends[i].err = err_bail;
+            }
+        }
+
+        if ((uint32_t)nb_sent < sends[i].total_len) {
+            /* skip the iovecs sent and adjust the partially sent one */
+            msg = &sends[i].msg;
+            rest_len = sends[i].total_len - nb_sent;
+            while ((nb_sent > 0) && (msg->msg_iovlen > 0)) {
+                if ((size_t)nb_sent < msg->msg_iov->iov_len) {
+                    msg->msg_iov->iov_base =
+                        (uint8_t*)msg->msg_iov->iov_base + nb_sent;
+                    msg->msg_iov->iov_len -= nb_sent;
+                    nb_sent = 0;
+                }
+                else {
+                    nb_sent -= msg->msg_iov->iov_len;
+                    msg->msg_iov++;
+                    msg->msg_iovlen--;
+                }
+            }
+            nb_sent = sends[i].total_len - rest_len;
+            sends[i].err = comm_lib_tcp_ll_sendmsg_blocking(sends[i].handle,
+                                                            msg->msg_iov,
+                                                            msg->msg_iovlen,
+                                                            &rest_len,
+                                                            handle_db_type,
+                                                            NULL);
+            nb_sent += rest_len;
+            chain_err = sends[i].err;
+        }
+        sends[i].total_len = nb_sent;
+    }
+}
+
+
+/* frames the messages of a batch into header_st and iov (2 per message) */
+static int
+tcp_batch_frame(struct handle_info *handle_info_st, struct tcp_send_msg *msgs,
+                uint32_t msgs_num, struct msg_header *header_st,
+                struct iovec *iov, uint32_t *total_len)
+{
+    int err = 0;
+    uint32_t header_len = 0;
+    uint32_t i = 0;
+
+    *total_len = 0;
+    for (i = 0; i < msgs_num; i++) {
+        err = msg_header_set(&header_st[i], msgs[i].payload_len,
+                             sizeof(header_st[i]), handle_info_st,
+                             &header_len);
+        lib_commu_bail_error(err);
+        header_st[i].metadata.msg_type = msgs[i].msg_type;
+
+        iov[2 * i].iov_base = &header_st[i];
+        iov[2 * i].iov_len = header_len;
+        iov[2 * i + 1].iov_base = msgs[i].payload;
+        iov[2 * i + 1].iov_len = msgs[i].payload_len;
+        *total_len += header_len + msgs[i].payload_len;
+    }
+
+bail:
+    return err;
+}
+
+
+/* #messages of a framed batch which were completely sent in sent_len bytes */
+static uint32_t
+tcp_batch_msgs_sent(const struct msg_header *header_st,
+                    const struct tcp_send_msg *msgs, uint32_t msgs_num,
+                    uint32_t sent_len)
+{
+    uint32_t msg_len = 0;
+    uint32_t i = 0;
+
+    for (i = 0; i < msgs_num; i++) {
+        msg_len = msg_header_len(&header_st[i].metadata) +
+                  msgs[i].payload_len;
+        if (sent_len < msg_len) {
+            break;
+        }
+        sent_len -= msg_len;
+    }
+    return i;
+}
+
+
+/* sends up to SEND_BATCH_LINKED batches of a plain TCP handle as linked
+ * sendmsg() of one io_uring submission */
+static int
+tcp_send_batch_linked(handle_t handle, struct handle_info *handle_info_st,
+                      enum db_type handle_db_type, struct tcp_send_msg *msgs,
+                      uint32_t msgs_num, uint32_t *msgs_sent)
+{
+    int err = 0;
+    struct msg_header *header_st = NULL;
+    struct iovec *iov = NULL;
+    struct tcp_uring_send sends[SEND_BATCH_LINKED];
+    struct lib_commu_uring_op ops[SEND_BATCH_LINKED];
+    uint32_t sends_num = 0;
+    uint32_t batch_num = 0;
+    uint32_t first = 0;
+    uint32_t i = 0;
+
+    *msgs_sent = 0;
+
+    if (msgs_num > (SEND_BATCH_MSGS * SEND_BATCH_LINKED)) {
+        msgs_num = SEND_BATCH_MSGS * SEND_BATCH_LINKED;
+    }
+
+    header_st = (struct msg_header *)malloc(msgs_num * sizeof(*header_st));
+    iov = (struct iovec *)malloc(msgs_num * 2 * sizeof(*iov));
+    if ((header_st == NULL) || (iov == NULL)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to allocate the batch of handle[%d]\n", handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    memset(sends, 0, sizeof(sends));
+    for (first = 0; first < msgs_num; first += batch_num) {
+        batch_num = msgs_num - first;
+        if (batch_num > SEND_BATCH_MSGS) {
+            batch_num = SEND_BATCH_MSGS;
+        }
+        err = tcp_batch_frame(handle_info_st, &msgs[first], batch_num,
+                              &header_st[first], &iov[2 * first],
+                              &sends[sends_num].total_len);
+        lib_commu_bail_error(err);
+
+        sends[sends_num].handle = handle;
+        sends[sends_num].db_type = handle_db_type;
+        sends[sends_num].msg.msg_iov = &iov[2 * first];
+        sends[sends_num].msg.msg_iovlen = batch_num * 2;
+        sends_num++;
+    }
+
+    tcp_uring_sends(sends, ops, sends_num);
+
+    /* the sends after a failed one were not tried */
+    first = 0;
+    for (i = 0; i < sends_num; i++) {
+        batch_num = msgs_num - first;
+        if (batch_num > SEND_BATCH_MSGS) {
+            batch_num = SEND_BATCH_MSGS;
+        }
+        if (sends[i].err) {
+            *msgs_sent += tcp_batch_msgs_sent(&header_st[first],
+                                              &msgs[first], batch_num,
+                                              sends[i].total_len);
+            lib_commu_bail_force(sends[i].err);
+        }
+        *msgs_sent += batch_num;
+        first += batch_num;
+    }
+
+bail:
+    free(header_st);
+    free(iov);
+    return err;
+}
+
+
+/* orders the messages of comm_lib_tcp_send_multi_blocking by handle, keeping
+ * the array order of each handle */
+static int
+tcp_multi_msg_cmp(const void *a, const void *b)
+{
+    const struct tcp_multi_msg *msg_a = (const struct tcp_multi_msg *)a;
+    const struct tcp_multi_msg *msg_b = (const struct tcp_multi_msg *)b;
+
+    if (msg_a->msg->handle != msg_b->msg->handle) {
+        return (msg_a->msg->handle < msg_b->msg->handle) ? -1 : 1;
+    }
+    if (msg_a->msg != msg_b->msg) {
+        return (msg_a->msg < msg_b->msg) ? -1 : 1;
+    }
+    return 0;
+}
+
+
+/* validates a message of comm_lib_tcp_send_multi_blocking and frames it,
+ * holding its handle */
+static int
+tcp_multi_msg_frame(struct tcp_multi_msg *multi_msg)
+{
+    int err = 0;
+    uint32_t header_len = 0;
+    struct tcp_send_handle_msg *msg = multi_msg->msg;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+
+    lib_commu_bail_null(msg->payload);
+
+    if (msg->payload_len >
+        (MAX_JUMBO_TCP_PAYLOAD - sizeof(struct msg_metadata))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u] handle[%d]\n",
+                msg->payload_len, msg->handle);
+        lib_commu_bail_force(EOVERFLOW);
+    }
+
+    err = lib_commu_db_handle_info_hold(msg->handle,
+                                        &multi_msg->handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+    multi_msg->db_type = handle_db_type;
+
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB)
+        && (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid handle type[%d]\n", handle_db_type);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = msg_header_set(&multi_msg->header_st, msg->payload_len,
+                         sizeof(multi_msg->header_st),
+                         multi_msg->handle_info_st, &header_len);
+    lib_commu_bail_error(err);
+
+    multi_msg->iov[0].iov_base = &multi_msg->header_st;
+    multi_msg->iov[0].iov_len = header_len;
+    multi_msg->iov[1].iov_base = msg->payload;
+    multi_msg->iov[1].iov_len = msg->payload_len;
+    multi_msg->total_len = header_len + msg->payload_len;
+
+bail:
+    return err;
+}
+
+static int
+tcp_zerocopy_get(handle_t handle, struct handle_info *handle_info_st,
+                 struct tcp_zerocopy **tcp_zerocopy)
+{
+    int err = 0;
+    int is_db_locked = 0;
+    struct tcp_zerocopy *new_zerocopy = NULL;
+
+    *tcp_zerocopy = __atomic_load_n(&handle_info_st->tcp_zerocopy,
+                                    __ATOMIC_ACQUIRE);
+    if (*tcp_zerocopy != NULL) {
+        goto bail;
+    }
+
+    err = pthread_mutex_lock(&lock_zerocopy_alloc);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    /* allocated by another thread meanwhile */
+    if (handle_info_st->tcp_zerocopy != NULL) {
+        *tcp_zerocopy = handle_info_st->tcp_zerocopy;
+        goto bail;
+    }
+
+    new_zerocopy = (struct tcp_zerocopy *)calloc(1, sizeof(*new_zerocopy));
+    if (new_zerocopy == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to allocate zerocopy state of handle[%d]\n", handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    pthread_mutex_init(&new_zerocopy->lock, NULL);
+
+    __atomic_store_n(&handle_info_st->tcp_zerocopy, new_zerocopy,
+                     __ATOMIC_RELEASE);
+    *tcp_zerocopy = new_zerocopy;
+
+bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_zerocopy_alloc);
+    }
+    return err;
+}
+
+
+/* frees the zerocopy state once no send runs on the handle */
+static void
+tcp_zerocopy_stop(struct handle_info *handle_info_st)
+{
+    struct tcp_zerocopy *tcp_zerocopy = NULL;
+
+    tcp_zerocopy = __atomic_exchange_n(&handle_info_st->tcp_zerocopy, NULL,
+                                       __ATOMIC_ACQ_REL);
+    if (tcp_zerocopy == NULL) {
+        return;
+    }
+
+    pthread_mutex_destroy(&tcp_zerocopy->lock);
+    safe_free(tcp_zerocopy);
+}
+
+
+static int
+tx_coalesce_start(handle_t handle, struct handle_info *handle_info_st,
+                  uint32_t max_bytes, uint32_t max_delay_usec)
+{
+    int err = 0;
+    int is_locked = 0;
+    struct tx_coalesce *tx_coalesce = NULL;
+
+    tx_coalesce = (struct tx_coalesce *)calloc(1, sizeof(*tx_coalesce) +
+                                               max_bytes);
+    if (tx_coalesce == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to allocate coalescing buffer of handle[%d]\n",
+                handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    pthread_mutex_init(&tx_coalesce->lock, NULL);
+    tx_coalesce->handle = handle;
+    tx_coalesce->max_bytes = max_bytes;
+    tx_coalesce->delay_ns = (unsigned long long)max_delay_usec * 1000ULL;
+
+    err = pthread_mutex_lock(&lock_coalesce);
+    lib_commu_bail_error(err);
+    is_locked = 1;
+
+    err = tx_coalesce_timer_open();
+    lib_commu_bail_error(err);
+
+    tx_coalesce->next = coalesce_list;
+    if (coalesce_list != NULL) {
+        coalesce_list->prev = tx_coalesce;
+    }
+    coalesce_list = tx_coalesce;
+    __atomic_store_n(&handle_info_st->tx_coalesce, tx_coalesce,
+                     __ATOMIC_RELEASE);
+    tx_coalesce = NULL;
+
+bail:
+    if (is_locked) {
+        pthread_mutex_unlock(&lock_coalesce);
+    }
+    if (tx_coalesce != NULL) {
+        pthread_mutex_destroy(&tx_coalesce->lock);
+        safe_free(tx_coalesce);
+    }
+    return err;
+}
+
+
+/* stops coalescing on the handle, the buffered messages are sent first.
+ * Called before the handle is closed */
+static int
+tx_coalesce_stop(struct handle_info *handle_info_st)
+{
+    int err = 0;
+    struct tx_coalesce *tx_coalesce = NULL;
+
+    /* the timer scans the list with lock_coalesce held, so it doesn't touch
+     * the buffer once it was unlinked */
+    pthread_mutex_lock(&lock_coalesce);
+    tx_coalesce = __atomic_exchange_n(&handle_info_st->tx_coalesce, NULL,
+                                      __ATOMIC_ACQ_REL);
+    if (tx_coalesce != NULL) {
+        if (tx_coalesce->prev != NULL) {
+            tx_coalesce->prev->next = tx_coalesce->next;
+        }
+        else {
+            coalesce_list = tx_coalesce->next;
+        }
+        if (tx_coalesce->next != NULL) {
+            tx_coalesce->next->prev = tx_coalesce->prev;
+        }
+    }
+    pthread_mutex_unlock(&lock_coalesce);
+
+    if (tx_coalesce == NULL) {
+        return 0;
+    }
+
+    err = tx_coalesce_drain(tx_coalesce);
+
+    pthread_mutex_destroy(&tx_coalesce->lock);
+    safe_free(tx_coalesce);
+    return err;
+}
+
+
+/* buffers the framed messages, or sends them directly after the buffered
+ * ones if they don't fit in an empty buffer */
+static int
+tx_coalesce_send(struct tx_coalesce *tx_coalesce, struct iovec *iov,
+                 uint32_t iov_num, uint32_t *buffer_len,
+                 enum db_type handle_db_type)
+{
+    int err = 0;
+    uint32_t i = 0;
+    int is_empty = 0;
+
+    pthread_mutex_lock(&tx_coalesce->lock);
+
+    if (tx_coalesce->err != 0) {
+        *buffer_len = 0;
+        lib_commu_bail_force(tx_coalesce->err);
+    }
+
+    if (*buffer_len > tx_coalesce->max_bytes - tx_coalesce->len) {
+        if (tx_coalesce->len > 0) {
+            err = tx_coalesce_flush(tx_coalesce, 1);
+            if (err) {
+                *buffer_len = 0;
+                lib_commu_bail_force(err);
+            }
+        }
+        if (*buffer_len > tx_coalesce->max_bytes) {
+            err = comm_lib_tcp_ll_sendmsg_blocking(tx_coalesce->handle, iov,
+                                                   iov_num, buffer_len,
+                                                   handle_db_type, NULL);
+            goto bail;
+        }
+    }
+
+    is_empty = (tx_coalesce->len == 0);
+    for (i = 0; i < iov_num; i++) {
+        memcpy(tx_coalesce->buffer + tx_coalesce->len, iov[i].iov_base,
+               iov[i].iov_len);
+        tx_coalesce->len += iov[i].iov_len;
+    }
+
+    if (is_empty) {
+        tx_coalesce->deadline_ns = time_ns_get() + tx_coalesce->delay_ns;
+        tx_coalesce_timer_arm(tx_coalesce->deadline_ns);
+    }
+
+    /* the deadline is checked here as well, in case the reactor is late */
+    if ((tx_coalesce->len == tx_coalesce->max_bytes) ||
+        (time_ns_get() >= tx_coalesce->deadline_ns)) {
+        err = tx_coalesce_flush(tx_coalesce, 1);
+    }
+
+bail:
+    pthread_mutex_unlock(&tx_coalesce->lock);
+    return err;
+}
+
+
+/* sends the buffered bytes, blocking or as many as the socket takes now.
+ * Called with tx_coalesce->lock held, the buffer is dropped on error */
+static int
+tx_coalesce_flush(struct tx_coalesce *tx_coalesce, int is_blocking)
+{
+    int err = 0;
+    struct iovec iov;
+    struct msghdr msg;
+    uint32_t sent = tx_coalesce->len - tx_coalesce->head;
+    ssize_t nb_sent = 0;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+
+    iov.iov_base = tx_coalesce->buffer + tx_coalesce->head;
+    iov.iov_len = sent;
+
+    if (is_blocking) {
+        err = comm_lib_tcp_ll_sendmsg_blocking(tx_coalesce->handle, &iov, 1,
+                                               &sent, handle_db_type, NULL);
+        lib_commu_bail_error(err);
+    }
+    else {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        nb_sent = sendmsg(tx_coalesce->handle, &msg,
+                          MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (nb_sent < 0) {
+            sent = 0;
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK) &&
+                (errno != EINTR)) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "Failed in sendmsg() on handle[%d] with err[%d]: %s",
+                        tx_coalesce->handle, errno, strerror(errno));
+                lib_commu_bail_force(errno);
+            }
+        }
+        else {
+            sent = nb_sent;
+            (void)handle_total_tx_update(tx_coalesce->handle,
+                                         &handle_db_type, sent);
+        }
+    }
+
+    tx_coalesce->head += sent;
+    if (tx_coalesce->head == tx_coalesce->len) {
+        tx_coalesce->head = 0;
+        tx_coalesce->len = 0;
+    }
+
+bail:
+    if (err) {
+        /* the stream is broken, fail the next sends */
+        tx_coalesce->err = err;
+        tx_coalesce->head = 0;
+        tx_coalesce->len = 0;
+    }
+    return err;
+}
+
+
+/* sends all the buffered bytes, returns the error which broke the stream
+ * if there is one */
+static int
+tx_coalesce_drain(struct tx_coalesce *tx_coalesce)
+{
+    int err = 0;
+
+    pthread_mutex_lock(&tx_coalesce->lock);
+    err = tx_coalesce->err;
+    if ((err == 0) && (tx_coalesce->len > 0)) {
+        err = tx_coalesce_flush(tx_coalesce, 1);
+    }
+    pthread_mutex_unlock(&tx_coalesce->lock);
+
+    return err;
+}
+
+
+/* creates the deadline timer of all the coalescing handles on first use.
+ * Called with lock_coalesce held */
+static int
+tx_coalesce_timer_open(void)
+{
+    int err = 0;
+
+    if (coalesce_timer_item.fd != INVALID_HANDLE_ID) {
+        goto bail;
+    }
+
+    coalesce_timer_item.fd = timerfd_create(CLOCK_MONOTONIC,
+                                            TFD_NONBLOCK | TFD_CLOEXEC);
+    if (coalesce_timer_item.fd < 0) {
+        coalesce_timer_item.fd = INVALID_HANDLE_ID;
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "timerfd_create failed with err(%d): %s\n", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+    coalesce_timer_item.handler = tx_coalesce_timer_handler;
+    coalesce_timer_item.release = NULL;
+    coalesce_timer_item.ctx = NULL;
+    coalesce_timer_ns = 0;
+
+    err = lib_commu_reactor_item_add(&coalesce_timer_item, EPOLLIN,
+                                     REACTOR_ANY_THREAD);
+    if (err) {
+        close(coalesce_timer_item.fd);
+        coalesce_timer_item.fd = INVALID_HANDLE_ID;
+        lib_commu_bail_force(err);
+    }
+
+bail:
+    return err;
+}
+
+
+/* called once the reactor is down, the buffers are freed with the DB */
+static void
+tx_coalesce_timer_close(void)
+{
+    pthread_mutex_lock(&lock_coalesce);
+    if (coalesce_timer_item.fd != INVALID_HANDLE_ID) {
+        close(coalesce_timer_item.fd);
+        coalesce_timer_item.fd = INVALID_HANDLE_ID;
+    }
+    coalesce_timer_ns = 0;
+    coalesce_list = NULL;
+    pthread_mutex_unlock(&lock_coalesce);
+}
+
+
+/* arms the timer to deadline_ns unless it expires before */
+static void
+tx_coalesce_timer_arm(unsigned long long deadline_ns)
+{
+    struct itimerspec timeout;
+
+    memset(&timeout, 0, sizeof(timeout));
+
+    pthread_mutex_lock(&lock_coalesce_timer);
+    if ((coalesce_timer_ns == 0) || (deadline_ns < coalesce_timer_ns)) {
+        timeout.it_value.tv_sec = deadline_ns / 1000000000ULL;
+        timeout.it_value.tv_nsec = deadline_ns % 1000000000ULL;
+        if (timerfd_settime(coalesce_timer_item.fd, TFD_TIMER_ABSTIME,
+                            &timeout, NULL) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "timerfd_settime failed with err(%d): %s\n", errno,
+                    strerror(errno));
+        }
+        else {
+            coalesce_timer_ns = deadline_ns;
+        }
+    }
+    pthread_mutex_unlock(&lock_coalesce_timer);
+}
+
+
+/* flushes the buffers whose deadline passed, without blocking the reactor.
+ * Bytes the socket doesn't take now are retried after another delay */
+static void
+tx_coalesce_timer_handler(struct lib_commu_reactor_item *item,
+                          uint32_t events)
+{
+    uint64_t expirations = 0;
+    unsigned long long now_ns = 0;
+    unsigned long long next_ns = 0;
+    unsigned long long deadline_ns = 0;
+    struct tx_coalesce *tx_coalesce = NULL;
+
+    UNUSED_PARAM(events);
+
+    if (read(item->fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+
+    /* senders arming the timer from now on are not missed */
+    pthread_mutex_lock(&lock_coalesce_timer);
+    coalesce_timer_ns = 0;
+    pthread_mutex_unlock(&lock_coalesce_timer);
+
+    now_ns = time_ns_get();
+
+    pthread_mutex_lock(&lock_coalesce);
+    for (tx_coalesce = coalesce_list; tx_coalesce != NULL;
+         tx_coalesce = tx_coalesce->next) {
+        /* a sender holding the buffer checks the deadline itself */
+        if (pthread_mutex_trylock(&tx_coalesce->lock) != 0) {
+            deadline_ns = now_ns + tx_coalesce->delay_ns;
+            if ((next_ns == 0) || (deadline_ns < next_ns)) {
+                next_ns = deadline_ns;
+            }
+            continue;
+        }
+
+        if ((tx_coalesce->len > 0) && (tx_coalesce->err == 0) &&
+            (tx_coalesce->deadline_ns <= now_ns)) {
+            (void)tx_coalesce_flush(tx_coalesce, 0);
+            tx_coalesce->deadline_ns = now_ns + tx_coalesce->delay_ns;
+        }
+        if ((tx_coalesce->len > 0) && (tx_coalesce->err == 0) &&
+            ((next_ns == 0) || (tx_coalesce->deadline_ns < next_ns))) {
+            next_ns = tx_coalesce->deadline_ns;
+        }
+
+        pthread_mutex_unlock(&tx_coalesce->lock);
+    }
+    pthread_mutex_unlock(&lock_coalesce);
+
+    if (next_ns != 0) {
+        tx_coalesce_timer_arm(next_ns);
+    }
+}
+
+
+static int
+tcp_channels_get(handle_t handle, struct handle_info *handle_info_st,
+                 struct tcp_channels **tcp_channels)
+{
+    int err = 0;
+    int is_db_locked = 0;
+    int optval = TCP_CHANNEL_CHUNK_SIZE;
+    uint32_t i = 0;
+    struct tcp_channels *new_channels = NULL;
+
+    *tcp_channels = __atomic_load_n(&handle_info_st->tcp_channels,
+                                    __ATOMIC_ACQUIRE);
+    if (*tcp_channels != NULL) {
+        goto bail;
+    }
+
+    /* the channels are keyed by the msg_type of each message */
+    if (handle_info_st->conn_info.msg_type != GENERAL_MSG_TYPE) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "handle[%d] isn't a general msg_type connection\n", handle);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    /* the reactor can't send on shm rings */
+    if (handle_info_st->shm_link != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] is a shm session\n", handle);
+        lib_commu_bail_force(EOPNOTSUPP);
+    }
+
+    /* queued or coalesced messages would split the frames */
+    if ((__atomic_load_n(&handle_info_st->tx_queue, __ATOMIC_ACQUIRE) != NULL) ||
+        (__atomic_load_n(&handle_info_st->tx_coalesce,
+                         __ATOMIC_ACQUIRE) != NULL)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "handle[%d] has an async send queue or coalesces\n", handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    err = pthread_mutex_lock(&lock_rx_mode_alloc);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    /* the frames are parsed by the channel receivers only */
+    if (handle_info_st->rx_callback != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has a receive callback\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    /* allocated by another thread meanwhile */
+    if (handle_info_st->tcp_channels != NULL) {
+        *tcp_channels = handle_info_st->tcp_channels;
+        goto bail;
+    }
+
+    /* a chunk yields to a higher priority message only if it doesn't join a
+     * long backlog in the socket buffer, so keep the unsent bytes short */
+    if ((handle_info_st->conn_info.transport == STREAM_TRANSPORT_TCP) &&
+        (setsockopt(handle, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &optval,
+                    sizeof(optval)) < 0)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [TCP_NOTSENT_LOWAT], err[%d]: %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    new_channels = (struct tcp_channels *)calloc(1, sizeof(*new_channels) +
+                                                 TCP_CHANNELS_NUM *
+                                                 sizeof(new_channels->channels[0]) +
+                                                 TCP_CHANNEL_RX_MSGS *
+                                                 sizeof(struct tcp_channel_msg) +
+                                                 TCP_CHANNEL_PRIORITIES_NUM *
+                                                 sizeof(uint32_t));
+    if (new_channels == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate channels of handle[%d]\n",
+                handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    pthread_mutex_init(&new_channels->lock, NULL);
+    pthread_cond_init(&new_channels->tx_cond, NULL);
+    pthread_cond_init(&new_channels->rx_cond, NULL);
+    new_channels->handle = handle;
+    new_channels->rx_msgs =
+        (struct tcp_channel_msg *)&new_channels->channels[TCP_CHANNELS_NUM];
+    new_channels->tx_waiting =
+        (uint32_t *)&new_channels->rx_msgs[TCP_CHANNEL_RX_MSGS];
+
+    for (i = 0; i < TCP_CHANNELS_NUM; i++) {
+        new_channels->channels[i].priority = TCP_CHANNEL_PRIORITIES_NUM - 1;
+        new_channels->channels[i].rx_head = TCP_CHANNEL_RX_NONE;
+        new_channels->channels[i].rx_tail = TCP_CHANNEL_RX_NONE;
+    }
+    for (i = 0; i < TCP_CHANNEL_RX_MSGS; i++) {
+        new_channels->rx_msgs[i].next = (i + 1 < TCP_CHANNEL_RX_MSGS) ?
+                                        (i + 1) : TCP_CHANNEL_RX_NONE;
+    }
+    new_channels->rx_free = 0;
+
+    __atomic_store_n(&handle_info_st->tcp_channels, new_channels,
+                     __ATOMIC_RELEASE);
+    *tcp_channels = new_channels;
+
+bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_rx_mode_alloc);
+    }
+    return err;
+}
+
+
+/* frees the channels once no channel call runs on the handle, the messages
+ * queued are dropped */
+static void
+tcp_channels_stop(struct handle_info *handle_info_st)
+{
+    struct tcp_channels *tcp_channels = NULL;
+    struct tcp_channel *channel = NULL;
+    uint32_t i = 0, idx = 0;
+
+    tcp_channels = __atomic_exchange_n(&handle_info_st->tcp_channels, NULL,
+                                       __ATOMIC_ACQ_REL);
+    if (tcp_channels == NULL) {
+        return;
+    }
+
+    for (i = 0; i < TCP_CHANNELS_NUM; i++) {
+        channel = &tcp_channels->channels[i];
+        for (idx = channel->rx_head; idx != TCP_CHANNEL_RX_NONE;
+             idx = tcp_channels->rx_msgs[idx].next) {
+            (void)lib_commu_pool_buffer_put(tcp_channels->rx_msgs[idx].payload);
+        }
+        if (channel->rx_chunks != NULL) {
+            (void)lib_commu_pool_buffer_put(channel->rx_chunks);
+        }
+    }
+    if (tcp_channels->rx_parked != NULL) {
+        (void)lib_commu_pool_buffer_put(tcp_channels->rx_parked);
+    }
+
+    pthread_cond_destroy(&tcp_channels->rx_cond);
+    pthread_cond_destroy(&tcp_channels->tx_cond);
+    pthread_mutex_destroy(&tcp_channels->lock);
+    safe_free(tcp_channels);
+}
+
+
+/* sends the message whole if it fits a chunk, otherwise its chunk at offset */
+static int
+tcp_channel_frame_send(handle_t handle, struct handle_info *handle_info_st,
+                       enum db_type handle_db_type, uint8_t msg_type,
+                       uint8_t *payload, uint32_t payload_len, uint32_t offset,
+                       uint32_t *frame_len)
+{
+    int err = 0;
+    struct msg_metadata metadata_st;
+    struct msg_chunk chunk_st;
+    struct iovec iov[3];
+    uint32_t iov_num = 0;
+    uint32_t chunk_len = payload_len - offset;
+    uint32_t header_len = sizeof(metadata_st);
+    uint32_t total_len = 0;
+
+    *frame_len = 0;
+    memset(&metadata_st, 0, sizeof(metadata_st));
+
+    iov[iov_num].iov_base = &metadata_st;
+    iov[iov_num].iov_len = sizeof(metadata_st);
+    iov_num++;
+
+    if ((offset == 0) && (payload_len <= TCP_CHANNEL_CHUNK_SIZE)) {
+        err = metadata_set(&metadata_st, MSG_VERSION, payload_len,
+                           *handle_info_st);
+        lib_commu_bail_error(err);
+    }
+    else {
+        if (chunk_len > TCP_CHANNEL_CHUNK_SIZE) {
+            chunk_len = TCP_CHANNEL_CHUNK_SIZE;
+        }
+        err = metadata_set(&metadata_st, MSG_CHUNK_VERSION,
+                           sizeof(chunk_st) + chunk_len, *handle_info_st);
+        lib_commu_bail_error(err);
+
+        chunk_st.msg_len = htonl(payload_len);
+        chunk_st.offset = htonl(offset);
+        iov[iov_num].iov_base = &chunk_st;
+        iov[iov_num].iov_len = sizeof(chunk_st);
+        iov_num++;
+        header_len += sizeof(chunk_st);
+    }
+    metadata_st.msg_type = msg_type;
+
+    iov[iov_num].iov_base = payload + offset;
+    iov[iov_num].iov_len = chunk_len;
+    iov_num++;
+    total_len = header_len + chunk_len;
+
+    err = tcp_iov_send(handle, handle_info_st, iov, iov_num, &total_len,
+                       handle_db_type);
+    lib_commu_bail_error(err);
+
+    *frame_len = chunk_len;
+
+bail:
+    return err;
+}
+
+
+/* reads one frame, a message is returned once all its chunks were read.
+ * Called by one receiver at a time, which owns the reassembly buffers */
+static int
+tcp_channel_frame_recv(handle_t handle, struct handle_info *handle_info_st,
+                       struct tcp_channels *tcp_channels, uint8_t *msg_type,
+                       uint8_t **payload, uint32_t *payload_len)
+{
+    int err = 0;
+    int is_chunk = 0;
+    struct msg_metadata metadata_st;
+    struct msg_trace trace_st;
+    struct msg_chunk chunk_st;
+    struct tcp_channel *channel = NULL;
+    uint32_t len = sizeof(metadata_st);
+    uint8_t *buffer = NULL;
+
+    *payload = NULL;
+    *payload_len = 0;
+
+    err = comm_lib_tcp_ll_recv_blocking(handle, (uint8_t*)&metadata_st, &len);
+    lib_commu_bail_error(err);
+
+    /* a chunk is validated as a message of its channel */
+    if (metadata_st.version == MSG_CHUNK_VERSION) {
+        is_chunk = 1;
+        metadata_st.version = MSG_VERSION;
+    }
+    err = validate_metadata_info(&metadata_st,
+                                 is_chunk ?
+                                 (sizeof(chunk_st) + TCP_CHANNEL_CHUNK_SIZE) :
+                                 MAX_JUMBO_TCP_PAYLOAD, handle_info_st);
+    lib_commu_bail_error(err);
+
+    /* the trace of a traced message follows the metadata */
+    if (metadata_st.version == MSG_TRACE_VERSION) {
+        len = sizeof(trace_st);
+        err = comm_lib_tcp_ll_recv_blocking(handle, (uint8_t*)&trace_st, &len);
+        lib_commu_bail_error(err);
+        msg_trace_recv(handle, &metadata_st,
+                       handle_info_st->conn_info.d_ipv4_addr,
+                       (uint8_t*)&trace_st);
+    }
+
+    *msg_type = metadata_st.msg_type;
+    channel = &tcp_channels->channels[metadata_st.msg_type];
+
+    if (!is_chunk) {
+        if (channel->rx_chunks != NULL) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "channel[%u] message received between chunks\n",
+                    metadata_st.msg_type);
+            lib_commu_bail_force(EIO);
+        }
+
+        err = lib_commu_pool_buffer_get(metadata_st.payload_size, &buffer);
+        lib_commu_bail_error(err);
+
+        len = metadata_st.payload_size;
+        err = comm_lib_tcp_ll_recv_blocking(handle, buffer, &len);
+        if (err) {
+            lib_commu_pool_buffer_put(buffer);
+            lib_commu_bail_force(err);
+        }
+
+        *payload = buffer;
+        *payload_len = metadata_st.payload_size;
+        goto bail;
+    }
+
+    if (metadata_st.payload_size <= sizeof(chunk_st)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid chunk size [%u]\n",
+                metadata_st.payload_size);
+        lib_commu_bail_force(EOVERFLOW);
+    }
+
+    len = sizeof(chunk_st);
+    err = comm_lib_tcp_ll_recv_blocking(handle, (uint8_t*)&chunk_st, &len);
+    lib_commu_bail_error(err);
+    chunk_st.msg_len = ntohl(chunk_st.msg_len);
+    chunk_st.offset = ntohl(chunk_st.offset);
+    len = metadata_st.payload_size - sizeof(chunk_st);
+
+    if (channel->rx_chunks == NULL) {
+        if ((chunk_st.msg_len == 0) ||
+            (chunk_st.msg_len > MAX_JUMBO_TCP_PAYLOAD)) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                    chunk_st.msg_len);
+            lib_commu_bail_force(EOVERFLOW);
+        }
+        err = lib_commu_pool_buffer_get(chunk_st.msg_len, &channel->rx_chunks);
+        lib_commu_bail_error(err);
+        channel->rx_msg_len = chunk_st.msg_len;
+        channel->rx_chunks_len = 0;
+    }
+
+    /* the chunks of a message are sent in order, one message at a time */
+    if ((chunk_st.msg_len != channel->rx_msg_len) ||
+        (chunk_st.offset != channel->rx_chunks_len) ||
+        (len > channel->rx_msg_len - channel->rx_chunks_len)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "channel[%u] chunk out of order, offset[%u] len[%u] "
+                "of message len[%u]\n", metadata_st.msg_type,
+                chunk_st.offset, len, chunk_st.msg_len);
+        lib_commu_bail_force(EIO);
+    }
+
+    err = comm_lib_tcp_ll_recv_blocking(handle,
+                                        channel->rx_chunks +
+                                        channel->rx_chunks_len, &len);
+    lib_commu_bail_error(err);
+    channel->rx_chunks_len += len;
+
+    if (channel->rx_chunks_len == channel->rx_msg_len) {
+        *payload = channel->rx_chunks;
+        *payload_len = channel->rx_msg_len;
+        channel->rx_chunks = NULL;
+    }
+
+bail:
+    return err;
+}
+
+
+/* queues a message to its channel, called with the channels locked.
+ * Returns ENOBUFS if the channel or the queue of all the channels is full */
+static int
+tcp_channel_msg_queue(struct tcp_channels *tcp_channels, uint8_t msg_type,
+                      uint8_t *payload, uint32_t payload_len)
+{
+    struct tcp_channel *channel = &tcp_channels->channels[msg_type];
+    uint32_t idx = tcp_channels->rx_free;
+
+    if ((idx == TCP_CHANNEL_RX_NONE) ||
+        (channel->rx_msgs_num == TCP_CHANNEL_RX_MSGS_MAX)) {
+        LCM_LOG(LCOMMU_LOG_DEBUG,
+                "channel[%u] of handle[%d] is full, reading stopped\n",
+                msg_type, tcp_channels->handle);
+        return ENOBUFS;
+    }
+
+    tcp_channels->rx_free = tcp_channels->rx_msgs[idx].next;
+    tcp_channels->rx_msgs[idx].payload = payload;
+    tcp_channels->rx_msgs[idx].payload_len = payload_len;
+    tcp_channels->rx_msgs[idx].next = TCP_CHANNEL_RX_NONE;
+
+    if (channel->rx_tail == TCP_CHANNEL_RX_NONE) {
+        channel->rx_head = idx;
+    }
+    else {
+        tcp_channels->rx_msgs[channel->rx_tail].next = idx;
+    }
+    channel->rx_tail = idx;
+    channel->rx_msgs_num++;
+    return 0;
+}
+
+
+/* calls the receive callback, returns 1 if it stopped the callbacks */
+static int
+rx_callback_deliver(struct rx_callback *rx_callback,
+                    struct addr_info addresser_st, uint8_t *payload,
+                    uint32_t payload_len, uint8_t msg_type)
+{
+    rx_callback->clbk_st.clbk_recv_func(rx_callback->handle, addresser_st,
+                                        payload, payload_len, msg_type,
+                                        rx_callback->clbk_st.data, 0);
+    return __atomic_load_n(&rx_callback->is_stopped, __ATOMIC_ACQUIRE);
+}
+
+
+/* parses the bytes the socket holds, a message is read to the buffer unless
+ * it's larger, then the rest of it is read directly to a pool buffer */
+static int
+rx_callback_tcp_recv(struct rx_callback *rx_callback,
+                     struct handle_info *handle_info_st, uint32_t *msgs_num,
+                     uint32_t *total_bytes)
+{
+    int err = 0;
+    ssize_t nb_recvd = 0;
+    uint32_t i = 0;
+    uint32_t unparsed_len = 0;
+    uint32_t header_len = 0;
+    uint32_t copy_len = 0;
+    struct msg_metadata metadata_st;
+    struct addr_info addresser_st;
+
+    addresser_st.ipv4_addr = handle_info_st->conn_info.d_ipv4_addr;
+    addresser_st.port = handle_info_st->conn_info.d_port;
+
+    for (i = 0; i < RX_CALLBACK_RECV_NUM; i++) {
+        if (rx_callback->payload != NULL) {
+            nb_recvd = recv(rx_callback->handle,
+                            rx_callback->payload + rx_callback->payload_recvd,
+                            rx_callback->metadata.payload_size -
+                            rx_callback->payload_recvd, MSG_DONTWAIT);
+        }
+        else {
+            /* keep the unparsed bytes at the buffer start */
+            if (rx_callback->head > 0) {
+                memmove(rx_callback->buffer,
+                        rx_callback->buffer + rx_callback->head,
+                        rx_callback->tail - rx_callback->head);
+                rx_callback->tail -= rx_callback->head;
+                rx_callback->head = 0;
+            }
+            nb_recvd = recv(rx_callback->handle,
+                            rx_callback->buffer + rx_callback->tail,
+                            RX_STREAM_BUFFER_SIZE - rx_callback->tail,
+                            MSG_DONTWAIT);
+        }
+        if (nb_recvd == 0) {
+            LCM_LOG(LCOMMU_LOG_NOTICE, "Peer reset the connection");
+            lib_commu_bail_force(ECONNRESET);
+        }
+        if (nb_recvd < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR, "recv() faild with err(%d): %s", errno,
+                    strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+        *total_bytes += nb_recvd;
+
+        if (rx_callback->payload != NULL) {
+            rx_callback->payload_recvd += nb_recvd;
+            if (rx_callback->payload_recvd <
+                rx_callback->metadata.payload_size) {
+                continue;
+            }
+            (*msgs_num)++;
+            if (rx_callback_deliver(rx_callback, addresser_st,
+                                    rx_callback->payload,
+                                    rx_callback->metadata.payload_size,
+                                    rx_callback->metadata.msg_type)) {
+                goto bail;
+            }
+            lib_commu_pool_buffer_put(rx_callback->payload);
+            rx_callback->payload = NULL;
+            continue;
+        }
+        rx_callback->tail += nb_recvd;
+
+        while (1) {
+            unparsed_len = rx_callback->tail - rx_callback->head;
+            if (unparsed_len < sizeof(metadata_st)) {
+                break;
+            }
+
+            memcpy(&metadata_st, rx_callback->buffer + rx_callback->head,
+                   sizeof(metadata_st));
+            err = validate_metadata_info(&metadata_st, MAX_JUMBO_TCP_PAYLOAD,
+                                         handle_info_st);
+            lib_commu_bail_error(err);
+
+            header_len = msg_header_len(&metadata_st);
+            if (unparsed_len < header_len) {
+                break;
+            }
+
+            copy_len = unparsed_len - header_len;
+            if (copy_len >= metadata_st.payload_size) {
+                msg_trace_recv(rx_callback->handle, &metadata_st,
+                               handle_info_st->conn_info.d_ipv4_addr,
+                               rx_callback->buffer + rx_callback->head +
+                               sizeof(metadata_st));
+                rx_callback->head += header_len + metadata_st.payload_size;
+                (*msgs_num)++;
+                if (rx_callback_deliver(rx_callback, addresser_st,
+                                        rx_callback->buffer +
+                                        rx_callback->head -
+                                        metadata_st.payload_size,
+                                        metadata_st.payload_size,
+                                        metadata_st.msg_type)) {
+                    goto bail;
+                }
+                continue;
+            }
+
+            /* the rest of a message fitting the buffer is received to it */
+            if (header_len + metadata_st.payload_size <=
+                RX_STREAM_BUFFER_SIZE) {
+                break;
+            }
+
+            err = lib_commu_pool_buffer_get(metadata_st.payload_size,
+                                            &rx_callback->payload);
+            lib_commu_bail_error(err);
+            msg_trace_recv(rx_callback->handle, &metadata_st,
+                           handle_info_st->conn_info.d_ipv4_addr,
+                           rx_callback->buffer + rx_callback->head +
+                           sizeof(metadata_st));
+            memcpy(rx_callback->payload,
+                   rx_callback->buffer + rx_callback->head + header_len,
+                   copy_len);
+            memcpy(&rx_callback->metadata, &metadata_st, sizeof(metadata_st));
+            rx_callback->payload_recvd = copy_len;
+            rx_callback->head = 0;
+            rx_callback->tail = 0;
+            break;
+        }
+    }
+
+bail:
+    return err;
+}
+
+
+/* receives the datagrams the socket holds, invalid ones are dropped */
+static int
+rx_callback_udp_recv(struct rx_callback *rx_callback,
+                     struct handle_info *handle_info_st, uint32_t *msgs_num,
+                     uint32_t *total_bytes, uint32_t *dropped_num)
+{
+    int err = 0;
+    int nb_msgs = 0;
+    int msg_err = 0;
+    uint32_t i = 0, j = 0;
+    struct msg_metadata metadata_st[UDP_BATCH_MSGS];
+    struct mmsghdr mmsg[UDP_BATCH_MSGS];
+    struct iovec iov[UDP_BATCH_MSGS][2];
+    struct sockaddr_in addressers[UDP_BATCH_MSGS];
+    struct addr_info addresser_st;
+
+    for (i = 0; i < RX_CALLBACK_RECV_NUM; i++) {
+        memset(mmsg, 0, sizeof(mmsg));
+        for (j = 0; j < UDP_BATCH_MSGS; j++) {
+            iov[j][0].iov_base = &metadata_st[j];
+            iov[j][0].iov_len = sizeof(metadata_st[j]);
+            iov[j][1].iov_base = rx_callback->buffer + j * MAX_UDP_PAYLOAD;
+            iov[j][1].iov_len = MAX_UDP_PAYLOAD;
+
+            mmsg[j].msg_hdr.msg_name = &addressers[j];
+            mmsg[j].msg_hdr.msg_namelen = sizeof(addressers[j]);
+            mmsg[j].msg_hdr.msg_iov = iov[j];
+            mmsg[j].msg_hdr.msg_iovlen = 2;
+        }
+
+        nb_msgs = recvmmsg(rx_callback->handle, mmsg, UDP_BATCH_MSGS,
+                           MSG_DONTWAIT, NULL);
+        if (nb_msgs < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed in recvmmsg() with err[%d]: %s",
+                    errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+
+        for (j = 0; j < (uint32_t)nb_msgs; j++) {
+            *total_bytes += mmsg[j].msg_len;
+
+            msg_err = 0;
+            if ((mmsg[j].msg_len < sizeof(metadata_st[j])) ||
+                (mmsg[j].msg_hdr.msg_flags & MSG_TRUNC)) {
+                msg_err = EOVERFLOW;
+            }
+            else {
+                msg_err = validate_metadata_info(&metadata_st[j],
+                                                 MAX_UDP_PAYLOAD,
+                                                 handle_info_st);
+                if ((msg_err == 0) &&
+                    (metadata_st[j].payload_size !=
+                     mmsg[j].msg_len - msg_header_len(&metadata_st[j]))) {
+                    msg_err = EIO;
+                }
+            }
+            if (msg_err) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "Dropped datagram of [%u] bytes, err[%d]\n",
+                        mmsg[j].msg_len, msg_err);
+                (*dropped_num)++;
+                continue;
+            }
+            /* a datagram up to MAX_UDP_MSG_SIZE fits its buffer */
+            udp_msg_trace_strip(rx_callback->handle, &metadata_st[j],
+                                addressers[j].sin_addr.s_addr,
+                                rx_callback->buffer + j * MAX_UDP_PAYLOAD,
+                                MAX_UDP_PAYLOAD, NULL);
+
+            addresser_st.ipv4_addr = addressers[j].sin_addr.s_addr;
+            addresser_st.port = addressers[j].sin_port;
+            (*msgs_num)++;
+            if (rx_callback_deliver(rx_callback, addresser_st,
+                                    rx_callback->buffer + j * MAX_UDP_PAYLOAD,
+                                    metadata_st[j].payload_size,
+                                    metadata_st[j].msg_type)) {
+                goto bail;
+            }
+        }
+
+        if (nb_msgs < UDP_BATCH_MSGS) {
+            break;
+        }
+    }
+
+bail:
+    return err;
+}
+
+
+static void
+rx_callback_handler(struct handle_reactor *handle_reactor,
+                    struct rx_callback *rx_callback)
+{
+    struct handle_info *handle_info_st = rx_callback->handle_info_st;
+    enum db_type handle_db_type = (enum db_type)rx_callback->db_type;
+    struct addr_info addresser_st;
+    uint32_t msgs_num = 0;
+    uint32_t total_bytes = 0;
+    uint32_t dropped_num = 0;
+    int err = 0;
+
+    if (rx_callback->db_type == UDP_HANDLE_DB) {
+        err = rx_callback_udp_recv(rx_callback, handle_info_st, &msgs_num,
+                                   &total_bytes, &dropped_num);
+    }
+    else {
+        err = rx_callback_tcp_recv(rx_callback, handle_info_st, &msgs_num,
+                                   &total_bytes);
+    }
+
+    handle_msgs_stats_update(rx_callback->handle, 1, msgs_num, err);
+    if (dropped_num > 0) {
+        (void)handle_stats_counter_add(rx_callback->handle,
+                                       HANDLE_STATS_RX_ERRORS, dropped_num);
+    }
+    if (total_bytes > 0) {
+        (void)handle_total_rx_update(rx_callback->handle, &handle_db_type,
+                                     total_bytes);
+    }
+
+    /* a failed stream can't be parsed further, and a closed socket would
+     * stay readable */
+    if (err) {
+        pthread_mutex_lock(&handle_reactor->lock);
+        if (!rx_callback->is_stopped) {
+            __atomic_store_n(&rx_callback->is_stopped, 1, __ATOMIC_RELEASE);
+            handle_reactor->events &= ~EPOLLIN;
+        }
+        else {
+            err = 0; /* stopped meanwhile */
+        }
+        pthread_mutex_unlock(&handle_reactor->lock);
+    }
+    if (err) {
+        memset(&addresser_st, 0, sizeof(addresser_st));
+        rx_callback->clbk_st.clbk_recv_func(rx_callback->handle,
+                                            addresser_st, NULL, 0, 0,
+                                            rx_callback->clbk_st.data, -err);
+    }
+}
+
+
+static void
+rx_callback_free(struct rx_callback *rx_callback)
+{
+    if (rx_callback->payload != NULL) {
+        lib_commu_pool_buffer_put(rx_callback->payload);
+    }
+    safe_free(rx_callback);
+}
+
+
+/* no callback is called once it returns, unless called from a reactor
+ * thread (e.g. from a callback), which doesn't wait for the callback in
+ * progress. Then the handler frees it once the callback returned */
+static void
+rx_callback_stop(struct handle_info *handle_info_st)
+{
+    struct handle_reactor *handle_reactor = NULL;
+    struct rx_callback *rx_callback = NULL;
+
+    rx_callback = __atomic_exchange_n(&handle_info_st->rx_callback, NULL,
+                                      __ATOMIC_ACQ_REL);
+    if (rx_callback == NULL) {
+        return;
+    }
+    /* set with the callback */
+    handle_reactor = __atomic_load_n(&handle_info_st->handle_reactor,
+                                     __ATOMIC_ACQUIRE);
+
+    pthread_mutex_lock(&handle_reactor->lock);
+    handle_reactor->rx_callback = NULL;
+    __atomic_store_n(&rx_callback->is_stopped, 1, __ATOMIC_RELEASE);
+    handle_reactor->events &= ~EPOLLIN;
+    (void)handle_reactor_arm(handle_reactor);
+
+    if ((handle_reactor->rx_running == rx_callback) &&
+        lib_commu_reactor_thread_is_current()) {
+        rx_callback->is_detached = 1;
+        pthread_mutex_unlock(&handle_reactor->lock);
+        return;
+    }
+
+    while (handle_reactor->rx_running == rx_callback) {
+        pthread_cond_wait(&handle_reactor->handler_cond,
+                          &handle_reactor->lock);
+    }
+    pthread_mutex_unlock(&handle_reactor->lock);
+
+    rx_callback_free(rx_callback);
+}
+
+
+/* sends a batch of fragments, each is 3 iovecs: metadata, msg_fragment and
+ * payload. A UDP_SEGMENT send is split by the kernel to a datagram per
+ * MAX_UDP_MSG_SIZE bytes, the last fragment may be shorter */
+static int
+udp_fragments_batch_send(handle_t handle, struct handle_info *handle_info_st,
+                         struct sockaddr_in *recipient,
+                         struct iovec *iov, uint32_t frags_num,
+                         uint32_t batch_len, uint32_t *retries)
+{
+    int err = 0;
+    int nb_msgs = 0;
+    ssize_t nb_sent = 0;
+    uint32_t i = 0;
+    uint32_t frags_sent = 0;
+    uint16_t repeat_times = 0;
+    struct msghdr msg;
+    struct mmsghdr mmsg[UDP_GSO_SEGMENTS_NUM];
+    struct cmsghdr *cmsg = NULL;
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control;
+
+    while ((frags_num > 1) &&
+           !__atomic_load_n(&handle_info_st->is_udp_gso_unsupported,
+                            __ATOMIC_RELAXED)) {
+        memset(&msg, 0, sizeof(msg));
+        memset(&control, 0, sizeof(control));
+        msg.msg_name = recipient;
+        msg.msg_namelen = sizeof(*recipient);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = frags_num * 3;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        *(uint16_t *)CMSG_DATA(cmsg) = MAX_UDP_MSG_SIZE;
+
+        nb_sent = sendmsg(handle, &msg, 0);
+        if (nb_sent == (ssize_t)batch_len) {
+            goto bail;
+        }
+        if ((nb_sent < 0) && (errno == EINTR)) {
+            (*retries)++;
+            continue;
+        }
+        /* the kernel or the device of this route can't segment, send a
+         * datagram per fragment from now on */
+        if ((nb_sent < 0) && ((errno == EIO) || (errno == EINVAL) ||
+                              (errno == ENOPROTOOPT))) {
+            LCM_LOG(LCOMMU_LOG_NOTICE,
+                    "UDP_SEGMENT send failed with err(%d): %s, "
+                    "falling back to sendmmsg()\n", errno, strerror(errno));
+            __atomic_store_n(&handle_info_st->is_udp_gso_unsupported, 1,
+                             __ATOMIC_RELAXED);
+            break;
+        }
+        LCM_LOG(LCOMMU_LOG_ERROR, "sendmsg() failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force((nb_sent < 0) ? errno : EIO);
+    }
+
+    memset(mmsg, 0, sizeof(mmsg[0]) * frags_num);
+    for (i = 0; i < frags_num; i++) {
+        mmsg[i].msg_hdr.msg_name = recipient;
+        mmsg[i].msg_hdr.msg_namelen = sizeof(*recipient);
+        mmsg[i].msg_hdr.msg_iov = &iov[i * 3];
+        mmsg[i].msg_hdr.msg_iovlen = 3;
+    }
+
+    while (frags_sent < frags_num) {
+        if (repeat_times == SEND_REPEAT_NUM) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Retry to send the fragments %d times",
+                    repeat_times);
+            lib_commu_bail_force(EIO);
+        }
+        repeat_times++;
+
+        nb_msgs = sendmmsg(handle, &mmsg[frags_sent], frags_num - frags_sent,
+                           0);
+        if (nb_msgs < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed in sendmmsg() with err[%d]: %s",
+                    errno, strerror(errno));
+            lib_commu_bail_force(EIO);
+        }
+        frags_sent += nb_msgs;
+    }
+    *retries += repeat_times - 1;
+
+bail:
+    return err;
+}
+
+
+/* sends a message larger than MAX_UDP_PAYLOAD in fragments of
+ * UDP_FRAGMENT_PAYLOAD bytes, the payload isn't copied */
+static int
+udp_fragments_send(handle_t handle, struct handle_info *handle_info_st,
+                   struct addr_info recipient_st, uint8_t *payload,
+                   uint32_t payload_len, uint32_t *total_bytes)
+{
+    int err = 0;
+    uint32_t msg_seq = 0;
+    uint32_t offset = 0;
+    uint32_t frag_len = 0;
+    uint32_t frags_num = 0;
+    uint32_t batch_len = 0;
+    uint32_t retries = 0;
+    struct sockaddr_in recipient;
+    struct msg_metadata metadata_st[UDP_GSO_SEGMENTS_NUM];
+    struct msg_fragment fragment_st[UDP_GSO_SEGMENTS_NUM];
+    struct iovec iov[UDP_GSO_SEGMENTS_NUM * 3];
+    unsigned long long start_ns = time_ns_get();
+
+    memset(&recipient, 0, sizeof(recipient));
+    recipient.sin_family = AF_INET;
+    recipient.sin_port = recipient_st.port;
+    recipient.sin_addr.s_addr = recipient_st.ipv4_addr;
+
+    msg_seq = __atomic_add_fetch(&handle_info_st->udp_tx_seq, 1,
+                                 __ATOMIC_RELAXED);
+
+    while (offset < payload_len) {
+        frags_num = 0;
+        batch_len = 0;
+        while ((frags_num < UDP_GSO_SEGMENTS_NUM) && (offset < payload_len)) {
+            frag_len = payload_len - offset;
+            if (frag_len > UDP_FRAGMENT_PAYLOAD) {
+                frag_len = UDP_FRAGMENT_PAYLOAD;
+            }
+
+            err = metadata_set(&metadata_st[frags_num], MSG_FRAGMENT_VERSION,
+                               sizeof(fragment_st[frags_num]) + frag_len,
+                               *handle_info_st);
+            lib_commu_bail_error(err);
+            fragment_st[frags_num].msg_seq = htonl(msg_seq);
+            fragment_st[frags_num].msg_len = htonl(payload_len);
+            fragment_st[frags_num].offset = htonl(offset);
+
+            iov[frags_num * 3].iov_base = &metadata_st[frags_num];
+            iov[frags_num * 3].iov_len = sizeof(metadata_st[frags_num]);
+            iov[frags_num * 3 + 1].iov_base = &fragment_st[frags_num];
+            iov[frags_num * 3 + 1].iov_len = sizeof(fragment_st[frags_num]);
+            iov[frags_num * 3 + 2].iov_base = payload + offset;
+            iov[frags_num * 3 + 2].iov_len = frag_len;
+
+            batch_len += sizeof(metadata_st[frags_num]) +
+                         sizeof(fragment_st[frags_num]) + frag_len;
+            offset += frag_len;
+            frags_num++;
+        }
+
+        err = udp_fragments_batch_send(handle, handle_info_st, &recipient,
+                                       iov, frags_num, batch_len, &retries);
+        lib_commu_bail_error(err);
+        *total_bytes += batch_len;
+    }
+
+bail:
+    (void)handle_io_hists_update(handle, 0, time_ns_get() - start_ns,
+                                 *total_bytes, retries);
+    return err;
+}
+
+
+/* allocates the reassembly table on the first large receive of a handle */
+static int
+udp_reassembly_get(handle_t handle, struct handle_info *handle_info_st,
+                   struct udp_reassembly **udp_reassembly)
+{
+    int err = 0;
+    int is_locked = 0;
+    int optval = 1;
+    int rcvbuf_size = MAX_UDP_LARGE_PAYLOAD;
+    struct udp_reassembly *new_reassembly = NULL;
+
+    *udp_reassembly = __atomic_load_n(&handle_info_st->udp_reassembly,
+                                      __ATOMIC_ACQUIRE);
+    if (*udp_reassembly != NULL) {
+        goto bail;
+    }
+
+    err = pthread_mutex_lock(&lock_rx_mode_alloc);
+    lib_commu_bail_error(err);
+    is_locked = 1;
+
+    /* the callback receives the datagrams */
+    if (handle_info_st->rx_callback != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has a receive callback\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    /* the reliable peers receive the datagrams */
+    if (handle_info_st->udp_reliable != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] receives reliable messages\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    /* allocated by another thread meanwhile */
+    if (handle_info_st->udp_reassembly != NULL) {
+        *udp_reassembly = handle_info_st->udp_reassembly;
+        goto bail;
+    }
+
+    /* without GRO every fragment is received by its own recvmsg() */
+    if (setsockopt(handle, SOL_UDP, UDP_GRO, &optval, sizeof(optval)) < 0) {
+        LCM_LOG(LCOMMU_LOG_NOTICE,
+                "Fail setting sock options [UDP_GRO], err[%d]: %s\n",
+                errno, strerror(errno));
+    }
+
+    /* the fragments of a whole message may be queued before it's received,
+     * the kernel caps it by net.core.rmem_max */
+    if (setsockopt(handle, SOL_SOCKET, SO_RCVBUF, &rcvbuf_size,
+                   sizeof(rcvbuf_size)) < 0) {
+        LCM_LOG(LCOMMU_LOG_NOTICE,
+                "Fail setting sock options [SO_RCVBUF], err[%d]: %s\n",
+                errno, strerror(errno));
+    }
+
+    new_reassembly = (struct udp_reassembly *)calloc(1,
+                                                     sizeof(*new_reassembly) +
+                                                     UDP_REASSEMBLY_MSGS *
+                                                     sizeof(new_reassembly->msgs[0]) +
+                                                     UDP_GRO_BUFFER_SIZE);
+    if (new_reassembly == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to allocate reassembly table of handle[%d]\n", handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    pthread_mutex_init(&new_reassembly->lock, NULL);
+    new_reassembly->buffer =
+        (uint8_t *)&new_reassembly->msgs[UDP_REASSEMBLY_MSGS];
+
+    __atomic_store_n(&handle_info_st->udp_reassembly, new_reassembly,
+                     __ATOMIC_RELEASE);
+    *udp_reassembly = new_reassembly;
+
+bail:
+    if (is_locked) {
+        pthread_mutex_unlock(&lock_rx_mode_alloc);
+    }
+    return err;
+}
+
+
+/* drops the messages being reassembled */
+static void
+udp_reassembly_stop(struct handle_info *handle_info_st)
+{
+    struct udp_reassembly *udp_reassembly = NULL;
+    uint32_t i = 0;
+
+    udp_reassembly = __atomic_exchange_n(&handle_info_st->udp_reassembly, NULL,
+                                         __ATOMIC_ACQ_REL);
+    if (udp_reassembly == NULL) {
+        return;
+    }
+
+    for (i = 0; i < UDP_REASSEMBLY_MSGS; i++) {
+        if (udp_reassembly->msgs[i].payload != NULL) {
+            (void)lib_commu_pool_buffer_put(udp_reassembly->msgs[i].payload);
+        }
+    }
+
+    pthread_mutex_destroy(&udp_reassembly->lock);
+    safe_free(udp_reassembly);
+}
+
+
+/* finds the message of a fragment, a new message takes a free entry or
+ * evicts the one updated least recently */
+static int
+udp_fragments_get(struct udp_reassembly *udp_reassembly,
+                  struct msg_fragment *fragment_st, uint32_t *dropped_num,
+                  struct udp_fragments **fragments)
+{
+    int err = 0;
+    uint32_t i = 0;
+    uint32_t frags_num = 0;
+    struct udp_fragments *entry = NULL;
+    struct udp_fragments *victim = NULL;
+
+    *fragments = NULL;
+
+    for (i = 0; i < UDP_REASSEMBLY_MSGS; i++) {
+        entry = &udp_reassembly->msgs[i];
+        if (entry->payload == NULL) {
+            if ((victim == NULL) || (victim->payload != NULL)) {
+                victim = entry;
+            }
+            continue;
+        }
+        if ((entry->ipv4_addr == udp_reassembly->ipv4_addr) &&
+            (entry->port == udp_reassembly->port) &&
+            (entry->msg_seq == fragment_st->msg_seq)) {
+            if (entry->msg_len != fragment_st->msg_len) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "message[%u] length [%u] != fragment length [%u]\n",
+                        entry->msg_seq, entry->msg_len, fragment_st->msg_len);
+                lib_commu_bail_force(EIO);
+            }
+            *fragments = entry;
+            goto bail;
+        }
+        if ((victim == NULL) ||
+            ((victim->payload != NULL) &&
+             (udp_reassembly->clock - entry->last_used >
+              udp_reassembly->clock - victim->last_used))) {
+            victim = entry;
+        }
+    }
+
+    if (victim->payload != NULL) {
+        LCM_LOG(LCOMMU_LOG_NOTICE,
+                "Dropped message[%u] of [%u/%u] bytes, reassembly table is full\n",
+                victim->msg_seq, victim->recvd_len, victim->msg_len);
+        (void)lib_commu_pool_buffer_put(victim->payload);
+        victim->payload = NULL;
+        (*dropped_num)++;
+    }
+
+    /* the payload is followed by a bit per fragment received */
+    frags_num = (fragment_st->msg_len + UDP_FRAGMENT_PAYLOAD - 1) /
+                UDP_FRAGMENT_PAYLOAD;
+    err = lib_commu_pool_buffer_get(fragment_st->msg_len +
+                                    (frags_num + 7) / 8, &victim->payload);
+    lib_commu_bail_error(err);
+    memset(victim->payload + fragment_st->msg_len, 0, (frags_num + 7) / 8);
+
+    victim->ipv4_addr = udp_reassembly->ipv4_addr;
+    victim->port = udp_reassembly->port;
+    victim->msg_seq = fragment_st->msg_seq;
+    victim->msg_len = fragment_st->msg_len;
+    victim->recvd_len = 0;
+    *fragments = victim;
+
+bail:
+    return err;
+}
+
+
+/* parses the next segment of the buffered datagram, a message is copied
+ * to payload once all its fragments were received. Segments describe their
+ * own size, so a GRO datagram is split without its segment size */
+static int
+udp_reassembly_segment_parse(struct handle_info *handle_info_st,
+                             struct udp_reassembly *udp_reassembly,
+                             struct addr_info *addresser_st, uint8_t *payload,
+                             uint32_t *payload_len, int *is_msg_done,
+                             uint32_t *dropped_num)
+{
+    int err = 0;
+    int is_fragment = 0;
+    struct msg_metadata metadata_st;
+    struct msg_fragment fragment_st;
+    struct udp_fragments *fragments = NULL;
+    uint8_t *segment = udp_reassembly->buffer + udp_reassembly->head;
+    uint32_t segment_len = udp_reassembly->tail - udp_reassembly->head;
+    uint32_t header_len = 0;
+    uint32_t frag_len = 0;
+    uint32_t frag_idx = 0;
+    uint8_t *frags_map = NULL;
+
+    *is_msg_done = 0;
+
+    if (segment_len < sizeof(metadata_st)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Data received < metadata\n");
+        udp_reassembly->head = udp_reassembly->tail;
+        lib_commu_bail_force(EIO);
+    }
+
+    /* a fragment is validated as a datagram of the handle */
+    memcpy(&metadata_st, segment, sizeof(metadata_st));
+    if (metadata_st.version == MSG_FRAGMENT_VERSION) {
+        is_fragment = 1;
+        metadata_st.version = MSG_VERSION;
+    }
+    err = validate_metadata_info(&metadata_st,
+                                 is_fragment ?
+                                 (sizeof(fragment_st) + UDP_FRAGMENT_PAYLOAD) :
+                                 MAX_UDP_PAYLOAD, handle_info_st);
+    if (err) {
+        udp_reassembly->head = udp_reassembly->tail;
+        lib_commu_bail_force(err);
+    }
+
+    header_len = msg_header_len(&metadata_st);
+    if ((segment_len < header_len) ||
+        (metadata_st.payload_size > segment_len - header_len)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "payload size [%u] > data received [%u]\n",
+                metadata_st.payload_size,
+                (uint32_t)(segment_len - sizeof(metadata_st)));
+        udp_reassembly->head = udp_reassembly->tail;
+        lib_commu_bail_force(EIO);
+    }
+    udp_reassembly->head += header_len + metadata_st.payload_size;
+    msg_trace_recv(handle_info_st->handle, &metadata_st,
+                   udp_reassembly->ipv4_addr, segment + sizeof(metadata_st));
+    segment += header_len;
+
+    if (!is_fragment) {
+        if (metadata_st.payload_size > *payload_len) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                    metadata_st.payload_size);
+            lib_commu_bail_force(EOVERFLOW);
+        }
+        memcpy(payload, segment, metadata_st.payload_size);
+        *payload_len = metadata_st.payload_size;
+        addresser_st->ipv4_addr = udp_reassembly->ipv4_addr;
+        addresser_st->port = udp_reassembly->port;
+        *is_msg_done = 1;
+        goto bail;
+    }
+
+    if (metadata_st.payload_size < sizeof(fragment_st)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Fragment size [%u] < fragment header\n",
+                metadata_st.payload_size);
+        lib_commu_bail_force(EIO);
+    }
+    memcpy(&fragment_st, segment, sizeof(fragment_st));
+    fragment_st.msg_seq = ntohl(fragment_st.msg_seq);
+    fragment_st.msg_len = ntohl(fragment_st.msg_len);
+    fragment_st.offset = ntohl(fragment_st.offset);
+    frag_len = metadata_st.payload_size - sizeof(fragment_st);
+    segment += sizeof(fragment_st);
+
+    /* a message is cut at every UDP_FRAGMENT_PAYLOAD bytes */
+    if ((fragment_st.msg_len <= MAX_UDP_PAYLOAD) ||
+        (fragment_st.msg_len > MAX_UDP_LARGE_PAYLOAD) ||
+        (fragment_st.offset >= fragment_st.msg_len) ||
+        (fragment_st.offset % UDP_FRAGMENT_PAYLOAD) ||
+        ((frag_len != UDP_FRAGMENT_PAYLOAD) &&
+         (frag_len != fragment_st.msg_len - fragment_st.offset)) ||
+        (frag_len > fragment_st.msg_len - fragment_st.offset)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid fragment [%u] bytes at [%u] of [%u] bytes\n",
+                frag_len, fragment_st.offset, fragment_st.msg_len);
+        lib_commu_bail_force(EIO);
+    }
+
+    err = udp_fragments_get(udp_reassembly, &fragment_st, dropped_num,
+                            &fragments);
+    lib_commu_bail_error(err);
+    fragments->last_used = ++udp_reassembly->clock;
+
+    /* a duplicated fragment is ignored */
+    frag_idx = fragment_st.offset / UDP_FRAGMENT_PAYLOAD;
+    frags_map = fragments->payload + fragments->msg_len;
+    if (frags_map[frag_idx / 8] & (1 << (frag_idx % 8))) {
+        goto bail;
+    }
+    frags_map[frag_idx / 8] |= (1 << (frag_idx % 8));
+    memcpy(fragments->payload + fragment_st.offset, segment, frag_len);
+    fragments->recvd_len += frag_len;
+    if (fragments->recvd_len < fragments->msg_len) {
+        goto bail;
+    }
+
+    if (fragments->msg_len > *payload_len) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                fragments->msg_len);
+        err = EOVERFLOW;
+    }
+    else {
+        memcpy(payload, fragments->payload, fragments->msg_len);
+        *payload_len = fragments->msg_len;
+        addresser_st->ipv4_addr = fragments->ipv4_addr;
+        addresser_st->port = fragments->port;
+        *is_msg_done = 1;
+    }
+    (void)lib_commu_pool_buffer_put(fragments->payload);
+    fragments->payload = NULL;
+
+bail:
+    return err;
+}
+
+
+/* creates the retransmission timer of all the reliable handles on first
+ * use, it ticks while there are reliable handles.
+ * Called with lock_reliable held */
+static int
+udp_reliable_timer_open(void)
+{
+    int err = 0;
+    struct itimerspec timeout;
+
+    if (reliable_timer_item.fd == INVALID_HANDLE_ID) {
+        reliable_timer_item.fd = timerfd_create(CLOCK_MONOTONIC,
+                                                TFD_NONBLOCK | TFD_CLOEXEC);
+        if (reliable_timer_item.fd < 0) {
+            reliable_timer_item.fd = INVALID_HANDLE_ID;
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "timerfd_create failed with err(%d): %s\n", errno,
+                    strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+        reliable_timer_item.handler = udp_reliable_timer_handler;
+        reliable_timer_item.release = NULL;
+        reliable_timer_item.ctx = NULL;
+
+        err = lib_commu_reactor_item_add(&reliable_timer_item, EPOLLIN,
+                                         REACTOR_ANY_THREAD);
+        if (err) {
+            close(reliable_timer_item.fd);
+            reliable_timer_item.fd = INVALID_HANDLE_ID;
+            lib_commu_bail_force(err);
+        }
+    }
+
+    if (reliable_list == NULL) {
+        memset(&timeout, 0, sizeof(timeout));
+        timeout.it_value.tv_nsec = UDP_RELIABLE_TICK_MSEC * 1000000L;
+        timeout.it_interval = timeout.it_value;
+        if (timerfd_settime(reliable_timer_item.fd, 0, &timeout, NULL) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "timerfd_settime failed with err(%d): %s\n", errno,
+                    strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+    }
+
+bail:
+    return err;
+}
+
+
+/* called once the reactor is down, the handles are freed with the DB */
+static void
+udp_reliable_timer_close(void)
+{
+    pthread_mutex_lock(&lock_reliable);
+    if (reliable_timer_item.fd != INVALID_HANDLE_ID) {
+        close(reliable_timer_item.fd);
+        reliable_timer_item.fd = INVALID_HANDLE_ID;
+    }
+    reliable_list = NULL;
+    pthread_mutex_unlock(&lock_reliable);
+}
+
+
+/* retransmits the messages not acked in time */
+static void
+udp_reliable_timer_handler(struct lib_commu_reactor_item *item,
+                           uint32_t events)
+{
+    uint64_t expirations = 0;
+    unsigned long long now_ns = 0;
+    struct udp_reliable *udp_reliable = NULL;
+
+    UNUSED_PARAM(events);
+
+    if (read(item->fd, &expirations, sizeof(expirations)) < 0) {
+        return;
+    }
+
+    now_ns = time_ns_get();
+
+    pthread_mutex_lock(&lock_reliable);
+    for (udp_reliable = reliable_list; udp_reliable != NULL;
+         udp_reliable = udp_reliable->next) {
+        pthread_mutex_lock(&udp_reliable->lock);
+        udp_reliable_retransmit(udp_reliable, now_ns);
+        udp_reliable_peers_forget(udp_reliable, now_ns);
+        pthread_mutex_unlock(&udp_reliable->lock);
+    }
+    pthread_mutex_unlock(&lock_reliable);
+}
+
+
+/* the timer doesn't scan the handle once it returns, and stops ticking
+ * after the last handle */
+static void
+udp_reliable_unlink(struct udp_reliable *udp_reliable)
+{
+    struct itimerspec timeout;
+
+    pthread_mutex_lock(&lock_reliable);
+    if (udp_reliable->prev != NULL) {
+        udp_reliable->prev->next = udp_reliable->next;
+    }
+    else if (reliable_list == udp_reliable) {
+        reliable_list = udp_reliable->next;
+    }
+    if (udp_reliable->next != NULL) {
+        udp_reliable->next->prev = udp_reliable->prev;
+    }
+    udp_reliable->prev = NULL;
+    udp_reliable->next = NULL;
+
+    if ((reliable_list == NULL) &&
+        (reliable_timer_item.fd != INVALID_HANDLE_ID)) {
+        memset(&timeout, 0, sizeof(timeout));
+        (void)timerfd_settime(reliable_timer_item.fd, 0, &timeout, NULL);
+    }
+    pthread_mutex_unlock(&lock_reliable);
+}
+
+
+/* retransmits the expired messages of every peer, and doubles the timeout
+ * of a peer once its oldest message not received expires. The messages to
+ * a peer are given up once one of them was retransmitted
+ * UDP_RELIABLE_RETRIES_MAX times, then the reset is. Once the peer received
+ * all of them, one is probed in case the ack freeing them was lost, a slow
+ * receiver isn't given up. Called with the lock held */
+static void
+udp_reliable_retransmit(struct udp_reliable *udp_reliable,
+                        unsigned long long now_ns)
+{
+    struct udp_reliable_peer *peer = NULL;
+    struct udp_reliable_msg *msg = NULL;
+    struct udp_reliable_msg *probe_msg = NULL;
+    struct sockaddr_in recipient;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    uint32_t seq = 0;
+    uint32_t retries = 0;
+    uint32_t total_bytes = 0;
+    uint32_t given_up_num = 0;
+    int is_expired = 0;
+    int is_oldest = 0;
+    int is_received = 0;
+
+    memset(&recipient, 0, sizeof(recipient));
+    recipient.sin_family = AF_INET;
+
+    for (peer = udp_reliable->peers; peer != NULL; peer = peer->next) {
+        is_expired = 0;
+        is_oldest = 1;
+        is_received = 1;
+        probe_msg = NULL;
+        recipient.sin_port = peer->port;
+        recipient.sin_addr.s_addr = peer->ipv4_addr;
+
+        /* the reset isn't acked, it's sent until the peer is forgotten */
+        if (peer->err != 0) {
+            if ((now_ns - peer->reset_sent_ns >= peer->rto_ns) &&
+                (udp_reliable_reset_send(udp_reliable, peer,
+                                         &recipient) == 0)) {
+                peer->reset_sent_ns = now_ns;
+                peer->rto_ns *= 2;
+                if (peer->rto_ns > UDP_RELIABLE_RTO_MAX_MSEC * 1000000ULL) {
+                    peer->rto_ns = UDP_RELIABLE_RTO_MAX_MSEC * 1000000ULL;
+                }
+            }
+            continue;
+        }
+
+        for (seq = peer->tx_acked; seq != peer->tx_seq; seq++) {
+            msg = peer->tx_msgs[seq % UDP_RELIABLE_WINDOW];
+            if (msg->is_sacked) {
+                if (probe_msg == NULL) {
+                    probe_msg = msg;
+                }
+                continue;
+            }
+            is_received = 0;
+            if (now_ns - msg->sent_ns < peer->rto_ns) {
+                is_oldest = 0;
+                continue;
+            }
+            if (msg->retries >= UDP_RELIABLE_RETRIES_MAX) {
+                given_up_num += peer->tx_seq - peer->tx_acked;
+                udp_reliable_peer_give_up(udp_reliable, peer);
+                break;
+            }
+            /* the socket is full, retried on the next tick */
+            if (udp_reliable_msg_resend(udp_reliable, peer, msg,
+                                        &recipient) != 0) {
+                break;
+            }
+            /* a message sent_ns was reset for didn't time out */
+            if ((msg->sent_ns != 0) && is_oldest) {
+                is_expired = 1;
+            }
+            is_oldest = 0;
+            msg->sent_ns = now_ns;
+            msg->retries++;
+            retries++;
+            total_bytes += msg->len;
+        }
+
+        if (is_received && (probe_msg != NULL) &&
+            (now_ns - probe_msg->sent_ns >= peer->rto_ns) &&
+            (udp_reliable_msg_resend(udp_reliable, peer, probe_msg,
+                                     &recipient) == 0)) {
+            is_expired = 1;
+            probe_msg->sent_ns = now_ns;
+            retries++;
+            total_bytes += probe_msg->len;
+        }
+
+        if (is_expired) {
+            peer->rto_ns *= 2;
+            if (peer->rto_ns > UDP_RELIABLE_RTO_MAX_MSEC * 1000000ULL) {
+                peer->rto_ns = UDP_RELIABLE_RTO_MAX_MSEC * 1000000ULL;
+            }
+        }
+    }
+
+    if (retries > 0) {
+        (void)handle_stats_counter_add(udp_reliable->handle,
+                                       HANDLE_STATS_RETRIES, retries);
+        (void)handle_total_tx_update(udp_reliable->handle, &handle_db_type,
+                                     total_bytes);
+    }
+    if (given_up_num > 0) {
+        (void)handle_stats_counter_add(udp_reliable->handle,
+                                       HANDLE_STATS_TX_ERRORS, given_up_num);
+    }
+}
+
+
+/* sends a message again, it skips the messages given up since it was sent */
+static int
+udp_reliable_msg_resend(struct udp_reliable *udp_reliable,
+                        struct udp_reliable_peer *peer,
+                        struct udp_reliable_msg *msg,
+                        struct sockaddr_in *recipient)
+{
+    uint32_t ack_seq = htonl(peer->tx_acked);
+
+    memcpy(msg->data + sizeof(struct msg_metadata) +
+           offsetof(struct msg_reliable, ack_seq), &ack_seq, sizeof(ack_seq));
+    if (sendto(udp_reliable->handle, msg->data, msg->len, MSG_DONTWAIT,
+               (struct sockaddr *)recipient, sizeof(*recipient)) < 0) {
+        return errno;
+    }
+    return 0;
+}
+
+
+/* drops the messages not acked by the peer, the next sends to it fail until
+ * it's forgotten. The peer fails too once it receives the reset */
+static void
+udp_reliable_peer_give_up(struct udp_reliable *udp_reliable,
+                          struct udp_reliable_peer *peer)
+{
+    struct udp_reliable_msg **slot = NULL;
+
+    LCM_LOG(LCOMMU_LOG_ERROR,
+            "Gave up [%u] messages to peer [0x%x:%u] of handle[%d]\n",
+            peer->tx_seq - peer->tx_acked, ntohl(peer->ipv4_addr),
+            ntohs(peer->port), udp_reliable->handle);
+
+    for (; peer->tx_acked != peer->tx_seq; peer->tx_acked++) {
+        slot = &peer->tx_msgs[peer->tx_acked % UDP_RELIABLE_WINDOW];
+        (void)lib_commu_pool_buffer_put((uint8_t *)*slot);
+        *slot = NULL;
+    }
+    peer->err = ETIMEDOUT;
+    peer->reset_sent_ns = 0;
+    udp_reliable_rto_update(peer, 0);
+    pthread_cond_broadcast(&udp_reliable->tx_cond);
+}
+
+
+/* tells the peer the messages not acked were given up */
+static int
+udp_reliable_reset_send(struct udp_reliable *udp_reliable,
+                        struct udp_reliable_peer *peer,
+                        struct sockaddr_in *recipient)
+{
+    struct msg_metadata metadata_st;
+    struct msg_reliable reliable_st;
+    struct iovec iov[2];
+    struct msghdr msg_hdr;
+
+    memset(&metadata_st, 0, sizeof(metadata_st));
+    memset(&reliable_st, 0, sizeof(reliable_st));
+    memset(&msg_hdr, 0, sizeof(msg_hdr));
+    (void)metadata_set(&metadata_st, MSG_RELIABLE_VERSION,
+                       sizeof(reliable_st), *udp_reliable->handle_info_st);
+
+    reliable_st.type = UDP_RELIABLE_RESET;
+    reliable_st.seq = htonl(peer->tx_seq);
+    reliable_st.ack_seq = htonl(peer->tx_acked);
+    reliable_st.epoch = htonl(peer->tx_epoch);
+
+    iov[0].iov_base = &metadata_st;
+    iov[0].iov_len = sizeof(metadata_st);
+    iov[1].iov_base = &reliable_st;
+    iov[1].iov_len = sizeof(reliable_st);
+    msg_hdr.msg_name = recipient;
+    msg_hdr.msg_namelen = sizeof(*recipient);
+    msg_hdr.msg_iov = iov;
+    msg_hdr.msg_iovlen = 2;
+
+    if (sendmsg(udp_reliable->handle, &msg_hdr, MSG_DONTWAIT) < 0) {
+        return errno;
+    }
+    return 0;
+}
+
+
+/* forgets the peers nothing was exchanged with for
+ * UDP_RELIABLE_PEER_IDLE_MSEC and with no message in flight, the next
+ * message to or from them starts a new sequence. A peer with messages
+ * received and not delivered fails first. Called with the lock held */
+static void
+udp_reliable_peers_forget(struct udp_reliable *udp_reliable,
+                          unsigned long long now_ns)
+{
+    struct udp_reliable_peer **peer_ptr = &udp_reliable->peers;
+    struct udp_reliable_peer **hash_ptr = NULL;
+    struct udp_reliable_peer *peer = NULL;
+
+    while ((peer = *peer_ptr) != NULL) {
+        if ((now_ns - peer->last_ns <
+             UDP_RELIABLE_PEER_IDLE_MSEC * 1000000ULL) ||
+            (peer->users_num > 0) || (peer->tx_acked != peer->tx_seq) ||
+            peer->is_rx_blocked || peer->is_ack_pending) {
+            peer_ptr = &peer->next;
+            continue;
+        }
+
+        /* the sender is gone, it won't retransmit the gap */
+        if (!peer->is_rx_failed &&
+            (peer->is_rx_reset || udp_reliable_rx_is_pending(peer))) {
+            peer->is_rx_reset = 1;
+            udp_reliable_peer_deliver(udp_reliable, peer);
+            if (!peer->is_rx_failed) {
+                peer_ptr = &peer->next;
+                continue;
+            }
+        }
+
+        LCM_LOG(LCOMMU_LOG_DEBUG,
+                "Forgot idle reliable peer [0x%x:%u] of handle[%d]\n",
+                ntohl(peer->ipv4_addr), ntohs(peer->port),
+                udp_reliable->handle);
+
+        for (hash_ptr = &udp_reliable->hash[udp_reliable_peer_bucket(
+                                                peer->ipv4_addr, peer->port)];
+             *hash_ptr != peer; hash_ptr = &(*hash_ptr)->hash_next) {
+        }
+        *hash_ptr = peer->hash_next;
+        *peer_ptr = peer->next;
+        udp_reliable->peers_num--;
+        safe_free(peer);
+    }
+}
+
+
+/* updates the round trip estimation with a sample (RFC 6298), or resets
+ * the timeout backed off by the retransmissions if rtt_ns is 0 */
+static void
+udp_reliable_rto_update(struct udp_reliable_peer *peer,
+                        unsigned long long rtt_ns)
+{
+    unsigned long long delta_ns = 0;
+
+    if (rtt_ns > 0) {
+        if (peer->srtt_ns == 0) {
+            peer->srtt_ns = rtt_ns;
+            peer->rttvar_ns = rtt_ns / 2;
+        }
+        else {
+            delta_ns = (peer->srtt_ns > rtt_ns) ? (peer->srtt_ns - rtt_ns) :
+                       (rtt_ns - peer->srtt_ns);
+            peer->rttvar_ns = (3 * peer->rttvar_ns + delta_ns) / 4;
+            peer->srtt_ns = (7 * peer->srtt_ns + rtt_ns) / 8;
+        }
+    }
+
+    if (peer->srtt_ns == 0) {
+        peer->rto_ns = UDP_RELIABLE_RTO_INIT_MSEC * 1000000ULL;
+        return;
+    }
+    peer->rto_ns = peer->srtt_ns + 4 * peer->rttvar_ns;
+    if (peer->rto_ns < UDP_RELIABLE_RTO_MIN_MSEC * 1000000ULL) {
+        peer->rto_ns = UDP_RELIABLE_RTO_MIN_MSEC * 1000000ULL;
+    }
+    if (peer->rto_ns > UDP_RELIABLE_RTO_MAX_MSEC * 1000000ULL) {
+        peer->rto_ns = UDP_RELIABLE_RTO_MAX_MSEC * 1000000ULL;
+    }
+}
+
+
+static uint32_t
+udp_reliable_peer_bucket(uint32_t ipv4_addr, uint16_t port)
+{
+    return (ntohl(ipv4_addr) * 31 + ntohs(port)) % UDP_RELIABLE_HASH_SIZE;
+}
+
+
+/* finds the peer of an address, a new peer is added if is_created */
+static int
+udp_reliable_peer_get(struct udp_reliable *udp_reliable, uint32_t ipv4_addr,
+                      uint16_t port, int is_created,
+                      struct udp_reliable_peer **peer)
+{
+    int err = 0;
+    uint32_t bucket = udp_reliable_peer_bucket(ipv4_addr, port);
+    struct udp_reliable_peer *new_peer = NULL;
+
+    for (*peer = udp_reliable->hash[bucket]; *peer != NULL;
+         *peer = (*peer)->hash_next) {
+        if (((*peer)->ipv4_addr == ipv4_addr) && ((*peer)->port == port)) {
+            goto bail;
+        }
+    }
+
+    if (!is_created) {
+        goto bail;
+    }
+
+    if (udp_reliable->peers_num >= UDP_RELIABLE_PEERS_MAX) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has [%u] reliable peers\n",
+                udp_reliable->handle, udp_reliable->peers_num);
+        lib_commu_bail_force(ENOBUFS);
+    }
+
+    /* the windows follow the peer */
+    new_peer = (struct udp_reliable_peer *)calloc(1, sizeof(*new_peer) +
+                                                  2 * UDP_RELIABLE_WINDOW *
+                                                  sizeof(struct udp_reliable_msg *));
+    if (new_peer == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to allocate reliable peer of handle[%d]\n",
+                udp_reliable->handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    new_peer->ipv4_addr = ipv4_addr;
+    new_peer->port = port;
+    new_peer->peer_magic = INVALID_MAGIC;
+    new_peer->rto_ns = UDP_RELIABLE_RTO_INIT_MSEC * 1000000ULL;
+    new_peer->tx_epoch = udp_reliable->epoch_next++;
+    new_peer->tx_msgs = (struct udp_reliable_msg **)(new_peer + 1);
+    new_peer->rx_msgs = new_peer->tx_msgs + UDP_RELIABLE_WINDOW;
+
+    new_peer->hash_next = udp_reliable->hash[bucket];
+    udp_reliable->hash[bucket] = new_peer;
+    new_peer->next = udp_reliable->peers;
+    udp_reliable->peers = new_peer;
+    udp_reliable->peers_num++;
+    *peer = new_peer;
+
+bail:
+    return err;
+}
+
+
+/* the peer restarted, its messages start over and ours are retransmitted */
+static void
+udp_reliable_peer_restart(struct udp_reliable_peer *peer)
+{
+    struct udp_reliable_msg *msg = NULL;
+    uint32_t seq = 0;
+
+    LCM_LOG(LCOMMU_LOG_NOTICE, "Reliable peer [0x%x:%u] restarted\n",
+            ntohl(peer->ipv4_addr), ntohs(peer->port));
+
+    udp_reliable_rx_drop(peer);
+    peer->is_rx_synced = 0;
+    peer->is_rx_reset = 0;
+    peer->is_rx_failed = 0;
+
+    for (seq = peer->tx_acked; seq != peer->tx_seq; seq++) {
+        msg = peer->tx_msgs[seq % UDP_RELIABLE_WINDOW];
+        msg->sent_ns = 0;
+        msg->is_sacked = 0;
+    }
+}
+
+
+static int
+udp_reliable_rx_is_pending(struct udp_reliable_peer *peer)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < UDP_RELIABLE_WINDOW; i++) {
+        if (peer->rx_msgs[i] != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/* drops the messages received and not delivered */
+static void
+udp_reliable_rx_drop(struct udp_reliable_peer *peer)
+{
+    uint32_t i = 0;
+
+    for (i = 0; i < UDP_RELIABLE_WINDOW; i++) {
+        if (peer->rx_msgs[i] != NULL) {
+            (void)lib_commu_pool_buffer_put((uint8_t *)peer->rx_msgs[i]);
+            peer->rx_msgs[i] = NULL;
+        }
+    }
+}
+
+
+/* receives a new sequence of the peer from seq, its oldest message not
+ * acked. The previous sequence fails first if messages of it weren't
+ * delivered, returns 0 while they wait for room in the delivery queue */
+static int
+udp_reliable_rx_sync(struct udp_reliable *udp_reliable,
+                     struct udp_reliable_peer *peer, uint32_t epoch,
+                     uint32_t seq)
+{
+    if (peer->is_rx_synced && !peer->is_rx_failed &&
+        (peer->is_rx_reset || udp_reliable_rx_is_pending(peer))) {
+        peer->is_rx_reset = 1;
+        udp_reliable_peer_deliver(udp_reliable, peer);
+        if (!peer->is_rx_failed) {
+            return 0;
+        }
+    }
+
+    peer->rx_epoch = epoch;
+    peer->rx_seq = seq;
+    peer->is_rx_synced = 1;
+    peer->is_rx_reset = 0;
+    peer->is_rx_failed = 0;
+    return 1;
+}
+
+
+/* queues the messages received in order for delivery, and ECONNRESET once
+ * the peer reset in place of the ones after them. Once the queue is full
+ * the peer waits in the blocked list, and isn't acked meanwhile */
+static void
+udp_reliable_peer_deliver(struct udp_reliable *udp_reliable,
+                          struct udp_reliable_peer *peer)
+{
+    struct udp_reliable_msg **slot = NULL;
+    struct udp_reliable_msg *msg = NULL;
+    uint8_t *buffer = NULL;
+
+    while (!peer->is_rx_failed) {
+        slot = &peer->rx_msgs[peer->rx_seq % UDP_RELIABLE_WINDOW];
+        if ((*slot == NULL) && !peer->is_rx_reset) {
+            return;
+        }
+        if (udp_reliable->rx_msgs_num >= UDP_RELIABLE_RX_MSGS_MAX) {
+            if (!peer->is_rx_blocked) {
+                peer->is_rx_blocked = 1;
+                peer->blocked_next = NULL;
+                if (udp_reliable->blocked_tail != NULL) {
+                    udp_reliable->blocked_tail->blocked_next = peer;
+                }
+                else {
+                    udp_reliable->blocked = peer;
+                }
+                udp_reliable->blocked_tail = peer;
+            }
+            return;
+        }
+
+        if (*slot != NULL) {
+            msg = *slot;
+            *slot = NULL;
+            peer->rx_seq++;
+        }
+        else {
+            /* retried on the next message or tick */
+            if (lib_commu_pool_buffer_get(sizeof(*msg), &buffer) != 0) {
+                return;
+            }
+            msg = (struct udp_reliable_msg *)buffer;
+            memset(msg, 0, sizeof(*msg));
+            msg->ipv4_addr = peer->ipv4_addr;
+            msg->port = peer->port;
+            msg->seq = peer->rx_seq;
+            msg->err = ECONNRESET;
+            udp_reliable_rx_drop(peer);
+            peer->is_rx_failed = 1;
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Reliable peer [0x%x:%u] of handle[%d] failed at [%u]\n",
+                    ntohl(peer->ipv4_addr), ntohs(peer->port),
+                    udp_reliable->handle, peer->rx_seq);
+        }
+
+        msg->next = NULL;
+        if (udp_reliable->rx_tail != NULL) {
+            udp_reliable->rx_tail->next = msg;
+        }
+        else {
+            udp_reliable->rx_head = msg;
+        }
+        udp_reliable->rx_tail = msg;
+        udp_reliable->rx_msgs_num++;
+        pthread_cond_signal(&udp_reliable->rx_cond);
+    }
+}
+
+
+/* delivers the blocked peers while the queue has room, and acks them.
+ * Called with the lock held */
+static void
+udp_reliable_blocked_deliver(struct udp_reliable *udp_reliable,
+                             struct handle_info *handle_info_st)
+{
+    struct udp_reliable_peer *acked_peers[UDP_BATCH_MSGS];
+    struct udp_reliable_peer *peer = NULL;
+    uint32_t acks_num = 0;
+
+    while ((udp_reliable->blocked != NULL) &&
+           (udp_reliable->rx_msgs_num < UDP_RELIABLE_RX_MSGS_MAX) &&
+           (acks_num < UDP_BATCH_MSGS)) {
+        peer = udp_reliable->blocked;
+        udp_reliable->blocked = peer->blocked_next;
+        if (udp_reliable->blocked == NULL) {
+            udp_reliable->blocked_tail = NULL;
+        }
+        peer->blocked_next = NULL;
+        peer->is_rx_blocked = 0;
+
+        udp_reliable_peer_deliver(udp_reliable, peer);
+        if (!peer->is_ack_pending) {
+            peer->is_ack_pending = 1;
+            acked_peers[acks_num++] = peer;
+        }
+    }
+
+    udp_reliable_acks_send(udp_reliable, handle_info_st, acked_peers,
+                           acks_num);
+}
+
+
+/* frees the messages delivered by the peer, and marks the ones it received
+ * so they aren't retransmitted. A message not received while 3 later ones
+ * were is lost, it's retransmitted on the next tick instead of timing out.
+ * Messages retransmitted or received before aren't sampled for the round
+ * trip (Karn) */
+static void
+udp_reliable_ack_recv(struct udp_reliable *udp_reliable,
+                      struct udp_reliable_peer *peer,
+                      struct msg_reliable *reliable_st,
+                      unsigned long long now_ns)
+{
+    struct udp_reliable_msg **slot = NULL;
+    struct udp_reliable_msg *msg = NULL;
+    unsigned long long rtt_ns = 0;
+    uint32_t seq = 0;
+    uint32_t high_seq = 0;
+    uint32_t i = 0;
+    int is_freed = 0;
+
+    /* acks messages not sent, of a previous incarnation of the handle */
+    if ((int32_t)(reliable_st->ack_seq - peer->tx_seq) > 0) {
+        return;
+    }
+
+    high_seq = peer->tx_acked;
+
+    while ((int32_t)(reliable_st->ack_seq - peer->tx_acked) > 0) {
+        slot = &peer->tx_msgs[peer->tx_acked % UDP_RELIABLE_WINDOW];
+        if (((*slot)->retries == 0) && !(*slot)->is_sacked) {
+            rtt_ns = now_ns - (*slot)->sent_ns;
+        }
+        (void)lib_commu_pool_buffer_put((uint8_t *)*slot);
+        *slot = NULL;
+        peer->tx_acked++;
+        is_freed = 1;
+    }
+
+    for (i = 0; i < UDP_RELIABLE_WINDOW; i++) {
+        seq = reliable_st->ack_seq + i;
+        if (!(reliable_st->sack_bits & (1U << i)) ||
+            ((int32_t)(seq - peer->tx_acked) < 0) ||
+            ((int32_t)(seq - peer->tx_seq) >= 0)) {
+            continue;
+        }
+        msg = peer->tx_msgs[seq % UDP_RELIABLE_WINDOW];
+        if (!msg->is_sacked) {
+            if (msg->retries == 0) {
+                rtt_ns = now_ns - msg->sent_ns;
+            }
+            msg->is_sacked = 1;
+        }
+        high_seq = seq;
+    }
+
+    for (seq = peer->tx_acked; (int32_t)(high_seq - seq) >= 3; seq++) {
+        msg = peer->tx_msgs[seq % UDP_RELIABLE_WINDOW];
+        if (!msg->is_sacked && (msg->retries == 0)) {
+            msg->sent_ns = 0;
+        }
+    }
+
+    if (rtt_ns > 0) {
+        udp_reliable_rto_update(peer, rtt_ns);
+    }
+    if (is_freed) {
+        pthread_cond_broadcast(&udp_reliable->tx_cond);
+    }
+}
+
+
+/* handles a datagram of a reliable peer, sets peer if it's to be acked.
+ * Called with the lock held */
+static int
+udp_reliable_datagram_recv(struct udp_reliable *udp_reliable,
+                           struct handle_info *handle_info_st,
+                           struct sockaddr_in *addresser, uint8_t *buffer,
+                           uint32_t len, unsigned long long now_ns,
+                           struct udp_reliable_peer **peer, int *is_new_msg)
+{
+    int err = 0;
+    struct msg_metadata metadata_st;
+    struct msg_reliable reliable_st;
+    struct udp_reliable_msg *msg = NULL;
+    uint8_t *msg_buffer = NULL;
+    uint32_t payload_len = 0;
+
+    *peer = NULL;
+    *is_new_msg = 0;
+
+    if (len < sizeof(metadata_st) + sizeof(reliable_st)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid datagram size [%u]\n", len);
+        lib_commu_bail_force(EIO);
+    }
+
+    memcpy(&metadata_st, buffer, sizeof(metadata_st));
+    if (metadata_st.version != MSG_RELIABLE_VERSION) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Datagram version[%u] isn't a reliable message\n",
+                metadata_st.version);
+        lib_commu_bail_force(EIO);
+    }
+
+    /* the header is checked as a plain message */
+    metadata_st.version = MSG_VERSION;
+    err = validate_metadata_info(&metadata_st,
+                                 sizeof(reliable_st) + MAX_UDP_RELIABLE_PAYLOAD,
+                                 handle_info_st);
+    lib_commu_bail_error(err);
+    if ((metadata_st.payload_size != len - sizeof(metadata_st)) ||
+        (metadata_st.payload_size < sizeof(reliable_st))) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid payload size [%u] of a [%u] bytes datagram\n",
+                metadata_st.payload_size, len);
+        lib_commu_bail_force(EIO);
+    }
+
+    memcpy(&reliable_st, buffer + sizeof(metadata_st), sizeof(reliable_st));
+    reliable_st.seq = ntohl(reliable_st.seq);
+    reliable_st.ack_seq = ntohl(reliable_st.ack_seq);
+    reliable_st.sack_bits = ntohl(reliable_st.sack_bits);
+    reliable_st.epoch = ntohl(reliable_st.epoch);
+    payload_len = metadata_st.payload_size - sizeof(reliable_st);
+
+    if (((reliable_st.type == UDP_RELIABLE_DATA) && (payload_len == 0)) ||
+        (reliable_st.type > UDP_RELIABLE_RESET)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid reliable type [%u] of [%u] bytes\n",
+                reliable_st.type, payload_len);
+        lib_commu_bail_force(EIO);
+    }
+
+    /* an ack of an unknown peer is stale */
+    err = udp_reliable_peer_get(udp_reliable, addresser->sin_addr.s_addr,
+                                addresser->sin_port,
+                                reliable_st.type != UDP_RELIABLE_ACK, peer);
+    lib_commu_bail_error(err);
+    if (*peer == NULL) {
+        goto bail;
+    }
+
+    if ((*peer)->peer_magic != metadata_st.trailer) {
+        if ((*peer)->peer_magic != INVALID_MAGIC) {
+            udp_reliable_peer_restart(*peer);
+        }
+        (*peer)->peer_magic = metadata_st.trailer;
+    }
+
+    /* an ack of the sequence before the peer was forgotten is stale */
+    if (reliable_st.type == UDP_RELIABLE_ACK) {
+        if (reliable_st.epoch == (*peer)->tx_epoch) {
+            (*peer)->last_ns = now_ns;
+            udp_reliable_ack_recv(udp_reliable, *peer, &reliable_st, now_ns);
+        }
+        *peer = NULL;
+        goto bail;
+    }
+
+    /* a message of an older sequence is stale, a newer one is received
+     * once the current one was delivered or failed */
+    if (!(*peer)->is_rx_synced ||
+        ((int32_t)(reliable_st.epoch - (*peer)->rx_epoch) > 0)) {
+        if (!udp_reliable_rx_sync(udp_reliable, *peer, reliable_st.epoch,
+                                  reliable_st.ack_seq)) {
+            *peer = NULL;
+            goto bail;
+        }
+    }
+    else if (reliable_st.epoch != (*peer)->rx_epoch) {
+        *peer = NULL;
+        goto bail;
+    }
+    (*peer)->last_ns = now_ns;
+
+    /* the messages after the ones the sender gave up are dropped */
+    if ((reliable_st.type == UDP_RELIABLE_RESET) || (*peer)->is_rx_reset) {
+        if (!(*peer)->is_rx_reset) {
+            (*peer)->is_rx_reset = 1;
+            udp_reliable_peer_deliver(udp_reliable, *peer);
+        }
+        *peer = NULL;
+        goto bail;
+    }
+
+    /* a duplicate is acked again, its ack may be lost */
+    if (((int32_t)(reliable_st.seq - (*peer)->rx_seq) < 0) ||
+        (reliable_st.seq - (*peer)->rx_seq >= UDP_RELIABLE_WINDOW) ||
+        ((*peer)->rx_msgs[reliable_st.seq % UDP_RELIABLE_WINDOW] != NULL)) {
+        goto bail;
+    }
+
+    err = lib_commu_pool_buffer_get(sizeof(*msg) + payload_len, &msg_buffer);
+    if (err) {
+        *peer = NULL;
+        goto bail;
+    }
+    msg = (struct udp_reliable_msg *)msg_buffer;
+    msg->ipv4_addr = (*peer)->ipv4_addr;
+    msg->port = (*peer)->port;
+    msg->seq = reliable_st.seq;
+    msg->err = 0;
+    msg->len = payload_len;
+    memcpy(msg->data, buffer + sizeof(metadata_st) + sizeof(reliable_st),
+           payload_len);
+    (*peer)->rx_msgs[reliable_st.seq % UDP_RELIABLE_WINDOW] = msg;
+    *is_new_msg = 1;
+
+    udp_reliable_peer_deliver(udp_reliable, *peer);
+
+bail:
+    return err;
+}
+
+
+/* acks the messages received from the peers, bit 0 of sack_bits is set if
+ * the next message waits for room in the delivery queue. A lost ack is
+ * repaired by the ack of the retransmission. Called with the lock held */
+static void
+udp_reliable_acks_send(struct udp_reliable *udp_reliable,
+                       struct handle_info *handle_info_st,
+                       struct udp_reliable_peer **peers, uint32_t peers_num)
+{
+    struct msg_metadata metadata_st;
+    struct msg_reliable reliable_st[UDP_BATCH_MSGS];
+    struct mmsghdr mmsg[UDP_BATCH_MSGS];
+    struct iovec iov[UDP_BATCH_MSGS][2];
+    struct sockaddr_in recipients[UDP_BATCH_MSGS];
+    struct udp_reliable_peer *peer = NULL;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    uint32_t sack_bits = 0;
+    uint32_t sent_num = 0;
+    uint32_t total_bytes = 0;
+    uint32_t i = 0, j = 0;
+    int nb_msgs = 0;
+
+    if (peers_num == 0) {
+        return;
+    }
+
+    memset(&metadata_st, 0, sizeof(metadata_st));
+    memset(mmsg, 0, peers_num * sizeof(mmsg[0]));
+    (void)metadata_set(&metadata_st, MSG_RELIABLE_VERSION,
+                       sizeof(reliable_st[0]), *handle_info_st);
+
+    for (j = 0; j < peers_num; j++) {
+        peer = peers[j];
+        peer->is_ack_pending = 0;
+
+        sack_bits = 0;
+        for (i = 0; i < UDP_RELIABLE_WINDOW; i++) {
+            if (peer->rx_msgs[(peer->rx_seq + i) % UDP_RELIABLE_WINDOW] !=
+                NULL) {
+                sack_bits |= 1U << i;
+            }
+        }
+        reliable_st[j].type = UDP_RELIABLE_ACK;
+        reliable_st[j].seq = 0;
+        reliable_st[j].ack_seq = htonl(peer->rx_seq);
+        reliable_st[j].sack_bits = htonl(sack_bits);
+        reliable_st[j].epoch = htonl(peer->rx_epoch);
+
+        memset(&recipients[j], 0, sizeof(recipients[j]));
+        recipients[j].sin_family = AF_INET;
+        recipients[j].sin_port = peer->port;
+        recipients[j].sin_addr.s_addr = peer->ipv4_addr;
+
+        iov[j][0].iov_base = &metadata_st;
+        iov[j][0].iov_len = sizeof(metadata_st);
+        iov[j][1].iov_base = &reliable_st[j];
+        iov[j][1].iov_len = sizeof(reliable_st[j]);
+        mmsg[j].msg_hdr.msg_name = &recipients[j];
+        mmsg[j].msg_hdr.msg_namelen = sizeof(recipients[j]);
+        mmsg[j].msg_hdr.msg_iov = iov[j];
+        mmsg[j].msg_hdr.msg_iovlen = 2;
+    }
+
+    while (sent_num < peers_num) {
+        nb_msgs = sendmmsg(udp_reliable->handle, mmsg + sent_num,
+                           peers_num - sent_num, MSG_DONTWAIT);
+        if (nb_msgs <= 0) {
+            if ((nb_msgs < 0) && (errno == EINTR)) {
+                continue;
+            }
+            break;
+        }
+        sent_num += nb_msgs;
+    }
+
+    total_bytes = sent_num * (sizeof(metadata_st) + sizeof(reliable_st[0]));
+    if (total_bytes > 0) {
+        (void)handle_total_tx_update(udp_reliable->handle, &handle_db_type,
+                                     total_bytes);
+    }
+}
+
+
+/* receives the datagrams of the reliable peers, and acks them once the
+ * batch was handled */
+static void
+udp_reliable_handler(struct lib_commu_reactor_item *item, uint32_t events)
+{
+    int err = 0;
+    int nb_msgs = 0;
+    int is_new_msg = 0;
+    struct udp_reliable *udp_reliable = (struct udp_reliable*)item->ctx;
+    struct handle_info *handle_info_st = udp_reliable->handle_info_st;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    struct mmsghdr mmsg[UDP_BATCH_MSGS];
+    struct iovec iov[UDP_BATCH_MSGS];
+    struct sockaddr_in addressers[UDP_BATCH_MSGS];
+    struct udp_reliable_peer *acked_peers[UDP_BATCH_MSGS];
+    struct udp_reliable_peer *peer = NULL;
+    unsigned long long now_ns = 0;
+    uint32_t acks_num = 0;
+    uint32_t msgs_num = 0;
+    uint32_t dropped_num = 0;
+    uint32_t total_bytes = 0;
+    uint32_t i = 0, j = 0;
+
+    UNUSED_PARAM(events);
+
+    for (i = 0; i < RX_CALLBACK_RECV_NUM; i++) {
+        memset(mmsg, 0, sizeof(mmsg));
+        for (j = 0; j < UDP_BATCH_MSGS; j++) {
+            iov[j].iov_base = udp_reliable->buffer + j * MAX_UDP_MSG_SIZE;
+            iov[j].iov_len = MAX_UDP_MSG_SIZE;
+
+            mmsg[j].msg_hdr.msg_name = &addressers[j];
+            mmsg[j].msg_hdr.msg_namelen = sizeof(addressers[j]);
+            mmsg[j].msg_hdr.msg_iov = &iov[j];
+            mmsg[j].msg_hdr.msg_iovlen = 1;
+        }
+
+        nb_msgs = recvmmsg(udp_reliable->handle, mmsg, UDP_BATCH_MSGS,
+                           MSG_DONTWAIT, NULL);
+        if (nb_msgs < 0) {
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed in recvmmsg() with err[%d]: %s",
+                    errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+
+        now_ns = time_ns_get();
+        acks_num = 0;
+
+        pthread_mutex_lock(&udp_reliable->lock);
+        for (j = 0; j < (uint32_t)nb_msgs; j++) {
+            total_bytes += mmsg[j].msg_len;
+            if ((mmsg[j].msg_hdr.msg_flags & MSG_TRUNC) ||
+                (udp_reliable_datagram_recv(udp_reliable, handle_info_st,
+                                            &addressers[j], iov[j].iov_base,
+                                            mmsg[j].msg_len, now_ns, &peer,
+                                            &is_new_msg) != 0)) {
+                dropped_num++;
+                continue;
+            }
+            msgs_num += is_new_msg;
+            if ((peer != NULL) && !peer->is_ack_pending) {
+                peer->is_ack_pending = 1;
+                acked_peers[acks_num++] = peer;
+            }
+        }
+        udp_reliable_acks_send(udp_reliable, handle_info_st, acked_peers,
+                               acks_num);
+        pthread_mutex_unlock(&udp_reliable->lock);
+
+        if (nb_msgs < UDP_BATCH_MSGS) {
+            break;
+        }
+    }
+
+bail:
+    handle_msgs_stats_update(udp_reliable->handle, 1, msgs_num, err);
+    if (dropped_num > 0) {
+        (void)handle_stats_counter_add(udp_reliable->handle,
+                                       HANDLE_STATS_RX_ERRORS, dropped_num);
+    }
+    if (total_bytes > 0) {
+        (void)handle_total_rx_update(udp_reliable->handle, &handle_db_type,
+                                     total_bytes);
+    }
+}
+
+
+static void
+udp_reliable_release(struct lib_commu_reactor_item *item)
+{
+    struct udp_reliable *udp_reliable = (struct udp_reliable*)item->ctx;
+    struct handle_info *handle_info_st = udp_reliable->handle_info_st;
+    int is_detached = 0;
+
+    pthread_mutex_lock(&udp_reliable->lock);
+    udp_reliable->is_released = 1;
+    is_detached = udp_reliable->is_detached;
+    pthread_cond_broadcast(&udp_reliable->released_cond);
+    pthread_mutex_unlock(&udp_reliable->lock);
+
+    if (is_detached) {
+        udp_reliable_free(udp_reliable);
+        handle_close_pending_put(handle_info_st);
+    }
+}
+
+
+static void
+udp_reliable_free(struct udp_reliable *udp_reliable)
+{
+    struct udp_reliable_peer *peer = NULL;
+    struct udp_reliable_msg *msg = NULL;
+    uint32_t i = 0;
+
+    while (udp_reliable->peers != NULL) {
+        peer = udp_reliable->peers;
+        udp_reliable->peers = peer->next;
+        for (i = 0; i < UDP_RELIABLE_WINDOW; i++) {
+            if (peer->tx_msgs[i] != NULL) {
+                (void)lib_commu_pool_buffer_put((uint8_t *)peer->tx_msgs[i]);
+            }
+            if (peer->rx_msgs[i] != NULL) {
+                (void)lib_commu_pool_buffer_put((uint8_t *)peer->rx_msgs[i]);
+            }
+        }
+        safe_free(peer);
+    }
+
+    while (udp_reliable->rx_head != NULL) {
+        msg = udp_reliable->rx_head;
+        udp_reliable->rx_head = msg->next;
+        (void)lib_commu_pool_buffer_put((uint8_t *)msg);
+    }
+
+    pthread_cond_destroy(&udp_reliable->released_cond);
+    pthread_cond_destroy(&udp_reliable->rx_cond);
+    pthread_cond_destroy(&udp_reliable->tx_cond);
+    pthread_mutex_destroy(&udp_reliable->lock);
+    safe_free(udp_reliable);
+}
+
+
+/* the users blocked in send or recv return ECANCELED, and so do the later
+ * ones. The peers are freed by udp_reliable_stop */
+static void
+udp_reliable_cancel(struct udp_reliable *udp_reliable)
+{
+    pthread_mutex_lock(&udp_reliable->lock);
+    udp_reliable->is_stopped = 1;
+    pthread_cond_broadcast(&udp_reliable->tx_cond);
+    pthread_cond_broadcast(&udp_reliable->rx_cond);
+    pthread_mutex_unlock(&udp_reliable->lock);
+}
+
+
+/* drops the peers and the messages not delivered, the users blocked in
+ * send or recv return ECANCELED. Called before the handle is closed.
+ * A reactor thread doesn't wait for the release, the reactor frees the peers
+ * then, see handle_close */
+static void
+udp_reliable_stop(struct handle_info *handle_info_st)
+{
+    struct udp_reliable *udp_reliable = NULL;
+    int is_waiting = 0;
+
+    udp_reliable = __atomic_exchange_n(&handle_info_st->udp_reliable, NULL,
+                                       __ATOMIC_ACQ_REL);
+    if (udp_reliable == NULL) {
+        return;
+    }
+
+    udp_reliable_unlink(udp_reliable);
+
+    pthread_mutex_lock(&udp_reliable->lock);
+    udp_reliable->is_stopped = 1;
+    pthread_cond_broadcast(&udp_reliable->tx_cond);
+    pthread_cond_broadcast(&udp_reliable->rx_cond);
+    is_waiting =
+        (lib_commu_reactor_item_remove_async(&udp_reliable->item) == 0);
+    /* the blocked users return once woken up */
+    while (udp_reliable->users_num > 0) {
+        pthread_cond_wait(&udp_reliable->released_cond, &udp_reliable->lock);
+    }
+    if (is_waiting && !udp_reliable->is_released &&
+        lib_commu_reactor_thread_is_current()) {
+        __atomic_add_fetch(&handle_info_st->close_pending, 1,
+                           __ATOMIC_ACQ_REL);
+        udp_reliable->is_detached = 1;
+        pthread_mutex_unlock(&udp_reliable->lock);
+        return;
+    }
+    while (is_waiting && !udp_reliable->is_released) {
+        pthread_cond_wait(&udp_reliable->released_cond, &udp_reliable->lock);
+    }
+    pthread_mutex_unlock(&udp_reliable->lock);
+
+    udp_reliable_free(udp_reliable);
+}
+
+
+static void
+pending_connect_handler(struct lib_commu_reactor_item *item, uint32_t events)
+{
+    int err = 0;
+    int so_err_val = 0;
+    socklen_t so_err_val_len = sizeof(so_err_val);
+    struct pending_connect *connect_st = (struct pending_connect*)item->ctx;
+
+    UNUSED_PARAM(events);
+
+    if (getsockopt(connect_st->client_fd, SOL_SOCKET, SO_ERROR, &so_err_val,
+                   &so_err_val_len) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "getsockopt failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+    if (so_err_val != 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to establish connection with err(%d): %s\n",
+                so_err_val, strerror(so_err_val));
+        lib_commu_bail_force(so_err_val);
+    }
+
+bail:
+    pending_connect_complete(connect_st, err);
+}
+
+
+static void
+pending_connect_timeout_handler(struct lib_commu_reactor_item *item,
+                                uint32_t events)
+{
+    struct pending_connect *connect_st = (struct pending_connect*)item->ctx;
+
+    UNUSED_PARAM(events);
+
+    LCM_LOG(LCOMMU_LOG_ERROR, "Connect on socket[%d] timed out\n",
+            connect_st->client_fd);
+    pending_connect_complete(connect_st, ETIMEDOUT);
+}
+
+
+/* called from the reactor thread serving both items of the connect */
+static void
+pending_connect_complete(struct pending_connect *connect_st, int err)
+{
+    int bail_err = 0;
+    int is_sock_sent_client = 0;
+    struct addr_info peer_info;
+
+    memset(&peer_info, 0, sizeof(peer_info));
+
+    if (connect_st->is_done) {
+        return;
+    }
+    connect_st->is_done = 1;
+
+    lib_commu_reactor_item_remove(&connect_st->connect_item);
+    if (connect_st->timer_fd != INVALID_HANDLE_ID) {
+        lib_commu_reactor_item_remove(&connect_st->timer_item);
+    }
+
+    if (err == 0) {
+        err = handle_new_non_blocking_client(connect_st->client_fd,
+                                             connect_st->fd_flags, connect_st,
+                                             &is_sock_sent_client);
+    }
+
+    if (err) {
+        if (!is_sock_sent_client) {
+            close_socket_wrapper(connect_st->client_fd);
+        }
+        peer_info.ipv4_addr = connect_st->conn_info.d_ipv4_addr;
+        peer_info.port = connect_st->conn_info.d_port;
+        bail_err = connect_st->clbk_st.clbk_notify_func(INVALID_HANDLE_ID,
+                                                        peer_info,
+                                                        connect_st->clbk_st.data,
+                                                        -err);
+        if (bail_err) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed to notify client on new handle with err(%d)\n",
+                    bail_err);
+        }
+    }
+}
+
+
+static void
+pending_connect_release(struct lib_commu_reactor_item *item)
+{
+    pending_connect_put((struct pending_connect*)item->ctx);
+}
+
+
+static void
+pending_connect_put(struct pending_connect *connect_st)
+{
+    if (__sync_sub_and_fetch(&connect_st->refcnt, 1) > 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&lock_pending_connects);
+    if (connect_st->prev != NULL) {
+        connect_st->prev->next = connect_st->next;
+    }
+    else {
+        pending_connects = connect_st->next;
+    }
+    if (connect_st->next != NULL) {
+        connect_st->next->prev = connect_st->prev;
+    }
+    pthread_mutex_unlock(&lock_pending_connects);
+
+    if (connect_st->timer_fd != INVALID_HANDLE_ID) {
+        close(connect_st->timer_fd);
+    }
+    safe_free(connect_st);
+}
+
+
+/* called on deinit once the reactor is down, the user isn't notified */
+static void
+pending_connects_flush(void)
+{
+    struct pending_connect *connect_st = NULL;
+
+    pthread_mutex_lock(&lock_pending_connects);
+    while (pending_connects != NULL) {
+        connect_st = pending_connects;
+        pending_connects = connect_st->next;
+        if (!connect_st->is_done) {
+            close_socket_wrapper(connect_st->client_fd);
+        }
+        if (connect_st->timer_fd != INVALID_HANDLE_ID) {
+            close(connect_st->timer_fd);
+        }
+        safe_free(connect_st);
+    }
+    pthread_mutex_unlock(&lock_pending_connects);
+}
+
+
+static int
+handle_new_non_blocking_client(
+    int client_fd, int def_flags, struct pending_connect *connect_st,
+    int *is_sock_sent_client)
+{
+    int err = 0;
+    uint32_t local_magic = 0;
+    struct addr_info peer_info;
+    struct addr_info local_info;
+
+    memset(&local_info, 0, sizeof(local_info));
+    memset(&peer_info, 0, sizeof(peer_info));
+
+    lib_commu_bail_null(connect_st);
+
+    if (client_fd == INVALID_HANDLE_ID) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid client FD\n");
+        lib_commu_bail_force(EPERM);
+    }
+
+    /* restore file status flags - set as blocking */
+    if (fcntl(client_fd, F_SETFL, def_flags) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "fcntl failed: on socket[%d] err(%u): %s",
+                client_fd, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* set local magic for the tcp client session */
+    err = pseudo_random_uint32_get(&local_magic);
+    lib_commu_bail_error(err);
+
+    peer_info.ipv4_addr = connect_st->conn_info.d_ipv4_addr;
+    peer_info.port = connect_st->conn_info.d_port;
+
+    /* insert handle to DB */
+    err = lib_commu_db_tcp_client_handle_info_set(client_fd,
+                                                  connect_st->conn_info.msg_type,
+                                                  local_info, peer_info,
+                                                  local_magic);
+    lib_commu_bail_error(err);
+
+    /*send new socket to client*/
+    err = connect_st->clbk_st.clbk_notify_func(client_fd, peer_info,
+                                                connect_st->clbk_st.data, 0);
+    lib_commu_bail_error(err);
+
+    *is_sock_sent_client = 1;
+
+    LCM_LOG(LCOMMU_LOG_INFO, "Establish connection on socket[%d]\n",
+            client_fd);
+
+bail:
+    return err;
+}
+
+
+/************************************************
+ *  Function implementations
+ ***********************************************/
+
+
+/**
+ * This function is used to open communication library and init it's data
+ *
+ * @param[in] - log_cb_t logging_cb
+ * @param[in, out] - None
+ * @param[out] - None
+ *
+ * @return 0 if operation completes successfully
+ * @return EFAULT or EINVAL or EPERM if pseusdo random init failed
+ * @return EPERM if DB operation failed
+ * @return errno codes of native pthread_mutex_init function
+ */
+int
+comm_lib_init(lib_commu_log_cb_t logging_cb)
+{
+    return comm_lib_init_with_params(logging_cb, NULL);
+}
+
+
+/**
+ * This function is used to open communication library and init it's data
+ * with non default resources
+ *
+ * @param[in] - log_cb_t logging_cb
+ * @param[in] - init_params - library resources, if NULL defaults are used
+ * @param[in, out] - None
+ * @param[out] - None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if init_params are out of range
+ * @return EFAULT or EINVAL or EPERM if pseusdo random init failed
+ * @return EPERM if DB operation failed
+ * @return errno codes of native pthread_mutex_init function
+ * @return errno codes of native epoll_create/pthread_create functions
+ * @return errno codes of native io_uring_setup function if IO_ENGINE_URING
+ *         is not supported by the kernel
+ */
+int
+comm_lib_init_with_params(lib_commu_log_cb_t logging_cb,
+                          const struct comm_lib_init_params *init_params)
+{
+    int err = 0;
+    struct comm_lib_init_params params;
+
+    memset(&params, 0, sizeof(params));
+    params.reactor_threads_num = DEFAULT_REACTOR_THREADS_NUM;
+    if (init_params != NULL) {
+        memcpy(&params, init_params, sizeof(params));
+    }
+    if (params.max_udp_sessions == 0) {
+        params.max_udp_sessions = DEFAULT_MAX_SESSIONS_NUM;
+    }
+    if (params.max_tcp_clients == 0) {
+        params.max_tcp_clients = DEFAULT_MAX_SESSIONS_NUM;
+    }
+    if (params.max_tcp_servers == 0) {
+        params.max_tcp_servers = DEFAULT_MAX_SESSIONS_NUM;
+    }
+    if (params.max_server_connections == 0) {
+        params.max_server_connections = DEFAULT_MAX_SESSIONS_NUM;
+    }
+
+    if (logging_cb == NULL) {
+        /* do nothing */
+    }
+    else {
+        lib_commu_log_cb = logging_cb;
+    }
+
+    if (g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_NOTICE, "Library already initialized\n");
+        goto bail;
+    }
+
+    if ((params.reactor_threads_num == 0) ||
+        (params.reactor_threads_num > MAX_REACTOR_THREADS_NUM)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid parameter [reactor_threads_num = %u]\n",
+                params.reactor_threads_num);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    if ((params.max_udp_sessions > MAX_SESSIONS_NUM) ||
+        (params.max_tcp_clients > MAX_SESSIONS_NUM) ||
+        (params.max_tcp_servers > MAX_SERVERS_NUM) ||
+        (params.max_server_connections > MAX_SESSIONS_NUM)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid parameter [max_udp_sessions = %u, "
+                "max_tcp_clients = %u, max_tcp_servers = %u, "
+                "max_server_connections = %u]\n",
+                params.max_udp_sessions, params.max_tcp_clients,
+                params.max_tcp_servers, params.max_server_connections);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    if ((params.io_engine != IO_ENGINE_SYSCALL) &&
+        (params.io_engine != IO_ENGINE_URING)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [io_engine = %d]\n",
+                params.io_engine);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = lib_db_init(&params);
+    lib_commu_bail_error(err);
+
+    /* Initialize MUTEX */
+    if (pthread_mutex_init(&lock_listener_db_access, NULL) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "pthread_mutex_init() failed with err(%d): %s\n", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+    if (pthread_mutex_init(&lock_tcp_session_db_access, NULL) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "pthread_mutex_init() failed with err(%d): %s\n", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    err = pseudo_random_gen_uint32_init();
+    lib_commu_bail_error(err);
+
+    if (params.io_engine == IO_ENGINE_URING) {
+        err = lib_commu_uring_init();
+        lib_commu_bail_error(err);
+    }
+    g_lib_commu_io_engine = params.io_engine;
+
+    err = lib_commu_reactor_init(params.reactor_threads_num);
+    lib_commu_bail_error(err);
+
+    g_lib_commu_init_done = 1;
+    LCM_LOG(LCOMMU_LOG_NOTICE,
+            "Communication library finish initialization\n");
+
+bail:
+    return -err;
+}
+
+
+
+/**
+ * This function is used to close communication library and deinit it's data
+ *
+ * @param[in] - None
+ * @param[in, out] - None
+ * @param[out] - None
+ *
+ * @return 0 if operation completes successfully
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native pthread_mutex_destroy function
+ */
+int
+comm_lib_deinit()
+{
+    int err = 0, tmp_err = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    g_lib_commu_init_done = 0;
+
+    tmp_err = lib_commu_reactor_deinit();
+    if (tmp_err != 0) {
+        err = tmp_err;
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to stop reactor err(%u)\n", err);
+        /*update error and continue, best effort deinit*/
+    }
+
+    /* connects still in progress are dropped silently */
+    pending_connects_flush();
+
+    /* coalesced messages are dropped as well */
+    tx_coalesce_timer_close();
+
+    /* reliable messages not acked or not delivered too */
+    udp_reliable_timer_close();
+
+    lib_commu_uring_deinit();
+    g_lib_commu_io_engine = IO_ENGINE_SYSCALL;
+
+    tmp_err = pthread_mutex_destroy(&lock_listener_db_access);
+    if (tmp_err != 0) {
+        err = tmp_err;
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "pthread_mutex_destroy() failed with err(%d): %s\n", errno,
+                strerror(errno));
+    }
+    tmp_err = pthread_mutex_destroy(&lock_tcp_session_db_access);
+    if (tmp_err != 0) {
+        err = tmp_err;
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "pthread_mutex_destroy() failed with err(%d): %s\n", errno,
+                strerror(errno));
+    }
+
+    tmp_err = lib_db_deinit();
+    lib_commu_bail_error(tmp_err);
+
+    /* buffers still held by the user are freed once released */
+    lib_commu_pool_flush();
+
+bail:
+    LCM_LOG(LCOMMU_LOG_NOTICE,
+            "Communication library finish deinit with err(%d)\n", err);
+    return -err;
+}
+
+
+/**
+ * Sets verbosity level of communication library
+ *
+ * @param[in] - verbosity - verbosity level
+ * @param[in, out] - None
+ * @param[out] - None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range, if operation completes unsuccessfully
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_verbosity_level_set(enum lib_commu_verbosity_level verbosity)
+{
+    int err = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    if ((verbosity > LCOMMU_VERBOSITY_LEVEL_MIN) &&
+        (verbosity <= LCOMMU_VERBOSITY_LEVEL_MAX)) {
+        LOG_VAR_NAME(__MODULE__) = verbosity;
+    }
+    else {
+        LCM_LOG(LCOMMU_LOG_ERROR, "verbosity[%d] is out of range <%d-%d>\n",
+                verbosity, LCOMMU_VERBOSITY_LEVEL_MIN,
+                LCOMMU_VERBOSITY_LEVEL_MAX);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = comm_lib_db_verbosity_level_set(verbosity);
+    lib_commu_bail_error(err);
+
+    err = lib_commu_reactor_verbosity_level_set(verbosity);
+    lib_commu_bail_error(err);
+
+    err = lib_commu_pool_verbosity_level_set(verbosity);
+    lib_commu_bail_error(err);
+
+    err = lib_commu_shm_verbosity_level_set(verbosity);
+    lib_commu_bail_error(err);
+
+    err = lib_commu_uring_verbosity_level_set(verbosity);
+    lib_commu_bail_error(err);
+
+
+bail:
+    return -err;
+}
+
+
+/**
+ * Gets the verbosity level of communication library
+ *
+ * @param[in] verbosity - verbosity level
+ * @param[in,out] None
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL Invalid argument - param null, if operation completes unsuccessfully
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_verbosity_level_get(enum lib_commu_verbosity_level *verbosity)
+{
+    int err = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Library isn't initialized\n");
+        lib_commu_bail_force(EPERM);
+    }
+
+    if (verbosity == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Param verbosity is NULL\n");
+        lib_commu_bail_force(EINVAL);
+    }
+
+    *verbosity = LOG_VAR_NAME(__MODULE__);
+
+
+bail:
+    return -err;
+}
+
+
+/**
+ * Open a UDP socket connection from specific types
+ *
+ * @param[in] params - parameters in order to open the socket.
+ * @param[in,out] handle - the handle open by the connection
+ * @param[out] - None.
+ *
+ * Global Variables Referred & Modified: None
+ *
+ * With CONN_TYPE_UDP_IP_MC, a CONN_SERVER connection joins
+ * params->fields.mc_udp_params.group_ipv4_addr, and a datagram sent to the
+ * group address is received by all the members. The connection is bound to
+ * the port on any address, and receives only the groups joined on it (by
+ * comm_lib_udp_mc_group_join too) and the unicast datagrams to the port.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL Invalid argument - handle==null, or a multicast
+ *         group_ipv4_addr which isn't a multicast address.
+ * @return EKEYREJECTED Key was rejected by service - param.type is unsupported.
+ * @return ENOBUFS or ENOMEM or EACCES is creation of socket fails. SOCKET(2) in Linux Programmer's Manual
+ * @return EACCES or EADDRINUSE or EBADF or EINVAL and more  if binding the socket fails.
+ * @return ENOBUFS or EPERM if can't update session db with the new handle.
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_udp_session_start(handle_t *handle,
+                           const struct udp_params const *params)
+{
+    int err = 0;
+
+    int sockfd = INVALID_HANDLE_ID;
+    struct sockaddr_in sock_addr;
+    uint32_t local_magic = 0;
+    socklen_t sock_addr_len = 0;
+    const struct mc_udp_params *mc_params = NULL;
+
+    memset((char *) &sock_addr, 0, sizeof(sock_addr));
+
+    lib_commu_bail_null(handle);
+    lib_commu_bail_null(params);
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    *handle = 0;
+
+    /*
+     * AF_INET - IPv4 Internet protocols.
+     * SOCK_DGRAM - Supports datagrams.
+     * SOCK_NONBLOCK -
+     */
+    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Socket creation failed failed err(%u): %s",
+                errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* set priority on socket */
+    err = set_sock_priority(sockfd);
+    lib_commu_bail_error(err);
+
+    switch (params->type) {
+    case CONN_TYPE_UDP_IP_UC:
+        sock_addr.sin_family = AF_INET;
+        sock_addr.sin_addr.s_addr =
+            params->fields.ip_udp_params.session_params.s_ipv4_addr;
+        sock_addr.sin_port =
+            params->fields.ip_udp_params.session_params.port;
+        break;
+
+    case CONN_TYPE_UDP_IP_MC:
+        mc_params = &params->fields.mc_udp_params;
+        if ((mc_params->ip_udp_params.connection_role == CONN_SERVER) &&
+            !IN_MULTICAST(ntohl(mc_params->group_ipv4_addr))) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Invalid multicast group [0x%x]\n",
+                    ntohl(mc_params->group_ipv4_addr));
+            lib_commu_bail_force(EINVAL);
+        }
+
+        err = set_sock_mc_options(sockfd, mc_params);
+        lib_commu_bail_error(err);
+
+        /* bound to any address, so the groups joined later are received
+         * too, IP_MULTICAST_ALL = 0 filters the groups not joined */
+        sock_addr.sin_family = AF_INET;
+        sock_addr.sin_addr.s_addr = INADDR_ANY;
+        sock_addr.sin_port = mc_params->ip_udp_params.session_params.port;
+        break;
+
+    default:
+        lib_commu_bail_force(EKEYREJECTED);
+    }
+
+    /* if connection role is server --> bind the socket  */
+    if (params->fields.ip_udp_params.connection_role == CONN_SERVER) {
+        sock_addr_len = sizeof(sock_addr);
+        if (bind(sockfd, (struct sockaddr *) &sock_addr, sock_addr_len) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "bind() socket[%d] failed with err(%u): %s\n",
+                    sockfd, errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+
+        if (mc_params != NULL) {
+            err = set_sock_mc_membership(sockfd, mc_params->group_ipv4_addr,
+                                         mc_params->ip_udp_params.session_params.s_ipv4_addr,
+                                         1);
+            lib_commu_bail_error(err);
+        }
+    }
+
+    /* set local magic for the udp session */
+    err = pseudo_random_uint32_get(&local_magic);
+    lib_commu_bail_error(err);
+
+    /* insert handle to DB */
+    err =
+        lib_commu_db_udp_handle_info_set(sockfd,
+                                         &(params->fields.ip_udp_params),
+                                         local_magic);
+    lib_commu_bail_error(err);
+
+    /* update socket fd */
+    *handle = sockfd;
+
+bail:
+    if (err && (sockfd != INVALID_HANDLE_ID)) {
+        close_socket_wrapper(sockfd);
+    }
+    return -err;
+}
+
+
+
+/**
+ * Close a socket connection
+ *
+ * @param[in] handle - the handle to close connection.
+ * @param[in,out] None.
+ * @param[out] None.
+ *
+ * Global Variables Referred & Modified: None
+ *
+ * @return 0 if operation completes successfully
+ * @return EBADF if handle isn't a valid open file descriptor.
+ * @return EINTR if The close() call was interrupted by a signal
+ * @return EIO if An I/O error occurred.
+ * @return ENOKEY if handle not found in DB
+ * @return EPREM if handle == INVALID_HANDLE_ID
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_udp_session_stop(handle_t handle)
+{
+    int err = 0;
+    struct handle_info *handle_info_st = NULL;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    /* no new call holds the handle */
+    err = lib_commu_db_udp_handle_info_closing_set(handle, &handle_info_st);
+    lib_commu_bail_error(err);
+
+    err = handle_close(handle_info_st);
+    lib_commu_bail_error(err);
+
+
+bail:
+    return -err;
+}
+
+
+/**
+ * Join a multicast group on a UDP connection
+ *
+ * @param[in] handle - the udp handle
+ * @param[in] group_ipv4_addr - the multicast group (network order)
+ * @param[in] if_ipv4_addr - the local interface address (network order, 0 - any)
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if group_ipv4_addr isn't a multicast address
+ * @return ENOKEY if handle wasn't found.
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function
+ */
+int
+comm_lib_udp_mc_group_join(handle_t handle, uint32_t group_ipv4_addr,
+                           uint32_t if_ipv4_addr)
+{
+    int err = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+
+    err = set_sock_mc_membership(handle, group_ipv4_addr, if_ipv4_addr, 1);
+    lib_commu_bail_error(err);
+
+bail:
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
+
+
+/**
+ * Leave a multicast group joined on a UDP connection
+ *
+ * @param[in] handle - the udp handle
+ * @param[in] group_ipv4_addr - the multicast group (network order)
+ * @param[in] if_ipv4_addr - the local interface address it was joined on
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if group_ipv4_addr isn't a multicast address
+ * @return ENOKEY if handle wasn't found.
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function
+ */
+int
+comm_lib_udp_mc_group_leave(handle_t handle, uint32_t group_ipv4_addr,
+                            uint32_t if_ipv4_addr)
+{
+    int err = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+
+    err = set_sock_mc_membership(handle, group_ipv4_addr, if_ipv4_addr, 0);
+    lib_commu_bail_error(err);
+
+bail:
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
+
+
+/**
+ * Send payload over a UDP connection
+ *
+ * @param[in] handle - the handle to send data.
+ * @param[in] payload - data to send.
+ * @param[in] conn_info - the information of the recipient and msg_type sent on handle.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes sent.
+ * @param[out] - None.
+ *
+ * Global Variables Referred & Modified: None
+ *
+ * @return 0 if operation completes successfully
+ * @return EOVERFLOW if payload_len > MAX_UDP_MSG_SIZE (1436) -sizeof(struct msg_metadata)
+ * @return ENOKEY if handle wasn't found.
+ * @return EIO if failed to send all payload
+ * @return EPERM if library didn't finish init
+ * @return sendmsg errno codes if failed to send payload
+ */
+int
+comm_lib_udp_send(handle_t handle, struct addr_info recipient_st,
+                  uint8_t *payload, uint32_t *payload_len)
+{
+    int err = 0;
+    struct iovec payload_iov;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(payload_len);
+
+    payload_iov.iov_base = payload;
+    payload_iov.iov_len = *payload_len;
+
+    err = udp_iov_send(handle, recipient_st, &payload_iov, 1, payload_len);
+    lib_commu_bail_error(err);
+
+bail:
+    return -err;
+}
+
+
+/**
+ * Send a payload gathered from several buffers over a UDP connection,
+ * the buffers are passed to the socket as is (no staging copy).
+ *
+ * @param[in] handle - the handle to send data.
+ * @param[in] recipient_st - the information of the recipient (address and port)
+ * @param[in] payload_iov - the payload buffers.
+ * @param[in] iov_num - #payload buffers (1-MAX_UDP_PAYLOAD_IOV)
+ * @param[out] payload_len - filled with actual #payload bytes sent.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if payload_iov == NULL or payload_len == NULL or iov_num is out of range
+ * @return EOVERFLOW if total payload > MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata)
+ * @return ENOKEY if handle wasn't found.
+ * @return EIO if failed to send all payload
+ * @return EPERM if library didn't finish init
+ * @return sendmsg errno codes if failed to send payload
+ */
+int
+comm_lib_udp_sendv(handle_t handle, struct addr_info recipient_st,
+                   const struct iovec *payload_iov, uint32_t iov_num,
+                   uint32_t *payload_len)
+{
+    int err = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(payload_iov);
+    lib_commu_bail_null(payload_len);
+
+    if ((iov_num == 0) || (iov_num > MAX_UDP_PAYLOAD_IOV)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [iov_num %u]\n", iov_num);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = udp_iov_send(handle, recipient_st, payload_iov, iov_num,
+                       payload_len);
+    lib_commu_bail_error(err);
+
+bail:
+    return -err;
+}
+
+
+
+/**
+ * Receive payload over a UDP connection,
+ * if receive fails the handle is closed and becomes obsolete
+ *
+ * @param[in] handle - the handle to receive the data
+ * @param[in] payload - data received.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes received.
+ * @param[out] None.
+ *
+ * Global Variables Referred & Modified: None
+ *
+ * @return 0 if operation completes successfully
+ * @return EOVERFLOW if payload_len is insufficient.
+ * @return EIO if failed to receive any part of the message
+ * @return EBADE if got data from unhallowed peer or corrupted data
+ * @return EINVAL if payload_len == 0
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 large or reliable messages
+ * @return EPERM if library didn't finish init
+ */
+
+int
+comm_lib_udp_recv(handle_t handle, struct addr_info *addresser_st,
+                  uint8_t *payload, uint32_t *payload_len)
+{
+    int err = 0;
+
+    struct msg_metadata metadata_st;
+    struct handle_info *handle_info_st = NULL;
+    struct iovec iov[3];
+    uint8_t spill[sizeof(struct msg_trace)];
+    uint32_t buffer_len = 0;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+
+    memset((char*) &metadata_st, 0, sizeof(metadata_st));
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(payload_len);
+    lib_commu_bail_null(addresser_st);
+
+    if (*payload_len == 0) {
+        lib_commu_bail_force(EINVAL);
+    }
+
+    /* 0. get handle info */
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type,
+                                        NULL);
+    lib_commu_bail_error(err);
+
+    /* the datagrams are delivered to the receive callback, or parsed by
+     * the large or the reliable message receivers */
+    if ((__atomic_load_n(&handle_info_st->rx_callback,
+                         __ATOMIC_ACQUIRE) != NULL) ||
+        (__atomic_load_n(&handle_info_st->udp_reassembly,
+                         __ATOMIC_ACQUIRE) != NULL) ||
+        (__atomic_load_n(&handle_info_st->udp_reliable,
+                         __ATOMIC_ACQUIRE) != NULL)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "handle[%d] has a receive callback or receives large or reliable messages\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    /* 1. get the metadata and the payload directly to the user buffer
+     * and update the addresser_st info. The trace of a traced datagram
+     * moves the end of a payload filling the buffer to the spill */
+    iov[0].iov_base = &metadata_st;
+    iov[0].iov_len = sizeof(metadata_st);
+    iov[1].iov_base = payload;
+    iov[1].iov_len = *payload_len;
+    iov[2].iov_base = spill;
+    iov[2].iov_len = sizeof(spill);
+    buffer_len = sizeof(metadata_st) + *payload_len + sizeof(spill);
+
+    err = comm_lib_udp_ll_recv(handle, iov, 3, &buffer_len, addresser_st);
+    lib_commu_bail_error(err);
+
+    if (buffer_len < sizeof(metadata_st)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Data received < metadata\n");
+        lib_commu_bail_force(EIO);
+    }
+
+    LCM_LOG(LCOMMU_LOG_INFO,
+            "metadata info: msg_type[%u], payload_size[%u], peer_magic[%u], version[%u]\n",
+            metadata_st.msg_type, ntohl(metadata_st.payload_size),
+            ntohl(metadata_st.trailer), metadata_st.version);
+
+    /* 2. validate the metadata */
+    err = validate_metadata_info(&metadata_st, *payload_len, handle_info_st);
+    lib_commu_bail_error(err);
+
+    if (metadata_st.payload_size !=
+        buffer_len - msg_header_len(&metadata_st)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "payload size [%u] != data received [%u]\n",
+                metadata_st.payload_size,
+                (uint32_t)(buffer_len - msg_header_len(&metadata_st)));
+        lib_commu_bail_force(EIO);
+    }
+
+    udp_msg_trace_strip(handle, &metadata_st, addresser_st->ipv4_addr,
+                        payload, *payload_len, spill);
+    *payload_len = metadata_st.payload_size;
+
+
+bail:
+    LCM_LOG(LCOMMU_LOG_DEBUG, "finish: %s, with error code[%d]\n", __func__,
+            err);
+    if (err && (payload_len != NULL)) {
+        *payload_len = 0;
+    }
+    handle_msgs_stats_update(handle, 1, (err == 0) ? 1 : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
+
+
+/**
+ * Send several datagrams over a UDP connection with sendmmsg().
+ * The handle lookup and the statistics update are done once per call.
+ *
+ * @param[in] handle - the handle to send data.
+ * @param[in] msgs - the datagrams to send, msgs[i].addr is the recipient.
+ * @param[in,out] msgs_num - #datagrams to send, filled with #datagrams sent.
+ * @param[out] - None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if msgs == NULL or msgs_num == NULL or a payload == NULL
+ * @return EOVERFLOW if a payload_len > MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata)
+ * @return ENOKEY if handle wasn't found.
+ * @return EIO if failed to send all datagrams
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_udp_send_batch(handle_t handle, struct udp_msg *msgs,
+                        uint32_t *msgs_num)
+{
+    int err = 0, err_bail = 0;
+
+    struct msg_header header_st[UDP_BATCH_MSGS];
+    struct handle_info *handle_info_st = NULL;
+    struct mmsghdr mmsg[UDP_BATCH_MSGS];
+    struct iovec iov[UDP_BATCH_MSGS][2];
+    struct sockaddr_in recipients[UDP_BATCH_MSGS];
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    uint32_t msgs_sent = 0;
+    uint32_t batch_num = 0;
+    uint32_t prepared_num = 0;
+    uint32_t header_len = 0;
+    uint32_t total_bytes = 0;
+    uint16_t repeat_times = 0;
+    uint32_t i = 0;
+    int nb_msgs = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(msgs);
+    lib_commu_bail_null(msgs_num);
+
+    for (i = 0; i < *msgs_num; i++) {
+        lib_commu_bail_null(msgs[i].payload);
+        if (msgs[i].payload_len >
+            MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata)) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u] msg[%u]\n",
+                    msgs[i].payload_len, i);
+            lib_commu_bail_force(EOVERFLOW);
+        }
+    }
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type,
+                                        NULL);
+    lib_commu_bail_error(err);
+
+    while (msgs_sent < *msgs_num) {
+        if (repeat_times == SEND_REPEAT_NUM) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Retry to send the batch %d times",
+                    repeat_times);
+            lib_commu_bail_force(EIO);
+        }
+        repeat_times++;
+
+        batch_num = *msgs_num - msgs_sent;
+        if (batch_num > UDP_BATCH_MSGS) {
+            batch_num = UDP_BATCH_MSGS;
+        }
+
+        memset(mmsg, 0, sizeof(mmsg[0]) * batch_num);
+        memset(recipients, 0, sizeof(recipients[0]) * batch_num);
+        for (i = 0; i < batch_num; i++) {
+            /* the datagrams not sent by the last call keep their header */
+            if (i >= prepared_num) {
+                err = msg_header_set(&header_st[i],
+                                     msgs[msgs_sent + i].payload_len,
+                                     MAX_UDP_MSG_SIZE -
+                                     msgs[msgs_sent + i].payload_len,
+                                     handle_info_st, &header_len);
+                lib_commu_bail_error(err);
+            }
+
+            recipients[i].sin_family = AF_INET;
+            recipients[i].sin_addr.s_addr = msgs[msgs_sent + i].addr.ipv4_addr;
+            recipients[i].sin_port = msgs[msgs_sent + i].addr.port;
+
+            iov[i][0].iov_base = &header_st[i];
+            iov[i][0].iov_len = msg_header_len(&header_st[i].metadata);
+            iov[i][1].iov_base = msgs[msgs_sent + i].payload;
+            iov[i][1].iov_len = msgs[msgs_sent + i].payload_len;
+
+            mmsg[i].msg_hdr.msg_name = &recipients[i];
+            mmsg[i].msg_hdr.msg_namelen = sizeof(recipients[i]);
+            mmsg[i].msg_hdr.msg_iov = iov[i];
+            mmsg[i].msg_hdr.msg_iovlen = 2;
+        }
+
+        nb_msgs = sendmmsg(handle, mmsg, batch_num, 0);
+        if (nb_msgs < 0) {
+            if (errno == EINTR) {
+                prepared_num = batch_num;
+                continue;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed in sendmmsg() with err[%d]: %s",
+                    errno, strerror(errno));
+            lib_commu_bail_force(EIO);
+        }
+
+        for (i = 0; i < (uint32_t)nb_msgs; i++) {
+            total_bytes += mmsg[i].msg_len;
+        }
+        msgs_sent += nb_msgs;
+
+        prepared_num = batch_num - nb_msgs;
+        memmove(header_st, &header_st[nb_msgs],
+                prepared_num * sizeof(header_st[0]));
+    }
+
+    LCM_LOG(LCOMMU_LOG_DEBUG, "#datagrams sent [%u], #bytes sent [%u]\n",
+            msgs_sent, total_bytes);
+
+bail:
+    if (msgs_num != NULL) {
+        *msgs_num = msgs_sent;
+    }
+    handle_msgs_stats_update(handle, 0, msgs_sent, err);
+    if (total_bytes > 0) {
+        err_bail = handle_total_tx_update(handle, &handle_db_type, total_bytes);
+        if (err_bail) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed in to update tx[%u] on handle[%d]\n", total_bytes,
+                    handle);
+            if (err == 0) {
+                err = err_bail;
+            }
+        }
+    }
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
+
+
+/**
+ * Receive several datagrams over a UDP connection with recvmmsg().
+ * Blocking until at least one datagram is received, then returns the
+ * datagrams already queued on the socket (up to msgs_num).
+ * The payload is received directly to msgs[i].payload. A datagram which
+ * failed validation (corrupted, unhallowed peer or larger than
+ * msgs[i].payload_len) is returned with payload_len == 0.
+ *
+ * @param[in] handle - the handle to receive the data
+ * @param[in,out] msgs - the receive buffers; payload_len (buffer size) is
+ *                       filled with #bytes received and addr with the addresser
+ * @param[in,out] msgs_num - #buffers, filled with #datagrams received
+ * @param[out] None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if msgs == NULL or msgs_num == NULL or msgs_num == 0
+ *                or a payload == NULL or a payload_len == 0
+ * @return ENOKEY if handle wasn't found.
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 large or reliable messages
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native recvmmsg function
+ */
+int
+comm_lib_udp_recv_batch(handle_t handle, struct udp_msg *msgs,
+                        uint32_t *msgs_num)
+{
+    int err = 0, err_bail = 0;
+
+    struct msg_metadata metadata_st[UDP_BATCH_MSGS];
+    struct handle_info *handle_info_st = NULL;
+    struct mmsghdr mmsg[UDP_BATCH_MSGS];
+    struct iovec iov[UDP_BATCH_MSGS][3];
+    uint8_t spills[UDP_BATCH_MSGS][sizeof(struct msg_trace)];
+    struct sockaddr_in addressers[UDP_BATCH_MSGS];
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    uint32_t msgs_recvd = 0;
+    uint32_t batch_num = 0;
+    uint32_t total_bytes = 0;
+    uint32_t i = 0;
+    int flags = MSG_WAITFORONE;
+    int nb_msgs = 0;
+    int msg_err = 0;
+    uint32_t dropped_num = 0;
+    struct udp_msg *msg = NULL;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(msgs);
+    lib_commu_bail_null(msgs_num);
+
+    if (*msgs_num == 0) {
+        lib_commu_bail_force(EINVAL);
+    }
+
+    for (i = 0; i < *msgs_num; i++) {
+        lib_commu_bail_null(msgs[i].payload);
+        if (msgs[i].payload_len == 0) {
+            lib_commu_bail_force(EINVAL);
+        }
+    }
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type,
+                                        NULL);
+    lib_commu_bail_error(err);
+
+    /* the datagrams are delivered to the receive callback, or parsed by
+     * the large or the reliable message receivers */
+    if ((__atomic_load_n(&handle_info_st->rx_callback,
+                         __ATOMIC_ACQUIRE) != NULL) ||
+        (__atomic_load_n(&handle_info_st->udp_reassembly,
+                         __ATOMIC_ACQUIRE) != NULL) ||
+        (__atomic_load_n(&handle_info_st->udp_reliable,
+                         __ATOMIC_ACQUIRE) != NULL)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "handle[%d] has a receive callback or receives large or reliable messages\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    while (msgs_recvd < *msgs_num) {
+        batch_num = *msgs_num - msgs_recvd;
+        if (batch_num > UDP_BATCH_MSGS) {
+            batch_num = UDP_BATCH_MSGS;
+        }
+
+        memset(mmsg, 0, sizeof(mmsg[0]) * batch_num);
+        for (i = 0; i < batch_num; i++) {
+            iov[i][0].iov_base = &metadata_st[i];
+            iov[i][0].iov_len = sizeof(metadata_st[i]);
+            iov[i][1].iov_base = msgs[msgs_recvd + i].payload;
+            iov[i][1].iov_len = msgs[msgs_recvd + i].payload_len;
+            iov[i][2].iov_base = spills[i];
+            iov[i][2].iov_len = sizeof(spills[i]);
+
+            mmsg[i].msg_hdr.msg_name = &addressers[i];
+            mmsg[i].msg_hdr.msg_namelen = sizeof(addressers[i]);
+            mmsg[i].msg_hdr.msg_iov = iov[i];
+            mmsg[i].msg_hdr.msg_iovlen = 3;
+        }
+
+        /* block only till the first datagram */
+        nb_msgs = recvmmsg(handle, mmsg, batch_num, flags, NULL);
+        if (nb_msgs < 0) {
+            if ((errno == EINTR) && (msgs_recvd == 0)) {
+                continue;
+            }
+            if ((msgs_recvd > 0) &&
+                ((errno == EAGAIN) || (errno == EWOULDBLOCK) ||
+                 (errno == EINTR))) {
+                break;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed in recvmmsg() with err[%d]: %s",
+                    errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+
+        for (i = 0; i < (uint32_t)nb_msgs; i++) {
+            msg = &msgs[msgs_recvd + i];
+            total_bytes += mmsg[i].msg_len;
+            msg->addr.ipv4_addr = addressers[i].sin_addr.s_addr;
+            msg->addr.port = addressers[i].sin_port;
+
+            msg_err = 0;
+            if ((mmsg[i].msg_len < sizeof(metadata_st[i])) ||
+                (mmsg[i].msg_hdr.msg_flags & MSG_TRUNC)) {
+                msg_err = EOVERFLOW;
+            }
+            else {
+                msg_err = validate_metadata_info(&metadata_st[i],
+                                                 msg->payload_len,
+                                                 handle_info_st);
+                if ((msg_err == 0) &&
+                    (metadata_st[i].payload_size !=
+                     mmsg[i].msg_len - msg_header_len(&metadata_st[i]))) {
+                    msg_err = EIO;
+                }
+            }
+
+            if (msg_err) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "Dropped datagram of [%u] bytes, err[%d]\n",
+                        mmsg[i].msg_len, msg_err);
+                msg->payload_len = 0;
+                dropped_num++;
+            }
+            else {
+                udp_msg_trace_strip(handle, &metadata_st[i],
+                                    addressers[i].sin_addr.s_addr,
+                                    msg->payload, msg->payload_len, spills[i]);
+                msg->payload_len = metadata_st[i].payload_size;
+            }
+        }
+        msgs_recvd += nb_msgs;
+
+        if ((uint32_t)nb_msgs < batch_num) {
+            break;
+        }
+        flags = MSG_DONTWAIT;
+    }
+
+    LCM_LOG(LCOMMU_LOG_DEBUG, "#datagrams received [%u], #bytes received [%u]\n",
+            msgs_recvd, total_bytes);
+
+bail:
+    if (msgs_num != NULL) {
+        *msgs_num = msgs_recvd;
+    }
+    handle_msgs_stats_update(handle, 1, msgs_recvd - dropped_num, err);
+    if (dropped_num > 0) {
+        (void)handle_stats_counter_add(handle, HANDLE_STATS_RX_ERRORS,
+                                       dropped_num);
+    }
+    if (total_bytes > 0) {
+        err_bail = handle_total_rx_update(handle, &handle_db_type, total_bytes);
+        if (err_bail) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed in to update rx[%u] on handle[%d]\n", total_bytes,
+                    handle);
+            if (err == 0) {
+                err = err_bail;
+            }
+        }
+    }
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
+
+
+
+/**
+ * start a TCP connection from the server side.
+ * registers a listener socket on the library reactor, which "listens" to
+ * new connections. Once connection is established a callback is being made
+ * from the reactor thread with a new handle toward the client.
+ * The reactor thread is shared with the other servers, the async sends and
+ * the receive callbacks it serves, so a slow callback stalls all of them.
+ * With params.transport == STREAM_TRANSPORT_UNIX the server listens on the
+ * UNIX domain path of params.port, and the peers are reported as 127.0.0.1.
+ * With params.acceptors_num > 1 the server opens that many SO_REUSEPORT
+ * listeners, each accepting on another reactor thread, and the kernel spreads
+ * the incoming connections between them (TCP only).
+ *
+ * @param[in] params - server address, port, etc (network order)
+ * @param[in] function callback
+ * @param[in,out] server_id - the id of the server to open
+ * @param[out] handle
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if clbk_st == NULL, or params.acceptors_num is above
+ *         MAX_ACCEPTORS_NUM, the #reactor threads, or 1 on a UNIX server
+ * @return EACCES if can't create listener socket
+ * @return EADDRINUSE if a running UNIX server listens on the path of params.port
+ * @return ENOBUFS or ENOMEM The socket cannot be created until sufficient resources are freed
+ * @return errno codes of native listen/epoll_ctl functions
+ * @return EPERM if library didn't finish init
+ * @return ENOMEM if can't create new session due to DB limit
+ */
+int
+comm_lib_tcp_server_session_start(struct session_params params,
+                                  struct register_to_new_handle *clbk_st,
+                                  uint16_t *server_id)
+{
+    int err = 0;
+    uint32_t i = 0;
+    uint32_t acceptors_num = 0;
+    uint32_t reactor_id = REACTOR_ANY_THREAD;
+    struct sockaddr_storage serveraddr;
+    socklen_t sockaddr_len = 0;
+    struct listener_session *session = NULL;
+    struct listener_acceptor *acceptor = NULL;
+    uint16_t idx = lib_commu_db_max_servers_get();
+    int is_db_locked = 0;
+    int is_idx_set = 0;
+
+    memset((char *) &serveraddr, 0, sizeof(serveraddr));
+
+    lib_commu_bail_null(clbk_st);
+    lib_commu_bail_null(clbk_st->clbk_notify_func);
+    lib_commu_bail_null(server_id);
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    acceptors_num = (params.acceptors_num == 0) ? 1 : params.acceptors_num;
+    if ((acceptors_num > MAX_ACCEPTORS_NUM) ||
+        (acceptors_num > lib_commu_reactor_threads_num_get()) ||
+        ((acceptors_num > 1) &&
+         (params.transport == STREAM_TRANSPORT_UNIX))) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid parameter [acceptors_num] %u, %u reactor threads\n",
+                params.acceptors_num, lib_commu_reactor_threads_num_get());
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = stream_sockaddr_set(params.transport, params.s_ipv4_addr,
+                              params.port, &serveraddr, &sockaddr_len);
+    lib_commu_bail_error(err);
+
+    if (params.transport == STREAM_TRANSPORT_UNIX) {
+        err = unix_stream_path_reclaim(&serveraddr, sockaddr_len);
+        lib_commu_bail_error(err);
+    }
+
+    session = (struct listener_session *) calloc(1, sizeof(*session) +
+                                                 acceptors_num *
+                                                 sizeof(session->acceptors[0]));
+    if (session == NULL) {
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    session->clbk_st.clbk_notify_func = clbk_st->clbk_notify_func;
+    session->clbk_st.data = clbk_st->data;
+    session->params.msg_type = params.msg_type;
+    session->params.port = params.port;
+    session->params.s_ipv4_addr = params.s_ipv4_addr;
+    session->params.transport = params.transport;
+    session->params.acceptors_num = acceptors_num;
+    session->acceptors_num = acceptors_num;
+    session->is_stopped = 0;
+    session->event_fd = INVALID_HANDLE_ID;
+
+    for (i = 0; i < acceptors_num; i++) {
+        acceptor = &session->acceptors[i];
+        acceptor->listener_fd = INVALID_HANDLE_ID;
+        acceptor->session = session;
+
+        acceptor->listener_item.fd = INVALID_HANDLE_ID;
+        acceptor->listener_item.handler = listener_accept_handler;
+        acceptor->listener_item.release = NULL;
+        acceptor->listener_item.ctx = acceptor;
+
+        acceptor->event_item.fd = INVALID_HANDLE_ID;
+        acceptor->event_item.handler = listener_event_handler;
+        acceptor->event_item.release = listener_release;
+        acceptor->event_item.ctx = acceptor;
+    }
+
+    session->event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (session->event_fd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Could not create eventfd err(%d) :%s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* SO_REUSEPORT is set only on a sharded server, a single listener
+     * keeps failing to bind a port in use */
+    for (i = 0; i < acceptors_num; i++) {
+        acceptor = &session->acceptors[i];
+        err = listener_socket_open(&serveraddr, sockaddr_len,
+                                   (acceptors_num > 1),
+                                   &acceptor->listener_fd);
+        lib_commu_bail_error(err);
+        acceptor->listener_item.fd = acceptor->listener_fd;
+        acceptor->event_item.fd = session->event_fd;
+    }
+
+    /*start take idx from DB*/
+    err = pthread_mutex_lock(&lock_tcp_session_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    err = lib_commu_db_unoccupied_listener_thread_get(&idx);
+    if (err) {
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    session->server_id = idx;
+
+    err = lib_commu_db_server_status_listener_set(idx,
+                                                  session->acceptors[0].listener_fd,
+                                                  HANDLE_STATUS_UP);
+    lib_commu_bail_error(err);
+
+    listener_sessions[idx] = session;
+    is_idx_set = 1;
+
+    /* each acceptor is served by another reactor thread, both items of an
+     * acceptor by the same one. the exit item is added first, so on failure
+     * the started acceptors are stopped through the eventfd */
+    for (i = 0; i < acceptors_num; i++) {
+        acceptor = &session->acceptors[i];
+
+        err = lib_commu_reactor_item_add(&acceptor->event_item, EPOLLIN,
+                                         reactor_id);
+        lib_commu_bail_error(err);
+        session->started_num++;
+
+        if (reactor_id == REACTOR_ANY_THREAD) {
+            reactor_id = acceptor->event_item.reactor_id;
+        }
+
+        err = lib_commu_reactor_item_add(&acceptor->listener_item, EPOLLIN,
+                                         acceptor->event_item.reactor_id);
+        lib_commu_bail_error(err);
+        acceptor->is_listening = 1;
+
+        reactor_id = (reactor_id + 1) % lib_commu_reactor_threads_num_get();
+    }
+
+    *server_id = idx;
+
+    err = pthread_mutex_unlock(&lock_tcp_session_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 0;
+    /*finish take idx from DB && assign session in listener_sessions*/
+
+
+bail:
+    if (err) {
+        if (session != NULL) {
+            if (is_idx_set) {
+                lib_commu_db_server_status_listener_set(idx, INVALID_HANDLE_ID,
+                                                        HANDLE_STATUS_DOWN);
+                listener_sessions[idx] = NULL;
+            }
+            listener_session_stop_wait(session);
+            safe_free(session);
+        }
+    }
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_tcp_session_db_access);
+    }
+    return -err;
+}
+
+
+/**
+ * stop a TCP connection from the server side.
+ * removes the listener from the reactor. It does close
+ * all the open sockets of this server.
+ *
+ * @param[in] server_id - the id of the server to close
+ * @param[in] handle_array_len - size of handle_array
+ * @param[in,out] uint32 *handle_array - the handles which closed.
+ * @param[out] - None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle_array == NULL or handle_array_len == 0
+ * @return EBADF  or ENOBUFS if if operation completes unsuccessfully
+ * @return EINTR or EIO - if failed to close socket.
+ * @return ENOKEY if server_id is out of bound.
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_server_session_stop(uint16_t server_id, handle_t *handle_array,
+                                 uint32_t handle_array_len)
+{
+    int err = 0;
+    uint32_t i = 0, j = 0;
+    uint16_t idx = 0;
+    struct server_status server_status;
+    struct listener_session *session = NULL;
+    int is_db_locked = 0;
+    handle_t client_handles[MAX_CONNECTION_NUM];
+    uint32_t client_handles_num = 0;
+    struct handle_info *handle_info_st = NULL;
+    int is_closing = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(handle_array);
+    if (handle_array_len == 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [handle_array_len]\n");
+        lib_commu_bail_force(EINVAL);
+    }
+
+    if (server_id >= lib_commu_db_max_servers_get()) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [server_id]\n");
+        lib_commu_bail_force(EINVAL);
+    }
+
+    idx = server_id;
+
+    err = lib_commu_db_tcp_server_status_get(&server_status, server_id);
+    if (err == ENOKEY) {
+        /* never started */
+        server_status.listener_status = HANDLE_STATUS_DOWN;
+        err = 0;
+    }
+    lib_commu_bail_error(err);
+
+    if (server_status.listener_status == HANDLE_STATUS_DOWN) {
+        LCM_LOG(LCOMMU_LOG_NOTICE, "Server[%u] already not active\n",
+                server_id);
+        goto bail;
+    }
+
+    session = listener_sessions[idx];
+    lib_commu_bail_null(session);
+
+    /* signal to the reactor to remove the listeners and wait till it
+     * released the session */
+    err = listener_session_stop_wait(session);
+    lib_commu_bail_error(err);
+
+    /*start delete session resource DB and sockets*/
+    err = pthread_mutex_lock(&lock_tcp_session_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    listener_sessions[idx] = NULL;
+    safe_free(session);
+    LCM_LOG(LCOMMU_LOG_INFO, "listener removed from reactor\n");
+
+    /* close all clients sockets. A deleted entry leaves the table, so the
+     * table is walked again till it is empty */
+    do {
+        client_handles_num = MAX_CONNECTION_NUM;
+        err = lib_commu_db_tcp_server_handles_get(server_id, 0,
+                                                  client_handles,
+                                                  &client_handles_num);
+        lib_commu_bail_error(err);
+
+        for (i = 0; i < client_handles_num; i++) {
+            err = lib_commu_db_tcp_handle_info_closing_set(client_handles[i],
+                                                           &handle_info_st);
+            if (err) {
+                /* closed by its own peer stop, wait for it to delete the
+                 * entry before the table is reset */
+                is_closing = 1;
+                continue;
+            }
+
+            err = handle_close(handle_info_st);
+            lib_commu_bail_error(err);
+
+            /* best effort */
+            if (j < handle_array_len) {
+                handle_array[j++] = client_handles[i];
+            }
+        }
+
+        if (is_closing) {
+            is_closing = 0;
+            usleep(HANDLE_USERS_WAIT_USEC);
+        }
+    } while (client_handles_num != 0);
+    err = 0;
+
+    /* reset TCP DB */
+    err = lib_commu_db_tcp_session_db_deinit(server_id);
+    lib_commu_bail_error(err);
+
+    err = pthread_mutex_unlock(&lock_tcp_session_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 0;
+
+bail:
+    if (is_db_locked) {
+        err = pthread_mutex_unlock(&lock_tcp_session_db_access);
+        lib_commu_return_from_bail(-err);
+    }
+    return -err;
+}
+
+
+
+/**
+ * start a TCP connection from the client side. (Blocking)
+ * opens a socket toward specific server IP and port from user context
+ * Once connection is established the function returns and update new handle
+ * IP and port must be valid
+ *
+ * @param[in] conn_info - server address, port, etc...
+ * @param[in,out] client_handle
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if client_handle or conn_info are NULL
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native socket function
+ * @return errno codes of native connect function
+ */
+int
+comm_lib_tcp_client_blocking_start(
+    const struct connection_info const *conn_info,
+    handle_t *client_handle)
+{
+    int err = 0;
+    int sock_fd = INVALID_HANDLE_ID;
+    struct sockaddr_storage server_sock_addr;
+    uint32_t local_magic = 0;
+    socklen_t sock_addr_len = 0;
+    struct addr_info peer_info;
+    struct addr_info local_info;
+
+    memset(&server_sock_addr, 0, sizeof(server_sock_addr));
+    memset(&local_info, 0, sizeof(local_info));
+    memset(&peer_info, 0, sizeof(peer_info));
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(client_handle);
+    lib_commu_bail_null(conn_info);
+
+    *client_handle = 0;
+
+    err = stream_sockaddr_set(conn_info->transport, conn_info->d_ipv4_addr,
+                              conn_info->d_port, &server_sock_addr,
+                              &sock_addr_len);
+    lib_commu_bail_error(err);
+
+    /*
+     * AF_INET - IPv4 Internet protocols, AF_UNIX - local peers.
+     * SOCK_STREAM - Supports TCP.
+     */
+    sock_fd = socket(server_sock_addr.ss_family, SOCK_STREAM, 0);
+    if (sock_fd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Socket creation failed err(%u): %s", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    err = stream_sock_options_set(sock_fd, conn_info->transport, 1);
+    lib_commu_bail_error(err);
+
+    if (connect(sock_fd, (struct sockaddr*) &server_sock_addr,
+                sock_addr_len) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Connect() failed: on socket[%d] err(%u): %s",
+                sock_fd, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* set local magic for the tcp client session */
+    err = pseudo_random_uint32_get(&local_magic);
+    lib_commu_bail_error(err);
+
+    peer_info.ipv4_addr = conn_info->d_ipv4_addr;
+    peer_info.port = conn_info->d_port;
+
+    /* insert handle to DB */
+    err = lib_commu_db_tcp_client_handle_info_set(sock_fd, conn_info->msg_type,
+                                                  local_info, peer_info,
+                                                  local_magic);
+    lib_commu_bail_error(err);
+
+    *client_handle = sock_fd;
+
+bail:
+    if (err && (sock_fd != INVALID_HANDLE_ID)) {
+        close_socket_wrapper(sock_fd);
+    }
+    return -err;
+}
+
+/**
+ * start a TCP connection from the client side. (NON-Blocking)
+ * opens a non blocking socket toward specific server IP and port, the
+ * connection is completed by the reactor.
+ * Once connection is established, a callback is being made with a new handle
+ * toward the client.
+ * If connection fails, a callback is being made with handle = -1 and in rc the proper (int*)error code
+ * IP and port must be valid
+ *
+ * @param[in] conn_info - server address, port, etc...
+ * @param[in] clbk_st - function callback
+ * @param[in] tval - Client can set timeout for the connection.
+ *                   if tval == NULL, connection will wait till connection is established or error
+ *                   else connection will wait till time stated will pass,
+ *                   and the callback is made with rc = -ETIMEDOUT.
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if client_handle or conn_info are NULL
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native socket function
+ * @return errno codes of native connect function
+ * @return errno codes of native timerfd_create function
+ */
+int
+comm_lib_tcp_client_non_blocking_start(
+    const struct connection_info const *conn_info,
+    struct register_to_new_handle *clbk_st, struct timeval *tval)
+{
+    int err = 0;
+    int sock_fd = INVALID_HANDLE_ID;
+    int fd_flags = 0;
+    struct sockaddr_storage server_sock_addr;
+    socklen_t sock_addr_len = 0;
+    struct itimerspec timeout;
+    struct pending_connect *connect_st = NULL;
+
+    memset(&server_sock_addr, 0, sizeof(server_sock_addr));
+    memset(&timeout, 0, sizeof(timeout));
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(conn_info);
+    lib_commu_bail_null(clbk_st);
+
+    err = stream_sockaddr_set(conn_info->transport, conn_info->d_ipv4_addr,
+                              conn_info->d_port, &server_sock_addr,
+                              &sock_addr_len);
+    lib_commu_bail_error(err);
+
+    /*
+     * AF_INET - IPv4 Internet protocols, AF_UNIX - local peers.
+     * SOCK_STREAM - Supports TCP.
+     */
+    sock_fd = socket(server_sock_addr.ss_family, SOCK_STREAM, 0);
+    if (sock_fd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Socket creation failed err(%u): %s", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    err = stream_sock_options_set(sock_fd, conn_info->transport, 0);
+    lib_commu_bail_error(err);
+
+    /* set socket as non-blocking */
+    if ((fd_flags = fcntl(sock_fd, F_GETFL, 0)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "fcntl failed: on socket[%d] err(%u): %s",
+                sock_fd, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+    if (fcntl(sock_fd, F_SETFL, fd_flags | O_NONBLOCK) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "fcntl failed: on socket[%d] err(%u): %s",
+                sock_fd, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    /* connect non-blocking mode, an established connect is reported by the reactor too */
+    if ((connect(sock_fd, (struct sockaddr*) &server_sock_addr,
+                 sock_addr_len) < 0) && (errno != EINPROGRESS)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "None blocking connect failed: on socket[%d] err(%u): %s",
+                sock_fd, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    connect_st = (struct pending_connect*)calloc(1, sizeof(*connect_st));
+    lib_commu_bail_null(connect_st);
+
+    connect_st->client_fd = sock_fd;
+    connect_st->fd_flags = fd_flags;
+    connect_st->timer_fd = INVALID_HANDLE_ID;
+    memcpy(&(connect_st->conn_info), conn_info, sizeof(*conn_info));
+    connect_st->clbk_st.clbk_notify_func = clbk_st->clbk_notify_func;
+    connect_st->clbk_st.data = clbk_st->data;
+    connect_st->refcnt = 1;
+    connect_st->connect_item.fd = sock_fd;
+    connect_st->connect_item.handler = pending_connect_handler;
+    connect_st->connect_item.release = pending_connect_release;
+    connect_st->connect_item.ctx = connect_st;
+
+    pthread_mutex_lock(&lock_pending_connects);
+    connect_st->next = pending_connects;
+    if (pending_connects != NULL) {
+        pending_connects->prev = connect_st;
+    }
+    pending_connects = connect_st;
+    pthread_mutex_unlock(&lock_pending_connects);
+
+    /* the timer item is served by the reactor thread of the socket item */
+    connect_st->connect_item.reactor_id = REACTOR_ANY_THREAD;
+    if (tval != NULL) {
+        connect_st->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+                                              TFD_NONBLOCK | TFD_CLOEXEC);
+        if (connect_st->timer_fd < 0) {
+            connect_st->timer_fd = INVALID_HANDLE_ID;
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "timerfd_create failed with err(%d): %s\n", errno,
+                    strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+        connect_st->timer_item.fd = connect_st->timer_fd;
+        connect_st->timer_item.handler = pending_connect_timeout_handler;
+        connect_st->timer_item.release = pending_connect_release;
+        connect_st->timer_item.ctx = connect_st;
+
+        __sync_add_and_fetch(&connect_st->refcnt, 1);
+        err = lib_commu_reactor_item_add(&connect_st->timer_item, EPOLLIN,
+                                         REACTOR_ANY_THREAD);
+        if (err) {
+            __sync_sub_and_fetch(&connect_st->refcnt, 1);
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed to add connect timer to reactor err(%d)\n", err);
+            lib_commu_bail_force(err);
+        }
+        connect_st->connect_item.reactor_id = connect_st->timer_item.reactor_id;
+    }
+
+    __sync_add_and_fetch(&connect_st->refcnt, 1);
+    err = lib_commu_reactor_item_add(&connect_st->connect_item, EPOLLOUT,
+                                     connect_st->connect_item.reactor_id);
+    if (err) {
+        __sync_sub_and_fetch(&connect_st->refcnt, 1);
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to add connect socket[%d] to reactor err(%d)\n",
+                sock_fd, err);
+        if (connect_st->timer_fd != INVALID_HANDLE_ID) {
+            /* the timer can't fire before it is armed, no notification */
+            connect_st->is_done = 1;
+            lib_commu_reactor_item_remove_async(&connect_st->timer_item);
+        }
+        lib_commu_bail_force(err);
+    }
+
+    if (tval != NULL) {
+        timeout.it_value.tv_sec = tval->tv_sec;
+        timeout.it_value.tv_nsec = tval->tv_usec * 1000;
+        if ((timeout.it_value.tv_sec == 0) && (timeout.it_value.tv_nsec == 0)) {
+            /* a zero it_value disarms the timer, expire right away instead */
+            timeout.it_value.tv_nsec = 1;
+        }
+        if (timerfd_settime(connect_st->timer_fd, 0, &timeout, NULL) < 0) {
+            /* the connect is registered already, it goes on without a timeout */
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "timerfd_settime failed with err(%d): %s\n", errno,
+                    strerror(errno));
+        }
+    }
+
+    /* the reactor owns the connect from now on */
+    pending_connect_put(connect_st);
+    return 0;
+
+bail:
+    if (connect_st != NULL) {
+        /* the socket is closed below, the items don't own it */
+        connect_st->is_done = 1;
+        pending_connect_put(connect_st);
+    }
+    if (err && (sock_fd != INVALID_HANDLE_ID)) {
+        close_socket_wrapper(sock_fd);
+    }
+    return -err;
+}
+
+/**
+ * start a shared memory session with a peer on the same host.
+ * The first caller of d_port creates the rings and the second attaches,
+ * the handle is the segment fd and is kept in the TCP clients DB so the
+ * TCP send/recv APIs serve it. A peer whose process is gone is taken as
+ * stopped.
+ *
+ * @param[in] conn_info - d_port names the session, msg_type as in TCP
+ * @param[in,out] handle - the session handle
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle or conn_info are NULL
+ * @return EBUSY - if both peers of the session are already attached
+ * @return EPROTO - if the session was created by an incompatible library
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native shm_open/ftruncate/mmap functions
+ */
+int
+comm_lib_shm_session_start(const struct connection_info const *conn_info,
+                           handle_t *handle)
+{
+    int err = 0;
+    int is_handle_set = 0;
+    handle_t shm_fd = INVALID_HANDLE_ID;
+    uint32_t local_magic = 0;
+    char path[SHM_SESSION_PATH_LEN];
+    struct lib_commu_shm_link *shm_link = NULL;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = TCP_CLIENT_HANDLE_DB;
+    struct addr_info peer_info;
+    struct addr_info local_info;
+
+    memset(&local_info, 0, sizeof(local_info));
+    memset(&peer_info, 0, sizeof(peer_info));
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(handle);
+    lib_commu_bail_null(conn_info);
+
+    *handle = INVALID_HANDLE_ID;
+
+    snprintf(path, sizeof(path), SHM_SESSION_PATH, ntohs(conn_info->d_port));
+    err = lib_commu_shm_link_open(path, SHM_RING_SIZE, &shm_link);
+    lib_commu_bail_error(err);
+    shm_fd = lib_commu_shm_link_fd_get(shm_link);
+
+    /* set local magic for the session */
+    err = pseudo_random_uint32_get(&local_magic);
+    lib_commu_bail_error(err);
+
+    peer_info.ipv4_addr = htonl(INADDR_LOOPBACK);
+    peer_info.port = conn_info->d_port;
+
+    /* insert handle to DB */
+    err = lib_commu_db_tcp_client_handle_info_set(shm_fd, conn_info->msg_type,
+                                                  local_info, peer_info,
+                                                  local_magic);
+    lib_commu_bail_error(err);
+    is_handle_set = 1;
+
+    err = lib_commu_db_hanlde_info_get(shm_fd, &handle_info_st,
+                                       &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+    __atomic_store_n(&handle_info_st->shm_link, shm_link, __ATOMIC_RELEASE);
+
+    *handle = shm_fd;
+
+bail:
+    if (err && (shm_link != NULL)) {
+        if (is_handle_set) {
+            (void)lib_commu_db_tcp_handle_info_delete(shm_fd);
+        }
+        lib_commu_shm_link_close(shm_link);
+    }
+    return -err;
+}
+
+/**
+ * close a TCP connection between two peers.
+ * Can be used from server/client side
+ *
+ * @param[in] handle
+ * @param[in,out] None
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EPERM - handle haven't create by library TCP API[s]
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_peer_stop(handle_t handle)
+{
+    int err = 0;
+    struct handle_info *handle_info_st = NULL;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    /* no new call holds the handle */
+    err = lib_commu_db_tcp_handle_info_closing_set(handle, &handle_info_st);
+    lib_commu_bail_error(err);
+
+    err = handle_close(handle_info_st);
+    lib_commu_bail_error(err);
+
+
+bail:
+    return -err;
+}
+
+
+
+/**
+ * send the payload as stream of bytes over TCP connection
+ * Can be used from server/clients side. blocking until all payload is sent.
+ *
+ * @param[in] payload - the data to pass.
+ * @param[in,out] payload_len - size of payload
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EOVERFLOW - if payload_len exceeds MAX TCP SIZE message
+ * @return EINVAL or ENOKEY- if handle doesn't exist in library DB
+ * @return EIO - if could not sent all buffer (after 3 retries)
+ * @return ETIMEDOUT - if the MSG_ZEROCOPY pages weren't released in time,
+ *         the connection is reset and the handle must be closed, see
+ *         comm_lib_tcp_zerocopy_set
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native send function
+ */
+int
+comm_lib_tcp_send_blocking(handle_t handle, uint8_t *payload,
+                           uint32_t *payload_len)
+{
+    int err = 0;
+
+    struct msg_header header_st;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct iovec iov[2];
+    uint32_t header_len = 0;
+    uint32_t total_len = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(payload_len);
+
+    if (*payload_len > (MAX_JUMBO_TCP_PAYLOAD - sizeof(struct msg_metadata))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n", *payload_len);
+        lib_commu_bail_force(EOVERFLOW);
+    }
+
+    memset((char*) &header_st, 0, sizeof(header_st));
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type,
+                                        NULL);
+    lib_commu_bail_error(err);
+
+    err = msg_header_set(&header_st, *payload_len, sizeof(header_st),
+                         handle_info_st, &header_len);
+    lib_commu_bail_error(err);
+
+
+    /* sending the header and the payload together */
+    iov[0].iov_base = &header_st;
+    iov[0].iov_len = header_len;
+    iov[1].iov_base = payload;
+    iov[1].iov_len = *payload_len;
+    total_len = header_len + *payload_len;
+
+    err = tcp_iov_send(handle, handle_info_st, iov, 2, &total_len,
+                       handle_db_type);
+    if (total_len < header_len) {
+        *payload_len = 0;
+    }
+    else {
+        *payload_len = total_len - header_len;
+    }
+    lib_commu_bail_error(err);
+
+bail:
+    handle_msgs_stats_update(handle, 0, (err == 0) ? 1 : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
+
+
+/**
+ * send several messages as stream of bytes over TCP connection
+ * Can be used from server/clients side. blocking until all messages are sent.
+ * The messages are sent with one sendmsg() per SEND_BATCH_MSGS messages.
+ * With IO_ENGINE_URING up to SEND_BATCH_LINKED batches are linked sendmsg()
+ * submitted with one io_uring_enter.
+ *
+ * @param[in] msgs - the messages to send.
+ * @param[in,out] msgs_num - #messages to send, updated to #messages sent
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if msgs == NULL or msgs_num == NULL or a payload == NULL
+ * @return EINVAL or ENOKEY- if handle doesn't exist in library DB
+ * @return EOVERFLOW - if a payload_len exceeds MAX TCP SIZE message or is 0
+ * @return EBADE - if a msg_type differs from the connection msg_type
+ * @return EIO - if could not sent all buffer (after SEND_REPEAT_NUM retries)
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function
+ */
+int
+comm_lib_tcp_send_batch_blocking(handle_t handle, struct tcp_send_msg *msgs,
+                                 uint32_t *msgs_num)
+{
+    int err = 0;
 
-static void*
-client_connect_thread(void *args)
-{
-    int err = 0, bail_err = 0;
-    int so_err_val = 0;
-    uint32_t so_err_val_len = sizeof(so_err_val);
-    struct addr_info peer_info;
-    int client_fd = INVALID_HANDLE_ID;
-    int is_sock_sent_client = 0;
-    int fd_max = INVALID_HANDLE_ID;
-    int fd_flags = 0;
-    int i = 0;
-    struct sockaddr_in server_sock_addr;
-    socklen_t sock_addr_len = 0;
-    struct connect_thread_args *thread_args = NULL;
-    fd_set write_fds;
-    fd_set read_fds;
+    struct msg_header header_st[SEND_BATCH_MSGS];
+    struct iovec iov[SEND_BATCH_MSGS * 2];
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    uint32_t msgs_sent = 0;
+    uint32_t batch_num = 0;
+    uint32_t total_len = 0;
+    uint32_t i = 0;
+    int is_linked = 0;
 
-    client_connect_thread_cnt++;
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
 
-    memset(&server_sock_addr, 0, sizeof(server_sock_addr));
-    memset(&peer_info, 0, sizeof(peer_info));
-    FD_ZERO(&write_fds);
-    FD_ZERO(&read_fds);
+    lib_commu_bail_null(msgs);
+    lib_commu_bail_null(msgs_num);
 
-    lib_commu_bail_null(args);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type,
+                                        NULL);
+    lib_commu_bail_error(err);
 
-    thread_args = (struct connect_thread_args*)args;
-    client_fd = thread_args->client_fd;
-    if (client_fd == 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid client FD");
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB)
+        && (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid handle type[%d]\n", handle_db_type);
         lib_commu_bail_force(EINVAL);
     }
 
-    /* set socket as non-blocking */
-    if ((fd_flags = fcntl(client_fd, F_GETFL, 0)) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "fcntl failed: on socket[%d] err(%u): %s",
-                client_fd, errno, strerror(errno));
-        lib_commu_bail_force(errno);
-    }
-    if (fcntl(client_fd, F_SETFL, fd_flags | O_NONBLOCK) < 0) {
-        close_socket_wrapper(client_fd);
-        LCM_LOG(LCOMMU_LOG_ERROR, "fcntl failed: on socket[%d] err(%u): %s",
-                client_fd, errno, strerror(errno));
-        lib_commu_bail_force(errno);
-    }
-
-    /* prepare server params to connect */
-    server_sock_addr.sin_family = AF_INET;
-    server_sock_addr.sin_port = thread_args->conn_info.d_port;
-    server_sock_addr.sin_addr.s_addr = thread_args->conn_info.d_ipv4_addr;
-    sock_addr_len = sizeof(struct sockaddr);
-
-    /* connect non-blocking mode*/
-    err = connect(client_fd, (struct sockaddr*) &server_sock_addr,
-                  sock_addr_len);
-    if (err < 0) {
-        if (errno != EINPROGRESS) {
+    /* validate all the messages before sending any */
+    for (i = 0; i < *msgs_num; i++) {
+        lib_commu_bail_null(msgs[i].payload);
+        if ((msgs[i].payload_len == 0) ||
+            (msgs[i].payload_len >
+             (MAX_JUMBO_TCP_PAYLOAD - sizeof(struct msg_metadata)))) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u] msg[%u]\n",
+                    msgs[i].payload_len, i);
+            lib_commu_bail_force(EOVERFLOW);
+        }
+        if ((handle_info_st->conn_info.msg_type != GENERAL_MSG_TYPE) &&
+            (msgs[i].msg_type != handle_info_st->conn_info.msg_type)) {
             LCM_LOG(LCOMMU_LOG_ERROR,
-                    "None blocking connect failed: on socket[%d] err(%u): %s",
-                    client_fd, errno, strerror(errno));
-            lib_commu_bail_force(errno);
+                    "Connection msg_type[%u], msg_type[%u] msg[%u]\n",
+                    handle_info_st->conn_info.msg_type, msgs[i].msg_type, i);
+            lib_commu_bail_force(EBADE);
         }
     }
-    else { /* connect is already done */
-        err = handle_new_non_blocking_client(client_fd, fd_flags, thread_args,
-                                             &is_sock_sent_client);
-        lib_commu_bail_error(err);
-        goto bail;
-    }
 
-    fd_max =
-        (client_fd > client_connect_exit_event_fd) ?
-        client_fd : client_connect_exit_event_fd;
+    is_linked = (g_lib_commu_io_engine == IO_ENGINE_URING) &&
+                tcp_iov_is_plain(handle_info_st);
 
-    while (1) {
-        /* set args for select */
-        FD_ZERO(&write_fds);
-        FD_ZERO(&read_fds);
-        FD_SET(client_fd, &write_fds);
-        FD_SET(client_connect_exit_event_fd, &read_fds);
+    while (msgs_sent < *msgs_num) {
+        batch_num = *msgs_num - msgs_sent;
+        if (is_linked && (batch_num > SEND_BATCH_MSGS)) {
+            err = tcp_send_batch_linked(handle, handle_info_st,
+                                        handle_db_type, &msgs[msgs_sent],
+                                        batch_num, &batch_num);
+            msgs_sent += batch_num;
+            lib_commu_bail_error(err);
+            continue;
+        }
+        if (batch_num > SEND_BATCH_MSGS) {
+            batch_num = SEND_BATCH_MSGS;
+        }
 
-        /* wait on socket with select */
-        if (select(fd_max + 1, &read_fds, &write_fds, NULL,
-                   thread_args->use_tval ? &(thread_args->tval) : NULL) < 0) {
-            if (errno != EINTR) { /* if select caught signal --> don't exit with error */
-                LCM_LOG(LCOMMU_LOG_ERROR, "select() failed with err(%d): %s\n",
-                        errno, strerror(errno));
-                lib_commu_bail_force(errno);
-            }
+        err = tcp_batch_frame(handle_info_st, &msgs[msgs_sent], batch_num,
+                              header_st, iov, &total_len);
+        lib_commu_bail_error(err);
+
+        err = tcp_iov_send(handle, handle_info_st, iov, batch_num * 2,
+                           &total_len, handle_db_type);
+        if (err) {
+            /* count the messages which were completely sent */
+            msgs_sent += tcp_batch_msgs_sent(header_st, &msgs[msgs_sent],
+                                             batch_num, total_len);
+            lib_commu_bail_force(err);
         }
 
-        for (i = 0; i <= fd_max; i++) {
-            is_sock_sent_client = 0;
-            if (FD_ISSET(i, &write_fds)) { /* socket is write-ready */
-                if (i == client_fd) {
-                    if (getsockopt(i, SOL_SOCKET, SO_ERROR, &so_err_val,
-                                   &so_err_val_len)
-                        < 0) {
-                        LCM_LOG(LCOMMU_LOG_ERROR,
-                                "getsockopt failed with err(%d): %s\n", errno,
-                                strerror(errno));
-                        lib_commu_bail_force(errno);
-                    }
-                    if (so_err_val == 0) { /* connection established */
-                        err = handle_new_non_blocking_client(
-                            client_fd, fd_flags, thread_args,
-                            &is_sock_sent_client);
-                        lib_commu_bail_error(err);
-                        goto bail;
-                    }
-                    else {
-                        LCM_LOG(LCOMMU_LOG_ERROR,
-                                "Failed to establish connection with err(%d): %s\n",
-                                so_err_val, strerror(so_err_val));
-                        lib_commu_bail_force(so_err_val);
-                    }
-                }
-            }
-            else if (FD_ISSET(i, &read_fds)) { /* socket is write-ready */
-                if (i == client_connect_exit_event_fd) {
-                    LCM_LOG(LCOMMU_LOG_NOTICE,
-                            "Exiting from client connect thread");
-                    goto bail;
-                }
-            }
-        } /* end for loop on FDs */
-    } /* end while */
+        msgs_sent += batch_num;
+    }
 
 bail:
-    if (err && (client_fd != INVALID_HANDLE_ID)) {
-        /* handle failure */
-        if (!is_sock_sent_client) {
-            close_socket_wrapper(client_fd);
-        }
-        peer_info.ipv4_addr = thread_args->conn_info.d_ipv4_addr;
-        peer_info.port = thread_args->conn_info.d_port;
-        err = -err;
-        bail_err = thread_args->clbk_st.clbk_notify_func(INVALID_HANDLE_ID,
-                                                         peer_info,
-                                                         thread_args->clbk_st.data,
-                                                         err);
-        if (bail_err) {
-            LCM_LOG(LCOMMU_LOG_ERROR,
-                    "Failed to notify client on new handle with err(%d)\n",
-                    bail_err);
-        }
+    if (msgs_num != NULL) {
+        *msgs_num = msgs_sent;
     }
-    client_connect_thread_cnt--;
-    safe_free(args);
-    pthread_exit(NULL);
+    handle_msgs_stats_update(handle, 0, msgs_sent, err);
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
 }
 
 
-static int
-handle_new_non_blocking_client(
-    int client_fd, int def_flags, struct connect_thread_args *thread_args,
-    int *is_sock_sent_client)
+/**
+ * send messages over several TCP connections, blocking until all of them
+ * are sent or failed. Each message is framed as in comm_lib_tcp_send_blocking,
+ * the messages of a connection are sent in array order, the connections are
+ * served concurrently. With IO_ENGINE_URING the messages of connections
+ * without coalescing, zerocopy or shared memory are submitted together, up to
+ * 64 sendmsg() per io_uring_enter, otherwise each message takes its own send.
+ *
+ * @param[in,out] msgs - the messages to send, the err of each one is set
+ * @param[in] msgs_num - #messages to send
+ *
+ * @return 0 if operation completes successfully, see the err of the messages
+ * @return EINVAL - if msgs == NULL
+ * @return ENOMEM - if the send state couldn't be allocated
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_send_multi_blocking(struct tcp_send_handle_msg *msgs,
+                                 uint32_t msgs_num)
 {
     int err = 0;
-    uint32_t local_magic = 0;
-    struct addr_info peer_info;
-    struct addr_info local_info;
-
-    memset(&local_info, 0, sizeof(local_info));
-    memset(&peer_info, 0, sizeof(peer_info));
-
-    lib_commu_bail_null(thread_args);
+    int msg_err = 0;
+    int is_uring = 0;
+    struct tcp_multi_msg *multi_msgs = NULL;
+    struct tcp_multi_msg *multi_msg = NULL;
+    struct tcp_uring_send *sends = NULL;
+    struct lib_commu_uring_op *ops = NULL;
+    uint32_t sends_num = 0;
+    uint32_t total_len = 0;
+    uint32_t i = 0;
 
-    if (client_fd == INVALID_HANDLE_ID) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid client FD\n");
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    /* restore file status flags - set as blocking */
-    if (fcntl(client_fd, F_SETFL, def_flags) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "fcntl failed: on socket[%d] err(%u): %s",
-                client_fd, errno, strerror(errno));
-        lib_commu_bail_force(errno);
+    lib_commu_bail_null(msgs);
+
+    if (msgs_num == 0) {
+        goto bail;
     }
 
-    /* set local magic for the tcp client session */
-    err = pseudo_random_uint32_get(&local_magic);
-    lib_commu_bail_error(err);
+    multi_msgs = (struct tcp_multi_msg *)calloc(msgs_num,
+                                                sizeof(*multi_msgs));
+    if (g_lib_commu_io_engine == IO_ENGINE_URING) {
+        sends = (struct tcp_uring_send *)calloc(msgs_num, sizeof(*sends));
+        ops = (struct lib_commu_uring_op *)calloc(msgs_num, sizeof(*ops));
+    }
+    if ((multi_msgs == NULL) ||
+        ((g_lib_commu_io_engine == IO_ENGINE_URING) &&
+         ((sends == NULL) || (ops == NULL)))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate %u messages\n",
+                msgs_num);
+        lib_commu_bail_force(ENOMEM);
+    }
 
-    peer_info.ipv4_addr = thread_args->conn_info.d_ipv4_addr;
-    peer_info.port = thread_args->conn_info.d_port;
+    for (i = 0; i < msgs_num; i++) {
+        multi_msgs[i].msg = &msgs[i];
+    }
+    /* the messages of a handle are adjacent, linked by tcp_uring_sends */
+    qsort(multi_msgs, msgs_num, sizeof(*multi_msgs), tcp_multi_msg_cmp);
+
+    for (i = 0; i < msgs_num; i++) {
+        multi_msg = &multi_msgs[i];
+        msg_err = tcp_multi_msg_frame(multi_msg);
+        multi_msg->msg->err = -msg_err;
+
+        /* all the messages of a handle take the same path */
+        if ((i == 0) ||
+            (multi_msgs[i - 1].msg->handle != multi_msg->msg->handle)) {
+            is_uring = (sends != NULL) &&
+                       (multi_msg->handle_info_st != NULL) &&
+                       tcp_iov_is_plain(multi_msg->handle_info_st);
+        }
+        if (msg_err || !is_uring) {
+            continue;
+        }
 
-    /* insert handle to DB */
-    err = lib_commu_db_tcp_client_handle_info_set(client_fd,
-                                                  thread_args->conn_info.msg_type,
-                                                  local_info, peer_info,
-                                                  local_magic);
-    lib_commu_bail_error(err);
+        multi_msg->is_uring = 1;
+        sends[sends_num].handle = multi_msg->msg->handle;
+        sends[sends_num].db_type = multi_msg->db_type;
+        sends[sends_num].msg.msg_iov = multi_msg->iov;
+        sends[sends_num].msg.msg_iovlen = 2;
+        sends[sends_num].total_len = multi_msg->total_len;
+        sends_num++;
+    }
 
-    /*send new socket to client*/
-    err = thread_args->clbk_st.clbk_notify_func(client_fd, peer_info,
-                                                thread_args->clbk_st.data, 0);
-    lib_commu_bail_error(err);
+    if (sends_num > 0) {
+        tcp_uring_sends(sends, ops, sends_num);
+    }
 
-    *is_sock_sent_client = 1;
+    sends_num = 0;
+    for (i = 0; i < msgs_num; i++) {
+        multi_msg = &multi_msgs[i];
+        if (multi_msg->is_uring) {
+            multi_msg->msg->err = -sends[sends_num].err;
+            sends_num++;
+        }
+        else if (multi_msg->msg->err == 0) {
+            total_len = multi_msg->total_len;
+            multi_msg->msg->err =
+                -tcp_iov_send(multi_msg->msg->handle,
+                              multi_msg->handle_info_st, multi_msg->iov, 2,
+                              &total_len, multi_msg->db_type);
+        }
 
-    LCM_LOG(LCOMMU_LOG_INFO, "Establish connection on socket[%d]\n",
-            client_fd);
+        if (multi_msg->handle_info_st != NULL) {
+            handle_msgs_stats_update(multi_msg->msg->handle, 0,
+                                     (multi_msg->msg->err == 0) ? 1 : 0,
+                                     -multi_msg->msg->err);
+            lib_commu_db_handle_info_release(multi_msg->handle_info_st);
+        }
+    }
 
 bail:
-    return err;
+    free(multi_msgs);
+    free(sends);
+    free(ops);
+    return -err;
 }
 
-
-static int
-create_client_connect_event_socket(int *fd)
+/**
+ * queue the payload to be sent over TCP connection, without blocking.
+ * Can be used from server/clients side. The message is framed as in
+ * comm_lib_tcp_send_blocking and sent by the library reactor thread once the
+ * socket is writable, messages of a connection are sent in queue order.
+ * clbk_send_done_func is called from the reactor thread with rc == 0 once the
+ * message was sent, or with rc < 0 if the connection failed. payload must
+ * stay valid till then. Messages still queued when the handle is closed by
+ * comm_lib_tcp_peer_stop/comm_lib_tcp_server_session_stop are completed with
+ * -ECANCELED from the closing thread, on comm_lib_deinit they are dropped.
+ * Don't mix with the blocking send functions on the same handle while
+ * messages are queued.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in] payload - the data to pass.
+ * @param[in] payload_len - size of payload
+ * @param[in] clbk_st - the completion callback
+ *
+ * @return 0 if the message was queued
+ * @return EINVAL - if payload == NULL or clbk_st == NULL or clbk_st->clbk_send_done_func == NULL
+ * @return EINVAL - if handle isn't a TCP handle
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOVERFLOW - if payload_len exceeds MAX TCP SIZE message
+ * @return EAGAIN - if MAX_TX_QUEUE_MSGS messages are already queued on the handle
+ * @return ENOMEM - if failed to allocate the handle queue
+ * @return EOPNOTSUPP - if handle is a shm session, coalesces its messages or
+ *         sends with MSG_ZEROCOPY
+ * @return EBUSY - if handle sends on channels or has a receive callback
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function if the connection failed
+ */
+int
+comm_lib_tcp_send_async(handle_t handle, uint8_t *payload,
+                        uint32_t payload_len,
+                        const struct register_to_send_completion *clbk_st)
 {
     int err = 0;
-    int len = 0;
-    struct sockaddr_un s_addr;
+    int is_queue_locked = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct handle_reactor *handle_reactor = NULL;
+    struct tx_queue *tx_queue = NULL;
+    struct tx_queue_msg *queue_msg = NULL;
+    uint32_t header_len = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
 
-    memset(&s_addr, 0, sizeof(s_addr));
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(clbk_st);
+    lib_commu_bail_null(clbk_st->clbk_send_done_func);
 
-    lib_commu_bail_null(fd);
+    if (payload_len > (MAX_JUMBO_TCP_PAYLOAD - sizeof(struct msg_metadata))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n", payload_len);
+        lib_commu_bail_force(EOVERFLOW);
+    }
 
-    *fd = 0;
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
 
-    /* Create socket from which to read. */
-    *fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (*fd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Could not create connect event socket err(%d): %s\n", errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB) &&
+        (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a TCP handle\n", handle);
+        lib_commu_bail_force(EINVAL);
     }
 
-    s_addr.sun_family = AF_UNIX;
-    strcpy(s_addr.sun_path, CLIENT_CONNECT_THREAD_PATH);
-    unlink(s_addr.sun_path);
+    /* the reactor can't wait on shm rings */
+    if (handle_info_st->shm_link != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] is a shm session\n", handle);
+        lib_commu_bail_force(EOPNOTSUPP);
+    }
 
-    len = strlen(s_addr.sun_path) + sizeof(s_addr.sun_family);
-    if (bind(*fd, (struct sockaddr *)&s_addr, len) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to bind socket[%d] err(%d): %s\n",
-                *fd, errno, strerror( errno));
-        lib_commu_bail_force(errno);
+    /* queued messages would be overtaken by the coalesced ones */
+    if (handle_info_st->tx_coalesce != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] coalesces its messages\n",
+                handle);
+        lib_commu_bail_force(EOPNOTSUPP);
     }
 
-bail:
-    return err;
-}
+    /* the reactor would wake up on the MSG_ZEROCOPY notifications */
+    if (handle_info_st->zerocopy_min_bytes != 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] sends with MSG_ZEROCOPY\n",
+                handle);
+        lib_commu_bail_force(EOPNOTSUPP);
+    }
 
-static int
-exit_client_connect_threads(void)
-{
-    int err = 0;
-    int n_bytes = 0;
-    int send_event_fd = INVALID_HANDLE_ID;
-    struct sockaddr_un s_addr;
-    socklen_t sock_len = 0;
-    int exit_code = 1;
+    /* queued messages would split the frames of the channels */
+    if (__atomic_load_n(&handle_info_st->tcp_channels,
+                        __ATOMIC_ACQUIRE) != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] sends on channels\n", handle);
+        lib_commu_bail_force(EBUSY);
+    }
 
-    memset(&s_addr, 0, sizeof(s_addr));
+    err = tx_queue_get(handle, handle_info_st, &tx_queue);
+    lib_commu_bail_error(err);
 
-    send_event_fd = socket(AF_UNIX, SOCK_DGRAM, 0);
-    if (send_event_fd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Could not create exit client connect event socket err(%d): %s\n",
-                errno, strerror(errno));
-        lib_commu_bail_force(errno);
+    err = pthread_mutex_lock(&tx_queue->lock);
+    lib_commu_bail_error(err);
+    is_queue_locked = 1;
+
+    if (tx_queue->err != 0) {
+        lib_commu_bail_force(tx_queue->err);
     }
 
-    s_addr.sun_family = AF_UNIX;
-    strcpy(s_addr.sun_path, CLIENT_CONNECT_THREAD_PATH);
-    sock_len = strlen(s_addr.sun_path) + sizeof(s_addr.sun_family);
+    if (tx_queue->msgs_num == MAX_TX_QUEUE_MSGS) {
+        LCM_LOG(LCOMMU_LOG_DEBUG, "tx queue of handle[%d] is full\n", handle);
+        lib_commu_bail_force(EAGAIN);
+    }
 
-    n_bytes = sendto(send_event_fd, &exit_code, sizeof(exit_code), 0,
-                     (const struct sockaddr*) &s_addr, sock_len);
-    if (n_bytes < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Writing to socket[%d] on path: %s, failed with err(%d): %s\n",
-                send_event_fd, s_addr.sun_path, errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    queue_msg = &tx_queue->msgs[(tx_queue->head + tx_queue->msgs_num) %
+                                MAX_TX_QUEUE_MSGS];
+    memset(&queue_msg->header, 0, sizeof(queue_msg->header));
+    err = msg_header_set(&queue_msg->header, payload_len,
+                         sizeof(queue_msg->header), handle_info_st,
+                         &header_len);
+    lib_commu_bail_error(err);
+    queue_msg->payload = payload;
+    queue_msg->payload_len = payload_len;
+    queue_msg->clbk_st = *clbk_st;
+
+    /* the reactor drains a non empty queue, arm it on the first message */
+    if (tx_queue->msgs_num == 0) {
+        handle_reactor = __atomic_load_n(&handle_info_st->handle_reactor,
+                                         __ATOMIC_ACQUIRE);
+        pthread_mutex_lock(&handle_reactor->lock);
+        handle_reactor->events |= EPOLLOUT;
+        err = handle_reactor_arm(handle_reactor);
+        if (err) {
+            handle_reactor->events &= ~EPOLLOUT;
+        }
+        pthread_mutex_unlock(&handle_reactor->lock);
+        lib_commu_bail_error(err);
     }
+    tx_queue->msgs_num++;
 
 bail:
-    close_socket_wrapper(send_event_fd);
-    return err;
+    if (is_queue_locked) {
+        pthread_mutex_unlock(&tx_queue->lock);
+    }
+    if (err) {
+        handle_msgs_stats_update(handle, 0, 0, err);
+    }
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
 }
 
-/************************************************
- *  Function implementations
- ***********************************************/
-
 
 /**
- * This function is used to open communication library and init it's data
+ * coalesce the messages sent on a TCP connection into a buffer of
+ * max_bytes, flushed once full, after max_delay_usec or by
+ * comm_lib_tcp_flush. max_bytes = 0 flushes the buffer and stops coalescing.
  *
- * @param[in] - log_cb_t logging_cb
- * @param[in, out] - None
- * @param[out] - None
+ * @param[in] handle - the TCP handle
+ * @param[in] max_bytes - buffer size (1-MAX_COALESCE_BYTES), 0 to stop
+ * @param[in] max_delay_usec - the longest time a message is buffered
+ *                             (1-MAX_COALESCE_DELAY_USEC)
  *
  * @return 0 if operation completes successfully
- * @return EFAULT or EINVAL or EPERM if pseusdo random init failed
- * @return EPERM if DB operation failed
- * @return errno codes of native pthread_mutex_init function
+ * @return EINVAL - if handle isn't a TCP handle or a parameter is out of range
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if comm_lib_tcp_send_async was used on the handle
+ * @return ENOMEM - if failed to allocate the buffer
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg/timerfd_create functions
  */
 int
-comm_lib_init(lib_commu_log_cb_t logging_cb)
+comm_lib_tcp_coalesce_set(handle_t handle, uint32_t max_bytes,
+                          uint32_t max_delay_usec)
 {
     int err = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
 
-    if (logging_cb == NULL) {
-        /* do nothing */
-    }
-    else {
-        lib_commu_log_cb = logging_cb;
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
     }
 
-    if (g_lib_commu_init_done) {
-        LCM_LOG(LCOMMU_LOG_NOTICE, "Library already initialized\n");
-        goto bail;
+    if ((max_bytes > MAX_COALESCE_BYTES) ||
+        ((max_bytes > 0) &&
+         ((max_delay_usec == 0) ||
+          (max_delay_usec > MAX_COALESCE_DELAY_USEC)))) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid coalescing max_bytes[%u] max_delay_usec[%u]\n",
+                max_bytes, max_delay_usec);
+        lib_commu_bail_force(EINVAL);
     }
 
-    err = lib_db_init();
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    /* Initialize MUTEX */
-    if (pthread_mutex_init(&lock_listener_db_access, NULL) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "pthread_mutex_init() failed with err(%d): %s\n", errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB) &&
+        (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a TCP handle\n", handle);
+        lib_commu_bail_force(EINVAL);
     }
-    if (pthread_mutex_init(&lock_tcp_session_db_access, NULL) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "pthread_mutex_init() failed with err(%d): %s\n", errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+
+    /* the reactor can't send on shm rings */
+    if (handle_info_st->shm_link != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] is a shm session\n", handle);
+        lib_commu_bail_force(EOPNOTSUPP);
     }
 
-    err = pseudo_random_gen_uint32_init();
-    lib_commu_bail_error(err);
+    if ((max_bytes > 0) &&
+        (__atomic_load_n(&handle_info_st->tx_queue, __ATOMIC_ACQUIRE) != NULL)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has an async send queue\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    /* coalesced messages would split the frames of the channels */
+    if ((max_bytes > 0) &&
+        (__atomic_load_n(&handle_info_st->tcp_channels,
+                         __ATOMIC_ACQUIRE) != NULL)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] sends on channels\n", handle);
+        lib_commu_bail_force(EBUSY);
+    }
 
-    err = create_client_connect_event_socket(&client_connect_exit_event_fd);
+    /* a new size or delay takes effect with an empty buffer */
+    err = tx_coalesce_stop(handle_info_st);
     lib_commu_bail_error(err);
 
-    g_lib_commu_init_done = 1;
-    LCM_LOG(LCOMMU_LOG_NOTICE,
-            "Communication library finish initialization\n");
+    if (max_bytes > 0) {
+        err = tx_coalesce_start(handle, handle_info_st, max_bytes,
+                                max_delay_usec);
+        lib_commu_bail_error(err);
+    }
 
 bail:
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
-
 /**
- * This function is used to close communication library and deinit it's data
+ * send the messages coalesced on a TCP connection, blocking until they
+ * are sent.
  *
- * @param[in] - None
- * @param[in, out] - None
- * @param[out] - None
+ * @param[in] handle - the TCP handle
  *
  * @return 0 if operation completes successfully
+ * @return ENOKEY - if handle doesn't exist in library DB
  * @return EPERM if library didn't finish init
- * @return errno codes of native pthread_mutex_destroy function
+ * @return errno codes of native sendmsg function, including errors of
+ *         earlier flushes by the reactor
  */
 int
-comm_lib_deinit()
+comm_lib_tcp_flush(handle_t handle)
 {
-    int err = 0, tmp_err = 0;
+    int err = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct tx_coalesce *tx_coalesce = NULL;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    g_lib_commu_init_done = 0;
-
-    tmp_err = pthread_mutex_destroy(&lock_listener_db_access);
-    if (tmp_err != 0) {
-        err = tmp_err;
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "pthread_mutex_destroy() failed with err(%d): %s\n", errno,
-                strerror(errno));
-    }
-    tmp_err = pthread_mutex_destroy(&lock_tcp_session_db_access);
-    if (tmp_err != 0) {
-        err = tmp_err;
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "pthread_mutex_destroy() failed with err(%d): %s\n", errno,
-                strerror(errno));
-    }
-
-    if (client_connect_thread_cnt > 0) {
-        tmp_err = exit_client_connect_threads();
-        if (tmp_err != 0) {
-            err = tmp_err;
-            LCM_LOG(LCOMMU_LOG_ERROR,
-                    "Failed on to send exit event to client connect thread err(%u)\n",
-                    err);
-            /*update error and continue, best effort deinit*/
-        }
-    }
-
-    while (1) {
-        if (client_connect_thread_cnt == 0) {
-            break;
-        }
-        sleep(1);
-    }
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
 
-    if (client_connect_exit_event_fd != INVALID_HANDLE_ID) {
-        tmp_err = close_socket_wrapper(client_connect_exit_event_fd);
-        if (tmp_err != 0) {
-            err = tmp_err;
-            LCM_LOG(LCOMMU_LOG_ERROR,
-                    "Failed to close socketsocket(%u): with err[%u]\n",
-                    client_connect_exit_event_fd, err);
-            /*update error and continue, best effort deinit*/
-        }
+    tx_coalesce = __atomic_load_n(&handle_info_st->tx_coalesce,
+                                  __ATOMIC_ACQUIRE);
+    if (tx_coalesce == NULL) {
+        goto bail;
     }
 
-    tmp_err = lib_db_deinit();
-    lib_commu_bail_error(tmp_err);
+    err = tx_coalesce_drain(tx_coalesce);
 
 bail:
-    LCM_LOG(LCOMMU_LOG_NOTICE,
-            "Communication library finish deinit with err(%d)\n", err);
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
 /**
- * Sets verbosity level of communication library
+ * send the large messages of a TCP connection with MSG_ZEROCOPY, a blocking
+ * send returns once the kernel released the payload pages.
  *
- * @param[in] - verbosity - verbosity level
- * @param[in, out] - None
- * @param[out] - None
+ * @param[in] handle - the TCP handle
+ * @param[in] min_bytes - smallest message sent with MSG_ZEROCOPY
+ *                        (MIN_ZEROCOPY_BYTES-MAX_JUMBO_TCP_PAYLOAD), 0 to stop
  *
  * @return 0 if operation completes successfully
- * @return EINVAL - Invalid argument - param out of range, if operation completes unsuccessfully
+ * @return EINVAL - if handle isn't a TCP handle or min_bytes is out of range
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session or a UNIX domain socket
+ * @return EBUSY - if comm_lib_tcp_send_async was used on the handle
+ * @return ENOMEM - if failed to allocate the zerocopy state
  * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function
  */
 int
-comm_lib_verbosity_level_set(enum lib_commu_verbosity_level verbosity)
+comm_lib_tcp_zerocopy_set(handle_t handle, uint32_t min_bytes)
 {
     int err = 0;
+    int optval = 1;
+    struct handle_info *handle_info_st = NULL;
+    struct tcp_zerocopy *tcp_zerocopy = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    if ((verbosity > LCOMMU_VERBOSITY_LEVEL_MIN) &&
-        (verbosity <= LCOMMU_VERBOSITY_LEVEL_MAX)) {
-        LOG_VAR_NAME(__MODULE__) = verbosity;
+    if ((min_bytes > 0) &&
+        ((min_bytes < MIN_ZEROCOPY_BYTES) ||
+         (min_bytes > MAX_JUMBO_TCP_PAYLOAD))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid zerocopy min_bytes[%u]\n",
+                min_bytes);
+        lib_commu_bail_force(EINVAL);
     }
-    else {
-        LCM_LOG(LCOMMU_LOG_ERROR, "verbosity[%d] is out of range <%d-%d>\n",
-                verbosity, LCOMMU_VERBOSITY_LEVEL_MIN,
-                LCOMMU_VERBOSITY_LEVEL_MAX);
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB) &&
+        (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a TCP handle\n", handle);
         lib_commu_bail_force(EINVAL);
     }
 
-    err = comm_lib_db_verbosity_level_set(verbosity);
+    if (handle_info_st->shm_link != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] is a shm session\n", handle);
+        lib_commu_bail_force(EOPNOTSUPP);
+    }
+
+    if (min_bytes == 0) {
+        __atomic_store_n(&handle_info_st->zerocopy_min_bytes, 0,
+                         __ATOMIC_RELAXED);
+        goto bail;
+    }
+
+    if (__atomic_load_n(&handle_info_st->tx_queue, __ATOMIC_ACQUIRE) != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has an async send queue\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    /* the socket option stays set once enabled, it has no cost by itself */
+    if (setsockopt(handle, SOL_SOCKET, SO_ZEROCOPY, &optval,
+                   sizeof(optval)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Fail setting sock options [SO_ZEROCOPY], err[%d]: %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    err = tcp_zerocopy_get(handle, handle_info_st, &tcp_zerocopy);
     lib_commu_bail_error(err);
 
+    __atomic_store_n(&handle_info_st->zerocopy_min_bytes, min_bytes,
+                     __ATOMIC_RELEASE);
 
 bail:
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
 /**
- * Gets the verbosity level of communication library
+ * set the priority of a channel of a TCP connection.
+ * A channel carries the messages of one msg_type, sent by
+ * comm_lib_tcp_channel_send and received by comm_lib_tcp_channel_recv.
  *
- * @param[in] verbosity - verbosity level
- * @param[in,out] None
- * @param[out] None
+ * @param[in] handle - the TCP handle
+ * @param[in] msg_type - the channel
+ * @param[in] priority - 0 (the highest) - (TCP_CHANNEL_PRIORITIES_NUM - 1)
  *
  * @return 0 if operation completes successfully
- * @return EINVAL Invalid argument - param null, if operation completes unsuccessfully
+ * @return EINVAL - if handle isn't a TCP handle of a GENERAL_MSG_TYPE
+ *                  connection or priority is out of range
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if handle coalesces its messages or
+ *                 comm_lib_tcp_send_async was used on it
+ * @return ENOMEM - if failed to allocate the channels
  * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function
  */
 int
-comm_lib_verbosity_level_get(enum lib_commu_verbosity_level *verbosity)
+comm_lib_tcp_channel_set(handle_t handle, uint8_t msg_type, uint8_t priority)
 {
     int err = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct tcp_channels *tcp_channels = NULL;
 
     if (!g_lib_commu_init_done) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Library isn't initialized\n");
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    if (verbosity == NULL) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Param verbosity is NULL\n");
+    if (priority >= TCP_CHANNEL_PRIORITIES_NUM) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid channel priority[%u]\n", priority);
         lib_commu_bail_force(EINVAL);
     }
 
-    *verbosity = LOG_VAR_NAME(__MODULE__);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB) &&
+        (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a TCP handle\n", handle);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = tcp_channels_get(handle, handle_info_st, &tcp_channels);
+    lib_commu_bail_error(err);
 
+    /* takes effect on the next message of the channel */
+    pthread_mutex_lock(&tcp_channels->lock);
+    tcp_channels->channels[msg_type].priority = priority;
+    pthread_mutex_unlock(&tcp_channels->lock);
 
 bail:
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
 /**
- * Open a UDP socket connection from specific types
- *
- * @param[in] params - parameters in order to open the socket.
- * @param[in,out] handle - the handle open by the connection
- * @param[out] - None.
+ * send a message on a channel of a TCP connection, blocking until it is sent.
+ * A message larger than a chunk yields the connection after each chunk to the
+ * waiting senders of higher priority channels.
  *
- * Global Variables Referred & Modified: None
+ * @param[in] handle - the TCP handle
+ * @param[in] msg_type - the channel
+ * @param[in] payload - the data to send
+ * @param[in,out] payload_len - size of payload, updated to #bytes sent
  *
  * @return 0 if operation completes successfully
- * @return EINVAL Invalid argument - handle==null.
- * @return EKEYREJECTED Key was rejected by service - param.type is unsupported.
- * @return ENOBUFS or ENOMEM or EACCES is creation of socket fails. SOCKET(2) in Linux Programmer's Manual
- * @return EACCES or EADDRINUSE or EBADF or EINVAL and more  if binding the socket fails.
- * @return ENOBUFS or EPERM if can't update session db with the new handle.
+ * @return EINVAL - if payload == NULL or payload_len == NULL or handle isn't
+ *                  a TCP handle of a GENERAL_MSG_TYPE connection
+ * @return EOVERFLOW - if payload_len exceeds MAX JUMBO TCP SIZE message or is 0
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if handle coalesces its messages or
+ *                 comm_lib_tcp_send_async was used on it
+ * @return ENOMEM - if failed to allocate the channels
+ * @return EIO - if could not sent all buffer (after SEND_REPEAT_NUM retries)
  * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function, including errors of an
+ *         earlier send on the handle, which may have cut a message
  */
 int
-comm_lib_udp_session_start(handle_t *handle,
-                           const struct udp_params const *params)
+comm_lib_tcp_channel_send(handle_t handle, uint8_t msg_type, uint8_t *payload,
+                          uint32_t *payload_len)
 {
     int err = 0;
-
-    int sockfd = INVALID_HANDLE_ID;
-    struct sockaddr_in sock_addr;
-    uint32_t local_magic = 0;
-    socklen_t sock_addr_len = 0;
-
-    memset((char *) &sock_addr, 0, sizeof(sock_addr));
-
-    lib_commu_bail_null(handle);
-    lib_commu_bail_null(params);
+    int is_channel_owner = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct tcp_channels *tcp_channels = NULL;
+    struct tcp_channel *channel = NULL;
+    uint32_t len = 0;
+    uint32_t offset = 0;
+    uint32_t frame_len = 0;
+    uint8_t priority = 0;
+    uint8_t i = 0;
+    int is_preempted = 0;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    *handle = 0;
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(payload_len);
 
-    /*
-     * AF_INET - IPv4 Internet protocols.
-     * SOCK_DGRAM - Supports datagrams.
-     * SOCK_NONBLOCK -
-     */
-    sockfd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sockfd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Socket creation failed failed err(%u): %s",
-                errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    len = *payload_len;
+    *payload_len = 0;
+
+    if ((len == 0) ||
+        (len > (MAX_JUMBO_TCP_PAYLOAD - sizeof(struct msg_metadata)))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n", len);
+        lib_commu_bail_force(EOVERFLOW);
     }
 
-    /* set priority on socket */
-    err = set_sock_priority(sockfd);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    switch (params->type) {
-    case CONN_TYPE_UDP_IP_UC:
-        sock_addr.sin_family = AF_INET;
-        sock_addr.sin_addr.s_addr =
-            params->fields.ip_udp_params.session_params.s_ipv4_addr;
-        sock_addr.sin_port =
-            params->fields.ip_udp_params.session_params.port;
-        break;
-
-    default:
-        lib_commu_bail_force(EKEYREJECTED);
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB) &&
+        (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a TCP handle\n", handle);
+        lib_commu_bail_force(EINVAL);
     }
 
-    /* if connection role is server --> bind the socket  */
-    if (params->fields.ip_udp_params.connection_role == CONN_SERVER) {
-        sock_addr_len = sizeof(sock_addr);
-        if (bind(sockfd, (struct sockaddr *) &sock_addr, sock_addr_len) < 0) {
-            LCM_LOG(LCOMMU_LOG_ERROR,
-                    "bind() socket[%d] failed with err(%u): %s\n",
-                    sockfd, errno, strerror(errno));
-            lib_commu_bail_force(errno);
+    err = tcp_channels_get(handle, handle_info_st, &tcp_channels);
+    lib_commu_bail_error(err);
+
+    channel = &tcp_channels->channels[msg_type];
+
+    pthread_mutex_lock(&tcp_channels->lock);
+    priority = channel->priority;
+    tcp_channels->tx_waiting[priority]++;
+
+    while (offset < len) {
+        /* wait for the socket, the channel, and the senders of the higher
+         * priorities to finish */
+        while (tcp_channels->tx_err == 0) {
+            is_preempted = 0;
+            for (i = 0; i < priority; i++) {
+                if (tcp_channels->tx_waiting[i] > 0) {
+                    is_preempted = 1;
+                    break;
+                }
+            }
+            if (!is_preempted && !tcp_channels->is_tx_busy &&
+                (is_channel_owner || !channel->is_tx_busy)) {
+                break;
+            }
+            pthread_cond_wait(&tcp_channels->tx_cond, &tcp_channels->lock);
+        }
+        if (tcp_channels->tx_err != 0) {
+            err = tcp_channels->tx_err;
+            break;
         }
+
+        tcp_channels->is_tx_busy = 1;
+        channel->is_tx_busy = 1;
+        is_channel_owner = 1;
+        pthread_mutex_unlock(&tcp_channels->lock);
+
+        err = tcp_channel_frame_send(handle, handle_info_st, handle_db_type,
+                                     msg_type, payload, len, offset,
+                                     &frame_len);
+
+        pthread_mutex_lock(&tcp_channels->lock);
+        tcp_channels->is_tx_busy = 0;
+        pthread_cond_broadcast(&tcp_channels->tx_cond);
+        if (err) {
+            /* the peer can't tell where a cut frame ends */
+            tcp_channels->tx_err = err;
+            break;
+        }
+        offset += frame_len;
     }
 
-    /* set local magic for the udp session */
-    err = pseudo_random_uint32_get(&local_magic);
-    lib_commu_bail_error(err);
+    if (is_channel_owner) {
+        channel->is_tx_busy = 0;
+    }
+    tcp_channels->tx_waiting[priority]--;
+    pthread_cond_broadcast(&tcp_channels->tx_cond);
+    pthread_mutex_unlock(&tcp_channels->lock);
 
-    /* insert handle to DB */
-    err =
-        lib_commu_db_udp_handle_info_set(sockfd,
-                                         &(params->fields.ip_udp_params),
-                                         local_magic);
+    *payload_len = offset;
     lib_commu_bail_error(err);
 
-    /* update socket fd */
-    *handle = sockfd;
-
 bail:
-    if (err && (sockfd != INVALID_HANDLE_ID)) {
-        close_socket_wrapper(sockfd);
-    }
+    handle_msgs_stats_update(handle, 0, (err == 0) ? 1 : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
-
 /**
- * Close a socket connection
- *
- * @param[in] handle - the handle to close connection.
- * @param[in,out] None.
- * @param[out] None.
+ * receive a message of a channel of a TCP connection to a buffer of the
+ * library pool, blocking until one is received.
+ * Messages of other channels read meanwhile are queued to their channels,
+ * up to TCP_CHANNEL_RX_MSGS_MAX per channel. A message read while its
+ * channel is full stops the reading of the connection, by all the channels,
+ * till the channel's receiver takes one, so the sender is slowed by TCP flow
+ * control rather than losing messages.
  *
- * Global Variables Referred & Modified: None
+ * @param[in] handle - the TCP handle
+ * @param[in] msg_type - the channel
+ * @param[out] msg - the message, release its payload by
+ *                   comm_lib_recv_buffer_release
  *
  * @return 0 if operation completes successfully
- * @return EBADF if handle isn't a valid open file descriptor.
- * @return EINTR if The close() call was interrupted by a signal
- * @return EIO if An I/O error occurred.
- * @return ENOKEY if handle not found in DB
- * @return EPREM if handle == INVALID_HANDLE_ID
+ * @return EINVAL - if msg == NULL or handle isn't a TCP handle of a
+ *                  GENERAL_MSG_TYPE connection
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if handle coalesces its messages or
+ *                 comm_lib_tcp_send_async was used on it
+ * @return ECONNRESET or ENOTCONN - if connection on handle have been reset by peer
+ * @return EBADE - if peer magic is invalid
+ * @return EIO - if a message was received with an unknown version or
+ *               its chunks are out of order
+ * @return EOVERFLOW - if message size > MAX_JUMBO_TCP_PAYLOAD or meesage size = 0
+ * @return ENOMEM - if failed to allocate the channels or a message buffer
+ * @return EBUSY - if a receive callback is set on handle
  * @return EPERM if library didn't finish init
  */
 int
-comm_lib_udp_session_stop(handle_t handle)
+comm_lib_tcp_channel_recv(handle_t handle, uint8_t msg_type,
+                          struct recv_msg *msg)
 {
     int err = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct tcp_channels *tcp_channels = NULL;
+    struct tcp_channel *channel = NULL;
+    uint8_t *payload = NULL;
+    uint32_t payload_len = 0;
+    uint8_t frame_msg_type = 0;
+    uint32_t idx = 0;
+    int is_parked_taken = 0;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    err = close_socket_wrapper(handle);
+    lib_commu_bail_null(msg);
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    err = lib_commu_db_udp_handle_info_delete(handle);
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB) &&
+        (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a TCP handle\n", handle);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = tcp_channels_get(handle, handle_info_st, &tcp_channels);
     lib_commu_bail_error(err);
 
+    channel = &tcp_channels->channels[msg_type];
+
+    pthread_mutex_lock(&tcp_channels->lock);
+    while (channel->rx_msgs_num == 0) {
+        /* the message which stopped the reading is ours, all the channels
+         * were full */
+        if ((tcp_channels->rx_parked != NULL) &&
+            (tcp_channels->rx_parked_msg_type == msg_type)) {
+            is_parked_taken = 1;
+            break;
+        }
+        if (tcp_channels->rx_err != 0) {
+            err = tcp_channels->rx_err;
+            break;
+        }
+        /* another receiver reads the socket, it queues our messages too.
+         * While a message waits for room in its channel nobody reads */
+        if (tcp_channels->is_rx_busy || (tcp_channels->rx_parked != NULL)) {
+            pthread_cond_wait(&tcp_channels->rx_cond, &tcp_channels->lock);
+            continue;
+        }
+
+        tcp_channels->is_rx_busy = 1;
+        pthread_mutex_unlock(&tcp_channels->lock);
+
+        err = tcp_channel_frame_recv(handle, handle_info_st, tcp_channels,
+                                     &frame_msg_type, &payload, &payload_len);
+
+        pthread_mutex_lock(&tcp_channels->lock);
+        tcp_channels->is_rx_busy = 0;
+        pthread_cond_broadcast(&tcp_channels->rx_cond);
+        if (err) {
+            /* the stream can't be parsed further */
+            tcp_channels->rx_err = err;
+            break;
+        }
+        if ((payload != NULL) &&
+            tcp_channel_msg_queue(tcp_channels, frame_msg_type, payload,
+                                  payload_len)) {
+            tcp_channels->rx_parked = payload;
+            tcp_channels->rx_parked_len = payload_len;
+            tcp_channels->rx_parked_msg_type = frame_msg_type;
+        }
+    }
+
+    if (is_parked_taken) {
+        msg->payload = tcp_channels->rx_parked;
+        msg->payload_len = tcp_channels->rx_parked_len;
+        msg->msg_type = msg_type;
+        tcp_channels->rx_parked = NULL;
+        pthread_cond_broadcast(&tcp_channels->rx_cond);
+    }
+    else if (channel->rx_msgs_num > 0) {
+        err = 0;
+        idx = channel->rx_head;
+        msg->payload = tcp_channels->rx_msgs[idx].payload;
+        msg->payload_len = tcp_channels->rx_msgs[idx].payload_len;
+        msg->msg_type = msg_type;
+
+        channel->rx_head = tcp_channels->rx_msgs[idx].next;
+        if (channel->rx_head == TCP_CHANNEL_RX_NONE) {
+            channel->rx_tail = TCP_CHANNEL_RX_NONE;
+        }
+        channel->rx_msgs_num--;
+        tcp_channels->rx_msgs[idx].next = tcp_channels->rx_free;
+        tcp_channels->rx_free = idx;
+
+        /* the room made resumes the reading */
+        if ((tcp_channels->rx_parked != NULL) &&
+            (tcp_channel_msg_queue(tcp_channels,
+                                   tcp_channels->rx_parked_msg_type,
+                                   tcp_channels->rx_parked,
+                                   tcp_channels->rx_parked_len) == 0)) {
+            tcp_channels->rx_parked = NULL;
+            pthread_cond_broadcast(&tcp_channels->rx_cond);
+        }
+    }
+    pthread_mutex_unlock(&tcp_channels->lock);
+    lib_commu_bail_error(err);
 
 bail:
+    handle_msgs_stats_update(handle, 1, (err == 0) ? 1 : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
 /**
- * Send payload over a UDP connection
- *
- * @param[in] handle - the handle to send data.
- * @param[in] payload - data to send.
- * @param[in] conn_info - the information of the recipient and msg_type sent on handle.
- * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes sent.
- * @param[out] - None.
+ * Receive the messages as stream of bytes over TCP connection
+ * Can be used from server/clients side. blocking until at least one message is received.
+ * payload_data->msg_num_recv > 0 when got message
+ * if payload_data->jumbo_payload_len > 0 --> the message received on payload_data->jumbo_payload
+ * When max_msgs_to_recv > 1 all the complete messages already received (up to
+ * max_msgs_to_recv) are returned on payload_data->payload[0..], a jumbo
+ * message is always the last message returned.
+ * Bytes of further messages are kept in the handle buffer, the batch also
+ * ends early at a jumbo message or an invalid message, so before polling the
+ * handle receive again while comm_lib_tcp_recv_buffered_get reports messages.
  *
- * Global Variables Referred & Modified: None
+ * @param[in] max_msgs_to_recv - the maximum messages to receive (1-MAX_MSGS)
+ * @param[in,out] addresser_st - server address, port.
+ * @param[in,out] recv_payload_data_t - the data structure which contains parsed messages payloads must be initalize.
+ * @param[out] - None
  *
  * @return 0 if operation completes successfully
- * @return EOVERFLOW if payload_len > MAX_UDP_MSG_SIZE (1436) -sizeof(struct msg_metadata)
- * @return ENOKEY if handle wasn't found.
- * @return EIO if failed to send all payload
+ * @return EINVAL - if conn_info == NULL or payload_data == NULL or max_msgs_to_recv == 0 or handle type != TCP type
+ * @return ECONNRESET or ENOTCONN - if connection on handle have been reset by peer i.e socket not active
+ * @return EBADE - if msg type received on socket is invalid or peer magic is invalid
+ * @return EOVERFLOW - if message size > MAX_TCP_PAYLOAD or meesage size = 0
+ * @return EINVAL - if max_msgs_to_recv > MAX_MSGS
+ * @return ENOMEM - if failed to allocate the handle receive buffer
+ * @return EBUSY - if a receive callback is set on handle
+ * @return EIO - if a message was received with an unknown version
+ * @return ECONNABORTED - if a message failed midway on a previous call, the
+ *                        stream is out of sync and the handle must be closed
  * @return EPERM if library didn't finish init
- * @return sendto errno codes if failed to send payload
  */
 int
-comm_lib_udp_send(handle_t handle, struct addr_info recipient_st,
-                  uint8_t *payload, uint32_t *payload_len)
+comm_lib_tcp_recv_blocking(handle_t handle, struct addr_info *addresser_st,
+                           struct recv_payload_data *payload_data,
+                           uint32_t max_msgs_to_recv)
 {
     int err = 0;
 
     struct msg_metadata metadata_st;
+    struct msg_trace trace_st;
+    uint32_t metadata_len = sizeof(metadata_st);
+    uint32_t trace_len = 0;
+    uint32_t payload_len = 0;
+    int is_msg_started = 0;
     struct handle_info *handle_info_st = NULL;
-    uint8_t buffer[MAX_MTU];
-    uint32_t buffer_len = 0;
-    enum db_type handle_db_type = UDP_HANDLE_DB;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+
+    memset(&metadata_st, 0, sizeof(metadata_st));
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    /* 1. input validations start*/
+    lib_commu_bail_null(addresser_st);
+    lib_commu_bail_null(payload_data);
+
+    payload_data->msg_num_recv = 0;
+    memset(payload_data->payload_len, 0, sizeof(payload_data->payload_len));
+    payload_data->jumbo_payload_len = 0;
+
+    if (max_msgs_to_recv == 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [max_msgs_to_recv]\n");
+        lib_commu_bail_force(EINVAL);
+    }
+
+    if (max_msgs_to_recv > MAX_MSGS) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid parameter [max_msgs_to_recv > %d]\n", MAX_MSGS);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type,
+                                        NULL);
+    lib_commu_bail_error(err);
+
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB)
+        && (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid handle type[%d]\n", handle_db_type);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    /* the messages are delivered to the receive callback */
+    if (__atomic_load_n(&handle_info_st->rx_callback, __ATOMIC_ACQUIRE) != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has a receive callback\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+    /*input validations end*/
+
+    err = rx_stream_check(handle, &handle_info_st->rx_stream);
+    lib_commu_bail_error(err);
 
-    memset((char*) &metadata_st, 0, sizeof(metadata_st));
-    memset((uint8_t*) buffer, 0, sizeof(buffer));
+    addresser_st->ipv4_addr = handle_info_st->conn_info.d_ipv4_addr;
+    addresser_st->port = handle_info_st->conn_info.d_port;
 
-    if (!g_lib_commu_init_done) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
-        lib_commu_bail_force(EPERM);
+    /* several messages are parsed out of one recv() into the handle stream
+     * buffer. A single message read goes to the buffer as well while it still
+     * holds unparsed bytes of a previous call */
+    if ((max_msgs_to_recv > 1) ||
+        (handle_info_st->rx_stream.tail > handle_info_st->rx_stream.head)) {
+        err = rx_stream_msgs_parse(handle, handle_info_st, payload_data,
+                                   max_msgs_to_recv);
+        lib_commu_bail_error(err);
+        goto bail;
     }
 
-    lib_commu_bail_null(payload);
-    lib_commu_bail_null(payload_len);
-    if (*payload_len > MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata)) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n", *payload_len);
-        lib_commu_bail_force(EOVERFLOW);
+    /* 2. recv the metadata and validate*/
+    err = comm_lib_tcp_ll_recv_blocking(handle, (uint8_t*) &metadata_st,
+                                        &metadata_len);
+    lib_commu_bail_error(err);
+
+    if (metadata_len < sizeof(metadata_st)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "metadata incomplete\n");
+        lib_commu_bail_force(EIO);
     }
+    is_msg_started = 1;
 
-    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st,
-                                       &handle_db_type,
-                                       NULL);
+    err = validate_metadata_info(&metadata_st, MAX_JUMBO_TCP_PAYLOAD,
+                                 handle_info_st);
     lib_commu_bail_error(err);
 
-    err =
-        metadata_set(&metadata_st, MSG_VERSION, *payload_len, *handle_info_st);
-    lib_commu_bail_error(err);
+    /* the trace of a traced message follows the metadata */
+    if (metadata_st.version == MSG_TRACE_VERSION) {
+        trace_len = sizeof(trace_st);
+        err = comm_lib_tcp_ll_recv_blocking(handle, (uint8_t*)&trace_st,
+                                            &trace_len);
+        lib_commu_bail_error(err);
+        msg_trace_recv(handle, &metadata_st,
+                       handle_info_st->conn_info.d_ipv4_addr,
+                       (uint8_t*)&trace_st);
+    }
+    /*recv the metadata and validate end*/
+
+    /* 3. get the message */
+    payload_len = metadata_st.payload_size;
+    if (metadata_st.payload_size <= MAX_TCP_PAYLOAD) {
+        err = comm_lib_tcp_ll_recv_blocking(handle, payload_data->payload[0],
+                                            &payload_len);
+        lib_commu_bail_error(err);
 
-    memcpy(buffer, &metadata_st, sizeof(metadata_st));
-    buffer_len = sizeof(metadata_st);
-    memcpy(buffer + buffer_len, payload, *payload_len);
-    buffer_len += *payload_len;
+        payload_data->payload_len[0] = payload_len;
+        payload_data->msg_type[0] = metadata_st.msg_type;
+    }
+    else {
+        err = comm_lib_tcp_ll_recv_blocking(handle,
+                                            payload_data->jumbo_payload,
+                                            &payload_len);
+        lib_commu_bail_error(err);
 
-    /* sending the payload */
-    err = comm_lib_udp_ll_send(handle, recipient_st, buffer, &buffer_len);
-    if (err != 0) {
-        if (buffer_len > sizeof(metadata_st)) {
-            *payload_len = buffer_len - sizeof(metadata_st);
-        }
-        else {
-            *payload_len = 0;
-        }
-        lib_commu_bail_force(EIO);
+        payload_data->jumbo_payload_len = payload_len;
+        payload_data->jumbo_msg_type = metadata_st.msg_type;
     }
 
+    payload_data->msg_num_recv++;
+
+
 bail:
+    if (err && is_msg_started) {
+        /* the rest of the message can't be skipped */
+        handle_info_st->rx_stream.is_failed = 1;
+    }
+    handle_msgs_stats_update(handle, 1,
+                             (payload_data != NULL) ?
+                             payload_data->msg_num_recv : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
-
 /**
- * Receive payload over a UDP connection,
- * if receive fails the handle is closed and becomes obsolete
- *
- * @param[in] handle - the handle to receive the data
- * @param[in] payload - data received.
- * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes received.
- * @param[out] None.
+ * Receive the messages as stream of bytes over TCP connection to buffers of
+ * the library pool. Can be used from server/clients side. blocking until at
+ * least one message is received.
+ * Each message is returned on a buffer sized by its metadata payload_size,
+ * the caller owns the buffer till it releases it by
+ * comm_lib_recv_buffer_release. All the complete messages already received
+ * (up to *msgs_num) are returned, the batch also ends early at a partial or
+ * an invalid message, so before polling the handle receive again while
+ * comm_lib_tcp_recv_buffered_get reports messages. May be mixed with
+ * comm_lib_tcp_recv_blocking on the same handle.
  *
- * Global Variables Referred & Modified: None
+ * @param[in] handle - the TCP handle
+ * @param[in,out] addresser_st - the peer address, port.
+ * @param[in,out] msgs - filled with the messages received
+ * @param[in,out] msgs_num - size of msgs, updated to #messages received
  *
  * @return 0 if operation completes successfully
- * @return EOVERFLOW if payload_len is insufficient.
- * @return EIO if failed to receive any part of the message
- * @return EBADE if got data from unhallowed peer or corrupted data
- * @return EINVAL if payload_len == 0
+ * @return EINVAL - if addresser_st == NULL or msgs == NULL or msgs_num == NULL or *msgs_num == 0 or handle type != TCP type
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return ECONNRESET or ENOTCONN - if connection on handle have been reset by peer i.e socket not active
+ * @return EBADE - if msg type received on socket is invalid or peer magic is invalid
+ * @return EOVERFLOW - if message size > MAX_JUMBO_TCP_PAYLOAD or meesage size = 0
+ * @return ENOMEM - if failed to allocate the handle receive buffer or a message buffer
+ * @return EBUSY - if a receive callback is set on handle
+ * @return EIO - if a message was received with an unknown version
+ * @return ECONNABORTED - if a message failed midway on a previous call, the
+ *                        stream is out of sync and the handle must be closed
  * @return EPERM if library didn't finish init
  */
-
 int
-comm_lib_udp_recv(handle_t handle, struct addr_info *addresser_st,
-                  uint8_t *payload, uint32_t *payload_len)
+comm_lib_tcp_recv_pooled(handle_t handle, struct addr_info *addresser_st,
+                         struct recv_msg *msgs, uint32_t *msgs_num)
 {
     int err = 0;
-
-    struct msg_metadata metadata_st;
+    uint32_t max_msgs = 0;
     struct handle_info *handle_info_st = NULL;
-    uint8_t buffer[MAX_MTU];
-    uint32_t buffer_len = MAX_MTU;
-    enum db_type handle_db_type = UDP_HANDLE_DB;
-
-    memset((char*) &metadata_st, 0, sizeof(metadata_st));
-    memset((uint8_t*) buffer, 0, sizeof(buffer));
+    enum db_type handle_db_type = ANY_HANLDE_DB;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    lib_commu_bail_null(payload);
-    lib_commu_bail_null(payload_len);
     lib_commu_bail_null(addresser_st);
+    lib_commu_bail_null(msgs);
+    lib_commu_bail_null(msgs_num);
 
-    if (*payload_len == 0) {
+    max_msgs = *msgs_num;
+    *msgs_num = 0;
+
+    if (max_msgs == 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [msgs_num]\n");
         lib_commu_bail_force(EINVAL);
     }
 
-    /* 0. get handle info */
-    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st,
-                                       &handle_db_type,
-                                       NULL);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    /* 1. get the payload and update the addresser_st info*/
-    err = comm_lib_udp_ll_recv(handle, buffer, &buffer_len, addresser_st);
-    lib_commu_bail_error(err);
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB)
+        && (handle_db_type != TCP_SERVER_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Invalid handle type[%d]\n", handle_db_type);
+        lib_commu_bail_force(EINVAL);
+    }
 
-    if (buffer_len < sizeof(metadata_st)) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Data received < metadata\n");
-        lib_commu_bail_force(EIO);
+    addresser_st->ipv4_addr = handle_info_st->conn_info.d_ipv4_addr;
+    addresser_st->port = handle_info_st->conn_info.d_port;
+
+    /* the messages are delivered to the receive callback */
+    if (__atomic_load_n(&handle_info_st->rx_callback, __ATOMIC_ACQUIRE) != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has a receive callback\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
     }
 
-    /* 2. get metadata from the payload */
-    err = parse_metadata_from_buffer(buffer, &metadata_st);
+    err = rx_stream_check(handle, &handle_info_st->rx_stream);
     lib_commu_bail_error(err);
 
-    err = validate_metadata_info(&metadata_st, *payload_len, handle_info_st);
+    err = rx_stream_msgs_parse_pooled(handle, handle_info_st, msgs, max_msgs,
+                                      msgs_num);
     lib_commu_bail_error(err);
 
-    /* 4. copy the payload from buffer */
-    memcpy(payload, buffer + sizeof(metadata_st), metadata_st.payload_size);
-    *payload_len = metadata_st.payload_size;
-
-
 bail:
-    LCM_LOG(LCOMMU_LOG_DEBUG, "finish: %s, with error code[%d]\n", __func__,
-            err);
-    if (err) {
-        *payload_len = 0;
-    }
+    handle_msgs_stats_update(handle, 1,
+                             (msgs_num != NULL) ? *msgs_num : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
-
 /**
- * start a TCP connection from the server side.
- * opens a thread which "listens" to new connections.
- * Once connection is established a callback is being made with
- * a new handle toward the client.
+ * Get the number of messages already received to the buffer of a TCP handle
+ * by comm_lib_tcp_recv_blocking/comm_lib_tcp_recv_pooled and not returned
+ * yet. The socket isn't readable for these messages, so while *msgs_num > 0
+ * receive again before polling the handle. A buffered invalid message is
+ * counted as one message, its error is returned by the next receive.
  *
- * @param[in] params - server address, port, etc (network order)
- * @param[in] function callback
- * @param[in,out] server_id - the id of the server to open
- * @param[out] handle
+ * @param[in] handle - the TCP handle
+ * @param[out] msgs_num - #complete messages in the handle buffer
  *
  * @return 0 if operation completes successfully
- * @return EINVAL if clbk_st == NULL
- * @return EACCES if can't create listener socket
- * @return ENOBUFS or ENOMEM The socket cannot be created until sufficient resources are freed
- * @return EAGAIN if Insufficient resources to create listener thread
+ * @return EINVAL - if msgs_num == NULL or handle type != TCP type
+ * @return ENOKEY - if handle doesn't exist in library DB
  * @return EPERM if library didn't finish init
- * @return ENOMEM if can't create new session due to DB limit
  */
 int
-comm_lib_tcp_server_session_start(struct session_params params,
-                                  struct register_to_new_handle *clbk_st,
-                                  uint16_t *server_id)
+comm_lib_tcp_recv_buffered_get(handle_t handle, uint32_t *msgs_num)
 {
     int err = 0;
-    int listener = INVALID_HANDLE_ID;
-    int event_fd = INVALID_HANDLE_ID;
-    struct sockaddr_in serveraddr;
-    int optval = 0;
-    socklen_t sockaddr_len = 0;
-    struct listener_thread_args *args = NULL;
-    uint16_t idx = NUM_OF_LISTENER_THREADS;
-    int is_db_locked = 0;
-
-    memset((char *) &serveraddr, 0, sizeof(serveraddr));
-
-    lib_commu_bail_null(clbk_st);
-    lib_commu_bail_null(clbk_st->clbk_notify_func);
-    lib_commu_bail_null(server_id);
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct rx_stream *rx_stream = NULL;
+    struct msg_metadata metadata_st;
+    uint32_t payload_size = 0;
+    uint32_t msg_len = 0;
+    uint32_t head = 0;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    listener = socket(AF_INET, SOCK_STREAM, 0);
-    if (-1 == listener) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Can't create socket, err(%d): %s\n",
-                errno, strerror(errno));
-        lib_commu_bail_force(errno);
-    }
+    lib_commu_bail_null(msgs_num);
+    *msgs_num = 0;
 
-    serveraddr.sin_family = AF_INET;
-    serveraddr.sin_port = params.port;
-    serveraddr.sin_addr.s_addr = params.s_ipv4_addr;
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
 
-    /*binding the listener socket*/
-    optval = 1; /* Set the option active */
-    if (-1 == setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &optval,
-                         sizeof(optval))) {
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB)
+        && (handle_db_type != TCP_SERVER_HANDLE_DB)) {
         LCM_LOG(LCOMMU_LOG_ERROR,
-                "Fail setting sock options [SO_REUSEADDR], err[%d]: %s\n",
-                errno,
-                strerror(errno));
-        close_socket_wrapper(listener);
-        lib_commu_bail_force(errno);
+                "Invalid handle type[%d]\n", handle_db_type);
+        lib_commu_bail_force(EINVAL);
     }
 
-    sockaddr_len = sizeof(serveraddr);
-    if (bind(listener, (struct sockaddr *) &serveraddr, sockaddr_len) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Bind listener socket[%d] failed err(%u): %s\n",
-                listener, errno, strerror(errno));
-        close_socket_wrapper(listener);
-        lib_commu_bail_force(errno);
+    rx_stream = &handle_info_st->rx_stream;
+    if (rx_stream->buffer == NULL) {
+        goto bail;
     }
 
-    /*start take idx from DB*/
-    err = pthread_mutex_lock(&lock_tcp_session_db_access);
-    lib_commu_bail_error(err);
-    is_db_locked = 1;
-
-    err = lib_commu_db_unoccupied_listener_thread_get(&idx);
-    if (err) {
-        close_socket_wrapper(listener);
-        lib_commu_bail_force(ENOMEM);
+    /* the next receive fails without blocking */
+    if (rx_stream->is_failed) {
+        *msgs_num = 1;
+        goto bail;
     }
 
-    *server_id = idx;
+    head = rx_stream->head;
+    while (rx_stream->tail - head >= sizeof(metadata_st)) {
+        /* the metadata is validated by the receive, check only its length */
+        memcpy(&metadata_st, rx_stream->buffer + head, sizeof(metadata_st));
+        payload_size = ntohl(metadata_st.payload_size);
+        if (((metadata_st.version != MSG_VERSION)
+             && (metadata_st.version != MSG_TRACE_VERSION))
+            || (payload_size == 0)
+            || (payload_size > MAX_JUMBO_TCP_PAYLOAD)) {
+            (*msgs_num)++;
+            break;
+        }
 
-    err = create_server_event_socket(&event_fd, idx);
-    if (err) {
-        close_socket_wrapper(listener);
-        lib_commu_bail_error(err);
+        msg_len = msg_header_len(&metadata_st) + payload_size;
+        if (rx_stream->tail - head < msg_len) {
+            break;
+        }
+
+        (*msgs_num)++;
+        head += msg_len;
     }
 
-    args = (struct listener_thread_args *) malloc(
-        sizeof(struct listener_thread_args));
-    lib_commu_bail_null(args);
+bail:
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
 
-    args->event_fd = event_fd;
-    args->server_id = idx;
-    args->thread_idx = idx;
-    args->listener_fd = listener;
-    args->clbk_st.clbk_notify_func = clbk_st->clbk_notify_func;
-    args->clbk_st.data = clbk_st->data;
-    args->params.msg_type = params.msg_type;
-    args->params.port = params.port;
-    args->params.s_ipv4_addr = params.s_ipv4_addr;
 
-    err = pthread_create(&listener_threads[idx], NULL, listener_main_thread,
-                         args);
-    if (err != 0) {
-        close_socket_wrapper(listener);
-        safe_free(args);
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Failed to create listener thread err(%u):\n", err);
-        lib_commu_bail_force(err);
-    }
+/**
+ * Release a buffer returned by comm_lib_tcp_recv_pooled back to the pool.
+ *
+ * @param[in] payload - the message buffer
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if payload == NULL or payload isn't a pool buffer or was already released
+ */
+int
+comm_lib_recv_buffer_release(uint8_t *payload)
+{
+    int err = 0;
 
-    err = pthread_mutex_unlock(&lock_tcp_session_db_access);
+    err = lib_commu_pool_buffer_put(payload);
     lib_commu_bail_error(err);
-    is_db_locked = 0;
-    /*finish take idx from DB && assign thread id in listener_threads*/
-
 
 bail:
-    if (is_db_locked) {
-        err = pthread_mutex_unlock(&lock_tcp_session_db_access);
-        lib_commu_return_from_bail(-err);
-    }
     return -err;
 }
 
 
 /**
- * stop a TCP connection from the server side.
- * close a thread which "listens" to new connections. It does close
- * all the open sockets within this thread.
+ * Send a message up to MAX_UDP_LARGE_PAYLOAD bytes over a UDP connection,
+ * a payload larger than MAX_UDP_PAYLOAD is sent in fragments with UDP
+ * segmentation offload, or with sendmmsg() where it isn't supported.
  *
- * @param[in] server_id - the id of the server to close
- * @param[in] handle_array_len - size of handle_array
- * @param[in,out] uint32 *handle_array - the handles which closed.
- * @param[out] - None
+ * @param[in] handle - the handle to send data.
+ * @param[in] recipient_st - the information of the recipient (address and port)
+ * @param[in] payload - data to send.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes sent.
  *
  * @return 0 if operation completes successfully
- * @return EINVAL - if handle_array == NULL or handle_array_len == 0
- * @return EBADF  or ENOBUFS if if operation completes unsuccessfully
- * @return EINTR or EIO - if failed to close socket.
- * @return ENOKEY if server_id is out of bound.
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0
+ * @return EOVERFLOW if payload_len > MAX_UDP_LARGE_PAYLOAD
+ * @return ENOKEY if handle wasn't found.
+ * @return EIO if failed to send all payload
  * @return EPERM if library didn't finish init
  */
 int
-comm_lib_tcp_server_session_stop(uint16_t server_id, handle_t *handle_array,
-                                 uint32_t handle_array_len)
+comm_lib_udp_large_send(handle_t handle, struct addr_info recipient_st,
+                        uint8_t *payload, uint32_t *payload_len)
 {
-    int err = 0;
-    uint32_t i = 0, j = 0;
-    uint16_t idx = 0;
-    uint16_t thread_idx = 0;
-    struct server_status const *server_status = NULL;
-    int is_db_locked = 0;
+    int err = 0, err_bail = 0;
+    struct handle_info *handle_info_st = NULL;
+    struct iovec payload_iov;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    uint32_t total_bytes = 0;
+    int is_stats_updated = 0;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    lib_commu_bail_null(handle_array);
-    if (handle_array_len == 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [handle_array_len]\n");
-        lib_commu_bail_force(EINVAL);
-    }
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(payload_len);
 
-    if (server_id >= SERVER_STATUS_ARR_LENGTH) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [server_id]\n");
+    if (*payload_len == 0) {
         lib_commu_bail_force(EINVAL);
     }
 
-    idx = server_id;
-    thread_idx = server_id;
-
-    err = lib_commu_db_tcp_server_status_get(&server_status, server_id);
-    lib_commu_bail_error(err);
-
-    if (server_status->listener_status == HANDLE_STATUS_DOWN) {
-        LCM_LOG(LCOMMU_LOG_NOTICE, "Server[%u] already not active\n",
-                server_id);
-        goto bail;
+    if (*payload_len > MAX_UDP_LARGE_PAYLOAD) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                *payload_len);
+        lib_commu_bail_force(EOVERFLOW);
     }
 
-    /* signal to listener thread to exit */
-    err = exit_server_thread(idx);
-    lib_commu_bail_error(err);
-
-    LCM_LOG(LCOMMU_LOG_INFO, "Thread id to close[%lu]",
-            listener_threads[thread_idx]);
-    err = pthread_join(listener_threads[thread_idx], NULL);
-    lib_commu_bail_error(err);
-
-    /*start delete session resource DB and sockets*/
-    err = pthread_mutex_lock(&lock_tcp_session_db_access);
-    lib_commu_bail_error(err);
-    is_db_locked = 1;
-
-    listener_threads[thread_idx] = 0;
-    LCM_LOG(LCOMMU_LOG_INFO, "listener thread exited\n");
-
-    /* close all clients sockets */
-    for (i = 0; i < MAX_CONNECTION_NUM; i++) {
-        if (server_status->client_status[i].handle != INVALID_HANDLE_ID) {
-            err = close_socket_wrapper(server_status->client_status[i].handle);
-            lib_commu_bail_error(err);
-
-            /* best effort */
-            if (j < handle_array_len) {
-                handle_array[j++] = server_status->client_status[i].handle;
-            }
-        }
+    /* a datagram as comm_lib_udp_send sends, with its statistics */
+    if (*payload_len <= MAX_UDP_PAYLOAD) {
+        payload_iov.iov_base = payload;
+        payload_iov.iov_len = *payload_len;
+        is_stats_updated = 1;
+        err = udp_iov_send(handle, recipient_st, &payload_iov, 1,
+                           payload_len);
+        goto bail;
     }
 
-    /* reset TCP DB */
-    err = lib_commu_db_tcp_session_db_deinit(server_id);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    err = pthread_mutex_unlock(&lock_tcp_session_db_access);
+    err = udp_fragments_send(handle, handle_info_st, recipient_st, payload,
+                             *payload_len, &total_bytes);
     lib_commu_bail_error(err);
-    is_db_locked = 0;
 
 bail:
-    if (is_db_locked) {
-        err = pthread_mutex_unlock(&lock_tcp_session_db_access);
-        lib_commu_return_from_bail(-err);
+    if (err && (payload_len != NULL)) {
+        *payload_len = 0;
+    }
+    if (!is_stats_updated) {
+        handle_msgs_stats_update(handle, 0, (err == 0) ? 1 : 0, err);
+    }
+    if (total_bytes > 0) {
+        err_bail = handle_total_tx_update(handle, &handle_db_type,
+                                          total_bytes);
+        if (err_bail) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed in to update tx[%u] on handle[%d]\n", total_bytes,
+                    handle);
+            if (err == 0) {
+                err = err_bail;
+            }
+        }
     }
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
-
 /**
- * start a TCP connection from the client side. (Blocking)
- * opens a socket toward specific server IP and port from user context
- * Once connection is established the function returns and update new handle
- * IP and port must be valid
+ * Receive a message sent by comm_lib_udp_large_send, or a datagram sent by
+ * the other UDP send functions, over a UDP connection.
+ * The first call turns on UDP_GRO on the socket and allocates the
+ * reassembly table of the handle.
  *
- * @param[in] conn_info - server address, port, etc...
- * @param[in,out] client_handle
- * @param[out] None
+ * @param[in] handle - the handle to receive the data
+ * @param[out] addresser_st - the information of the addresser (address and port)
+ * @param[out] payload - data received.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes received.
  *
  * @return 0 if operation completes successfully
- * @return EINVAL - if client_handle or conn_info are NULL
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0
+ * @return EOVERFLOW if payload_len is insufficient, the message is dropped.
+ * @return EIO if a datagram holds a partial or an inconsistent fragment
+ * @return EBADE if got data from unhallowed peer or corrupted data
+ * @return ENOKEY if handle wasn't found.
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 reliable messages
+ * @return ENOMEM - if failed to allocate the reassembly table or a message buffer
  * @return EPERM if library didn't finish init
- * @return errno codes of native socket function
- * @return errno codes of native connect function
+ * @return errno codes of native recvmsg function
  */
 int
-comm_lib_tcp_client_blocking_start(
-    const struct connection_info const *conn_info,
-    handle_t *client_handle)
+comm_lib_udp_large_recv(handle_t handle, struct addr_info *addresser_st,
+                        uint8_t *payload, uint32_t *payload_len)
 {
     int err = 0;
-    int sock_fd = INVALID_HANDLE_ID;
-    struct sockaddr_in server_sock_addr;
-    uint32_t local_magic = 0;
-    socklen_t sock_addr_len = 0;
-    struct addr_info peer_info;
-    struct addr_info local_info;
-
-    memset(&server_sock_addr, 0, sizeof(server_sock_addr));
-    memset(&local_info, 0, sizeof(local_info));
-    memset(&peer_info, 0, sizeof(peer_info));
+    int is_msg_done = 0;
+    struct handle_info *handle_info_st = NULL;
+    struct udp_reassembly *udp_reassembly = NULL;
+    struct addr_info sender_st;
+    struct iovec iov;
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    uint32_t buffer_len = 0;
+    uint32_t dropped_num = 0;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    lib_commu_bail_null(client_handle);
-    lib_commu_bail_null(conn_info);
-
-    *client_handle = 0;
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(payload_len);
+    lib_commu_bail_null(addresser_st);
 
-    /*
-     * AF_INET - IPv4 Internet protocols.
-     * SOCK_STREAM - Supports TCP.
-     * SOCK_NONBLOCK -
-     */
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Socket creation failed err(%u): %s", errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    if (*payload_len == 0) {
+        lib_commu_bail_force(EINVAL);
     }
 
-    /* enlarge soeckt send/recv buffer to max tcp jumbo size */
-    err = set_sock_buffer_size(sock_fd);
-    lib_commu_bail_error(err);
-
-    /* set priority on socket */
-    err = set_sock_priority(sock_fd);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    /* set keepalive on socket */
-    err = set_sock_ka(sock_fd);
+    err = udp_reassembly_get(handle, handle_info_st, &udp_reassembly);
     lib_commu_bail_error(err);
 
-    server_sock_addr.sin_family = AF_INET;
-    server_sock_addr.sin_port = conn_info->d_port;
-    server_sock_addr.sin_addr.s_addr = conn_info->d_ipv4_addr;
-    sock_addr_len = sizeof(struct sockaddr);
+    pthread_mutex_lock(&udp_reassembly->lock);
+    while (!is_msg_done) {
+        /* the segments of the previous datagram were parsed */
+        if (udp_reassembly->head == udp_reassembly->tail) {
+            udp_reassembly->head = 0;
+            udp_reassembly->tail = 0;
+
+            iov.iov_base = udp_reassembly->buffer;
+            iov.iov_len = UDP_GRO_BUFFER_SIZE;
+            buffer_len = UDP_GRO_BUFFER_SIZE;
+            err = comm_lib_udp_ll_recv(handle, &iov, 1, &buffer_len,
+                                       &sender_st);
+            if (err) {
+                break;
+            }
+            udp_reassembly->ipv4_addr = sender_st.ipv4_addr;
+            udp_reassembly->port = sender_st.port;
+            udp_reassembly->tail = buffer_len;
+        }
 
-    if (connect(sock_fd, (struct sockaddr*) &server_sock_addr,
-                sock_addr_len) < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Connect() failed: on socket[%d] err(%u): %s",
-                sock_fd, errno, strerror(errno));
-        lib_commu_bail_force(errno);
+        err = udp_reassembly_segment_parse(handle_info_st, udp_reassembly,
+                                           addresser_st, payload, payload_len,
+                                           &is_msg_done, &dropped_num);
+        if (err) {
+            break;
+        }
     }
-
-    /* set local magic for the tcp client session */
-    err = pseudo_random_uint32_get(&local_magic);
-    lib_commu_bail_error(err);
-
-    peer_info.ipv4_addr = conn_info->d_ipv4_addr;
-    peer_info.port = conn_info->d_port;
-
-    /* insert handle to DB */
-    err = lib_commu_db_tcp_client_handle_info_set(sock_fd, conn_info->msg_type,
-                                                  local_info, peer_info,
-                                                  local_magic);
-    lib_commu_bail_error(err);
-
-    *client_handle = sock_fd;
+    pthread_mutex_unlock(&udp_reassembly->lock);
 
 bail:
-    if (err && (sock_fd != INVALID_HANDLE_ID)) {
-        close_socket_wrapper(sock_fd);
+    if (err && (payload_len != NULL)) {
+        *payload_len = 0;
     }
+    if (dropped_num > 0) {
+        (void)handle_stats_counter_add(handle, HANDLE_STATS_RX_ERRORS,
+                                       dropped_num);
+    }
+    handle_msgs_stats_update(handle, 1, (err == 0) ? 1 : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
+
 /**
- * start a TCP connection from the client side. (NON-Blocking)
- * opens a thread which opens a socket toward specific server IP and port
- * Once connection is established, a callback is being made with a new handle
- * toward the client.
- * If connection fails, a callback is being made with handle = -1 and in rc the proper (int*)error code
- * IP and port must be valid
+ * receive the messages of a TCP or UDP handle by a callback, called from the
+ * reactor threads, instead of a thread blocked on the handle.
  *
- * @param[in] conn_info - server address, port, etc...
- * @param[in] clbk_st - function callback
- * @param[in] tval - Client can set timeout for the connection.
- *                   if tval == NULL, connection will wait till connection is established or error
- *                   else connection will wait till time stated will pass.
- * @param[out] None
+ * @param[in] handle - the TCP or UDP handle
+ * @param[in] clbk_st - the callback, NULL to stop
  *
  * @return 0 if operation completes successfully
- * @return EINVAL - if client_handle or conn_info are NULL
+ * @return EINVAL - if handle isn't a TCP or UDP handle or clbk_st->clbk_recv_func == NULL
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if a callback is already set, handle sends on channels or
+ *                 receives large or reliable messages
+ * @return ENOMEM - if failed to allocate the receive buffer
  * @return EPERM if library didn't finish init
- * @return errno codes of native socket function
- * @return errno codes of native connect function
+ * @return errno codes of native epoll_ctl function
  */
 int
-comm_lib_tcp_client_non_blocking_start(
-    const struct connection_info const *conn_info,
-    struct register_to_new_handle *clbk_st, struct timeval *tval)
+comm_lib_recv_callback_set(handle_t handle,
+                           const struct register_to_recv *clbk_st)
 {
-    int err = 0, err2 = 0;
-    int sock_fd = INVALID_HANDLE_ID;
-    pthread_t connect_thread = 0;
-    pthread_attr_t attr;
-    int is_attr_init = 0;
-    struct connect_thread_args *args = NULL;
+    int err = 0;
+    int is_locked = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct handle_reactor *handle_reactor = NULL;
+    struct rx_callback *rx_callback = NULL;
+    uint32_t buffer_size = 0;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    lib_commu_bail_null(conn_info);
-    lib_commu_bail_null(clbk_st);
-
-    /*
-     * AF_INET - IPv4 Internet protocols.
-     * SOCK_STREAM - Supports TCP.
-     * SOCK_NONBLOCK -
-     */
-    sock_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock_fd < 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Socket creation failed err(%u): %s", errno,
-                strerror(errno));
-        lib_commu_bail_force(errno);
+    if ((clbk_st != NULL) && (clbk_st->clbk_recv_func == NULL)) {
+        lib_commu_bail_force(EINVAL);
     }
 
-    /* enlarge soeckt send/recv buffer to max tcp jumbo size */
-    err = set_sock_buffer_size(sock_fd);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    /* set priority on socket */
-    err = set_sock_priority(sock_fd);
-    lib_commu_bail_error(err);
+    if ((handle_db_type != TCP_CLIENT_HANDLE_DB) &&
+        (handle_db_type != TCP_SERVER_HANDLE_DB) &&
+        (handle_db_type != UDP_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a TCP or UDP handle\n",
+                handle);
+        lib_commu_bail_force(EINVAL);
+    }
 
-    args = (struct connect_thread_args *) malloc(
-        sizeof(struct connect_thread_args));
-    lib_commu_bail_null(args);
+    if (clbk_st == NULL) {
+        rx_callback_stop(handle_info_st);
+        goto bail;
+    }
 
-    args->client_fd = sock_fd;
-    memcpy(&(args->conn_info), conn_info, sizeof(*conn_info));
-    args->clbk_st.clbk_notify_func = clbk_st->clbk_notify_func;
-    args->clbk_st.data = clbk_st->data;
-    args->use_tval = 0;
-    if (tval != NULL) {
-        memcpy(&(args->tval), tval, sizeof(*tval));
-        args->use_tval = 1;
+    /* the reactor can't wait on shm rings */
+    if (handle_info_st->shm_link != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] is a shm session\n", handle);
+        lib_commu_bail_force(EOPNOTSUPP);
     }
 
-    /* set thread attributs */
-    err = pthread_attr_init(&attr);
-    if (err != 0) {
+    buffer_size = (handle_db_type == UDP_HANDLE_DB) ?
+                  (UDP_BATCH_MSGS * MAX_UDP_PAYLOAD) : RX_STREAM_BUFFER_SIZE;
+    rx_callback = (struct rx_callback *)calloc(1, sizeof(*rx_callback) +
+                                               buffer_size);
+    if (rx_callback == NULL) {
         LCM_LOG(LCOMMU_LOG_ERROR,
-                "Failed to init ptheard attribute(%u):\n", err);
-        safe_free(args);
-        lib_commu_bail_force(err);
+                "Failed to allocate receive callback of handle[%d]\n", handle);
+        lib_commu_bail_force(ENOMEM);
     }
-    is_attr_init = 1;
 
-    err = pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-    if (err != 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Failed to set detach state on attribute attribute(%u):\n",
-                err);
-        safe_free(args);
-        lib_commu_bail_force(err);
+    rx_callback->handle = handle;
+    rx_callback->handle_info_st = handle_info_st;
+    rx_callback->db_type = handle_db_type;
+    rx_callback->clbk_st = *clbk_st;
+
+    err = pthread_mutex_lock(&lock_rx_mode_alloc);
+    lib_commu_bail_error(err);
+    is_locked = 1;
+
+    if (handle_info_st->rx_callback != NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] has a receive callback\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
     }
 
-    err = pthread_create(&connect_thread, &attr, client_connect_thread, args);
-    if (err != 0) {
+    /* the channel receivers parse the stream, and the large or the reliable
+     * message receivers parse the datagrams */
+    if ((handle_info_st->tcp_channels != NULL) ||
+        (handle_info_st->udp_reassembly != NULL) ||
+        (handle_info_st->udp_reliable != NULL)) {
         LCM_LOG(LCOMMU_LOG_ERROR,
-                "Failed to create client connect thread err(%u):\n", err);
-        safe_free(args);
+                "handle[%d] sends on channels or receives large or reliable messages\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    err = handle_reactor_get(handle, handle_info_st, &handle_reactor);
+    lib_commu_bail_error(err);
+
+    /* published before the first event may stop it */
+    __atomic_store_n(&handle_info_st->rx_callback, rx_callback,
+                     __ATOMIC_RELEASE);
+    pthread_mutex_lock(&handle_reactor->lock);
+    handle_reactor->rx_callback = rx_callback;
+    handle_reactor->events |= EPOLLIN;
+    err = handle_reactor_arm(handle_reactor);
+    if (err) {
+        handle_reactor->rx_callback = NULL;
+        handle_reactor->events &= ~EPOLLIN;
+    }
+    pthread_mutex_unlock(&handle_reactor->lock);
+    if (err) {
+        __atomic_store_n(&handle_info_st->rx_callback, NULL, __ATOMIC_RELEASE);
         lib_commu_bail_force(err);
     }
+    rx_callback = NULL;
 
 bail:
-    if (err && (sock_fd != INVALID_HANDLE_ID)) {
-        close_socket_wrapper(sock_fd);
+    if (is_locked) {
+        pthread_mutex_unlock(&lock_rx_mode_alloc);
     }
-    if (is_attr_init) {
-        err2 = pthread_attr_destroy(&attr);
-        if (err2) {
-            LCM_LOG(LCOMMU_LOG_ERROR,
-                    "Failed to destroy ptheard attribute(%u):\n", err2);
-        }
+    if (rx_callback != NULL) {
+        rx_callback_free(rx_callback);
     }
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
+
 /**
- * close a TCP connection between two peers.
- * Can be used from server/client side
+ * Deliver the messages of a UDP connection in order and without loss.
+ * Messages sent by comm_lib_udp_reliable_send carry a sequence number per
+ * peer; the reactor threads receive them, ack them with selective acks and
+ * queue them in order for comm_lib_udp_reliable_recv. A message not acked
+ * within the retransmission timeout (measured per peer) is retransmitted.
+ * Once a message was retransmitted UDP_RELIABLE_RETRIES_MAX times the peer
+ * fails on both ends: the messages not acked are given up and the sends to
+ * it fail, the receiver gets the messages received in order and then
+ * ECONNRESET in place of the rest. Its later messages are dropped until
+ * the sender forgot the peer, a message isn't skipped silently.
+ * At most UDP_RELIABLE_WINDOW messages to a peer are not acked at a time,
+ * and the acks stop while the delivery queue is full, so a slow receiver
+ * blocks its senders. A peer which restarted is detected by its magic.
+ * A peer nothing was sent to or received from for
+ * UDP_RELIABLE_PEER_IDLE_MSEC, and with no message in flight, is forgotten;
+ * the next message starts a new sequence. Both ends set it. Then
+ * comm_lib_udp_recv, comm_lib_udp_recv_batch, comm_lib_udp_large_recv and
+ * comm_lib_recv_callback_set fail on the handle.
  *
- * @param[in] handle
- * @param[in,out] None
- * @param[out] None
+ * @param[in] handle - the udp handle
+ * @param[in] is_enabled - 1 to deliver reliably, 0 to drop the peers and
+ *                         the messages not delivered
  *
  * @return 0 if operation completes successfully
- * @return EPERM - handle haven't create by library TCP API[s]
+ * @return EINVAL - if handle isn't a UDP handle
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 large messages
+ * @return ENOMEM - if failed to allocate the peers table
  * @return EPERM if library didn't finish init
+ * @return errno codes of native epoll_ctl/timerfd_create functions
  */
 int
-comm_lib_tcp_peer_stop(handle_t handle)
+comm_lib_udp_reliable_set(handle_t handle, int is_enabled)
 {
     int err = 0;
+    int is_locked = 0;
+    int is_linked = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    struct udp_reliable *udp_reliable = NULL;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    /* close the socket resource */
-    err = close_socket_wrapper(handle);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    /* delete handle DB resource */
-    err = lib_commu_db_tcp_handle_info_delete(handle);
+    if (handle_db_type != UDP_HANDLE_DB) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't a UDP handle\n", handle);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    if (!is_enabled) {
+        udp_reliable_stop(handle_info_st);
+        goto bail;
+    }
+
+    err = pthread_mutex_lock(&lock_rx_mode_alloc);
+    lib_commu_bail_error(err);
+    is_locked = 1;
+
+    if (handle_info_st->udp_reliable != NULL) {
+        goto bail;
+    }
+
+    /* the callback, or the large message receivers, receive the datagrams */
+    if ((handle_info_st->rx_callback != NULL) ||
+        (handle_info_st->udp_reassembly != NULL)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "handle[%d] has a receive callback or receives large messages\n",
+                handle);
+        lib_commu_bail_force(EBUSY);
+    }
+
+    udp_reliable = (struct udp_reliable *)calloc(1, sizeof(*udp_reliable) +
+                                                 UDP_RELIABLE_HASH_SIZE *
+                                                 sizeof(udp_reliable->hash[0]) +
+                                                 UDP_BATCH_MSGS *
+                                                 MAX_UDP_MSG_SIZE);
+    if (udp_reliable == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to allocate reliable peers of handle[%d]\n", handle);
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    pthread_mutex_init(&udp_reliable->lock, NULL);
+    pthread_cond_init(&udp_reliable->tx_cond, NULL);
+    pthread_cond_init(&udp_reliable->rx_cond, NULL);
+    pthread_cond_init(&udp_reliable->released_cond, NULL);
+    udp_reliable->buffer =
+        (uint8_t *)&udp_reliable->hash[UDP_RELIABLE_HASH_SIZE];
+    udp_reliable->handle = handle;
+    udp_reliable->handle_info_st = handle_info_st;
+    /* the peers don't take the sequences of a previous setting as newer */
+    udp_reliable->epoch_next = (uint32_t)(time_ns_get() / 1000000);
+    udp_reliable->item.fd = handle;
+    udp_reliable->item.handler = udp_reliable_handler;
+    udp_reliable->item.release = udp_reliable_release;
+    udp_reliable->item.ctx = udp_reliable;
+
+    pthread_mutex_lock(&lock_reliable);
+    err = udp_reliable_timer_open();
+    if (err == 0) {
+        udp_reliable->next = reliable_list;
+        if (reliable_list != NULL) {
+            reliable_list->prev = udp_reliable;
+        }
+        reliable_list = udp_reliable;
+        is_linked = 1;
+    }
+    pthread_mutex_unlock(&lock_reliable);
     lib_commu_bail_error(err);
 
+    /* published before the first datagram is handled */
+    __atomic_store_n(&handle_info_st->udp_reliable, udp_reliable,
+                     __ATOMIC_RELEASE);
+    err = lib_commu_reactor_item_add(&udp_reliable->item, EPOLLIN,
+                                     REACTOR_ANY_THREAD);
+    if (err) {
+        __atomic_store_n(&handle_info_st->udp_reliable, NULL,
+                         __ATOMIC_RELEASE);
+        lib_commu_bail_force(err);
+    }
+    udp_reliable = NULL;
 
 bail:
+    if (is_locked) {
+        pthread_mutex_unlock(&lock_rx_mode_alloc);
+    }
+    if (udp_reliable != NULL) {
+        if (is_linked) {
+            udp_reliable_unlink(udp_reliable);
+        }
+        udp_reliable_free(udp_reliable);
+    }
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
-
 /**
- * send the payload as stream of bytes over TCP connection
- * Can be used from server/clients side. blocking until all payload is sent.
+ * Send a message to a peer of a reliable UDP connection, blocking while
+ * UDP_RELIABLE_WINDOW messages to the peer are not acked.
+ * Returns once the message was sent, it's retransmitted until acked.
  *
- * @param[in] payload - the data to pass.
- * @param[in,out] payload_len - size of payload
- * @param[out] None
+ * @param[in] handle - the handle to send data.
+ * @param[in] recipient_st - the information of the recipient (address and port)
+ * @param[in] payload - data to send.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes sent.
  *
  * @return 0 if operation completes successfully
- * @return EOVERFLOW - if payload_len exceeds MAX TCP SIZE message
- * @return EINVAL or ENOKEY- if handle doesn't exist in library DB
- * @return EIO - if could not sent all buffer (after 3 retries)
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0,
+ *                or reliable delivery isn't set on handle
+ * @return EOVERFLOW if payload_len > MAX_UDP_RELIABLE_PAYLOAD
+ * @return ENOKEY if handle wasn't found.
+ * @return ETIMEDOUT if messages to the peer were given up and it wasn't
+ *                   forgotten since, the message wasn't sent
+ * @return ECANCELED if reliable delivery was turned off meanwhile
+ * @return ENOBUFS if the handle has UDP_RELIABLE_PEERS_MAX peers not idle
+ * @return ENOMEM if failed to allocate the peer or the message
  * @return EPERM if library didn't finish init
- * @return errno codes of native send function
+ * @return errno codes of native sendmsg function
  */
 int
-comm_lib_tcp_send_blocking(handle_t handle, uint8_t *payload,
-                           uint32_t *payload_len)
+comm_lib_udp_reliable_send(handle_t handle, struct addr_info recipient_st,
+                           uint8_t *payload, uint32_t *payload_len)
 {
     int err = 0;
-
-    struct msg_metadata metadata_st;
+    int is_locked = 0;
+    int is_user = 0;
     struct handle_info *handle_info_st = NULL;
-    enum db_type handle_db_type = ANY_HANLDE_DB;
-    uint32_t metadata_len = sizeof(metadata_st);
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    struct udp_reliable *udp_reliable = NULL;
+    struct udp_reliable_peer *peer = NULL;
+    struct udp_reliable_msg *msg = NULL;
+    struct msg_metadata metadata_st;
+    struct msg_reliable reliable_st;
+    struct iovec iov;
+    uint8_t *buffer = NULL;
+    uint32_t buffer_len = 0;
+
+    memset(&metadata_st, 0, sizeof(metadata_st));
+    memset(&reliable_st, 0, sizeof(reliable_st));
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
@@ -2258,152 +10144,224 @@ comm_lib_tcp_send_blocking(handle_t handle, uint8_t *payload,
     lib_commu_bail_null(payload);
     lib_commu_bail_null(payload_len);
 
-    if (*payload_len > (MAX_JUMBO_TCP_PAYLOAD - sizeof(metadata_st))) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n", *payload_len);
+    if (*payload_len == 0) {
+        lib_commu_bail_force(EINVAL);
+    }
+
+    if (*payload_len > MAX_UDP_RELIABLE_PAYLOAD) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                *payload_len);
         lib_commu_bail_force(EOVERFLOW);
     }
 
-    memset((char*) &metadata_st, 0, sizeof(metadata_st));
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+
+    udp_reliable = __atomic_load_n(&handle_info_st->udp_reliable,
+                                   __ATOMIC_ACQUIRE);
+    if (udp_reliable == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't reliable\n", handle);
+        lib_commu_bail_force(EINVAL);
+    }
 
-    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st,
-                                       &handle_db_type,
-                                       NULL);
+    /* the datagram is kept for retransmissions until acked */
+    buffer_len = sizeof(metadata_st) + sizeof(reliable_st) + *payload_len;
+    err = lib_commu_pool_buffer_get(sizeof(*msg) + buffer_len, &buffer);
     lib_commu_bail_error(err);
+    msg = (struct udp_reliable_msg *)buffer;
+    memset(msg, 0, sizeof(*msg));
+    msg->len = buffer_len;
 
-    err =
-        metadata_set(&metadata_st, MSG_VERSION, *payload_len, *handle_info_st);
+    err = metadata_set(&metadata_st, MSG_RELIABLE_VERSION,
+                       sizeof(reliable_st) + *payload_len, *handle_info_st);
     lib_commu_bail_error(err);
+    memcpy(msg->data, &metadata_st, sizeof(metadata_st));
+    memcpy(msg->data + sizeof(metadata_st) + sizeof(reliable_st), payload,
+           *payload_len);
 
+    pthread_mutex_lock(&udp_reliable->lock);
+    is_locked = 1;
 
-    /* sending the metadata */
-    err = comm_lib_tcp_ll_send_blocking(handle, (uint8_t*) &metadata_st,
-                                        &metadata_len, handle_db_type);
+    err = udp_reliable_peer_get(udp_reliable, recipient_st.ipv4_addr,
+                                recipient_st.port, 1, &peer);
     lib_commu_bail_error(err);
 
-    /* sending the payload */
-    err = comm_lib_tcp_ll_send_blocking(handle, payload, payload_len,
-                                        handle_db_type);
-    lib_commu_bail_error(err);
+    udp_reliable->users_num++;
+    peer->users_num++;
+    is_user = 1;
+    while (!udp_reliable->is_stopped && (peer->err == 0) &&
+           (peer->tx_seq - peer->tx_acked >= UDP_RELIABLE_WINDOW)) {
+        pthread_cond_wait(&udp_reliable->tx_cond, &udp_reliable->lock);
+    }
+
+    if (udp_reliable->is_stopped) {
+        lib_commu_bail_force(ECANCELED);
+    }
+
+    if (peer->err) {
+        lib_commu_bail_force(peer->err);
+    }
+
+    reliable_st.type = UDP_RELIABLE_DATA;
+    reliable_st.seq = htonl(peer->tx_seq);
+    reliable_st.ack_seq = htonl(peer->tx_acked);
+    reliable_st.epoch = htonl(peer->tx_epoch);
+    memcpy(msg->data + sizeof(metadata_st), &reliable_st,
+           sizeof(reliable_st));
+    msg->seq = peer->tx_seq;
+    msg->sent_ns = time_ns_get();
+
+    iov.iov_base = msg->data;
+    iov.iov_len = msg->len;
+    err = comm_lib_udp_ll_send(handle, recipient_st, &iov, 1, &buffer_len);
+    if (err && (err != EAGAIN) && (err != ENOBUFS) && (err != ENOMEM)) {
+        goto bail;
+    }
+
+    /* a datagram the socket didn't take is retransmitted by the timer */
+    err = 0;
+    peer->tx_msgs[peer->tx_seq % UDP_RELIABLE_WINDOW] = msg;
+    peer->tx_seq++;
+    peer->last_ns = msg->sent_ns;
+    buffer = NULL;
 
 bail:
+    if (is_user) {
+        peer->users_num--;
+        udp_reliable->users_num--;
+        if (udp_reliable->is_stopped && (udp_reliable->users_num == 0)) {
+            pthread_cond_broadcast(&udp_reliable->released_cond);
+        }
+    }
+    if (is_locked) {
+        pthread_mutex_unlock(&udp_reliable->lock);
+    }
+    if (buffer != NULL) {
+        (void)lib_commu_pool_buffer_put(buffer);
+    }
+    if (err && (payload_len != NULL)) {
+        *payload_len = 0;
+    }
+    handle_msgs_stats_update(handle, 0, (err == 0) ? 1 : 0, err);
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
 
 /**
- * Receive the messages as stream of bytes over TCP connection
- * Can be used from server/clients side. blocking until at least one message is received.
- * payload_data->msg_num_recv > 0 when got message
- * if payload_data->jumbo_payload_len > 0 --> the message received on payload_data->jumbo_payload
+ * Receive the next message of a reliable UDP connection, blocking until
+ * one is delivered. The messages of each peer are received in the order
+ * they were sent, a failed peer is received as ECONNRESET after the last
+ * message it delivered.
  *
- * @param[in] max_msgs_to_recv - the maximum messages to receive (1-MAX_MSGS)
- * @param[in,out] addresser_st - server address, port.
- * @param[in,out] recv_payload_data_t - the data structure which contains parsed messages payloads must be initalize.
- * @param[out] - None
+ * @param[in] handle - the handle to receive the data
+ * @param[out] addresser_st - the information of the addresser (address and port)
+ * @param[out] payload - data received.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes received.
  *
  * @return 0 if operation completes successfully
- * @return EINVAL - if conn_info == NULL or payload_data == NULL or max_msgs_to_recv == 0 or handle type != TCP type
- * @return ECONNRESET or ENOTCONN - if connection on handle have been reset by peer i.e socket not active
- * @return EBADE - if msg type received on socket is invalid or peer magic is invalid
- * @return EOVERFLOW - if message size > MAX_TCP_PAYLOAD or meesage size = 0
- * @return EPERM - if max_msgs_to_recv > 1, currently the API supports one message each time
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0,
+ *                or reliable delivery isn't set on handle
+ * @return EOVERFLOW if payload_len is insufficient, the message is dropped.
+ * @return ENOKEY if handle wasn't found.
+ * @return ECONNRESET if the peer filled in addresser_st gave up messages
+ *                    to the handle, its next ones weren't received
+ * @return ECANCELED if reliable delivery was turned off meanwhile
  * @return EPERM if library didn't finish init
  */
 int
-comm_lib_tcp_recv_blocking(handle_t handle, struct addr_info *addresser_st,
-                           struct recv_payload_data *payload_data,
-                           uint32_t max_msgs_to_recv)
+comm_lib_udp_reliable_recv(handle_t handle, struct addr_info *addresser_st,
+                           uint8_t *payload, uint32_t *payload_len)
 {
     int err = 0;
-
-    struct msg_metadata metadata_st;
-    uint32_t metadata_len = sizeof(metadata_st);
-    uint32_t payload_len = 0;
+    int is_locked = 0;
+    int is_user = 0;
     struct handle_info *handle_info_st = NULL;
-    enum db_type handle_db_type = ANY_HANLDE_DB;
-
-    memset(&metadata_st, 0, sizeof(metadata_st));
+    enum db_type handle_db_type = UDP_HANDLE_DB;
+    struct udp_reliable *udp_reliable = NULL;
+    struct udp_reliable_msg *msg = NULL;
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
         lib_commu_bail_force(EPERM);
     }
 
-    /* 1. input validations start*/
+    lib_commu_bail_null(payload);
+    lib_commu_bail_null(payload_len);
     lib_commu_bail_null(addresser_st);
-    lib_commu_bail_null(payload_data);
-
-    payload_data->msg_num_recv = 0;
-    memset(payload_data->payload_len, 0, sizeof(payload_data->payload_len));
-    payload_data->jumbo_payload_len = 0;
 
-    if (max_msgs_to_recv == 0) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [max_msgs_to_recv]\n");
+    if (*payload_len == 0) {
         lib_commu_bail_force(EINVAL);
     }
 
-    if (max_msgs_to_recv > 1) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Unsupported parameter [max_msgs_to_recv > 1]\n");
-        lib_commu_bail_force(EPERM);
-    }
-
-    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st,
-                                       &handle_db_type,
-                                       NULL);
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    if ((handle_db_type != TCP_CLIENT_HANDLE_DB)
-        && (handle_db_type != TCP_SERVER_HANDLE_DB)) {
-        LCM_LOG(LCOMMU_LOG_ERROR,
-                "Invalid handle type[%d]\n", handle_db_type);
+    udp_reliable = __atomic_load_n(&handle_info_st->udp_reliable,
+                                   __ATOMIC_ACQUIRE);
+    if (udp_reliable == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] isn't reliable\n", handle);
         lib_commu_bail_force(EINVAL);
     }
-    /*input validations end*/
-
-
-    addresser_st->ipv4_addr = handle_info_st->conn_info.d_ipv4_addr;
-    addresser_st->port = handle_info_st->conn_info.d_port;
 
-    /* 2. recv the metadata and validate*/
-    err = comm_lib_tcp_ll_recv_blocking(handle, (uint8_t*) &metadata_st,
-                                        &metadata_len);
-    lib_commu_bail_error(err);
+    pthread_mutex_lock(&udp_reliable->lock);
+    is_locked = 1;
 
-    if (metadata_len < sizeof(metadata_st)) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "metadata incomplete\n");
-        lib_commu_bail_force(EIO);
+    udp_reliable->users_num++;
+    is_user = 1;
+    while (!udp_reliable->is_stopped && (udp_reliable->rx_head == NULL)) {
+        pthread_cond_wait(&udp_reliable->rx_cond, &udp_reliable->lock);
     }
 
-    err = validate_metadata_info(&metadata_st, MAX_JUMBO_TCP_PAYLOAD,
-                                 handle_info_st);
-    lib_commu_bail_error(err);
-    /*recv the metadata and validate end*/
-
-    /* 3. get the message */
-    payload_len = metadata_st.payload_size;
-    if (metadata_st.payload_size <= MAX_TCP_PAYLOAD) {
-        err = comm_lib_tcp_ll_recv_blocking(handle, payload_data->payload[0],
-                                            &payload_len);
-        lib_commu_bail_error(err);
-
-        payload_data->payload_len[0] = payload_len;
-        payload_data->msg_type[0] = metadata_st.msg_type;
+    if (udp_reliable->is_stopped) {
+        lib_commu_bail_force(ECANCELED);
     }
-    else {
-        err = comm_lib_tcp_ll_recv_blocking(handle,
-                                            payload_data->jumbo_payload,
-                                            &payload_len);
-        lib_commu_bail_error(err);
 
-        payload_data->jumbo_payload_len = payload_len;
-        payload_data->jumbo_msg_type = metadata_st.msg_type;
+    msg = udp_reliable->rx_head;
+    udp_reliable->rx_head = msg->next;
+    if (udp_reliable->rx_head == NULL) {
+        udp_reliable->rx_tail = NULL;
     }
+    udp_reliable->rx_msgs_num--;
 
-    payload_data->msg_num_recv++;
-
+    /* the peers blocked on a full queue are acked again */
+    udp_reliable_blocked_deliver(udp_reliable, handle_info_st);
 
 bail:
+    if (is_user) {
+        udp_reliable->users_num--;
+        if (udp_reliable->is_stopped && (udp_reliable->users_num == 0)) {
+            pthread_cond_broadcast(&udp_reliable->released_cond);
+        }
+    }
+    if (is_locked) {
+        pthread_mutex_unlock(&udp_reliable->lock);
+    }
+    if (msg != NULL) {
+        if (msg->err) {
+            err = msg->err;
+            addresser_st->ipv4_addr = msg->ipv4_addr;
+            addresser_st->port = msg->port;
+        }
+        else if (msg->len > *payload_len) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Invalid payload size [%u]\n",
+                    msg->len);
+            err = EOVERFLOW;
+        }
+        else {
+            memcpy(payload, msg->data, msg->len);
+            *payload_len = msg->len;
+            addresser_st->ipv4_addr = msg->ipv4_addr;
+            addresser_st->port = msg->port;
+        }
+        (void)lib_commu_pool_buffer_put((uint8_t *)msg);
+    }
+    if (err && (payload_len != NULL)) {
+        *payload_len = 0;
+    }
+    lib_commu_db_handle_info_release(handle_info_st);
     return -err;
 }
 
@@ -2412,19 +10370,17 @@ bail:
  * Get the server status.
  *
  * @param[in] server_id - the id of the server.
- * @param[in,out] server_status.
- * @param[out] None.
+ * @param[out] server_status - filled with the server status, owned by the caller.
  *
  *
  * @return 0 if operation completes successfully
  * @return EINVAL if server_status == NULL
- * @return ENOKEY if server_id is out of bound.
+ * @return ENOKEY if server_id is out of bound or the server was never started.
  * @return EPERM if library didn't finish init
  */
 int
-comm_lib_tcp_server_status_get(
-    const struct server_status const **server_status,
-    uint16_t server_id)
+comm_lib_tcp_server_status_get(struct server_status *server_status,
+                               uint16_t server_id)
 {
     int err = 0;
 
@@ -2445,6 +10401,43 @@ bail:
 
 
 
+/**
+ * Get the status of the clients connected to the server, page by page.
+ * Clients are returned in the server table order, so a client accepted or
+ * closed between calls may shift the following pages.
+ *
+ * @param[in] server_id - the id of the server
+ * @param[in] offset - #clients to skip
+ * @param[in,out] status_arr - filled with the clients status
+ * @param[in,out] status_num - size of status_arr, updated to #clients filled
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if status_arr == NULL or status_num == NULL
+ * @return ENOKEY if server_id is out of bound.
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_server_clients_status_get(uint16_t server_id, uint32_t offset,
+                                       struct connection_status *status_arr,
+                                       uint32_t *status_num)
+{
+    int err = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    err = lib_commu_db_tcp_server_clients_status_get(server_id, offset,
+                                                     status_arr, status_num);
+    lib_commu_bail_error(err);
+
+bail:
+    return -err;
+}
+
+
+
 /**
  * Get the connection status by the handle given
  *
@@ -2465,13 +10458,18 @@ int
 comm_lib_tcp_handle_status_get(struct connection_status *connection_status)
 {
     int err = 0;
-    struct sockaddr_in peer_addr;
+    struct sockaddr_storage peer_addr;
     socklen_t peer_addr_len = sizeof(peer_addr);
-    struct sockaddr_in local_addr;
+    struct sockaddr_storage local_addr;
     socklen_t local_addr_len = sizeof(local_addr);
+    struct addr_info addr_info_st;
+    struct lib_commu_shm_link *shm_link = NULL;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
 
     memset(&peer_addr, 0, sizeof(peer_addr));
     memset(&local_addr, 0, sizeof(local_addr));
+    memset(&addr_info_st, 0, sizeof(addr_info_st));
 
     if (!g_lib_commu_init_done) {
         LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
@@ -2486,6 +10484,19 @@ comm_lib_tcp_handle_status_get(struct connection_status *connection_status)
 
     /* TODO - can add another verification and look for the handle in library DB */
 
+    shm_link = handle_shm_link_get(connection_status->handle);
+    if (shm_link != NULL) {
+        /* shm sessions have no socket, both peers are local */
+        connection_status->handle_status =
+            lib_commu_shm_link_is_peer_closed(shm_link) ?
+            HANDLE_STATUS_DOWN : HANDLE_STATUS_UP;
+        connection_status->peer_ipv4_addr = htonl(INADDR_LOOPBACK);
+        connection_status->peer_port = 0;
+        connection_status->local_ipv4_addr = htonl(INADDR_LOOPBACK);
+        connection_status->local_port = 0;
+        goto stats;
+    }
+
     err = getpeername(connection_status->handle,
                       (struct sockaddr *) &peer_addr,
                       &peer_addr_len);
@@ -2503,8 +10514,9 @@ comm_lib_tcp_handle_status_get(struct connection_status *connection_status)
     }
 
     connection_status->handle_status = HANDLE_STATUS_UP;
-    connection_status->peer_ipv4_addr = peer_addr.sin_addr.s_addr;
-    connection_status->peer_port = peer_addr.sin_port;
+    stream_sockaddr_addr_info_get(&peer_addr, &addr_info_st);
+    connection_status->peer_ipv4_addr = addr_info_st.ipv4_addr;
+    connection_status->peer_port = addr_info_st.port;
 
     if (getsockname(connection_status->handle, (struct sockaddr*) &local_addr,
                     &local_addr_len) < 0) {
@@ -2513,9 +10525,246 @@ comm_lib_tcp_handle_status_get(struct connection_status *connection_status)
         lib_commu_bail_force(errno);
     }
 
-    connection_status->local_ipv4_addr = local_addr.sin_addr.s_addr;
-    connection_status->local_port = local_addr.sin_port;
+    stream_sockaddr_addr_info_get(&local_addr, &addr_info_st);
+    connection_status->local_ipv4_addr = addr_info_st.ipv4_addr;
+    connection_status->local_port = addr_info_st.port;
+
+stats:
+    /* handles which are not in library DB have no counters */
+    memset(&connection_status->stats, 0, sizeof(connection_status->stats));
+    handle_db_type = ANY_HANLDE_DB;
+    if (lib_commu_db_hanlde_info_get(connection_status->handle,
+                                     &handle_info_st, &handle_db_type,
+                                     NULL) == 0) {
+        (void)lib_commu_db_handle_stats_get(connection_status->handle,
+                                            &connection_status->stats);
+    }
+
+bail:
+    return err;
+}
+
+
+/**
+ * Trace the messages sent on a handle (TCP or UDP) with MSG_TRACE_VERSION
+ * metadata, a sequence number and the send time. With MSG_TRACE_ON_PEER
+ * only once a traced message was received, the latency is recorded for same
+ * host peers only.
+ *
+ * @param[in] handle - the handle
+ * @param[in] mode - when the messages sent are traced, MSG_TRACE_OFF to stop
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if mode is invalid
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_msg_trace_set(handle_t handle, enum msg_trace_mode mode)
+{
+    int err = 0;
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    if ((mode != MSG_TRACE_OFF) && (mode != MSG_TRACE_ON_PEER) &&
+        (mode != MSG_TRACE_ALWAYS)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid trace mode[%d]\n", mode);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
+
+    /* the sequence goes on, so the receivers see no gap when it's resumed */
+    __atomic_store_n(&handle_info_st->trace_mode, mode, __ATOMIC_RELAXED);
+
+bail:
+    lib_commu_db_handle_info_release(handle_info_st);
+    return -err;
+}
+
+
+/**
+ * Get the traffic counters of a handle (TCP or UDP).
+ *
+ * @param[in] handle - the handle.
+ * @param[in,out] stats - the handle counters.
+ * @param[out] None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if stats == NULL
+ * @return ENOKEY - if handle wasn't found
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_stats_get(handle_t handle, struct handle_stats *stats)
+{
+    int err = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(stats);
+
+    err = lib_commu_db_handle_stats_get(handle, stats);
+    lib_commu_bail_error(err);
+
+bail:
+    return -err;
+}
+
+
+/**
+ * Get the histograms of a handle (TCP or UDP).
+ *
+ * @param[in] handle - the handle.
+ * @param[in,out] hists - the handle histograms.
+ * @param[out] None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if hists == NULL
+ * @return ENOKEY - if handle wasn't found
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_stats_histograms_get(handle_t handle,
+                              struct handle_histograms *hists)
+{
+    int err = 0;
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(hists);
+
+    err = lib_commu_db_handle_histograms_get(handle, hists);
+    lib_commu_bail_error(err);
+
+bail:
+    return -err;
+}
+
+
+static int
+stats_dump_append(char *buffer, uint32_t buffer_len, uint32_t *offset,
+                  const char *format, ...)
+{
+    int err = 0;
+    int len = 0;
+    va_list args;
+
+    if (*offset >= buffer_len) {
+        lib_commu_bail_force(EOVERFLOW);
+    }
+
+    va_start(args, format);
+    len = vsnprintf(buffer + *offset, buffer_len - *offset, format, args);
+    va_end(args);
+
+    if (len < 0) {
+        lib_commu_bail_force(EIO);
+    }
+    if ((uint32_t)len >= buffer_len - *offset) {
+        *offset = buffer_len;
+        lib_commu_bail_force(EOVERFLOW);
+    }
+    *offset += len;
 
 bail:
     return err;
 }
+
+
+/**
+ * Dump the counters and the non empty histogram buckets of a handle
+ * as text.
+ *
+ * @param[in] handle - the handle.
+ * @param[in,out] buffer - the text, always NULL terminated.
+ * @param[in] buffer_len - size of buffer.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if buffer == NULL or buffer_len == 0
+ * @return ENOKEY - if handle wasn't found
+ * @return EOVERFLOW - if the text was truncated to buffer_len
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_stats_dump(handle_t handle, char *buffer, uint32_t buffer_len)
+{
+    static const char *hist_names[HANDLE_HIST_NUM] = {
+        "tx_time_ns", "rx_time_ns", "tx_size", "rx_size", "retries",
+        "rx_latency_ns"
+    };
+    int err = 0;
+    uint32_t offset = 0;
+    uint32_t i = 0, j = 0;
+    struct handle_stats stats;
+    struct handle_histograms hists;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&hists, 0, sizeof(hists));
+
+    if (!g_lib_commu_init_done) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "%s\n", INIT_ERR_MSG);
+        lib_commu_bail_force(EPERM);
+    }
+
+    lib_commu_bail_null(buffer);
+    if (buffer_len == 0) {
+        lib_commu_bail_force(EINVAL);
+    }
+    buffer[0] = '\0';
+
+    err = lib_commu_db_handle_stats_get(handle, &stats);
+    lib_commu_bail_error(err);
+
+    err = lib_commu_db_handle_histograms_get(handle, &hists);
+    lib_commu_bail_error(err);
+
+    err = stats_dump_append(buffer, buffer_len, &offset,
+                            "handle %d rx_bytes %llu tx_bytes %llu rx_msgs %llu "
+                            "tx_msgs %llu rx_errors %llu tx_errors %llu "
+                            "retries %llu zerocopy_sends %llu "
+                            "zerocopy_copied %llu rx_gaps %llu "
+                            "rx_reorders %llu rx_clock_skews %llu\n", handle,
+                            stats.rx_bytes, stats.tx_bytes, stats.rx_msgs,
+                            stats.tx_msgs, stats.rx_errors, stats.tx_errors,
+                            stats.retries, stats.zerocopy_sends,
+                            stats.zerocopy_copied, stats.rx_gaps,
+                            stats.rx_reorders, stats.rx_clock_skews);
+    lib_commu_bail_error(err);
+
+    for (i = 0; i < HANDLE_HIST_NUM; i++) {
+        err = stats_dump_append(buffer, buffer_len, &offset,
+                                "%s count %llu sum %llu buckets", hist_names[i],
+                                hists.hist[i].count, hists.hist[i].sum);
+        lib_commu_bail_error(err);
+
+        for (j = 0; j < HANDLE_HIST_BUCKETS_NUM; j++) {
+            if (hists.hist[i].buckets[j] == 0) {
+                continue;
+            }
+            err = stats_dump_append(buffer, buffer_len, &offset, " %llu:%llu",
+                                    (j == 0) ? 0ULL : (1ULL << (j - 1)),
+                                    hists.hist[i].buckets[j]);
+            lib_commu_bail_error(err);
+        }
+
+        err = stats_dump_append(buffer, buffer_len, &offset, "\n");
+        lib_commu_bail_error(err);
+    }
+
+bail:
+    return -err;
+}
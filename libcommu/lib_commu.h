@@ -16,8 +16,13 @@
 
 #include <stdint.h>
 #include <sys/un.h>
+#include <sys/uio.h>
 #include <sys/time.h>
 #include "lib_commu_log.h"
+#ifdef LIB_COMMU_C_
+#include <sys/socket.h>
+#include "lib_commu_reactor.h"
+#endif
 
 struct addr_info {
     uint16_t port;        /**< the destination port   */
@@ -35,6 +40,37 @@ struct register_to_new_handle {
     void *data;                           /**< magic number for the callback - user defined input */
 };
 
+typedef void (*send_completion_notification)(handle_t handle,
+                                             uint8_t *payload,
+                                             uint32_t payload_len,
+                                             void *data, int rc);
+
+struct register_to_send_completion {
+    send_completion_notification clbk_send_done_func; /**< called once the message was sent (rc == 0) or failed (rc < 0) */
+    void *data;                                       /**< user defined input for the callback */
+};
+
+typedef void (*recv_notification)(handle_t handle,
+                                  struct addr_info addresser_st,
+                                  uint8_t *payload, uint32_t payload_len,
+                                  uint8_t msg_type, void *data, int rc);
+
+struct register_to_recv {
+    recv_notification clbk_recv_func; /**< called with each message received (rc == 0), the payload is valid
+                                       *   till it returns, or once the handle failed (rc < 0, payload NULL) */
+    void *data;                       /**< user defined input for the callback */
+};
+
+/**
+ * stream_transport enum is used to choose the socket family
+ * of the TCP API sessions
+ */
+enum stream_transport {
+    STREAM_TRANSPORT_TCP = 0,   /**< TCP/IP socket - the default */
+    STREAM_TRANSPORT_UNIX,      /**< UNIX domain stream socket for peers on the same host,
+                                 *   named by the port (UNIX_STREAM_SOCK_PATH), the IP is ignored */
+};
+
 /**
  * session_params structure is used to set
  * new connection with IP address and port to bind
@@ -43,6 +79,8 @@ struct session_params {
     uint16_t port;        /**< the source port - to be bound */
     uint32_t s_ipv4_addr; /**< source IPv4 - local address */
     uint16_t msg_type;    /**< the message type send on this connection   */
+    enum stream_transport transport; /**< the socket family of the server */
+    uint16_t acceptors_num; /**< #SO_REUSEPORT listeners, each on another reactor thread (0/1 - a single listener, 1-MAX_ACCEPTORS_NUM) */
 };
 
 /**
@@ -55,6 +93,7 @@ struct connection_info {
     uint32_t d_ipv4_addr; /**< destination IPv4         */
     uint16_t d_port;        /**< the destination port   */
     uint16_t msg_type;    /**< the message type send on this connection   */
+    enum stream_transport transport; /**< the socket family of the connection */
 };
 
 #ifdef LIB_COMMU_C_
@@ -74,24 +113,398 @@ struct msg_metadata {
     uint8_t version;      /**< version number   */
     uint8_t msg_type;     /**< message type to send   */
 };
+
+/**
+ * msg_chunk structure is sent after the metadata of a MSG_CHUNK_VERSION
+ * message, a chunk of a larger channel message
+ */
+struct msg_chunk {
+    uint32_t msg_len;     /**< payload size of the whole message */
+    uint32_t offset;      /**< offset of the chunk in the message payload */
+};
+
+/**
+ * msg_fragment structure is sent after the metadata of a
+ * MSG_FRAGMENT_VERSION datagram, a fragment of a large UDP message
+ */
+struct msg_fragment {
+    uint32_t msg_seq;     /**< sequence number of the message on the sending handle */
+    uint32_t msg_len;     /**< payload size of the whole message */
+    uint32_t offset;      /**< offset of the fragment in the message payload */
+};
+
+/**
+ * msg_reliable structure is sent after the metadata of a
+ * MSG_RELIABLE_VERSION datagram, a message or an ack of a reliable peer
+ */
+struct msg_reliable {
+    uint8_t type;         /**< UDP_RELIABLE_DATA, UDP_RELIABLE_ACK or UDP_RELIABLE_RESET */
+    uint32_t seq;         /**< DATA - sequence number of the message to the peer */
+    uint32_t ack_seq;     /**< DATA - oldest message not acked, all before were delivered,
+                           *   ACK - next message delivered, all before were delivered */
+    uint32_t sack_bits;   /**< ACK - bit i is set if message ack_seq + i was received */
+    uint32_t epoch;       /**< DATA, RESET - sequence of the sender, a new one once it forgot
+                           *   the peer, ACK - the sequence acked */
+};
+
+/**
+ * msg_trace structure is sent after the metadata of a MSG_TRACE_VERSION
+ * message, before its payload
+ */
+struct msg_trace {
+    uint32_t seq;           /**< sequence number of the message on the sending handle */
+    uint64_t timestamp_ns;  /**< CLOCK_MONOTONIC of the sender when the message was sent */
+};
+
+/**
+ * msg_header structure is used to keep the metadata and the trace of a
+ * message contiguous, the trace is part of the header of MSG_TRACE_VERSION only
+ */
+struct msg_header {
+    struct msg_metadata metadata;
+    struct msg_trace trace;
+};
 #pragma pack(pop)
 
 
-struct listener_thread_args {
-        int event_fd;
-        int server_id;
-        int thread_idx;
+struct listener_session;
+
+/**
+ * listener_acceptor structure is used to store
+ * one listening socket of a TCP server and its reactor items
+ */
+struct listener_acceptor {
         int listener_fd;
+        int is_listening; /**< set once listener_item was added to the reactor */
+        struct listener_session *session;
+        struct lib_commu_reactor_item listener_item; /**< accept events */
+        struct lib_commu_reactor_item event_item;    /**< exit events of the session eventfd */
+};
+
+/**
+ * listener_session structure is used to store
+ * a TCP server listener served by the reactor
+ */
+struct listener_session {
+        int event_fd;     /**< eventfd signaled on stop, polled by all the acceptors */
+        int server_id;
         struct register_to_new_handle clbk_st;
         struct session_params params;
+        uint32_t acceptors_num;
+        uint32_t started_num;  /**< #acceptors whose event_item was added */
+        uint32_t released_num; /**< #acceptors whose event_item was released */
+        int is_stopped;   /**< set by the reactor once all the listeners are closed */
+        struct listener_acceptor acceptors[]; /**< [acceptors_num] */
 };
 
-struct connect_thread_args {
+/**
+ * pending_connect structure is used to store
+ * a non blocking connect served by the reactor
+ */
+struct pending_connect {
         int client_fd;
+        int fd_flags;       /**< socket flags to restore once connected */
+        int timer_fd;       /**< timerfd of the connect timeout, INVALID_HANDLE_ID if none */
         struct connection_info conn_info;
         struct register_to_new_handle clbk_st;
-        struct timeval tval;
-        int use_tval;
+        struct lib_commu_reactor_item connect_item; /**< connect completion events */
+        struct lib_commu_reactor_item timer_item;   /**< connect timeout events */
+        uint32_t refcnt;    /**< the starting thread and the registered items */
+        int is_done;        /**< set once the user was notified */
+        struct pending_connect *prev;   /**< pending connects list, for deinit */
+        struct pending_connect *next;
+};
+
+/**
+ * tx_queue_msg structure is used to store
+ * a message queued by comm_lib_tcp_send_async
+ */
+struct tx_queue_msg {
+    struct msg_header header;       /**< the message header, ready to send */
+    uint8_t *payload;               /**< the user payload, owned by the user till completion */
+    uint32_t payload_len;           /**< size of payload */
+    struct register_to_send_completion clbk_st; /**< completion callback */
+};
+
+/**
+ * tx_queue structure is used to store the messages
+ * queued on a TCP handle. The queue is drained by the reactor thread
+ * when the socket is writable.
+ */
+struct tx_queue {
+    pthread_mutex_t lock;               /**< protects the queue, taken before handle_reactor->lock */
+    handle_t handle;                    /**< the TCP handle */
+    uint32_t head;                      /**< index of the oldest message */
+    uint32_t msgs_num;                  /**< #messages queued */
+    uint32_t head_sent;                 /**< #bytes of the oldest message already sent */
+    int err;                            /**< send error, fails queued and further messages */
+    struct tx_queue_msg msgs[];         /**< ring of MAX_TX_QUEUE_MSGS queued messages */
+};
+
+/**
+ * tcp_zerocopy structure is used to send the MSG_ZEROCOPY messages of a TCP
+ * handle. The kernel numbers the MSG_ZEROCOPY calls of a socket, the sends
+ * are serialized so each one knows the ids of its calls and waits for them.
+ */
+struct tcp_zerocopy {
+    pthread_mutex_t lock;               /**< serializes the MSG_ZEROCOPY sends, held while waiting */
+    uint32_t next_id;                   /**< completion id of the next MSG_ZEROCOPY call */
+};
+
+/**
+ * tcp_uring_send structure is used to pass the framed messages
+ * of a TCP handle to tcp_uring_sends
+ */
+struct tcp_uring_send {
+    handle_t handle;
+    int db_type;                        /**< enum db_type of the DB holding the handle */
+    struct msghdr msg;                  /**< the framed messages, its iovecs are consumed */
+    uint32_t total_len;                 /**< #bytes to send, updated to #bytes sent */
+    int err;
+};
+
+/**
+ * tcp_multi_msg structure is used to store
+ * a message of comm_lib_tcp_send_multi_blocking while it is sent
+ */
+struct tcp_multi_msg {
+    struct tcp_send_handle_msg *msg;
+    struct handle_info *handle_info_st; /**< held while the message is sent */
+    int db_type;                        /**< enum db_type of the DB holding the handle */
+    struct msg_header header_st;
+    struct iovec iov[2];
+    uint32_t total_len;
+    int is_uring;                       /**< sent by tcp_uring_sends */
+};
+
+/**
+ * tx_coalesce structure is used to gather the small messages
+ * sent on a TCP handle. The buffer is flushed once max_bytes are buffered,
+ * by comm_lib_tcp_flush, or by the reactor at the deadline of its oldest byte.
+ */
+struct tx_coalesce {
+    pthread_mutex_t lock;               /**< protects the buffer, held while flushing */
+    handle_t handle;                    /**< the TCP handle */
+    uint32_t max_bytes;                 /**< buffer size and flush threshold */
+    unsigned long long delay_ns;        /**< the longest time a byte is buffered */
+    unsigned long long deadline_ns;     /**< flush time of the buffered bytes */
+    uint32_t head;                      /**< #buffered bytes already sent */
+    uint32_t len;                       /**< #buffered bytes */
+    int err;                            /**< flush error, fails further sends */
+    struct tx_coalesce *prev;           /**< coalescing handles list, scanned by the timer */
+    struct tx_coalesce *next;
+    uint8_t buffer[];                   /**< max_bytes */
+};
+
+/**
+ * tcp_channel structure is used to store
+ * the messages of one msg_type on a TCP handle
+ */
+struct tcp_channel {
+    uint8_t priority;                   /**< 0 is the highest */
+    int is_tx_busy;                     /**< a message is being sent, its chunks must not interleave with another */
+    uint32_t rx_head;                   /**< oldest message queued, index of rx_msgs */
+    uint32_t rx_tail;                   /**< newest message queued */
+    uint32_t rx_msgs_num;               /**< #messages queued */
+    uint8_t *rx_chunks;                 /**< pool buffer of the message being reassembled, NULL if none */
+    uint32_t rx_msg_len;                /**< payload size of the message being reassembled */
+    uint32_t rx_chunks_len;             /**< #bytes reassembled */
+};
+
+/**
+ * tcp_channel_msg structure is used to store
+ * a message received to a channel
+ */
+struct tcp_channel_msg {
+    uint8_t *payload;                   /**< pool buffer, owned by the user once received */
+    uint32_t payload_len;               /**< size of payload */
+    uint32_t next;                      /**< next message of the channel, or of the free list */
+};
+
+/**
+ * tcp_channels structure is used to store the channels of a TCP handle.
+ * Senders write one frame at a time, a chunk of a large message yields the
+ * socket to the senders of higher priority channels. Receivers take turns
+ * reading frames of all the channels until a message of their own is queued.
+ */
+struct tcp_channels {
+    pthread_mutex_t lock;               /**< protects the channels */
+    pthread_cond_t tx_cond;             /**< signaled once a frame was sent */
+    pthread_cond_t rx_cond;             /**< signaled once a frame was received */
+    handle_t handle;                    /**< the TCP handle */
+    int is_tx_busy;                     /**< a frame is being sent */
+    int is_rx_busy;                     /**< a frame is being received */
+    int tx_err;                         /**< send error, fails further sends */
+    int rx_err;                         /**< receive error, fails further receives */
+    uint32_t *tx_waiting;               /**< #senders of each priority */
+    uint32_t rx_free;                   /**< free list of rx_msgs */
+    uint8_t *rx_parked;                 /**< a message read while its channel was full, the socket isn't read till it's queued */
+    uint32_t rx_parked_len;
+    uint8_t rx_parked_msg_type;
+    struct tcp_channel_msg *rx_msgs;    /**< TCP_CHANNEL_RX_MSGS messages queued on all the channels */
+    struct tcp_channel channels[];      /**< TCP_CHANNELS_NUM channels, by msg_type */
+};
+
+/**
+ * rx_callback structure is used to deliver the messages of a handle to its
+ * receive callback from the reactor thread serving the handle
+ */
+struct rx_callback {
+    handle_t handle;                    /**< the TCP or UDP handle */
+    struct handle_info *handle_info_st; /**< the DB entry of the handle, deleted after the callback stopped */
+    int db_type;                        /**< enum db_type of the DB holding the handle */
+    struct register_to_recv clbk_st;    /**< the receive callback */
+    int is_stopped;                     /**< set once stopped or failed, no more messages are delivered */
+    int is_detached;                    /**< stopped from the callback, freed by the handler once it returned */
+    struct msg_metadata metadata;       /**< metadata of the message received to payload */
+    uint8_t *payload;                   /**< pool buffer of a message larger than buffer, NULL if none */
+    uint32_t payload_recvd;             /**< #bytes of payload received */
+    uint32_t head;                      /**< #bytes of buffer parsed */
+    uint32_t tail;                      /**< #bytes of buffer received */
+    uint8_t buffer[];                   /**< TCP - RX_STREAM_BUFFER_SIZE bytes received and not delivered yet,
+                                         *   UDP - UDP_BATCH_MSGS payloads of MAX_UDP_PAYLOAD bytes */
+};
+
+/**
+ * handle_reactor structure is used to register a socket in the reactor once,
+ * for its receive callback (EPOLLIN) and its async send queue (EPOLLOUT).
+ * The item is armed one shot with the events still wanted after each
+ * handler call, it's kept till the handle is closed.
+ */
+struct handle_reactor {
+    pthread_mutex_t lock;               /**< protects the fields below */
+    pthread_cond_t handler_cond;        /**< signaled once the handler left a callback, and once released */
+    struct lib_commu_reactor_item item; /**< the socket registration */
+    handle_t handle;                    /**< the TCP or UDP handle */
+    struct handle_info *handle_info_st; /**< the DB entry of the handle, closed on release if detached */
+    uint32_t events;                    /**< EPOLLIN while a callback is set, EPOLLOUT while messages are queued */
+    struct rx_callback *rx_callback;    /**< the callback messages are delivered to, NULL if none */
+    struct rx_callback *rx_running;     /**< the callback the handler delivers to now, NULL if none */
+    struct tx_queue *tx_queue;          /**< the queue drained, NULL if nothing was queued */
+    pthread_t handler_thread;           /**< the reactor thread, valid while is_in_handler */
+    int is_in_handler;                  /**< set while the reactor thread serves the socket */
+    int is_removed;                     /**< set once the item was removed */
+    int is_released;                    /**< set by the reactor once the item was released */
+    int is_detached;                    /**< closed from a reactor thread, freed once released */
+};
+
+/**
+ * udp_fragments structure is used to store
+ * a large UDP message being reassembled
+ */
+struct udp_fragments {
+    uint32_t ipv4_addr;                 /**< the sender address */
+    uint16_t port;                      /**< the sender port */
+    uint32_t msg_seq;                   /**< sequence number of the message on the sender */
+    uint32_t msg_len;                   /**< payload size of the whole message */
+    uint32_t recvd_len;                 /**< #payload bytes reassembled */
+    uint8_t msg_type;                   /**< message type of the fragments */
+    uint32_t last_used;                 /**< udp_reassembly clock of the last fragment, the oldest is evicted */
+    uint8_t *payload;                   /**< pool buffer, msg_len bytes and a bit per fragment received, NULL if free */
+};
+
+/**
+ * udp_reassembly structure is used to receive the large messages of a UDP
+ * handle. A GRO datagram holds several segments of one sender, they are
+ * parsed one by one before the next datagram is received.
+ */
+struct udp_reassembly {
+    pthread_mutex_t lock;               /**< serializes the receivers of the handle */
+    uint32_t clock;                     /**< counts the fragments, orders the messages by their last fragment */
+    uint32_t ipv4_addr;                 /**< the sender of the buffered datagram */
+    uint16_t port;
+    uint32_t segment_size;              /**< GRO segment size of the buffered datagram */
+    uint32_t head;                      /**< #bytes of buffer parsed */
+    uint32_t tail;                      /**< #bytes of buffer received */
+    uint8_t *buffer;                    /**< UDP_GRO_BUFFER_SIZE bytes, follows msgs */
+    struct udp_fragments msgs[];        /**< UDP_REASSEMBLY_MSGS messages being reassembled */
+};
+
+/**
+ * udp_reliable_msg structure is used to store a message sent to a reliable
+ * peer until it's acked, or a message received until it's delivered.
+ * It's the head of a pool buffer.
+ */
+struct udp_reliable_msg {
+    struct udp_reliable_msg *next;      /**< delivery queue of the handle */
+    uint32_t ipv4_addr;                 /**< the sender of a received message */
+    uint16_t port;
+    uint32_t seq;                       /**< sequence number of the message */
+    int err;                            /**< received - ECONNRESET in place of the messages
+                                         *   the peer gave up, then len is 0 */
+    unsigned long long sent_ns;         /**< last transmission, 0 to retransmit on the next tick */
+    uint32_t retries;                   /**< #retransmissions before the peer received it */
+    int is_sacked;                      /**< received by the peer, not delivered yet. Then it's
+                                         *   only probed, in case the ack freeing it is lost */
+    uint32_t len;                       /**< #bytes of data */
+    uint8_t data[];                     /**< sent - the whole datagram, received - the payload */
+};
+
+/**
+ * udp_reliable_peer structure is used to store
+ * the messages exchanged with one peer of a reliable UDP handle
+ */
+struct udp_reliable_peer {
+    uint32_t ipv4_addr;                 /**< the peer address */
+    uint16_t port;
+    uint32_t peer_magic;                /**< trailer of the peer datagrams, changes once it restarts */
+    int err;                            /**< ETIMEDOUT once messages were given up, returned to
+                                         *   the senders until the peer is forgotten */
+    uint32_t users_num;                 /**< #senders to the peer, it isn't forgotten meanwhile */
+    unsigned long long last_ns;         /**< last message sent to or received from the peer */
+    unsigned long long reset_sent_ns;   /**< last reset sent once messages were given up */
+    uint32_t tx_epoch;                  /**< sequence of the messages sent to the peer */
+    uint32_t tx_seq;                    /**< sequence number of the next message sent */
+    uint32_t tx_acked;                  /**< oldest message not acked, tx_seq if none */
+    unsigned long long srtt_ns;         /**< smoothed round trip time, 0 until measured */
+    unsigned long long rttvar_ns;       /**< round trip time variation */
+    unsigned long long rto_ns;          /**< retransmission timeout */
+    uint32_t rx_epoch;                  /**< sequence of the messages received, once is_rx_synced */
+    uint32_t rx_seq;                    /**< next message delivered */
+    int is_rx_synced;                   /**< rx_seq was taken from the first message of rx_epoch */
+    int is_rx_reset;                    /**< the peer gave up messages, fails once the ones
+                                         *   received in order were delivered */
+    int is_rx_failed;                   /**< the failure was delivered, the messages of
+                                         *   rx_epoch are dropped */
+    int is_ack_pending;                 /**< an ack is sent once the received datagrams were handled */
+    int is_rx_blocked;                  /**< rx_seq was received, and waits for room in the delivery queue */
+    struct udp_reliable_peer *hash_next; /**< peers of a hash bucket */
+    struct udp_reliable_peer *next;     /**< peers of the handle, scanned by the timer */
+    struct udp_reliable_peer *blocked_next; /**< peers waiting for room in the delivery queue */
+    struct udp_reliable_msg **tx_msgs;  /**< UDP_RELIABLE_WINDOW messages not acked, by seq */
+    struct udp_reliable_msg **rx_msgs;  /**< UDP_RELIABLE_WINDOW messages received and not delivered, by seq */
+};
+
+/**
+ * udp_reliable structure is used to deliver the messages of a UDP handle
+ * in order and without loss. The reactor receives the datagrams and acks
+ * them, a timer retransmits the messages not acked in time.
+ */
+struct udp_reliable {
+    pthread_mutex_t lock;               /**< protects the peers and the delivery queue */
+    pthread_cond_t tx_cond;             /**< signaled once messages were acked or given up */
+    pthread_cond_t rx_cond;             /**< signaled once a message was queued for delivery */
+    pthread_cond_t released_cond;       /**< signaled once the reactor released the item,
+                                         *   or the last blocked user returned */
+    struct lib_commu_reactor_item item; /**< EPOLLIN registration */
+    handle_t handle;                    /**< the UDP handle */
+    struct handle_info *handle_info_st; /**< the DB entry of the handle, deleted after the item was released */
+    int is_released;                    /**< set by the reactor once the item was released */
+    int is_detached;                    /**< turned off from a reactor thread, freed once released */
+    int is_stopped;                     /**< set once turned off, the blocked users return */
+    uint32_t users_num;                 /**< #users blocked in send or recv */
+    uint32_t peers_num;
+    uint32_t epoch_next;                /**< tx_epoch of the next peer, from the clock once set */
+    struct udp_reliable_peer *peers;    /**< all the peers */
+    struct udp_reliable_peer *blocked;  /**< peers waiting for room in the delivery queue */
+    struct udp_reliable_peer *blocked_tail;
+    struct udp_reliable_msg *rx_head;   /**< delivery queue */
+    struct udp_reliable_msg *rx_tail;
+    uint32_t rx_msgs_num;               /**< #messages in the delivery queue */
+    struct udp_reliable *prev;          /**< reliable handles list, scanned by the timer */
+    struct udp_reliable *next;
+    uint8_t *buffer;                    /**< UDP_BATCH_MSGS datagrams of MAX_UDP_MSG_SIZE bytes, follows hash */
+    struct udp_reliable_peer *hash[];   /**< UDP_RELIABLE_HASH_SIZE buckets of peers */
 };
 
 
@@ -100,6 +513,10 @@ struct connect_thread_args {
  ***********************************************/
 
 #define MSG_VERSION                 (1)
+#define MSG_CHUNK_VERSION           (2) /* a msg_chunk and its part of a channel message follow the metadata */
+#define MSG_FRAGMENT_VERSION        (3) /* a msg_fragment and its part of a large UDP message follow the metadata */
+#define MSG_RELIABLE_VERSION        (4) /* a msg_reliable and the message, if any, follow the metadata */
+#define MSG_TRACE_VERSION           (5) /* a msg_trace follows the metadata, then the payload */
 #define MAX_MTU                     (1500)
 #define DEFAULT_UDP_SERVER_PORT     3100
 #define DEFAULT_UDP_CLIENT_PORT     3200
@@ -107,10 +524,42 @@ struct connect_thread_args {
 #define UDP_HEADER_SIZE             (8)
 #define MAX_UDP_MSG_SIZE            (MAX_MTU - MAX_IPV4_HEADER_SIZE - \
                                      UDP_HEADER_SIZE)                                  /* not including sizeof(msg_metadata) */
-#define PENDING_CONNECTIOS_SIZE     (16)
+#define PENDING_CONNECTIOS_SIZE     (SOMAXCONN) /* per listener, mass reconnects overflow a short backlog */
+#define ACCEPT_BATCH_NUM            (64) /* #accept4() per listener event */
 #define SEND_REPEAT_NUM             (500)
 #define RECV_REPEAT_NUM             (500)
-#define CLIENT_CONNECT_THREAD_PATH  "/tmp/lib_commu_client_connect"
+#define RX_STREAM_BUFFER_SIZE       (64 * 1024) /* per TCP handle, allocated on first multi message receive */
+#define SEND_BATCH_MSGS             (512) /* #messages per sendmsg(), 2 iovecs each - bounded by IOV_MAX */
+#define SEND_BATCH_LINKED           (4) /* #sendmsg() of a batch send linked in one io_uring submission */
+#define SHM_SESSION_PATH_LEN        (32) /* SHM_SESSION_PATH with a 5 digits port */
+#define UDP_BATCH_MSGS              (64) /* #datagrams per sendmmsg()/recvmmsg() */
+#define TX_QUEUE_BATCH_MSGS         (64) /* #queued messages per sendmsg() of the async send */
+#define ZEROCOPY_CMSG_SIZE          (128) /* control buffer of one error queue notification */
+#define ZEROCOPY_WAIT_MSEC          (10 * 1000) /* bound of a MSG_ZEROCOPY completion wait if the socket has no send timeout */
+#define TCP_CHANNELS_NUM            (256) /* a channel per msg_type of the metadata */
+#define TCP_CHANNEL_CHUNK_SIZE      (64 * 1024) /* channel messages are sent in chunks up to this size */
+#define TCP_CHANNEL_RX_MSGS         (1024) /* #messages queued on all the channels of a handle */
+#define TCP_CHANNEL_RX_MSGS_MAX     (256) /* #messages queued on one channel, then the connection isn't read */
+#define TCP_CHANNEL_RX_NONE         (0xFFFFFFFF) /* end of a tcp_channel_msg list */
+#define RX_CALLBACK_RECV_NUM        (16) /* #recv()/recvmmsg() per event of a receive callback handle */
+#define UDP_FRAGMENT_PAYLOAD        (MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata) - \
+                                     sizeof(struct msg_fragment))       /* payload bytes of a full fragment */
+#define UDP_GSO_SEGMENTS_NUM        (44) /* #fragments per UDP_SEGMENT sendmsg(), below 64KB and UDP_MAX_SEGMENTS */
+#define UDP_GRO_BUFFER_SIZE         (64 * 1024) /* a GRO datagram, up to 64KB */
+#define UDP_REASSEMBLY_MSGS         (16) /* #large messages reassembled at a time per handle */
+#define UDP_RELIABLE_DATA           (0) /* msg_reliable types */
+#define UDP_RELIABLE_ACK            (1)
+#define UDP_RELIABLE_RESET          (2)
+#define UDP_RELIABLE_WINDOW         (32) /* #messages sent to a peer and not acked, the sack_bits of an ack */
+#define UDP_RELIABLE_HASH_SIZE      (256) /* peers hash buckets per handle */
+#define UDP_RELIABLE_PEERS_MAX      (4096) /* #peers per handle */
+#define UDP_RELIABLE_RX_MSGS_MAX    (4096) /* #messages queued for delivery per handle, then the acks stop */
+#define UDP_RELIABLE_TICK_MSEC      (5) /* retransmission timer period */
+#define UDP_RELIABLE_RTO_INIT_MSEC  (100) /* retransmission timeout until the round trip is measured */
+#define UDP_RELIABLE_RTO_MIN_MSEC   (10)
+#define UDP_RELIABLE_RTO_MAX_MSEC   (2000) /* the timeout doubles on each retransmission up to it */
+#define UDP_RELIABLE_RETRIES_MAX    (10) /* #retransmissions of a message, then the peer's messages are given up */
+#define UDP_RELIABLE_PEER_IDLE_MSEC (30000) /* a peer nothing was exchanged with meanwhile is forgotten */
 
 /************************************************
  *  Local Macros
@@ -124,11 +573,30 @@ struct connect_thread_args {
 
 #define MAX_MSGS            (20) /* TODO: define the proper max */
 #define MAX_UDP_PAYLOAD     (1422) /* if metadata size change need to change it also */
+#define MAX_UDP_PAYLOAD_IOV (15) /* #payload buffers of comm_lib_udp_sendv */
+#define DEFAULT_MC_TTL      (1) /* multicast datagrams stay on the local network */
 #define MAX_TCP_PAYLOAD     (4094)
 #define MAX_JUMBO_TCP_PAYLOAD     (1024*1600) /* ~1.63 MB */
+#define MAX_UDP_LARGE_PAYLOAD     (MAX_JUMBO_TCP_PAYLOAD) /* comm_lib_udp_large_send limit */
+#define MAX_UDP_RELIABLE_PAYLOAD  (1405) /* if msg_reliable size change need to change it also */
 #define MAX_CONNECTION_NUM  (16)
+#define MAX_TX_QUEUE_MSGS   (1024) /* #messages comm_lib_tcp_send_async can queue per connection */
+#define MAX_COALESCE_BYTES  (256 * 1024) /* comm_lib_tcp_coalesce_set buffer limit */
+#define MAX_COALESCE_DELAY_USEC (1000000) /* comm_lib_tcp_coalesce_set deadline limit */
+#define MIN_ZEROCOPY_BYTES  (16 * 1024) /* comm_lib_tcp_zerocopy_set limit, smaller payloads are cheaper to copy */
+#define TCP_CHANNEL_PRIORITIES_NUM (8) /* comm_lib_tcp_channel_set priorities, 0 is the highest */
+#define HANDLE_HIST_BUCKETS_NUM (32) /* log2 buckets of each handle histogram */
+#define UNIX_STREAM_SOCK_PATH   "/tmp/lib_commu_stream_%u" /* STREAM_TRANSPORT_UNIX server path, by port (host order) */
+#define SHM_SESSION_PATH    "/lib_commu_shm_%u" /* comm_lib_shm_session_start segment name, by port (host order) */
+#define SHM_RING_SIZE       (2 * 1024 * 1024) /* bytes of each direction ring of a shm session */
 #define GENERAL_MSG_TYPE    (65535)
 #define INVALID_HANDLE_ID   (-1)
+#define DEFAULT_REACTOR_THREADS_NUM (1)
+#define MAX_REACTOR_THREADS_NUM     (16)
+#define MAX_ACCEPTORS_NUM           (MAX_REACTOR_THREADS_NUM) /* session_params.acceptors_num limit */
+#define DEFAULT_MAX_SESSIONS_NUM    (16) /* default of each comm_lib_init_params limit */
+#define MAX_SESSIONS_NUM            (1024*1024)
+#define MAX_SERVERS_NUM             (1024)
 
 /************************************************
  *  Macros
@@ -138,6 +606,59 @@ struct connect_thread_args {
  *  Type definitions
  ***********************************************/
 
+/**
+ * comm_lib_io_engine enum is used to select
+ * how the blocking TCP data calls reach the kernel
+ */
+enum comm_lib_io_engine {
+    IO_ENGINE_SYSCALL = 0, /**< sendmsg/recv system calls */
+    IO_ENGINE_URING,       /**< an io_uring per thread: a blocking call takes one io_uring_enter, batch and multi-handle sends submit several sendmsg() in it */
+};
+
+/**
+ * comm_lib_init_params structure is used to set
+ * the library resources on init
+ */
+struct comm_lib_init_params {
+    uint32_t reactor_threads_num; /**< #epoll threads serving TCP server listeners and client connects (1-MAX_REACTOR_THREADS_NUM) */
+    uint32_t max_udp_sessions;    /**< maximum #udp sessions (0 - DEFAULT_MAX_SESSIONS_NUM, up to MAX_SESSIONS_NUM) */
+    uint32_t max_tcp_clients;     /**< maximum #tcp client sessions (0 - DEFAULT_MAX_SESSIONS_NUM, up to MAX_SESSIONS_NUM) */
+    uint32_t max_tcp_servers;     /**< maximum #tcp servers (0 - DEFAULT_MAX_SESSIONS_NUM, up to MAX_SERVERS_NUM) */
+    uint32_t max_server_connections; /**< maximum #connections per tcp server (0 - DEFAULT_MAX_SESSIONS_NUM, up to MAX_SESSIONS_NUM) */
+    enum comm_lib_io_engine io_engine; /**< engine of the blocking TCP send/receive calls (0 - IO_ENGINE_SYSCALL) */
+};
+
+/**
+ * tcp_send_msg structure is used to pass
+ * a message to comm_lib_tcp_send_batch_blocking
+ */
+struct tcp_send_msg {
+    uint8_t msg_type;     /**< message type, must match the connection msg_type unless it is GENERAL_MSG_TYPE */
+    uint8_t *payload;     /**< the data to pass */
+    uint32_t payload_len; /**< size of payload */
+};
+
+/**
+ * tcp_send_handle_msg structure is used to pass
+ * a message to comm_lib_tcp_send_multi_blocking
+ */
+struct tcp_send_handle_msg {
+    handle_t handle;      /**< the TCP handle to send on */
+    uint8_t *payload;     /**< the data to pass */
+    uint32_t payload_len; /**< size of payload */
+    int err;              /**< out: 0 if the message was sent, else as returned by comm_lib_tcp_send_blocking */
+};
+
+/**
+ * udp_msg structure is used to pass a datagram to
+ * comm_lib_udp_send_batch / comm_lib_udp_recv_batch
+ */
+struct udp_msg {
+    struct addr_info addr;  /**< the recipient on send, the addresser on receive */
+    uint8_t *payload;       /**< the data to send / the buffer to receive to */
+    uint32_t payload_len;   /**< size of payload, on receive filled with #bytes received */
+};
+
 enum handle_op_status {
     HANDLE_STATUS_DOWN = 0,    /**< indicating the handle status as DOWN*/
     HANDLE_STATUS_UP = 1      /**< indicating the handle status as UP*/
@@ -157,6 +678,16 @@ struct recv_payload_data {
     uint8_t jumbo_msg_type; /**< the jumbo message type received */
 };
 
+/**
+ * recv_msg structure is used to return
+ * a message received by comm_lib_tcp_recv_pooled
+ */
+struct recv_msg {
+    uint8_t *payload;     /**< pool buffer of payload_len bytes, release by comm_lib_recv_buffer_release */
+    uint32_t payload_len; /**< bytes received */
+    uint8_t msg_type;     /**< the message type received */
+};
+
 /**
  * socket_connection_info structure is used to store
  * server connection
@@ -177,6 +708,69 @@ struct socket_connection_info {
     unsigned long long total_sum_bytes_tx; /**< total number of bytes sent on this socket - statistics     */
 };
 
+/**
+ * handle_stats structure is used to return
+ * the traffic counters of a handle
+ */
+struct handle_stats {
+    unsigned long long rx_bytes;    /**< bytes received */
+    unsigned long long tx_bytes;    /**< bytes sent */
+    unsigned long long rx_msgs;     /**< messages received */
+    unsigned long long tx_msgs;     /**< messages sent */
+    unsigned long long rx_errors;   /**< failed receive calls and dropped messages */
+    unsigned long long tx_errors;   /**< failed send calls */
+    unsigned long long retries;     /**< repeated send/recv on partial transfer, EINTR or EAGAIN */
+    unsigned long long zerocopy_sends;  /**< sendmsg() calls with MSG_ZEROCOPY, see comm_lib_tcp_zerocopy_set */
+    unsigned long long zerocopy_copied; /**< of them, payloads the kernel copied anyway (e.g. loopback) */
+    unsigned long long rx_gaps;     /**< traced messages missing when a later one was received, see comm_lib_msg_trace_set */
+    unsigned long long rx_reorders; /**< traced messages received after a later one */
+    unsigned long long rx_clock_skews; /**< traced messages of a same host peer sent after their receive by the receiver clock, left out of HANDLE_HIST_RX_LATENCY */
+};
+
+/**
+ * msg_trace_mode enum is used to select when the messages sent
+ * on a handle carry a msg_trace, see comm_lib_msg_trace_set
+ */
+enum msg_trace_mode {
+    MSG_TRACE_OFF = 0,  /**< messages are sent without a msg_trace */
+    MSG_TRACE_ON_PEER,  /**< traced once a traced message was received on the handle */
+    MSG_TRACE_ALWAYS,   /**< traced from the first message, the peers must accept MSG_TRACE_VERSION */
+};
+
+/**
+ * handle_hist_type enum is used to index
+ * the histograms of a handle
+ */
+enum handle_hist_type {
+    HANDLE_HIST_TX_TIME = 0,    /**< nsec spent in one send call */
+    HANDLE_HIST_RX_TIME,        /**< nsec spent in one receive call, including the wait for data */
+    HANDLE_HIST_TX_SIZE,        /**< bytes sent by one send call, a datagram or a TCP message (batch) */
+    HANDLE_HIST_RX_SIZE,        /**< bytes received by one receive call */
+    HANDLE_HIST_RETRIES,        /**< repeated send/recv of one call */
+    HANDLE_HIST_RX_LATENCY,     /**< nsec from the send of a traced message to its receive, same host peers only */
+    HANDLE_HIST_NUM
+};
+
+/**
+ * handle_hist structure is used to store
+ * a log2 bucketed histogram. buckets[0] counts the zero values,
+ * buckets[i] counts the values in [2^(i-1), 2^i), the last bucket
+ * counts all the larger values too.
+ */
+struct handle_hist {
+    unsigned long long count;   /**< #values */
+    unsigned long long sum;     /**< sum of the values */
+    unsigned long long buckets[HANDLE_HIST_BUCKETS_NUM];
+};
+
+/**
+ * handle_histograms structure is used to return
+ * the histograms of a handle, indexed by handle_hist_type
+ */
+struct handle_histograms {
+    struct handle_hist hist[HANDLE_HIST_NUM];
+};
+
 /**
  * connection_status_t structure is used to store
  * the status of the connection.
@@ -188,6 +782,7 @@ struct connection_status {
     uint16_t local_port;        /**< the port of my side */
     uint32_t peer_ipv4_addr;    /**< the IP address of my peer */
     uint16_t peer_port;         /**< the port of the peer */
+    struct handle_stats stats;  /**< the connection counters, filled by the status get functions */
 };
 
 /**
@@ -196,7 +791,7 @@ struct connection_status {
  */
 struct server_status {
     uint32_t clients_num; /**< number of clients connected to server  */
-    struct connection_status client_status[MAX_CONNECTION_NUM]; /**< client status */
+    struct connection_status client_status[MAX_CONNECTION_NUM]; /**< status of the first MAX_CONNECTION_NUM clients, see comm_lib_tcp_server_clients_status_get */
     handle_t listener_handle; /**< the listener handle */
     uint8_t listener_status; /**< listener status enable==1/disable==0 */
 };
@@ -221,6 +816,17 @@ struct ip_udp_params {
     uint16_t is_single_peer;                /**<if 1 ==> enforce receive data from single peer */
 };
 
+/**
+ * mc_udp_params structure is used to start new multicast udp connection.
+ * session_params.s_ipv4_addr is the local interface (0 - chosen by routing).
+ */
+struct mc_udp_params {
+    struct ip_udp_params ip_udp_params; /**<ip udp parameters, must be first */
+    uint32_t group_ipv4_addr;   /**<group joined by a CONN_SERVER connection, bound to INADDR_ANY:port (network order) */
+    uint8_t ttl;                /**<TTL of sent datagrams (0 - DEFAULT_MC_TTL) */
+    uint8_t is_loopback;        /**<if 1 ==> sent datagrams are delivered to the local members too */
+};
+
 /**
  * udp_fields union is used to determine which kind of udp connection
  * to start
@@ -228,7 +834,7 @@ struct ip_udp_params {
 union udp_fields
 {
     struct ip_udp_params ip_udp_params; /**<ip udp parameters      */
-    /* mc_udp_params_t  mc_udp_params; multi-cast udp parameters   */
+    struct mc_udp_params mc_udp_params; /**<multi-cast udp parameters */
     /* raw_uc_prarms_t     raw_prarms; raw udp parameters          */
 };
 
@@ -238,7 +844,7 @@ union udp_fields
  */
 enum udp_type {
     CONN_TYPE_UDP_IP_UC, /**< Unreliable unicast connection */
-    /* CON_TYPE_IP_MC,       multicast connection */
+    CONN_TYPE_UDP_IP_MC, /**< Unreliable multicast connection */
     /* CON_TYPE_RAW_UC,      Build Layer 2 unicast connection */
 };
 
@@ -275,6 +881,29 @@ struct udp_params {
 int
 comm_lib_init(lib_commu_log_cb_t logging_cb);
 
+/**
+ * This function is used to open communication library and init it's data
+ * with non default resources
+ *
+ * @param[in] logging_cb - the logging callback
+ * @param[in] init_params - library resources, if NULL defaults are used
+ * @param[in,out] None
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if init_params are out of range
+ * @return EFAULT or EINVAL or EPERM if pseusdo random init failed
+ * @return EPERM if DB operation failed
+ * @return ENOMEM if failed to allocate the DB tables
+ * @return errno codes of native pthread_mutex_init function
+ * @return errno codes of native epoll_create/pthread_create functions
+ * @return errno codes of native io_uring_setup function if IO_ENGINE_URING
+ *         is not supported by the kernel
+ */
+int
+comm_lib_init_with_params(lib_commu_log_cb_t logging_cb,
+                          const struct comm_lib_init_params *init_params);
+
 /**
  * This function is used to close communication library and deinit it's data
  *
@@ -322,9 +951,16 @@ comm_lib_verbosity_level_get(enum lib_commu_verbosity_level *verbosity);
 
 /**
  * start a TCP connection from the server side.
- * opens a thread which "listens" to new connections.
- * Once connection is established a callback is being made with
- * a new handle toward the client.
+ * registers a listener socket on the library reactor, which "listens" to
+ * new connections. Once connection is established a callback is being made
+ * from the reactor thread with a new handle toward the client.
+ * The reactor thread is shared with the other servers, the async sends and
+ * the receive callbacks it serves, so a slow callback stalls all of them.
+ * With params.transport == STREAM_TRANSPORT_UNIX the server listens on the
+ * UNIX domain path of params.port, and the peers are reported as 127.0.0.1.
+ * With params.acceptors_num > 1 the server opens that many SO_REUSEPORT
+ * listeners, each accepting on another reactor thread, and the kernel spreads
+ * the incoming connections between them (TCP only).
  *
  * @param[in] params - server address, port, etc (network order)
  * @param[in] clbk_st - function callback
@@ -332,10 +968,12 @@ comm_lib_verbosity_level_get(enum lib_commu_verbosity_level *verbosity);
  * @param[out] None
  *
  * @return 0 if operation completes successfully
- * @return EINVAL if clbk_st == NULL
+ * @return EINVAL if clbk_st == NULL, or params.acceptors_num is above
+ *         MAX_ACCEPTORS_NUM, the #reactor threads, or 1 on a UNIX server
  * @return EACCES if can't create listener socket
+ * @return EADDRINUSE if a running UNIX server listens on the path of params.port
  * @return ENOBUFS or ENOMEM The socket cannot be created until sufficient resources are freed
- * @return EAGAIN if Insufficient resources to create listener thread
+ * @return errno codes of native listen/epoll_ctl functions
  * @return EPERM if library didn't finish init
  * @return ENOMEM if can't create new session due to DB limit
  */
@@ -347,8 +985,8 @@ comm_lib_tcp_server_session_start(struct session_params params,
 
 /**
  * stop a TCP connection from the server side.
- * close a thread which "listens" to new connections. It does close
- * all the open sockets within this thread.
+ * removes the listener from the reactor. It does close
+ * all the open sockets of this server.
  *
  * @param[in] server_id - the id of the server to close
  * @param[in] handle_array_len - size of handle_array
@@ -371,7 +1009,8 @@ comm_lib_tcp_server_session_stop(uint16_t server_id, handle_t *handle_array,
  * start a TCP connection from the client side. (Blocking)
  * opens a socket toward specific server IP and port from user context
  * Once connection is established the function returns and update new handle
- * IP and port must be valid
+ * IP and port must be valid, conn_info->transport chooses TCP or the UNIX
+ * domain server of d_port
  *
  * @param[in] conn_info - server address, port, etc...
  * @param[in,out] client_handle
@@ -390,10 +1029,13 @@ comm_lib_tcp_client_blocking_start(
 
 /**
  * start a TCP connection from the client side. (NON-Blocking)
- * opens a thread which opens a socket toward specific server IP and port
+ * opens a non blocking socket toward specific server IP and port, the
+ * connection is completed by the reactor threads.
  * Once connection is established, a callback is being made with a new handle
  * toward the client.
- * IP and port must be valid
+ * If connection fails, a callback is being made with handle = -1 and rc = -errno
+ * IP and port must be valid, conn_info->transport chooses TCP or the UNIX
+ * domain server of d_port (EAGAIN is returned if its backlog is full)
  *
  * @param[in] conn_info - server address, port, etc...
  * @param[in] clbk_st - function callback
@@ -405,18 +1047,49 @@ comm_lib_tcp_client_blocking_start(
  * @return 0 if operation completes successfully
  * @return EINVAL - if client_handle or conn_info are NULL
  * @return EPERM if library didn't finish init
- * @return ETIMEDOUT if connection haven't been established till timeout.
  * @return errno codes of native socket function
  * @return errno codes of native connect function
+ * @return errno codes of native timerfd_create function
+ *
+ * ETIMEDOUT is passed to the callback if connection haven't been established
+ * till timeout.
  */
 int
 comm_lib_tcp_client_non_blocking_start(
         const struct connection_info const *conn_info,
         struct register_to_new_handle *clbk_st, struct timeval *tval);
 
+/**
+ * start a shared memory session between two processes (or threads) on the
+ * same host. The session is named by conn_info->d_port: the first caller
+ * creates a pair of SHM_RING_SIZE rings, the second attaches to them, and
+ * both return without waiting for the peer. A session left by a process
+ * which died before its peer attached is created again. Both processes
+ * must share the pid namespace: once the peer process is gone the session
+ * fails as if the peer stopped it.
+ * The handle is used with the TCP send/recv APIs and stopped with
+ * comm_lib_tcp_peer_stop. Messages are copied once into the rings instead
+ * of through socket buffers, the handle fd can't be polled for readiness
+ * and comm_lib_tcp_send_async isn't supported on it.
+ *
+ * @param[in] conn_info - d_port names the session, msg_type as in TCP
+ * @param[in,out] handle - the session handle
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle or conn_info are NULL
+ * @return EBUSY - if both peers of the session are already attached
+ * @return EPROTO - if the session was created by an incompatible library
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native shm_open/ftruncate/mmap functions
+ */
+int
+comm_lib_shm_session_start(const struct connection_info const *conn_info,
+                           handle_t *handle);
+
 /**
  * close a TCP connection between two peers.
- * Can be used from server/client side
+ * Can be used from server/client side, and from the library callbacks.
  *
  * @param[in] handle
  * @param[in,out] None
@@ -442,6 +1115,9 @@ comm_lib_tcp_peer_stop(handle_t handle);
  * @return EOVERFLOW - if payload_len exceeds MAX TCP SIZE message
  * @return EINVAL or ENOKEY- if handle doesn't exist in library DB
  * @return EIO - if could not sent all buffer (after 3 retries)
+ * @return ETIMEDOUT - if the MSG_ZEROCOPY pages weren't released in time,
+ *         the connection is reset and the handle must be closed, see
+ *         comm_lib_tcp_zerocopy_set
  * @return EPERM if library didn't finish init
  * @return errno codes of native send function
  */
@@ -450,11 +1126,279 @@ comm_lib_tcp_send_blocking(handle_t handle, uint8_t *payload,
                            uint32_t *payload_len);
 
 
+/**
+ * send several messages as stream of bytes over TCP connection
+ * Can be used from server/clients side. blocking until all messages are sent.
+ * Messages are framed as in comm_lib_tcp_send_blocking and written with a
+ * single sendmsg() per batch, i.e. few syscalls for many small messages.
+ * With IO_ENGINE_URING up to SEND_BATCH_LINKED batches are linked sendmsg()
+ * submitted with one io_uring_enter.
+ *
+ * @param[in] msgs - the messages to send.
+ * @param[in,out] msgs_num - #messages to send, updated to #messages sent
+ * @param[out] None
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if msgs == NULL or msgs_num == NULL or a payload == NULL
+ * @return EINVAL or ENOKEY- if handle doesn't exist in library DB
+ * @return EOVERFLOW - if a payload_len exceeds MAX TCP SIZE message or is 0
+ * @return EBADE - if a msg_type differs from the connection msg_type
+ * @return EIO - if could not sent all buffer
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function
+ */
+int
+comm_lib_tcp_send_batch_blocking(handle_t handle, struct tcp_send_msg *msgs,
+                                 uint32_t *msgs_num);
+
+
+/**
+ * send messages over several TCP connections, blocking until all of them
+ * are sent or failed. Each message is framed as in comm_lib_tcp_send_blocking,
+ * the messages of a connection are sent in array order, the connections are
+ * served concurrently. With IO_ENGINE_URING the messages of connections
+ * without coalescing, zerocopy or shared memory are submitted together, up to
+ * 64 sendmsg() per io_uring_enter, otherwise each message takes its own send.
+ *
+ * @param[in,out] msgs - the messages to send, the err of each one is set
+ * @param[in] msgs_num - #messages to send
+ *
+ * @return 0 if operation completes successfully, see the err of the messages
+ * @return EINVAL - if msgs == NULL
+ * @return ENOMEM - if the send state couldn't be allocated
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_send_multi_blocking(struct tcp_send_handle_msg *msgs,
+                                 uint32_t msgs_num);
+
+
+/**
+ * queue the payload to be sent over TCP connection, without blocking.
+ * Can be used from server/clients side. The message is framed as in
+ * comm_lib_tcp_send_blocking and sent by the library reactor thread once the
+ * socket is writable, messages of a connection are sent in queue order.
+ * clbk_send_done_func is called from the reactor thread with rc == 0 once the
+ * message was sent, or with rc < 0 if the connection failed. payload must
+ * stay valid till then. Messages still queued when the handle is closed by
+ * comm_lib_tcp_peer_stop/comm_lib_tcp_server_session_stop are completed with
+ * -ECANCELED from the closing thread, on comm_lib_deinit they are dropped.
+ * Don't mix with the blocking send functions on the same handle while
+ * messages are queued. The reactor thread serving the queue also serves the
+ * receive callback of the handle, see comm_lib_recv_callback_set.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in] payload - the data to pass.
+ * @param[in] payload_len - size of payload
+ * @param[in] clbk_st - the completion callback
+ *
+ * @return 0 if the message was queued
+ * @return EINVAL - if payload == NULL or clbk_st == NULL or clbk_st->clbk_send_done_func == NULL
+ * @return EINVAL - if handle isn't a TCP handle
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOVERFLOW - if payload_len exceeds MAX TCP SIZE message
+ * @return EAGAIN - if MAX_TX_QUEUE_MSGS messages are already queued on the handle
+ * @return ENOMEM - if failed to allocate the handle queue
+ * @return EOPNOTSUPP - if handle is a shm session, coalesces its messages or
+ *         sends with MSG_ZEROCOPY
+ * @return EBUSY - if handle sends on channels
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function if the connection failed
+ */
+int
+comm_lib_tcp_send_async(handle_t handle, uint8_t *payload,
+                        uint32_t payload_len,
+                        const struct register_to_send_completion *clbk_st);
+
+
+/**
+ * coalesce the messages sent on a TCP connection.
+ * Messages sent by comm_lib_tcp_send_blocking/comm_lib_tcp_send_batch_blocking
+ * are framed into a buffer of max_bytes instead of being sent one by one.
+ * The buffer is sent once it is full, once max_delay_usec passed since the
+ * oldest buffered message, or by comm_lib_tcp_flush. A message which doesn't
+ * fit in an empty buffer is sent directly, after the buffered ones.
+ * Since a send completes once the message was buffered, errors of a later
+ * flush are returned by the next send/flush on the handle.
+ * Setting max_bytes = 0 flushes the buffer and stops coalescing, the buffer
+ * is also flushed when the handle is closed.
+ * Don't call concurrently with the send functions on the same handle.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in] max_bytes - buffer size (1-MAX_COALESCE_BYTES), 0 to stop
+ * @param[in] max_delay_usec - the longest time a message is buffered
+ *                             (1-MAX_COALESCE_DELAY_USEC)
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle isn't a TCP handle or a parameter is out of range
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if comm_lib_tcp_send_async was used on the handle
+ * @return ENOMEM - if failed to allocate the buffer
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg/timerfd_create functions
+ */
+int
+comm_lib_tcp_coalesce_set(handle_t handle, uint32_t max_bytes,
+                          uint32_t max_delay_usec);
+
+
+/**
+ * send the messages coalesced on a TCP connection, blocking until they
+ * are sent. Does nothing if the handle doesn't coalesce its messages.
+ *
+ * @param[in] handle - the TCP handle
+ *
+ * @return 0 if operation completes successfully
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function, including errors of
+ *         earlier flushes by the reactor
+ */
+int
+comm_lib_tcp_flush(handle_t handle);
+
+
+/**
+ * send the large messages of a TCP connection with MSG_ZEROCOPY.
+ * A blocking send of min_bytes or more (metadata included) pins the payload
+ * pages instead of copying them to the socket buffer, and returns only once
+ * the kernel notified on the socket error queue that it released them, so
+ * the caller may reuse the payload buffer as usual.
+ * The MSG_ZEROCOPY sends of a handle run one at a time. A send whose pages
+ * weren't released within the socket send timeout (SO_SNDTIMEO, or
+ * ZEROCOPY_WAIT_MSEC if not set) fails with ETIMEDOUT: the connection is
+ * reset, which drops the queued data and releases the pages before the send
+ * returns, and the handle must be closed.
+ * Not used on a handle which coalesces its messages.
+ * Setting min_bytes = 0 stops using MSG_ZEROCOPY.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in] min_bytes - smallest message sent with MSG_ZEROCOPY
+ *                        (MIN_ZEROCOPY_BYTES-MAX_JUMBO_TCP_PAYLOAD), 0 to stop
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle isn't a TCP handle or min_bytes is out of range
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session or a UNIX domain socket
+ * @return EBUSY - if comm_lib_tcp_send_async was used on the handle
+ * @return ENOMEM - if failed to allocate the zerocopy state
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function
+ */
+int
+comm_lib_tcp_zerocopy_set(handle_t handle, uint32_t min_bytes);
+
+
+/**
+ * set the priority of a channel of a TCP connection.
+ * A channel carries the messages of one msg_type, sent by
+ * comm_lib_tcp_channel_send and received by comm_lib_tcp_channel_recv.
+ * Large messages are sent in chunks and a message of a higher priority
+ * channel is sent between two chunks, so small control messages don't wait
+ * behind a jumbo message of a bulk channel. Each channel has its own receive
+ * queue, a full queue stops the reading of the connection, so each channel
+ * the peer sends on must be received. The channels not set have the lowest
+ * priority.
+ * Both peers must use only the channel functions on the connection, which
+ * must be a GENERAL_MSG_TYPE connection.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in] msg_type - the channel
+ * @param[in] priority - 0 (the highest) - (TCP_CHANNEL_PRIORITIES_NUM - 1)
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle isn't a TCP handle of a GENERAL_MSG_TYPE
+ *                  connection or priority is out of range
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if handle coalesces its messages or
+ *                 comm_lib_tcp_send_async was used on it
+ * @return ENOMEM - if failed to allocate the channels
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function
+ */
+int
+comm_lib_tcp_channel_set(handle_t handle, uint8_t msg_type, uint8_t priority);
+
+
+/**
+ * send a message on a channel of a TCP connection, blocking until it is sent.
+ * A message larger than a chunk yields the connection after each chunk to the
+ * waiting senders of higher priority channels. Messages of one channel are
+ * sent one after another. See comm_lib_tcp_channel_set.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in] msg_type - the channel
+ * @param[in] payload - the data to send
+ * @param[in,out] payload_len - size of payload, updated to #bytes sent
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if payload == NULL or payload_len == NULL or handle isn't
+ *                  a TCP handle of a GENERAL_MSG_TYPE connection
+ * @return EOVERFLOW - if payload_len exceeds MAX JUMBO TCP SIZE message or is 0
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if handle coalesces its messages or
+ *                 comm_lib_tcp_send_async was used on it
+ * @return ENOMEM - if failed to allocate the channels
+ * @return EIO - if could not sent all buffer (after SEND_REPEAT_NUM retries)
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function, including errors of an
+ *         earlier send on the handle, which may have cut a message
+ */
+int
+comm_lib_tcp_channel_send(handle_t handle, uint8_t msg_type, uint8_t *payload,
+                          uint32_t *payload_len);
+
+
+/**
+ * receive a message of a channel of a TCP connection to a buffer of the
+ * library pool, blocking until one is received.
+ * Messages of other channels read meanwhile are queued to their channels,
+ * up to TCP_CHANNEL_RX_MSGS_MAX per channel. A message read while its
+ * channel is full stops the reading of the connection, by all the channels,
+ * till the channel's receiver takes one, so the sender is slowed by TCP flow
+ * control rather than losing messages.
+ * See comm_lib_tcp_channel_set.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in] msg_type - the channel
+ * @param[out] msg - the message, release its payload by
+ *                   comm_lib_recv_buffer_release
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if msg == NULL or handle isn't a TCP handle of a
+ *                  GENERAL_MSG_TYPE connection
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if handle coalesces its messages or
+ *                 comm_lib_tcp_send_async was used on it
+ * @return ECONNRESET or ENOTCONN - if connection on handle have been reset by peer
+ * @return EBADE - if peer magic is invalid
+ * @return EIO - if a message was received with an unknown version or
+ *               its chunks are out of order
+ * @return EOVERFLOW - if message size > MAX_JUMBO_TCP_PAYLOAD or meesage size = 0
+ * @return ENOMEM - if failed to allocate the channels or a message buffer
+ * @return EBUSY - if a receive callback is set on handle
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_channel_recv(handle_t handle, uint8_t msg_type,
+                          struct recv_msg *msg);
+
+
 /**
  * Receive the messages as stream of bytes over TCP connection
  * Can be used from server/clients side. blocking until at least one message is received.
  * payload_data->msg_num_recv > 0 when got message
  * if payload_data->jumbo_payload_len > 0 --> the message received on payload_data->jumbo_payload
+ * When max_msgs_to_recv > 1 all the complete messages already received (up to
+ * max_msgs_to_recv) are returned on payload_data->payload[0..], a jumbo
+ * message is always the last message returned.
+ * Bytes of further messages are kept in the handle buffer, the batch also
+ * ends early at a jumbo message or an invalid message, so before polling the
+ * handle receive again while comm_lib_tcp_recv_buffered_get reports messages.
  *
  * @param[in] max_msgs_to_recv - the maximum messages to receive (1-MAX_MSGS)
  * @param[in,out] addresser_st - server address, port.
@@ -466,7 +1410,12 @@ comm_lib_tcp_send_blocking(handle_t handle, uint8_t *payload,
  * @return ECONNRESET or ENOTCONN - if connection on handle have been reset by peer i.e socket not active
  * @return EBADE - if msg type received on socket is invalid
  * @return EOVERFLOW - if message size > MAX_TCP_PAYLOAD or meesage size = 0
- * @return EPERM - if max_msgs_to_recv > 1, currently the API supports one message each time
+ * @return EINVAL - if max_msgs_to_recv > MAX_MSGS
+ * @return ENOMEM - if failed to allocate the handle receive buffer
+ * @return EBUSY - if a receive callback is set on handle
+ * @return EIO - if a message was received with an unknown version
+ * @return ECONNABORTED - if a message failed midway on a previous call, the
+ *                        stream is out of sync and the handle must be closed
  */
 int
 comm_lib_tcp_recv_blocking(handle_t handle, struct addr_info *addresser_st,
@@ -474,21 +1423,141 @@ comm_lib_tcp_recv_blocking(handle_t handle, struct addr_info *addresser_st,
                            uint32_t max_msgs_to_recv);
 
 
+/**
+ * Receive the messages as stream of bytes over TCP connection to buffers of
+ * the library pool. Can be used from server/clients side. blocking until at
+ * least one message is received.
+ * Each message is returned on a buffer sized by its metadata payload_size,
+ * the caller owns the buffer till it releases it by
+ * comm_lib_recv_buffer_release. All the complete messages already received
+ * (up to *msgs_num) are returned, the batch also ends early at a partial or
+ * an invalid message, so before polling the handle receive again while
+ * comm_lib_tcp_recv_buffered_get reports messages. May be mixed with
+ * comm_lib_tcp_recv_blocking on the same handle.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[in,out] addresser_st - the peer address, port.
+ * @param[in,out] msgs - filled with the messages received
+ * @param[in,out] msgs_num - size of msgs, updated to #messages received
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if addresser_st == NULL or msgs == NULL or msgs_num == NULL or *msgs_num == 0 or handle type != TCP type
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return ECONNRESET or ENOTCONN - if connection on handle have been reset by peer i.e socket not active
+ * @return EBADE - if msg type received on socket is invalid or peer magic is invalid
+ * @return EOVERFLOW - if message size > MAX_JUMBO_TCP_PAYLOAD or meesage size = 0
+ * @return ENOMEM - if failed to allocate the handle receive buffer or a message buffer
+ * @return EBUSY - if a receive callback is set on handle
+ * @return EIO - if a message was received with an unknown version
+ * @return ECONNABORTED - if a message failed midway on a previous call, the
+ *                        stream is out of sync and the handle must be closed
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_recv_pooled(handle_t handle, struct addr_info *addresser_st,
+                         struct recv_msg *msgs, uint32_t *msgs_num);
+
+
+/**
+ * Get the number of messages already received to the buffer of a TCP handle
+ * by comm_lib_tcp_recv_blocking/comm_lib_tcp_recv_pooled and not returned
+ * yet. The socket isn't readable for these messages, so while *msgs_num > 0
+ * receive again before polling the handle. A buffered invalid message is
+ * counted as one message, its error is returned by the next receive.
+ *
+ * @param[in] handle - the TCP handle
+ * @param[out] msgs_num - #complete messages in the handle buffer
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if msgs_num == NULL or handle type != TCP type
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_tcp_recv_buffered_get(handle_t handle, uint32_t *msgs_num);
+
+
+/**
+ * Release a buffer returned by comm_lib_tcp_recv_pooled back to the pool.
+ *
+ * @param[in] payload - the message buffer
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if payload == NULL or payload isn't a pool buffer or was already released
+ */
+int
+comm_lib_recv_buffer_release(uint8_t *payload);
+
+
+/**
+ * receive the messages of a TCP or UDP handle by a callback, instead of a
+ * thread blocked on the handle. The messages are parsed and delivered by the
+ * reactor threads (see comm_lib_init_params.reactor_threads_num), so the
+ * number of threads doesn't grow with the handles. The callbacks of one handle
+ * are called one at a time, each with one message (a datagram on UDP).
+ * A failed handle (e.g. reset by peer) is reported once with rc < 0 and
+ * isn't received anymore. Dropped datagrams are counted on rx_errors.
+ * The receive functions fail with EBUSY on the handle while the callback is
+ * set. Stopping drops the bytes of a message not received completely, so a
+ * TCP handle should be stopped only to be closed. Stopping is also done by
+ * closing the handle, and may be done from the callback.
+ * Stopping or closing from a callback, i.e. from any reactor thread, doesn't
+ * wait for a callback of the handle in progress on another reactor thread.
+ * Then the socket is closed once that callback returned.
+ *
+ * @param[in] handle - the TCP or UDP handle
+ * @param[in] clbk_st - the callback, NULL to stop
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle isn't a TCP or UDP handle or clbk_st->clbk_recv_func == NULL
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EOPNOTSUPP - if handle is a shm session
+ * @return EBUSY - if a callback is already set, handle sends on channels or
+ *                 receives large or reliable messages
+ * @return ENOMEM - if failed to allocate the receive buffer
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native epoll_ctl function
+ */
+int
+comm_lib_recv_callback_set(handle_t handle,
+                           const struct register_to_recv *clbk_st);
+
+
 /**
  * Get the server status.
  *
  * @param[in] server_id - the id of the server.
- * @param[in,out] server_status.
- * @param[out] None.
+ * @param[out] server_status - filled with the server status, owned by the caller.
  *
  *
  * @return 0 if operation completes successfully
  * @return EINVAL if server_status == NULL
+ * @return ENOKEY if server_id is out of bound or the server was never started.
+ */
+int
+comm_lib_tcp_server_status_get(struct server_status *server_status,
+                               uint16_t server_id);
+
+
+/**
+ * Get the status of the clients connected to the server, page by page.
+ * Clients are returned in the server table order, so a client accepted or
+ * closed between calls may shift the following pages.
+ *
+ * @param[in] server_id - the id of the server
+ * @param[in] offset - #clients to skip
+ * @param[in,out] status_arr - filled with the clients status
+ * @param[in,out] status_num - size of status_arr, updated to #clients filled
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if status_arr == NULL or status_num == NULL
  * @return ENOKEY if server_id is out of bound.
+ * @return EPERM if library didn't finish init
  */
 int
-comm_lib_tcp_server_status_get(
-    const struct server_status const **server_status, uint16_t server_id);
+comm_lib_tcp_server_clients_status_get(uint16_t server_id, uint32_t offset,
+                                       struct connection_status *status_arr,
+                                       uint32_t *status_num);
 
 
 /**
@@ -511,6 +1580,99 @@ int
 comm_lib_tcp_handle_status_get(struct connection_status *connection_status);
 
 
+/**
+ * Trace the messages sent on a handle (TCP or UDP). Messages sent by
+ * comm_lib_udp_send, comm_lib_udp_sendv, comm_lib_udp_send_batch,
+ * comm_lib_tcp_send_blocking, comm_lib_tcp_send_batch_blocking and
+ * comm_lib_tcp_send_async carry MSG_TRACE_VERSION metadata, followed by a
+ * sequence number of the handle and the sender CLOCK_MONOTONIC time (of the
+ * queueing, for async sends). A datagram which doesn't fit MAX_UDP_MSG_SIZE
+ * with the trace is sent without it. Channel, large and reliable messages
+ * aren't traced.
+ * An older peer rejects the traced messages as invalid (its receive fails
+ * with EIO), so the version is negotiated: with MSG_TRACE_ON_PEER the
+ * messages are traced only once a traced message was received on the
+ * handle, which an older peer never sends. One end, whose peers are known
+ * to accept MSG_TRACE_VERSION, starts with MSG_TRACE_ALWAYS. A UDP handle
+ * traces its datagrams to all the recipients once any peer traced.
+ * The receivers accept both versions; per handle they count the sequence
+ * numbers skipped in rx_gaps and the late ones in rx_reorders. The latency
+ * subtracts the CLOCK_MONOTONIC times of the two peers, so the time from the
+ * send to the receive is added to the HANDLE_HIST_RX_LATENCY histogram only
+ * for a peer on the same host: a loopback peer, a UNIX domain or shm session,
+ * or a TCP connection whose local and peer addresses match. A message of such
+ * a peer received before its send time is counted in rx_clock_skews. The
+ * sequence restarts on a message of another sender, and a UDP handle numbers
+ * its datagrams to all the recipients in one sequence, so gaps are meaningful
+ * between two peers only.
+ *
+ * @param[in] handle - the handle
+ * @param[in] mode - when the messages sent are traced, MSG_TRACE_OFF to stop
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if mode is invalid
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_msg_trace_set(handle_t handle, enum msg_trace_mode mode);
+
+
+/**
+ * Get the traffic counters of a handle (TCP or UDP).
+ * The counters are updated lock free on the data path and read here.
+ *
+ * @param[in] handle - the handle.
+ * @param[in,out] stats - the handle counters.
+ * @param[out] None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if stats == NULL
+ * @return ENOKEY - if handle wasn't found
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_stats_get(handle_t handle, struct handle_stats *stats);
+
+
+/**
+ * Get the histograms of a handle (TCP or UDP).
+ * The histograms are updated lock free by the low level send/recv calls.
+ *
+ * @param[in] handle - the handle.
+ * @param[in,out] hists - the handle histograms.
+ * @param[out] None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if hists == NULL
+ * @return ENOKEY - if handle wasn't found
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_stats_histograms_get(handle_t handle,
+                              struct handle_histograms *hists);
+
+
+/**
+ * Dump the counters and the non empty histogram buckets of a handle
+ * as text, one line per counters/histogram, e.g.
+ * "tx_time_ns count 10 sum 52000 buckets 4096:8 8192:2"
+ * where each bucket is given by its lower bound.
+ *
+ * @param[in] handle - the handle.
+ * @param[in,out] buffer - the text, always NULL terminated.
+ * @param[in] buffer_len - size of buffer.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if buffer == NULL or buffer_len == 0
+ * @return ENOKEY - if handle wasn't found
+ * @return EOVERFLOW - if the text was truncated to buffer_len
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_stats_dump(handle_t handle, char *buffer, uint32_t buffer_len);
+
+
 /**
  * Open a UDP socket connection from specific types
  *
@@ -520,8 +1682,15 @@ comm_lib_tcp_handle_status_get(struct connection_status *connection_status);
  *
  * Global Variables Referred & Modified: None
  *
+ * With CONN_TYPE_UDP_IP_MC, a CONN_SERVER connection joins
+ * params->fields.mc_udp_params.group_ipv4_addr, and a datagram sent to the
+ * group address is received by all the members. The connection is bound to
+ * the port on any address, and receives only the groups joined on it (by
+ * comm_lib_udp_mc_group_join too) and the unicast datagrams to the port.
+ *
  * @return 0 if operation completes successfully
- * @return EINVAL Invalid argument - handle==null.
+ * @return EINVAL Invalid argument - handle==null, or a multicast
+ *         group_ipv4_addr which isn't a multicast address.
  * @return EKEYREJECTED Key was rejected by service - param.type is unsupported.
  * @return ENOBUFS or ENOMEM or EACCES is creation of socket fails. SOCKET(2) in Linux Programmer's Manual
  * @return EACCES or EADDRINUSE or EBADF or EINVAL and more  if binding the socket fails.
@@ -551,6 +1720,43 @@ int
 comm_lib_udp_session_stop(handle_t handle);
 
 
+/**
+ * Join a multicast group on a UDP connection, datagrams sent to the group
+ * and the connection port are received on the handle.
+ *
+ * @param[in] handle - the udp handle
+ * @param[in] group_ipv4_addr - the multicast group (network order)
+ * @param[in] if_ipv4_addr - the local interface address (network order, 0 - any)
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if group_ipv4_addr isn't a multicast address
+ * @return ENOKEY if handle wasn't found.
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function (EADDRINUSE if already joined)
+ */
+int
+comm_lib_udp_mc_group_join(handle_t handle, uint32_t group_ipv4_addr,
+                           uint32_t if_ipv4_addr);
+
+
+/**
+ * Leave a multicast group joined on a UDP connection
+ *
+ * @param[in] handle - the udp handle
+ * @param[in] group_ipv4_addr - the multicast group (network order)
+ * @param[in] if_ipv4_addr - the local interface address it was joined on
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if group_ipv4_addr isn't a multicast address
+ * @return ENOKEY if handle wasn't found.
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native setsockopt function (EADDRNOTAVAIL if not joined)
+ */
+int
+comm_lib_udp_mc_group_leave(handle_t handle, uint32_t group_ipv4_addr,
+                            uint32_t if_ipv4_addr);
+
+
 /**
  * Send payload over a UDP connection
  *
@@ -574,6 +1780,30 @@ comm_lib_udp_send(handle_t handle, struct addr_info recipient_st,
                   uint8_t *payload, uint32_t *payload_len);
 
 
+/**
+ * Send a payload gathered from several buffers over a UDP connection
+ * The metadata and the buffers are passed to the socket as is, without
+ * copying the payload to a staging buffer.
+ *
+ * @param[in] handle - the handle to send data.
+ * @param[in] recipient_st - the information of the recipient (address and port)
+ * @param[in] payload_iov - the payload buffers.
+ * @param[in] iov_num - #payload buffers (1-MAX_UDP_PAYLOAD_IOV)
+ * @param[out] payload_len - filled with actual #payload bytes sent.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if payload_iov == NULL or payload_len == NULL or iov_num is out of range
+ * @return EOVERFLOW if total payload > MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata)
+ * @return ENOKEY if handle wasn't found.
+ * @return EIO if failed to send all payload
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_udp_sendv(handle_t handle, struct addr_info recipient_st,
+                   const struct iovec *payload_iov, uint32_t iov_num,
+                   uint32_t *payload_len);
+
+
 /**
  * Receive payload over a UDP connection
  *
@@ -590,10 +1820,207 @@ comm_lib_udp_send(handle_t handle, struct addr_info recipient_st,
  * @return EIO if failed to receive any part of the message
  * @return EBADE if got data from unhallowed peer or corrupted data
  * @return EINVAL if payloand_len == 0 || payload
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 large or reliable messages
  * @return EPERM if library didn't finish init
  */
 int
 comm_lib_udp_recv(handle_t handle, struct addr_info *addresser_st,
                   uint8_t *payload, uint32_t *payload_len);
 
+
+/**
+ * Send several datagrams over a UDP connection
+ * The datagrams are sent with few sendmmsg() calls, the handle lookup and
+ * statistics update are done once per call.
+ *
+ * @param[in] handle - the handle to send data.
+ * @param[in] msgs - the datagrams to send, msgs[i].addr is the recipient.
+ * @param[in,out] msgs_num - #datagrams to send, filled with #datagrams sent.
+ * @param[out] - None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if msgs == NULL or msgs_num == NULL or a payload == NULL
+ * @return EOVERFLOW if a payload_len > MAX_UDP_MSG_SIZE - sizeof(struct msg_metadata)
+ * @return ENOKEY if handle wasn't found.
+ * @return EIO if failed to send all datagrams
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_udp_send_batch(handle_t handle, struct udp_msg *msgs,
+                        uint32_t *msgs_num);
+
+
+/**
+ * Receive several datagrams over a UDP connection
+ * Blocking until at least one datagram is received, then returns the
+ * datagrams already queued on the socket (up to msgs_num).
+ * A datagram which failed validation is returned with payload_len == 0.
+ *
+ * @param[in] handle - the handle to receive the data
+ * @param[in,out] msgs - the receive buffers; payload_len (buffer size) is
+ *                       filled with #bytes received and addr with the addresser
+ * @param[in,out] msgs_num - #buffers, filled with #datagrams received
+ * @param[out] None.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if msgs == NULL or msgs_num == NULL or msgs_num == 0
+ *                or a payload == NULL or a payload_len == 0
+ * @return ENOKEY if handle wasn't found.
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 large or reliable messages
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native recvmmsg function
+ */
+int
+comm_lib_udp_recv_batch(handle_t handle, struct udp_msg *msgs,
+                        uint32_t *msgs_num);
+
+
+/**
+ * Send a message up to MAX_UDP_LARGE_PAYLOAD bytes over a UDP connection.
+ * A payload larger than MAX_UDP_PAYLOAD is sent in fragments, handed to the
+ * socket UDP_GSO_SEGMENTS_NUM at a time with UDP segmentation offload
+ * (UDP_SEGMENT, linux 4.18), or with sendmmsg() where it isn't supported.
+ * The recipient receives it with comm_lib_udp_large_recv.
+ *
+ * @param[in] handle - the handle to send data.
+ * @param[in] recipient_st - the information of the recipient (address and port)
+ * @param[in] payload - data to send.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes sent.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0
+ * @return EOVERFLOW if payload_len > MAX_UDP_LARGE_PAYLOAD
+ * @return ENOKEY if handle wasn't found.
+ * @return EIO if failed to send all payload
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_udp_large_send(handle_t handle, struct addr_info recipient_st,
+                        uint8_t *payload, uint32_t *payload_len);
+
+
+/**
+ * Receive a message sent by comm_lib_udp_large_send, or a datagram sent by
+ * the other UDP send functions, over a UDP connection.
+ * The first call turns on UDP_GRO on the socket, so the kernel may coalesce
+ * the fragments of a sender to one datagram. The fragments are reassembled
+ * in a table of UDP_REASSEMBLY_MSGS messages keyed by the sender and the
+ * message sequence number; once it's full, the message updated least
+ * recently is dropped. Then comm_lib_udp_recv, comm_lib_udp_recv_batch and
+ * comm_lib_recv_callback_set fail on the handle.
+ *
+ * @param[in] handle - the handle to receive the data
+ * @param[out] addresser_st - the information of the addresser (address and port)
+ * @param[out] payload - data received.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes received.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0
+ * @return EOVERFLOW if payload_len is insufficient, the message is dropped.
+ * @return EIO if a datagram holds a partial or an inconsistent fragment
+ * @return EBADE if got data from unhallowed peer or corrupted data
+ * @return ENOKEY if handle wasn't found.
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 reliable messages
+ * @return ENOMEM - if failed to allocate the reassembly table or a message buffer
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native recvmsg/setsockopt functions
+ */
+int
+comm_lib_udp_large_recv(handle_t handle, struct addr_info *addresser_st,
+                        uint8_t *payload, uint32_t *payload_len);
+
+
+/**
+ * Deliver the messages of a UDP connection in order and without loss.
+ * Messages sent by comm_lib_udp_reliable_send carry a sequence number per
+ * peer; the reactor threads receive them, ack them with selective acks and
+ * queue them in order for comm_lib_udp_reliable_recv. A message not acked
+ * within the retransmission timeout (measured per peer) is retransmitted.
+ * Once a message was retransmitted UDP_RELIABLE_RETRIES_MAX times the peer
+ * fails on both ends: the messages not acked are given up and the sends to
+ * it fail, the receiver gets the messages received in order and then
+ * ECONNRESET in place of the rest. Its later messages are dropped until
+ * the sender forgot the peer, a message isn't skipped silently.
+ * At most UDP_RELIABLE_WINDOW messages to a peer are not acked at a time,
+ * and the acks stop while the delivery queue is full, so a slow receiver
+ * blocks its senders. A peer which restarted is detected by its magic.
+ * A peer nothing was sent to or received from for
+ * UDP_RELIABLE_PEER_IDLE_MSEC, and with no message in flight, is forgotten;
+ * the next message starts a new sequence. Both ends set it. Then
+ * comm_lib_udp_recv, comm_lib_udp_recv_batch, comm_lib_udp_large_recv and
+ * comm_lib_recv_callback_set fail on the handle.
+ *
+ * @param[in] handle - the udp handle
+ * @param[in] is_enabled - 1 to deliver reliably, 0 to drop the peers and
+ *                         the messages not delivered
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - if handle isn't a UDP handle
+ * @return ENOKEY - if handle doesn't exist in library DB
+ * @return EBUSY - if a receive callback is set on handle, or it receives
+ *                 large messages
+ * @return ENOMEM - if failed to allocate the peers table
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native epoll_ctl/timerfd_create functions
+ */
+int
+comm_lib_udp_reliable_set(handle_t handle, int is_enabled);
+
+
+/**
+ * Send a message to a peer of a reliable UDP connection, blocking while
+ * UDP_RELIABLE_WINDOW messages to the peer are not acked.
+ * Returns once the message was sent, it's retransmitted until acked.
+ *
+ * @param[in] handle - the handle to send data.
+ * @param[in] recipient_st - the information of the recipient (address and port)
+ * @param[in] payload - data to send.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes sent.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0,
+ *                or reliable delivery isn't set on handle
+ * @return EOVERFLOW if payload_len > MAX_UDP_RELIABLE_PAYLOAD
+ * @return ENOKEY if handle wasn't found.
+ * @return ETIMEDOUT if messages to the peer were given up and it wasn't
+ *                   forgotten since, the message wasn't sent
+ * @return ECANCELED if reliable delivery was turned off meanwhile
+ * @return ENOBUFS if the handle has UDP_RELIABLE_PEERS_MAX peers not idle
+ * @return ENOMEM if failed to allocate the peer or the message
+ * @return EPERM if library didn't finish init
+ * @return errno codes of native sendmsg function
+ */
+int
+comm_lib_udp_reliable_send(handle_t handle, struct addr_info recipient_st,
+                           uint8_t *payload, uint32_t *payload_len);
+
+
+/**
+ * Receive the next message of a reliable UDP connection, blocking until
+ * one is delivered. The messages of each peer are received in the order
+ * they were sent, a failed peer is received as ECONNRESET after the last
+ * message it delivered.
+ *
+ * @param[in] handle - the handle to receive the data
+ * @param[out] addresser_st - the information of the addresser (address and port)
+ * @param[out] payload - data received.
+ * @param[in,out] payload_len - sizeof the payload, filled with actual #bytes received.
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL if payload == NULL or payload_len == NULL or *payload_len == 0,
+ *                or reliable delivery isn't set on handle
+ * @return EOVERFLOW if payload_len is insufficient, the message is dropped.
+ * @return ENOKEY if handle wasn't found.
+ * @return ECONNRESET if the peer filled in addresser_st gave up messages
+ *                    to the handle, its next ones weren't received
+ * @return ECANCELED if reliable delivery was turned off meanwhile
+ * @return EPERM if library didn't finish init
+ */
+int
+comm_lib_udp_reliable_recv(handle_t handle, struct addr_info *addresser_st,
+                           uint8_t *payload, uint32_t *payload_len);
+
 #endif /* LIB_COMMU_H_ */
@@ -0,0 +1,947 @@
+/* Copyright (c) 2014  Mellanox Technologies, Ltd. All rights reserved.
+ *
+ * This software is available to you under BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * libcommu_bench - loopback benchmark of the communication library.
+ *
+ * Runs both peers of every case in one process and prints one JSON object
+ * per case and payload size on stdout:
+ *   pingpong - one message in flight, latency is the round trip
+ *   stream   - one way send_blocking stream, latency is send to receive
+ *   fanin    - several TCP clients streaming to one server
+ *   udp      - UDP bursts of BENCH_UDP_BURST datagrams, lost ones are counted
+ * The TCP cases run over TCP, UNIX domain and shared memory sessions.
+ */
+
+#include "lib_commu.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <arpa/inet.h>
+
+/************************************************
+ *  Local Defines
+ ***********************************************/
+
+#define BENCH_BASE_PORT         (17400)
+#define BENCH_MSG_TYPE          (5)
+#define BENCH_DEFAULT_MSGS      (20000)
+#define BENCH_DEFAULT_CLIENTS   (8)
+#define BENCH_MAX_CLIENTS       (256)
+#define BENCH_MIN_MSGS          (64)  /* per case, even for the largest payloads */
+#define BENCH_BYTES_BUDGET      (256ULL * 1024 * 1024) /* bytes sent per case */
+#define BENCH_RECV_MSGS         (16)  /* comm_lib_tcp_recv_pooled batch */
+#define BENCH_UDP_BURST         (64)  /* datagrams per comm_lib_udp_send_batch */
+#define BENCH_UDP_WINDOW        (4 * BENCH_UDP_BURST) /* datagrams in flight before a burst waits */
+#define BENCH_UDP_WINDOW_NSEC   (1000000) /* longest wait for the window, datagrams may be lost */
+#define BENCH_UDP_END_WAIT_USEC (10000)
+#define BENCH_STAMP_SIZE        (sizeof(uint64_t))
+#define BENCH_MAX_TCP_SIZE      (MAX_JUMBO_TCP_PAYLOAD - 16) /* leaves room for the message metadata */
+
+/************************************************
+ *  Local Type definitions
+ ***********************************************/
+
+enum bench_transport {
+    BENCH_TRANSPORT_TCP,
+    BENCH_TRANSPORT_UNIX,
+    BENCH_TRANSPORT_SHM,
+    BENCH_TRANSPORT_NUM
+};
+
+/**
+ * bench_pair structure is used to store
+ * the two handles of a connection and its server
+ */
+struct bench_pair {
+    enum bench_transport transport;
+    handle_t client;                        /**< the sending side */
+    handle_t server[BENCH_MAX_CLIENTS];     /**< the accepted side(s) */
+    uint32_t server_num;                    /**< #accepted, updated by the reactor */
+    uint16_t server_id;                     /**< the TCP/UNIX server */
+    uint8_t is_server_started;
+};
+
+/**
+ * bench_result structure is used to store
+ * the measurements of one case
+ */
+struct bench_result {
+    const char *name;
+    const char *transport;
+    uint32_t size;          /**< payload bytes */
+    uint32_t clients;
+    uint64_t msgs;          /**< messages sent */
+    uint64_t lost;          /**< messages sent and never received */
+    uint64_t elapsed_ns;
+    uint64_t *samples;      /**< latency of every received message */
+    uint64_t samples_num;
+};
+
+/**
+ * bench_peer structure is used to pass
+ * the work of one thread of a case
+ */
+struct bench_peer {
+    pthread_t thread;
+    handle_t handle;
+    uint32_t size;
+    uint64_t msgs;
+    uint64_t *samples;      /**< receivers only - room for msgs samples */
+    uint64_t samples_num;
+    volatile int *is_done;  /**< udp receiver only - set once the sender is done */
+    int err;
+};
+
+/************************************************
+ *  Local variables
+ ***********************************************/
+
+static const char *transport_names[BENCH_TRANSPORT_NUM] = {"tcp", "unix", "shm"};
+
+static const uint32_t tcp_sizes[] = {
+    16, 64, 256, 1024, MAX_TCP_PAYLOAD, 64 * 1024, 512 * 1024,
+    BENCH_MAX_TCP_SIZE
+};
+
+static const uint32_t udp_sizes[] = {16, 64, 256, 1024, MAX_UDP_PAYLOAD};
+
+static uint64_t msgs_per_case = BENCH_DEFAULT_MSGS;
+static uint32_t fanin_clients = BENCH_DEFAULT_CLIENTS;
+static uint16_t next_port = BENCH_BASE_PORT;
+
+/************************************************
+ *  Local function declarations
+ ***********************************************/
+
+static uint64_t time_ns_get(void);
+
+static uint64_t case_msgs_get(uint32_t size);
+
+static int sample_cmp(const void *a, const void *b);
+
+static void result_print(struct bench_result *result);
+
+static int bench_new_handle(handle_t new_handle, struct addr_info peer_addr_st,
+                            void *data, int rc);
+
+static int pair_open(struct bench_pair *pair, enum bench_transport transport,
+                     uint32_t clients, handle_t *clients_handles);
+
+static void pair_close(struct bench_pair *pair, handle_t *clients_handles,
+                       uint32_t clients);
+
+static int msgs_send(handle_t handle, uint8_t *buffer, uint32_t size,
+                     uint64_t msgs);
+
+static int msgs_recv(handle_t handle, uint64_t msgs, uint64_t *samples,
+                     uint64_t *samples_num);
+
+static void * sender_thread(void *args);
+
+static void * receiver_thread(void *args);
+
+static void * echo_thread(void *args);
+
+static void * udp_receiver_thread(void *args);
+
+static int pingpong_run(enum bench_transport transport, uint32_t size);
+
+static int stream_run(enum bench_transport transport, uint32_t size);
+
+static int fanin_run(uint32_t size);
+
+static int udp_run(uint32_t size);
+
+/************************************************
+ *  Function implementations
+ ***********************************************/
+
+static uint64_t
+time_ns_get(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the large payloads are limited by BENCH_BYTES_BUDGET */
+static uint64_t
+case_msgs_get(uint32_t size)
+{
+    uint64_t msgs = BENCH_BYTES_BUDGET / size;
+
+    if (msgs > msgs_per_case) {
+        msgs = msgs_per_case;
+    }
+    if (msgs < BENCH_MIN_MSGS) {
+        msgs = BENCH_MIN_MSGS;
+    }
+    return msgs;
+}
+
+static int
+sample_cmp(const void *a, const void *b)
+{
+    uint64_t sa = *(const uint64_t *)a;
+    uint64_t sb = *(const uint64_t *)b;
+
+    return (sa > sb) - (sa < sb);
+}
+
+static void
+result_print(struct bench_result *result)
+{
+    double secs = result->elapsed_ns / 1e9;
+    uint64_t received = result->msgs - result->lost;
+    uint64_t p50 = 0, p99 = 0, p999 = 0;
+
+    if (secs <= 0) {
+        secs = 1e-9;
+    }
+
+    if (result->samples_num > 0) {
+        qsort(result->samples, result->samples_num, sizeof(uint64_t),
+              sample_cmp);
+        p50 = result->samples[result->samples_num * 50 / 100];
+        p99 = result->samples[result->samples_num * 99 / 100];
+        p999 = result->samples[result->samples_num * 999 / 1000];
+    }
+
+    printf("{\"case\":\"%s\",\"transport\":\"%s\",\"size\":%u,"
+           "\"clients\":%u,\"msgs\":%llu,\"lost\":%llu,\"secs\":%.6f,"
+           "\"msgs_per_sec\":%.0f,\"mb_per_sec\":%.2f,"
+           "\"p50_ns\":%llu,\"p99_ns\":%llu,\"p999_ns\":%llu}\n",
+           result->name, result->transport, result->size, result->clients,
+           (unsigned long long)result->msgs, (unsigned long long)result->lost,
+           secs, received / secs,
+           (double)received * result->size / secs / (1024 * 1024),
+           (unsigned long long)p50, (unsigned long long)p99,
+           (unsigned long long)p999);
+    fflush(stdout);
+}
+
+/* called from the reactor for every accepted connection */
+static int
+bench_new_handle(handle_t new_handle, struct addr_info peer_addr_st,
+                 void *data, int rc)
+{
+    struct bench_pair *pair = (struct bench_pair *)data;
+    uint32_t index = 0;
+
+    (void)peer_addr_st;
+
+    if (rc != 0) {
+        fprintf(stderr, "accept failed: %s\n", strerror(-rc));
+        return 0;
+    }
+
+    index = __atomic_load_n(&pair->server_num, __ATOMIC_RELAXED);
+    pair->server[index] = new_handle;
+    __atomic_store_n(&pair->server_num, index + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+ * opens a server and clients connected to it, clients_handles may be NULL
+ * for one client which is stored in pair->client
+ */
+static int
+pair_open(struct bench_pair *pair, enum bench_transport transport,
+          uint32_t clients, handle_t *clients_handles)
+{
+    int err = 0;
+    uint32_t i = 0;
+    uint16_t port = next_port++;
+    struct session_params params;
+    struct connection_info conn_info;
+    struct register_to_new_handle clbk_st;
+    handle_t *handles = (clients_handles != NULL) ? clients_handles :
+                        &pair->client;
+
+    memset(pair, 0, sizeof(*pair));
+    memset(&params, 0, sizeof(params));
+    memset(&conn_info, 0, sizeof(conn_info));
+    pair->transport = transport;
+    pair->client = INVALID_HANDLE_ID;
+
+    conn_info.d_ipv4_addr = htonl(INADDR_LOOPBACK);
+    conn_info.d_port = htons(port);
+    conn_info.msg_type = BENCH_MSG_TYPE;
+
+    if (transport == BENCH_TRANSPORT_SHM) {
+        err = comm_lib_shm_session_start(&conn_info, &pair->server[0]);
+        if (err == 0) {
+            pair->server_num = 1;
+            err = comm_lib_shm_session_start(&conn_info, &pair->client);
+        }
+        goto out;
+    }
+
+    params.port = htons(port);
+    params.s_ipv4_addr = htonl(INADDR_LOOPBACK);
+    params.msg_type = BENCH_MSG_TYPE;
+    params.transport = (transport == BENCH_TRANSPORT_UNIX) ?
+                       STREAM_TRANSPORT_UNIX : STREAM_TRANSPORT_TCP;
+    conn_info.transport = params.transport;
+    clbk_st.clbk_notify_func = bench_new_handle;
+    clbk_st.data = pair;
+
+    err = comm_lib_tcp_server_session_start(params, &clbk_st,
+                                            &pair->server_id);
+    if (err) {
+        goto out;
+    }
+    pair->is_server_started = 1;
+
+    for (i = 0; i < clients; i++) {
+        handles[i] = INVALID_HANDLE_ID;
+    }
+    for (i = 0; i < clients; i++) {
+        err = comm_lib_tcp_client_blocking_start(&conn_info, &handles[i]);
+        if (err) {
+            goto out;
+        }
+    }
+
+    while (__atomic_load_n(&pair->server_num, __ATOMIC_ACQUIRE) < clients) {
+        usleep(100);
+    }
+
+out:
+    if (err) {
+        fprintf(stderr, "%s session on port %u failed: %s\n",
+                transport_names[transport], port, strerror(-err));
+    }
+    return err;
+}
+
+static void
+pair_close(struct bench_pair *pair, handle_t *clients_handles,
+           uint32_t clients)
+{
+    uint32_t i = 0;
+    handle_t handles[BENCH_MAX_CLIENTS];
+
+    if (clients_handles == NULL) {
+        clients_handles = &pair->client;
+        clients = 1;
+    }
+    for (i = 0; i < clients; i++) {
+        if (clients_handles[i] != INVALID_HANDLE_ID) {
+            (void)comm_lib_tcp_peer_stop(clients_handles[i]);
+        }
+    }
+
+    if (pair->transport == BENCH_TRANSPORT_SHM) {
+        if (pair->server_num > 0) {
+            (void)comm_lib_tcp_peer_stop(pair->server[0]);
+        }
+    }
+    else if (pair->is_server_started) {
+        (void)comm_lib_tcp_server_session_stop(pair->server_id, handles,
+                                               BENCH_MAX_CLIENTS);
+    }
+}
+
+/* sends msgs messages stamped with the send time */
+static int
+msgs_send(handle_t handle, uint8_t *buffer, uint32_t size, uint64_t msgs)
+{
+    int err = 0;
+    uint64_t i = 0;
+    uint64_t stamp = 0;
+    uint32_t len = 0;
+
+    for (i = 0; i < msgs; i++) {
+        stamp = time_ns_get();
+        memcpy(buffer, &stamp, BENCH_STAMP_SIZE);
+        len = size;
+        err = comm_lib_tcp_send_blocking(handle, buffer, &len);
+        if (err) {
+            fprintf(stderr, "send on handle[%d] failed: %s\n", handle,
+                    strerror(-err));
+            break;
+        }
+    }
+    return err;
+}
+
+/* receives msgs messages, samples their send to receive time */
+static int
+msgs_recv(handle_t handle, uint64_t msgs, uint64_t *samples,
+          uint64_t *samples_num)
+{
+    int err = 0;
+    uint32_t i = 0, msgs_num = 0;
+    uint64_t stamp = 0, now = 0;
+    struct addr_info addr_st;
+    struct recv_msg recv_msgs[BENCH_RECV_MSGS];
+
+    *samples_num = 0;
+    while (*samples_num < msgs) {
+        msgs_num = BENCH_RECV_MSGS;
+        err = comm_lib_tcp_recv_pooled(handle, &addr_st, recv_msgs,
+                                       &msgs_num);
+        if (err) {
+            fprintf(stderr, "recv on handle[%d] failed: %s\n", handle,
+                    strerror(-err));
+            break;
+        }
+        now = time_ns_get();
+        for (i = 0; i < msgs_num; i++) {
+            memcpy(&stamp, recv_msgs[i].payload, BENCH_STAMP_SIZE);
+            samples[(*samples_num)++] = now - stamp;
+            comm_lib_recv_buffer_release(recv_msgs[i].payload);
+        }
+    }
+    return err;
+}
+
+static void *
+sender_thread(void *args)
+{
+    struct bench_peer *peer = (struct bench_peer *)args;
+    uint8_t *buffer = (uint8_t *)calloc(1, peer->size);
+
+    if (buffer == NULL) {
+        peer->err = -ENOMEM;
+        return NULL;
+    }
+    peer->err = msgs_send(peer->handle, buffer, peer->size, peer->msgs);
+    free(buffer);
+    return NULL;
+}
+
+static void *
+receiver_thread(void *args)
+{
+    struct bench_peer *peer = (struct bench_peer *)args;
+
+    peer->err = msgs_recv(peer->handle, peer->msgs, peer->samples,
+                          &peer->samples_num);
+    return NULL;
+}
+
+/* returns every message received until the peer closes the connection */
+static void *
+echo_thread(void *args)
+{
+    struct bench_peer *peer = (struct bench_peer *)args;
+    uint32_t i = 0, msgs_num = 0, len = 0;
+    struct addr_info addr_st;
+    struct recv_msg recv_msgs[BENCH_RECV_MSGS];
+
+    while (peer->err == 0) {
+        msgs_num = BENCH_RECV_MSGS;
+        peer->err = comm_lib_tcp_recv_pooled(peer->handle, &addr_st,
+                                             recv_msgs, &msgs_num);
+        for (i = 0; (peer->err == 0) && (i < msgs_num); i++) {
+            len = recv_msgs[i].payload_len;
+            peer->err = comm_lib_tcp_send_blocking(peer->handle,
+                                                   recv_msgs[i].payload,
+                                                   &len);
+            comm_lib_recv_buffer_release(recv_msgs[i].payload);
+        }
+        for (; i < msgs_num; i++) {
+            comm_lib_recv_buffer_release(recv_msgs[i].payload);
+        }
+    }
+    return NULL;
+}
+
+static int
+pingpong_run(enum bench_transport transport, uint32_t size)
+{
+    int err = 0;
+    uint64_t i = 0, start_ns = 0, sent_ns = 0;
+    uint32_t len = 0, msgs_num = 0;
+    uint8_t *buffer = NULL;
+    struct bench_pair pair;
+    struct bench_peer echo;
+    struct bench_result result;
+    struct addr_info addr_st;
+    struct recv_msg recv_msg;
+
+    memset(&echo, 0, sizeof(echo));
+    memset(&result, 0, sizeof(result));
+    result.name = "pingpong";
+    result.transport = transport_names[transport];
+    result.size = size;
+    result.clients = 1;
+    result.msgs = case_msgs_get(size);
+
+    buffer = (uint8_t *)calloc(1, size);
+    result.samples = (uint64_t *)calloc(result.msgs, sizeof(uint64_t));
+    if ((buffer == NULL) || (result.samples == NULL)) {
+        err = -ENOMEM;
+        goto out;
+    }
+
+    err = pair_open(&pair, transport, 1, NULL);
+    if (err) {
+        goto close;
+    }
+
+    echo.handle = pair.server[0];
+    err = -pthread_create(&echo.thread, NULL, echo_thread, &echo);
+    if (err) {
+        goto close;
+    }
+
+    start_ns = time_ns_get();
+    for (i = 0; i < result.msgs; i++) {
+        sent_ns = time_ns_get();
+        len = size;
+        err = comm_lib_tcp_send_blocking(pair.client, buffer, &len);
+        if (err) {
+            break;
+        }
+        msgs_num = 1;
+        err = comm_lib_tcp_recv_pooled(pair.client, &addr_st, &recv_msg,
+                                       &msgs_num);
+        if (err) {
+            break;
+        }
+        result.samples[result.samples_num++] = time_ns_get() - sent_ns;
+        comm_lib_recv_buffer_release(recv_msg.payload);
+    }
+    result.elapsed_ns = time_ns_get() - start_ns;
+    result.lost = result.msgs - result.samples_num;
+
+    /* the echo thread exits once the client is closed */
+    (void)comm_lib_tcp_peer_stop(pair.client);
+    pair.client = INVALID_HANDLE_ID;
+    pthread_join(echo.thread, NULL);
+
+    if (err == 0) {
+        result_print(&result);
+    }
+
+close:
+    pair_close(&pair, NULL, 0);
+out:
+    free(result.samples);
+    free(buffer);
+    return err;
+}
+
+static int
+stream_run(enum bench_transport transport, uint32_t size)
+{
+    int err = 0;
+    uint64_t start_ns = 0;
+    struct bench_pair pair;
+    struct bench_peer sender;
+    struct bench_result result;
+
+    memset(&sender, 0, sizeof(sender));
+    memset(&result, 0, sizeof(result));
+    result.name = "stream";
+    result.transport = transport_names[transport];
+    result.size = size;
+    result.clients = 1;
+    result.msgs = case_msgs_get(size);
+
+    result.samples = (uint64_t *)calloc(result.msgs, sizeof(uint64_t));
+    if (result.samples == NULL) {
+        return -ENOMEM;
+    }
+
+    err = pair_open(&pair, transport, 1, NULL);
+    if (err) {
+        goto close;
+    }
+
+    sender.handle = pair.client;
+    sender.size = size;
+    sender.msgs = result.msgs;
+    start_ns = time_ns_get();
+    err = -pthread_create(&sender.thread, NULL, sender_thread, &sender);
+    if (err) {
+        goto close;
+    }
+
+    err = msgs_recv(pair.server[0], result.msgs, result.samples,
+                    &result.samples_num);
+    result.elapsed_ns = time_ns_get() - start_ns;
+    result.lost = result.msgs - result.samples_num;
+    pthread_join(sender.thread, NULL);
+
+    if ((err == 0) && (sender.err == 0)) {
+        result_print(&result);
+    }
+
+close:
+    pair_close(&pair, NULL, 0);
+    free(result.samples);
+    return err ? err : sender.err;
+}
+
+static int
+fanin_run(uint32_t size)
+{
+    int err = 0;
+    uint32_t i = 0, senders_num = 0, receivers_num = 0;
+    uint64_t client_msgs = 0, start_ns = 0;
+    handle_t clients[BENCH_MAX_CLIENTS];
+    struct bench_pair pair;
+    struct bench_peer senders[BENCH_MAX_CLIENTS];
+    struct bench_peer receivers[BENCH_MAX_CLIENTS];
+    struct bench_result result;
+
+    memset(senders, 0, sizeof(senders));
+    memset(receivers, 0, sizeof(receivers));
+    memset(&result, 0, sizeof(result));
+    result.name = "fanin";
+    result.transport = transport_names[BENCH_TRANSPORT_TCP];
+    result.size = size;
+    result.clients = fanin_clients;
+    client_msgs = (case_msgs_get(size) + fanin_clients - 1) / fanin_clients;
+    result.msgs = client_msgs * fanin_clients;
+
+    result.samples = (uint64_t *)calloc(result.msgs, sizeof(uint64_t));
+    if (result.samples == NULL) {
+        return -ENOMEM;
+    }
+
+    err = pair_open(&pair, BENCH_TRANSPORT_TCP, fanin_clients, clients);
+    if (err) {
+        goto close;
+    }
+
+    start_ns = time_ns_get();
+    for (i = 0; (err == 0) && (i < fanin_clients); i++) {
+        receivers[i].handle = pair.server[i];
+        receivers[i].msgs = client_msgs;
+        receivers[i].samples = result.samples + i * client_msgs;
+        err = -pthread_create(&receivers[i].thread, NULL, receiver_thread,
+                              &receivers[i]);
+        if (err == 0) {
+            receivers_num++;
+        }
+    }
+    for (i = 0; (err == 0) && (i < fanin_clients); i++) {
+        senders[i].handle = clients[i];
+        senders[i].size = size;
+        senders[i].msgs = client_msgs;
+        err = -pthread_create(&senders[i].thread, NULL, sender_thread,
+                              &senders[i]);
+        if (err == 0) {
+            senders_num++;
+        }
+    }
+
+    for (i = 0; i < senders_num; i++) {
+        pthread_join(senders[i].thread, NULL);
+        err = err ? err : senders[i].err;
+    }
+    /* receivers still waiting for a sender which failed exit on close */
+    if (err) {
+        pair_close(&pair, clients, fanin_clients);
+        pair.is_server_started = 0;
+        memset(clients, 0xff, sizeof(clients));
+    }
+    for (i = 0; i < receivers_num; i++) {
+        pthread_join(receivers[i].thread, NULL);
+        err = err ? err : receivers[i].err;
+    }
+    result.elapsed_ns = time_ns_get() - start_ns;
+
+    if (err == 0) {
+        /* the receivers filled contiguous parts of the samples */
+        result.samples_num = result.msgs;
+        result_print(&result);
+    }
+
+close:
+    pair_close(&pair, clients, pair.is_server_started ? fanin_clients : 0);
+    free(result.samples);
+    return err;
+}
+
+static void *
+udp_receiver_thread(void *args)
+{
+    struct bench_peer *peer = (struct bench_peer *)args;
+    uint32_t i = 0, msgs_num = 0;
+    uint64_t stamp = 0, now = 0;
+    uint8_t (*buffers)[MAX_UDP_PAYLOAD] = NULL;
+    struct udp_msg msgs[BENCH_UDP_BURST];
+
+    buffers = calloc(BENCH_UDP_BURST, MAX_UDP_PAYLOAD);
+    if (buffers == NULL) {
+        peer->err = -ENOMEM;
+        return NULL;
+    }
+
+    while (peer->err == 0) {
+        for (i = 0; i < BENCH_UDP_BURST; i++) {
+            msgs[i].payload = buffers[i];
+            msgs[i].payload_len = MAX_UDP_PAYLOAD;
+        }
+        msgs_num = BENCH_UDP_BURST;
+        peer->err = comm_lib_udp_recv_batch(peer->handle, msgs, &msgs_num);
+        now = time_ns_get();
+        for (i = 0; (peer->err == 0) && (i < msgs_num); i++) {
+            memcpy(&stamp, msgs[i].payload, BENCH_STAMP_SIZE);
+            /* a zero stamp marks the end of the case */
+            if (stamp == 0) {
+                *peer->is_done = 1;
+                break;
+            }
+            if (peer->samples_num < peer->msgs) {
+                peer->samples[peer->samples_num] = now - stamp;
+                __atomic_store_n(&peer->samples_num, peer->samples_num + 1,
+                                 __ATOMIC_RELAXED);
+            }
+        }
+        if (*peer->is_done) {
+            break;
+        }
+    }
+
+    free(buffers);
+    return NULL;
+}
+
+static int
+udp_run(uint32_t size)
+{
+    int err = 0;
+    uint32_t i = 0, msgs_num = 0;
+    uint64_t sent = 0, start_ns = 0, window_ns = 0, stamp = 0;
+    uint16_t port = next_port;
+    volatile int is_done = 0;
+    uint8_t (*buffers)[MAX_UDP_PAYLOAD] = NULL;
+    handle_t server = INVALID_HANDLE_ID, client = INVALID_HANDLE_ID;
+    struct udp_params params;
+    struct udp_msg msgs[BENCH_UDP_BURST];
+    struct bench_peer receiver;
+    struct bench_result result;
+
+    next_port += 2;
+    memset(&params, 0, sizeof(params));
+    memset(&receiver, 0, sizeof(receiver));
+    memset(&result, 0, sizeof(result));
+    result.name = "udp";
+    result.transport = "udp";
+    result.size = size;
+    result.clients = 1;
+    result.msgs = case_msgs_get(size);
+
+    buffers = calloc(BENCH_UDP_BURST, MAX_UDP_PAYLOAD);
+    result.samples = (uint64_t *)calloc(result.msgs, sizeof(uint64_t));
+    if ((buffers == NULL) || (result.samples == NULL)) {
+        err = -ENOMEM;
+        goto out;
+    }
+
+    params.type = CONN_TYPE_UDP_IP_UC;
+    params.fields.ip_udp_params.session_params.port = htons(port);
+    params.fields.ip_udp_params.session_params.s_ipv4_addr =
+        htonl(INADDR_LOOPBACK);
+    params.fields.ip_udp_params.session_params.msg_type = BENCH_MSG_TYPE;
+    params.fields.ip_udp_params.connection_role = CONN_SERVER;
+    err = comm_lib_udp_session_start(&server, &params);
+    if (err) {
+        goto out;
+    }
+    params.fields.ip_udp_params.session_params.port = htons(port + 1);
+    err = comm_lib_udp_session_start(&client, &params);
+    if (err) {
+        goto out;
+    }
+
+    for (i = 0; i < BENCH_UDP_BURST; i++) {
+        msgs[i].addr.ipv4_addr = htonl(INADDR_LOOPBACK);
+        msgs[i].addr.port = htons(port);
+        msgs[i].payload = buffers[i];
+    }
+
+    receiver.handle = server;
+    receiver.msgs = result.msgs;
+    receiver.samples = result.samples;
+    receiver.is_done = &is_done;
+    err = -pthread_create(&receiver.thread, NULL, udp_receiver_thread,
+                          &receiver);
+    if (err) {
+        goto out;
+    }
+
+    start_ns = time_ns_get();
+    while ((err == 0) && (sent < result.msgs)) {
+        msgs_num = BENCH_UDP_BURST;
+        if (result.msgs - sent < msgs_num) {
+            msgs_num = result.msgs - sent;
+        }
+        stamp = time_ns_get();
+        for (i = 0; i < msgs_num; i++) {
+            memcpy(msgs[i].payload, &stamp, BENCH_STAMP_SIZE);
+            msgs[i].payload_len = size;
+        }
+        err = comm_lib_udp_send_batch(client, msgs, &msgs_num);
+        sent += msgs_num;
+
+        /* let the receiver drain the previous bursts */
+        window_ns = time_ns_get() + BENCH_UDP_WINDOW_NSEC;
+        while ((sent - __atomic_load_n(&receiver.samples_num,
+                                       __ATOMIC_RELAXED) > BENCH_UDP_WINDOW) &&
+               (time_ns_get() < window_ns)) {
+            sched_yield();
+        }
+    }
+    result.elapsed_ns = time_ns_get() - start_ns;
+
+    /* datagrams may be lost, repeat the end mark until it was received */
+    stamp = 0;
+    memcpy(msgs[0].payload, &stamp, BENCH_STAMP_SIZE);
+    while (!is_done && (receiver.err == 0)) {
+        msgs[0].payload_len = size;
+        msgs_num = 1;
+        (void)comm_lib_udp_send_batch(client, msgs, &msgs_num);
+        usleep(BENCH_UDP_END_WAIT_USEC);
+    }
+    pthread_join(receiver.thread, NULL);
+
+    result.msgs = sent;
+    result.samples_num = receiver.samples_num;
+    result.lost = sent - receiver.samples_num;
+    if ((err == 0) && (receiver.err == 0)) {
+        result_print(&result);
+    }
+    else if (err == 0) {
+        err = receiver.err;
+    }
+
+out:
+    if (err) {
+        fprintf(stderr, "udp case of size %u failed: %s\n", size,
+                strerror(-err));
+    }
+    if (client != INVALID_HANDLE_ID) {
+        (void)comm_lib_udp_session_stop(client);
+    }
+    if (server != INVALID_HANDLE_ID) {
+        (void)comm_lib_udp_session_stop(server);
+    }
+    free(result.samples);
+    free(buffers);
+    return err;
+}
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-n msgs] [-c clients] [-o pingpong|stream|fanin|udp]\n"
+            "  -n  messages per case (default %u), large payloads send less\n"
+            "  -c  fanin clients (1-%u, default %u)\n"
+            "  -o  run one case only\n",
+            name, BENCH_DEFAULT_MSGS, BENCH_MAX_CLIENTS,
+            BENCH_DEFAULT_CLIENTS);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int err = 0, opt = 0;
+    uint32_t i = 0, t = 0;
+    const char *only = NULL;
+    struct comm_lib_init_params init_params;
+
+    while ((opt = getopt(argc, argv, "n:c:o:h")) != -1) {
+        switch (opt) {
+            case 'n':
+                msgs_per_case = strtoull(optarg, NULL, 0);
+                break;
+
+            case 'c':
+                fanin_clients = strtoul(optarg, NULL, 0);
+                break;
+
+            case 'o':
+                only = optarg;
+                break;
+
+            default:
+                usage(argv[0]);
+                return (opt == 'h') ? 0 : 1;
+        }
+    }
+
+    if ((msgs_per_case == 0) || (fanin_clients == 0) ||
+        (fanin_clients > BENCH_MAX_CLIENTS)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    memset(&init_params, 0, sizeof(init_params));
+    init_params.reactor_threads_num = DEFAULT_REACTOR_THREADS_NUM;
+    init_params.max_tcp_clients = 2 * BENCH_MAX_CLIENTS;
+    init_params.max_server_connections = BENCH_MAX_CLIENTS;
+    err = comm_lib_init_with_params(NULL, &init_params);
+    if (err) {
+        fprintf(stderr, "comm_lib_init failed: %s\n", strerror(-err));
+        return 1;
+    }
+
+    for (t = 0; t < BENCH_TRANSPORT_NUM; t++) {
+        for (i = 0; i < sizeof(tcp_sizes) / sizeof(tcp_sizes[0]); i++) {
+            if ((only == NULL) || (strcmp(only, "pingpong") == 0)) {
+                err = err ? err : pingpong_run(t, tcp_sizes[i]);
+            }
+            if ((only == NULL) || (strcmp(only, "stream") == 0)) {
+                err = err ? err : stream_run(t, tcp_sizes[i]);
+            }
+        }
+    }
+
+    for (i = 0; i < sizeof(tcp_sizes) / sizeof(tcp_sizes[0]); i++) {
+        if ((only == NULL) || (strcmp(only, "fanin") == 0)) {
+            err = err ? err : fanin_run(tcp_sizes[i]);
+        }
+    }
+
+    for (i = 0; i < sizeof(udp_sizes) / sizeof(udp_sizes[0]); i++) {
+        if ((only == NULL) || (strcmp(only, "udp") == 0)) {
+            err = err ? err : udp_run(udp_sizes[i]);
+        }
+    }
+
+    (void)comm_lib_deinit();
+    return err ? 1 : 0;
+}
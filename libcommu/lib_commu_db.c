@@ -30,11 +30,16 @@
 #include "lib_commu_db.h"
 #include "lib_commu_log.h"
 #include "lib_commu_bail.h"
+#include "lib_commu_shm.h"
 
+#include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
+#include <unistd.h>
 #include <errno.h>
 #include <stdio.h>
 #include <pthread.h>
+#include <sys/resource.h>
 
 #undef  __MODULE__
 #define __MODULE__ LIB_COMMU_DB
@@ -47,11 +52,15 @@
  *  Local variables
  ***********************************************/
 
-static struct handle_info udp_handle_info[UDP_HANDLE_ARR_LENGTH];
-static struct handle_info server_tcp_handle_info[SERVER_STATUS_ARR_LENGTH][TCP_HANDLE_ARR_LENGTH];                                                                        /* opened by server side */
-static struct handle_info client_tcp_handle_info[TCP_HANDLE_ARR_LENGTH]; /*open by connecting to another server*/
-static struct server_status server_status_st[SERVER_STATUS_ARR_LENGTH];
+static struct handle_info_table udp_handle_table;
+static struct handle_info_table client_tcp_handle_table; /*open by connecting to another server*/
+static struct server_db **server_db_arr = NULL;           /* opened by server side, allocated on first use */
+static struct lib_commu_db_limits db_limits;
 static pthread_mutex_t lock_handles_db_access = PTHREAD_MUTEX_INITIALIZER;
+/* handle_info of each open handle indexed by the socket fd. Entries are
+ * published/cleared under lock_handles_db_access and read without it */
+static struct handle_info **handle_index = NULL;
+static uint32_t handle_index_size = 0;
 static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
         LCOMMU_VERBOSITY_LEVEL_NOTICE;
 
@@ -60,84 +69,157 @@ static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
  ***********************************************/
 
 /*
- *  This function initialize the udp database
+ *  This function initialize the mutex for the DB
  *
  * @return 0 if operation completes successfully.
  * @return err!=0 if operation completes unsuccessfully.
  */
 static int
-lib_commu_db_udp_session_db_init(void);
+lib_commu_db_mutex_init(void);
 
 /*
- *  This function deinitialize the udp database
+ *  This function deinitialize the mutex for the DB
  *
  * @return 0 if operation completes successfully.
  * @return err!=0 if operation completes unsuccessfully.
  */
 static int
-lib_commu_db_udp_session_db_deinit(void);
-
+lib_commu_db_mutex_deinit(void);
 
 /*
- *  This function initialize the tcp database
+ *  This function initialize a handle table, no entry is allocated
+ *
+ * @param[in] table - the table
+ * @param[in] max_len - the maximum #entries of the table
  *
  * @return 0 if operation completes successfully.
- * @return err!=0 if operation completes unsuccessfully.
+ * @return ENOMEM if failed to allocate the table.
  */
 static int
-lib_commu_db_tcp_all_session_db_init(void);
+handle_table_init(struct handle_info_table *table, uint32_t max_len);
+
+/*
+ *  This function releases a handle table and all its entries
+ */
+static void
+handle_table_deinit(struct handle_info_table *table);
+
+/*
+ *  This function resets all the entries of a handle table.
+ *  The entries stay allocated, since lock free readers may still hold them.
+ */
+static void
+handle_table_reset(struct handle_info_table *table);
+
+/*
+ *  This function returns the number of allocated entries of a handle table
+ */
+static uint32_t
+handle_table_len(struct handle_info_table *table);
 
 /*
- *  This function deinitialize the tcp database
+ *  This function returns an allocated entry of a handle table
+ */
+static struct handle_info *
+handle_table_entry(struct handle_info_table *table, uint32_t idx);
+
+/*
+ *  This function gets an empty entry of a handle table.
+ *  A new chunk of entries is allocated if all the entries are in use.
  *
  * @return 0 if operation completes successfully.
- * @return err!=0 if operation completes unsuccessfully.
+ * @return ENOBUFS if the table reached its limit.
+ * @return ENOMEM if failed to allocate a chunk.
  */
 static int
-lib_commu_db_tcp_all_session_db_deinit(void);
+handle_table_slot_get(struct handle_info_table *table,
+                      struct handle_info **handle_info_st);
+
+static void
+handle_info_reset(struct handle_info *handle_info_st);
+
+static struct handle_info_table *
+handle_table_get(enum db_type handle_type, uint16_t server_id);
 
 /*
- *  This function initialize the mutex for the DB
+ *  This function gets the server DB, allocates it on first use
  *
  * @return 0 if operation completes successfully.
- * @return err!=0 if operation completes unsuccessfully.
+ * @return ENOKEY if server_id is out of bound.
+ * @return ENOMEM if failed to allocate the server DB.
  */
 static int
-lib_commu_db_mutex_init(void);
+server_db_get(uint16_t server_id, struct server_db **server_db_st);
 
 /*
- *  This function deinitialize the mutex for the DB
+ *  This function gets the DB of a server without allocating it
  *
  * @return 0 if operation completes successfully.
- * @return err!=0 if operation completes unsuccessfully.
+ * @return ENOKEY if server_id is out of bound or the server DB wasn't allocated.
  */
 static int
-lib_commu_db_mutex_deinit(void);
+server_db_lookup(uint16_t server_id, struct server_db **server_db_st);
 
-static int
-find_empty_slot(enum db_type type, uint16_t server_idx, uint16_t *idx);
+static void
+server_db_free_all(void);
 
 static int
-find_handle_idx(enum db_type handle_type, uint16_t server_id, handle_t handle,
-                uint16_t *idx);
+handle_info_set(enum db_type handle_type, uint16_t server_id, handle_t handle,
+                uint16_t msg_type, struct addr_info local_info,
+                struct addr_info peer_info, uint8_t is_single_peer,
+                uint32_t local_magic);
+
+static void
+connection_status_fill(struct handle_info *handle_info_st,
+                       struct connection_status *connection_status);
 
 static int
-reset_handle_db(enum db_type handle_type, uint16_t server_id);
+listener_sessions_init(void);
+
+static void
+listener_sessions_deinit(void);
 
+static void
+handle_stats_fill(struct handle_info *handle_info_st,
+                  struct handle_stats *stats);
+
+static void
+handle_hist_add(struct handle_hist *hist, unsigned long long value);
 static int
-handle_info_set(enum db_type handle_type, uint16_t server_id, handle_t handle,
-                uint8_t msg_type, struct addr_info local_info,
-                struct addr_info peer_info, uint8_t is_single_peer,
-                uint32_t local_magic);
+trace_peer_is_local(const struct handle_info *handle_info_st,
+                    uint32_t peer_ipv4_addr);
 
+/*
+ *  This function allocates the fd indexed handle table, sized by the
+ *  process open files limit
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOMEM if failed to allocate the table.
+ */
 static int
-reset_all_tcp_servers_status_db(void);
+handle_index_init(void);
+
+static void
+handle_index_deinit(void);
+
+static void
+handle_index_set(struct handle_info *handle_info_st);
+
+static void
+handle_index_clear(struct handle_info *handle_info_st);
+
+static struct handle_info *
+handle_index_lookup(handle_t handle);
+
+static struct handle_info *
+handle_info_lookup(handle_t handle, enum db_type handle_db_type);
 
 static int
-reset_server_status(uint16_t idx);
+handle_info_closing_set(handle_t handle, int is_tcp,
+                        struct handle_info **handle_info_st);
 
 static int
-init_listner_exit_event_info(void);
+handle_info_delete(struct handle_info *handle_info_st);
 
 
 /************************************************
@@ -145,177 +227,260 @@ init_listner_exit_event_info(void);
  ***********************************************/
 
 static int
-find_empty_slot(enum db_type type, uint16_t server_idx, uint16_t *idx)
+handle_table_init(struct handle_info_table *table, uint32_t max_len)
 {
     int err = 0;
-    uint16_t i = 0;
+    uint32_t chunks_max = 0;
+
+    memset(table, 0, sizeof(*table));
+
+    chunks_max = (max_len + HANDLE_TABLE_CHUNK_SIZE - 1) /
+                 HANDLE_TABLE_CHUNK_SIZE;
+    table->chunks = (struct handle_info **)calloc(chunks_max,
+                                                  sizeof(*table->chunks));
+    if (table->chunks == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate handle table[%u]\n",
+                max_len);
+        lib_commu_bail_force(ENOMEM);
+    }
+    table->max_len = max_len;
 
-    lib_commu_bail_null(idx);
+bail:
+    return err;
+}
 
-    switch (type) {
+static void
+handle_table_deinit(struct handle_info_table *table)
+{
+    uint32_t i = 0;
 
-        case UDP_HANDLE_DB:
-            for (i = 0; i < UDP_HANDLE_ARR_LENGTH; i++) {
-                if (udp_handle_info[i].handle == INVALID_HANDLE_ID) {
-                    *idx = i;
-                    goto bail;
-                }
-            }
-            break;
+    if (table->chunks == NULL) {
+        return;
+    }
 
-        case TCP_CLIENT_HANDLE_DB:
-            for (i = 0; i < TCP_HANDLE_ARR_LENGTH; i++) {
-                if (client_tcp_handle_info[i].handle == INVALID_HANDLE_ID) {
-                    *idx = i;
-                    goto bail;
-                }
-            }
-            break;
+    handle_table_reset(table);
 
-        case TCP_SERVER_HANDLE_DB:
-            for (i = 0; i < TCP_HANDLE_ARR_LENGTH; i++) {
-            if (server_tcp_handle_info[server_idx][i].handle ==
-                INVALID_HANDLE_ID) {
-                    *idx = i;
-                    goto bail;
-                }
-            }
-            break;
+    for (i = 0; i < table->chunks_num; i++) {
+        safe_free(table->chunks[i]);
+    }
+    safe_free(table->chunks);
+    memset(table, 0, sizeof(*table));
+}
 
-        case TCP_SERVER_STATUS_HANDLE_DB:
-            for (i = 0; i < MAX_CONNECTION_NUM; i++) {
-            if (server_status_st[server_idx].client_status[i].handle ==
-                INVALID_HANDLE_ID) {
-                    *idx = i;
-                    goto bail;
-                }
-            }
-            break;
+static void
+handle_table_reset(struct handle_info_table *table)
+{
+    uint32_t i = 0;
+    uint32_t len = handle_table_len(table);
+
+    for (i = 0; i < len; i++) {
+        handle_info_reset(handle_table_entry(table, i));
+    }
+    table->used_num = 0;
+}
+
+static uint32_t
+handle_table_len(struct handle_info_table *table)
+{
+    uint32_t len = 0;
+
+    len = __atomic_load_n(&table->chunks_num, __ATOMIC_ACQUIRE) *
+          HANDLE_TABLE_CHUNK_SIZE;
+    if (len > table->max_len) {
+        len = table->max_len;
+    }
+
+    return len;
+}
+
+static struct handle_info *
+handle_table_entry(struct handle_info_table *table, uint32_t idx)
+{
+    return &table->chunks[idx / HANDLE_TABLE_CHUNK_SIZE]
+           [idx % HANDLE_TABLE_CHUNK_SIZE];
+}
 
-        case LISTENER_THREAD_DB:
-            for (i = 0; i < NUM_OF_LISTENER_THREADS; i++) {
-                if (listener_threads[i] == 0) {
-                    *idx = i;
-                    goto bail;
-                }
+static int
+handle_table_slot_get(struct handle_info_table *table,
+                      struct handle_info **handle_info_st)
+{
+    int err = 0;
+    uint32_t i = 0;
+    uint32_t len = handle_table_len(table);
+    struct handle_info *chunk = NULL;
+
+    /* look for a free entry only if there is one */
+    if (table->used_num < len) {
+        for (i = 0; i < len; i++) {
+            if (handle_table_entry(table, i)->handle == INVALID_HANDLE_ID) {
+                *handle_info_st = handle_table_entry(table, i);
+                goto bail;
             }
-            break;
+        }
+    }
 
-        default:
-            LCM_LOG(LCOMMU_LOG_ERROR, "Unknown DB type[%d]", type);
-            lib_commu_bail_force(EINVAL);
-            break;
+    if (len >= table->max_len) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "No empty slot in handle table[%u]\n",
+                table->max_len);
+        lib_commu_bail_force(ENOBUFS);
     }
 
-    LCM_LOG(LCOMMU_LOG_ERROR, "No empty slot in handle DB type[%d]", type);
-    lib_commu_bail_force(ENOBUFS);
+    /* grow the table by one chunk */
+    chunk = (struct handle_info *)calloc(HANDLE_TABLE_CHUNK_SIZE,
+                                         sizeof(*chunk));
+    if (chunk == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate handle table chunk\n");
+        lib_commu_bail_force(ENOMEM);
+    }
+    for (i = 0; i < HANDLE_TABLE_CHUNK_SIZE; i++) {
+        chunk[i].handle = INVALID_HANDLE_ID;
+        chunk[i].socekt_info.peer_magic = INVALID_MAGIC;
+    }
+
+    table->chunks[table->chunks_num] = chunk;
+    /* readers walking the table see the chunk before the new length */
+    __atomic_store_n(&table->chunks_num, table->chunks_num + 1,
+                     __ATOMIC_RELEASE);
 
+    *handle_info_st = chunk;
 
 bail:
     return err;
 }
 
-
-static int
-find_handle_idx(enum db_type handle_type, uint16_t server_id, handle_t handle,
-                uint16_t *idx)
+static void
+handle_info_reset(struct handle_info *handle_info_st)
 {
-    int err = 0;
-    uint16_t i = 0;
+    handle_index_clear(handle_info_st);
+    safe_free(handle_info_st->rx_stream.buffer);
+    /* the queue was stopped on close, or the reactor is down on deinit */
+    safe_free(handle_info_st->tx_queue);
+    safe_free(handle_info_st->tx_coalesce);
+    safe_free(handle_info_st->tcp_channels);
+    safe_free(handle_info_st->rx_callback);
+    safe_free(handle_info_st->handle_reactor);
+    safe_free(handle_info_st->udp_reassembly);
+    safe_free(handle_info_st->udp_reliable);
+    /* a shm session handle is the link fd, closed with the link */
+    if (handle_info_st->shm_link != NULL) {
+        lib_commu_shm_link_close(handle_info_st->shm_link);
+    }
+    /* a failed hold may still touch users, see lib_commu_db_handle_info_hold */
+    memset(handle_info_st, 0, offsetof(struct handle_info, users));
+    handle_info_st->handle = INVALID_HANDLE_ID;
+    handle_info_st->socekt_info.peer_magic = INVALID_MAGIC;
+}
 
-    lib_commu_bail_null(idx);
+static struct handle_info_table *
+handle_table_get(enum db_type handle_type, uint16_t server_id)
+{
+    struct handle_info_table *table = NULL;
 
     switch (handle_type) {
         case UDP_HANDLE_DB:
-            for (i = 0; i < UDP_HANDLE_ARR_LENGTH; i++) {
-                if (udp_handle_info[i].handle == handle) {
-                    *idx = i;
-                    goto bail;
-                }
-            }
+            table = &udp_handle_table;
             break;
 
-        case TCP_SERVER_STATUS_HANDLE_DB:
-            for (i = 0; i < MAX_CONNECTION_NUM; i++) {
-            if (server_status_st[server_id].client_status[i].handle ==
-                handle) {
-                    *idx = i;
-                    goto bail;
-                }
+        case TCP_CLIENT_HANDLE_DB:
+            table = &client_tcp_handle_table;
+            break;
+
+        case TCP_SERVER_HANDLE_DB:
+            if ((server_id < db_limits.max_servers) &&
+                (server_db_arr[server_id] != NULL)) {
+                table = &server_db_arr[server_id]->handles;
             }
             break;
 
         default:
-            LCM_LOG(LCOMMU_LOG_ERROR, "handle type[%d] is unsupported",
-                    handle_type);
-            lib_commu_bail_error(EPERM);
             break;
     }
 
-
-    LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] not found", handle);
-    lib_commu_bail_error(ENOKEY);
-
-bail:
-    return err;
+    return table;
 }
 
 static int
-reset_handle_db(enum db_type handle_type, uint16_t server_id)
+server_db_get(uint16_t server_id, struct server_db **server_db_st)
 {
     int err = 0;
-    int i = 0;
-    uint16_t idx = server_id;
+    struct server_db *server = NULL;
 
-    switch (handle_type) {
-
-        case UDP_HANDLE_DB:
+    if (server_id >= db_limits.max_servers) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [server_id %u]\n",
+                server_id);
+        lib_commu_bail_force(ENOKEY);
+    }
 
-            memset(udp_handle_info, 0, sizeof(udp_handle_info));
+    if (server_db_arr[server_id] != NULL) {
+        *server_db_st = server_db_arr[server_id];
+        goto bail;
+    }
 
-            for (i = 0; i < UDP_HANDLE_ARR_LENGTH; i++) {
-                udp_handle_info[i].handle = INVALID_HANDLE_ID;
-                udp_handle_info[i].socekt_info.peer_magic = INVALID_MAGIC;
-            }
-            break;
+    server = (struct server_db *)calloc(1, sizeof(*server));
+    if (server == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate server[%u] DB\n",
+                server_id);
+        lib_commu_bail_force(ENOMEM);
+    }
 
-        case TCP_CLIENT_HANDLE_DB:
+    err = handle_table_init(&server->handles,
+                            db_limits.max_server_connections);
+    if (err) {
+        safe_free(server);
+        lib_commu_bail_force(err);
+    }
 
-        memset(client_tcp_handle_info, 0,
-               sizeof(client_tcp_handle_info));
+    server->status.listener_handle = INVALID_HANDLE_ID;
 
-            for (i = 0; i < TCP_HANDLE_ARR_LENGTH; i++) {
-                client_tcp_handle_info[i].handle = INVALID_HANDLE_ID;
-                client_tcp_handle_info[i].socekt_info.peer_magic = INVALID_MAGIC;
-            }
-            break;
+    server_db_arr[server_id] = server;
+    *server_db_st = server;
 
-        case TCP_SERVER_HANDLE_DB:
+bail:
+    return err;
+}
 
-        memset(server_tcp_handle_info[idx], 0,
-               sizeof(server_tcp_handle_info[idx]));
+static int
+server_db_lookup(uint16_t server_id, struct server_db **server_db_st)
+{
+    int err = 0;
 
-            for (i = 0; i < TCP_HANDLE_ARR_LENGTH; i++) {
-                server_tcp_handle_info[idx][i].handle = INVALID_HANDLE_ID;
-            server_tcp_handle_info[idx][i].socekt_info.peer_magic =
-                INVALID_MAGIC;
-            }
-            break;
+    if (server_id >= db_limits.max_servers) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [server_id %u]\n",
+                server_id);
+        lib_commu_bail_force(ENOKEY);
+    }
 
-        default:
-            LCM_LOG(LCOMMU_LOG_ERROR, "Unknown handle type[%d]", handle_type);
-            lib_commu_bail_force(EPERM);
-            break;
+    if (server_db_arr[server_id] == NULL) {
+        lib_commu_bail_force(ENOKEY);
     }
 
+    *server_db_st = server_db_arr[server_id];
 
 bail:
     return err;
 }
 
+static void
+server_db_free_all(void)
+{
+    uint32_t i = 0;
+
+    if (server_db_arr == NULL) {
+        return;
+    }
+
+    for (i = 0; i < db_limits.max_servers; i++) {
+        if (server_db_arr[i] != NULL) {
+            handle_table_deinit(&server_db_arr[i]->handles);
+            safe_free(server_db_arr[i]);
+        }
+    }
+    safe_free(server_db_arr);
+}
+
 static int
 handle_info_set(enum db_type handle_type, uint16_t server_id,
-                           handle_t handle, uint8_t msg_type,
+                           handle_t handle, uint16_t msg_type,
                            struct addr_info local_info,
                            struct addr_info peer_info, uint8_t is_single_peer,
                            uint32_t local_magic)
@@ -323,39 +488,37 @@ handle_info_set(enum db_type handle_type, uint16_t server_id,
 
     int err = 0;
     int is_db_locked = 0;
-    uint16_t idx = 0;
     struct handle_info *handle_info = NULL;
+    struct handle_info_table *table = NULL;
+    struct server_db *server = NULL;
+
+    if ((handle < 0) || ((uint32_t)handle >= handle_index_size)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "handle[%d] is above the open files limit[%u]\n",
+                handle, handle_index_size);
+        lib_commu_bail_force(ENOBUFS);
+    }
 
     err = pthread_mutex_lock(&lock_handles_db_access);
     lib_commu_bail_error(err);
     is_db_locked = 1;
 
-    err = find_empty_slot(handle_type, server_id, &idx);
-    lib_commu_bail_error(err);
-
-    switch (handle_type) {
-
-        case UDP_HANDLE_DB:
-            handle_info = &udp_handle_info[idx];
-            break;
-
-        case TCP_CLIENT_HANDLE_DB:
-            handle_info = &client_tcp_handle_info[idx];
-            break;
-
-        case TCP_SERVER_HANDLE_DB:
-            /* handle initiated by server (listener thread) */
-            handle_info = &server_tcp_handle_info[server_id][idx];
-            break;
+    if (handle_type == TCP_SERVER_HANDLE_DB) {
+        /* handle initiated by server (listener) */
+        err = server_db_get(server_id, &server);
+        lib_commu_bail_error(err);
+    }
 
-        default:
-            LCM_LOG(LCOMMU_LOG_ERROR, "Unknown handle type[%d]", handle_type);
-            lib_commu_bail_force(EPERM);
-            break;
+    table = handle_table_get(handle_type, server_id);
+    if (table == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Unknown handle type[%d]", handle_type);
+        lib_commu_bail_force(EPERM);
     }
 
+    err = handle_table_slot_get(table, &handle_info);
+    lib_commu_bail_error(err);
+
     /* set the handle with data */
-    lib_commu_bail_null(handle_info);
     handle_info->handle = handle;
     handle_info->conn_info.msg_type = msg_type;
     handle_info->conn_info.s_ipv4_addr = local_info.ipv4_addr;
@@ -368,6 +531,19 @@ handle_info_set(enum db_type handle_type, uint16_t server_id,
     handle_info->socekt_info.is_single_peer = is_single_peer;
     handle_info->socekt_info.total_sum_bytes_rx = 0;
     handle_info->socekt_info.total_sum_bytes_tx = 0;
+    memset(handle_info->stats, 0, sizeof(handle_info->stats));
+    handle_info->rx_stream.head = 0;
+    handle_info->rx_stream.tail = 0;
+    handle_info->rx_stream.is_failed = 0;
+    handle_info->db_type = handle_type;
+    handle_info->server_id = server_id;
+    table->used_num++;
+    if (server != NULL) {
+        server->status.clients_num = table->used_num;
+    }
+
+    /* publish the entry once it is complete */
+    handle_index_set(handle_info);
 
     err = pthread_mutex_unlock(&lock_handles_db_access);
     lib_commu_bail_error(err);
@@ -375,223 +551,365 @@ handle_info_set(enum db_type handle_type, uint16_t server_id,
 
 bail:
     if (is_db_locked) {
-        err = pthread_mutex_unlock(&lock_handles_db_access);
-        lib_commu_return_from_bail(err);
+        /* keep the error which led to bail */
+        pthread_mutex_unlock(&lock_handles_db_access);
     }
     return err;
 }
 
 
-static int
-reset_all_tcp_servers_status_db(void)
+static void
+connection_status_fill(struct handle_info *handle_info_st,
+                       struct connection_status *connection_status)
 {
-    int err = 0;
-    uint16_t i = 0;
+    struct sockaddr_in client_addr;
+    socklen_t addr_len = sizeof(client_addr);
 
-    for (i = 0; i < SERVER_STATUS_ARR_LENGTH; i++) {
-        err = reset_server_status(i);
-        lib_commu_bail_error(err);
+    memset(connection_status, 0, sizeof(*connection_status));
 
-        err = reset_handle_db(TCP_SERVER_HANDLE_DB, i);
-        lib_commu_bail_error(err);
+    connection_status->handle = handle_info_st->handle;
+    connection_status->local_ipv4_addr = handle_info_st->conn_info.s_ipv4_addr;
+    connection_status->local_port = handle_info_st->conn_info.s_port;
+    connection_status->peer_ipv4_addr = handle_info_st->conn_info.d_ipv4_addr;
+    connection_status->peer_port = handle_info_st->conn_info.d_port;
+
+    if (getpeername(handle_info_st->handle, (struct sockaddr *) &client_addr,
+                    &addr_len) == 0) {
+        connection_status->handle_status = HANDLE_STATUS_UP;
+    }
+    else {
+        connection_status->handle_status = HANDLE_STATUS_DOWN;
     }
 
-bail:
-    return err;
+    handle_stats_fill(handle_info_st, &connection_status->stats);
 }
 
+
 static int
-reset_server_status(uint16_t idx)
+listener_sessions_init(void)
 {
     int err = 0;
-    int i = 0;
-
-    memset(&(server_status_st[idx]), 0, sizeof(server_status_st[idx]));
 
-    server_status_st[idx].listener_handle = INVALID_HANDLE_ID;
-    server_status_st[idx].clients_num = 0;
-
-    for (i = 0; i < MAX_CONNECTION_NUM; i++ ) {
-        server_status_st[idx].client_status[i].handle = INVALID_HANDLE_ID;
+    listener_sessions =
+        (struct listener_session **)calloc(db_limits.max_servers,
+                                           sizeof(*listener_sessions));
+    if (listener_sessions == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate listeners DB\n");
+        lib_commu_bail_force(ENOMEM);
     }
 
-    goto bail; /*for compilation propose*/
-
 bail:
     return err;
 }
 
 
-static int
-init_listner_exit_event_info(void)
+static void
+listener_sessions_deinit(void)
 {
-    int err = 0;
-    uint16_t i = 0;
-
-    memset(listner_exit_event_info_st.event_fd, INVALID_HANDLE_ID,
-           sizeof(listner_exit_event_info_st.event_fd));
-
-    char *exit_listener_thread_socket_path[] = {
-                                          "/tmp/lib_commu_sock_path_0",
-                                          "/tmp/lib_commu_sock_path_1",
-                                          "/tmp/lib_commu_sock_path_2",
-                                          "/tmp/lib_commu_sock_path_3",
-                                          "/tmp/lib_commu_sock_path_4",
-                                          "/tmp/lib_commu_sock_path_5",
-                                          "/tmp/lib_commu_sock_path_6",
-                                          "/tmp/lib_commu_sock_path_7",
-                                          "/tmp/lib_commu_sock_path_8",
-                                          "/tmp/lib_commu_sock_path_9",
-                                          "/tmp/lib_commu_sock_path_10",
-                                          "/tmp/lib_commu_sock_path_11",
-                                          "/tmp/lib_commu_sock_path_12",
-                                          "/tmp/lib_commu_sock_path_13",
-                                          "/tmp/lib_commu_sock_path_14",
-                                          "/tmp/lib_commu_sock_path_15",
-    };
-
-    for (i = 0; i < NUM_OF_LISTENER_THREADS; i++) {
-        strcpy(listner_exit_event_info_st.event_socket_path[i],
-               exit_listener_thread_socket_path[i]);
-    }
-
-    goto bail; /*for compilation propose*/
+    safe_free(listener_sessions);
+}
 
-bail:
-    return err;
+
+static void
+handle_stats_fill(struct handle_info *handle_info_st,
+                  struct handle_stats *stats)
+{
+    unsigned long long *counters = handle_info_st->stats;
+
+    stats->rx_bytes =
+        __sync_fetch_and_add(&handle_info_st->socekt_info.total_sum_bytes_rx, 0);
+    stats->tx_bytes =
+        __sync_fetch_and_add(&handle_info_st->socekt_info.total_sum_bytes_tx, 0);
+    stats->rx_msgs = __sync_fetch_and_add(&counters[HANDLE_STATS_RX_MSGS], 0);
+    stats->tx_msgs = __sync_fetch_and_add(&counters[HANDLE_STATS_TX_MSGS], 0);
+    stats->rx_errors = __sync_fetch_and_add(&counters[HANDLE_STATS_RX_ERRORS], 0);
+    stats->tx_errors = __sync_fetch_and_add(&counters[HANDLE_STATS_TX_ERRORS], 0);
+    stats->retries = __sync_fetch_and_add(&counters[HANDLE_STATS_RETRIES], 0);
+    stats->zerocopy_sends =
+        __sync_fetch_and_add(&counters[HANDLE_STATS_ZEROCOPY_SENDS], 0);
+    stats->zerocopy_copied =
+        __sync_fetch_and_add(&counters[HANDLE_STATS_ZEROCOPY_COPIED], 0);
+    stats->rx_gaps = __sync_fetch_and_add(&counters[HANDLE_STATS_RX_GAPS], 0);
+    stats->rx_reorders =
+        __sync_fetch_and_add(&counters[HANDLE_STATS_RX_REORDERS], 0);
+    stats->rx_clock_skews =
+        __sync_fetch_and_add(&counters[HANDLE_STATS_RX_CLOCK_SKEWS], 0);
 }
 
-/************************************************
- *  Function implementations
- ***********************************************/
 
-/**
- *  This function initialize the database
- *
- * @return 0 if operation completes successfully.
- * @return EPERM if Handle type doesn't exist.
- */
-int
-lib_commu_db_init(void)
+static void
+handle_hist_add(struct handle_hist *hist, unsigned long long value)
 {
-    int err = 0;
+    uint32_t bucket = 0;
 
-    err = lib_commu_db_udp_session_db_init();
-    lib_commu_bail_error(err);
+    if (value > 0) {
+        bucket = 64 - __builtin_clzll(value);
+        if (bucket >= HANDLE_HIST_BUCKETS_NUM) {
+            bucket = HANDLE_HIST_BUCKETS_NUM - 1;
+        }
+    }
 
-    err = lib_commu_db_tcp_all_session_db_init();
-    lib_commu_bail_error(err);
+    __sync_fetch_and_add(&hist->count, 1);
+    __sync_fetch_and_add(&hist->sum, value);
+    __sync_fetch_and_add(&hist->buckets[bucket], 1);
+}
 
-    err = lib_commu_db_mutex_init();
-    lib_commu_bail_error(err);
 
-bail:
-    return err;
+/* a peer on the loopback, as UNIX domain peers are reported, or the peer
+ * of a TCP connection whose ends have the same address, as of a shm session */
+static int
+trace_peer_is_local(const struct handle_info *handle_info_st,
+                    uint32_t peer_ipv4_addr)
+{
+    if ((ntohl(peer_ipv4_addr) >> IN_CLASSA_NSHIFT) == IN_LOOPBACKNET) {
+        return 1;
+    }
+
+    return (handle_info_st->db_type != UDP_HANDLE_DB) &&
+           (peer_ipv4_addr == handle_info_st->conn_info.s_ipv4_addr);
 }
 
-/**
- *  This function deinitialize the database
- *
- * @return 0 if operation completes successfully.
- * @return EPERM if Handle type doesn't exist.
- */
-int
-lib_commu_db_deinit(void)
+
+static int
+handle_index_init(void)
 {
     int err = 0;
+    struct rlimit nofile_limit;
+    rlim_t index_size = HANDLE_INDEX_MAX_SIZE;
 
-    err = lib_commu_db_udp_session_db_deinit();
-    lib_commu_bail_error(err);
+    memset(&nofile_limit, 0, sizeof(nofile_limit));
 
-    err = lib_commu_db_tcp_all_session_db_deinit();
-    lib_commu_bail_error(err);
+    /* the hard limit bounds any later raise of the soft limit */
+    if ((getrlimit(RLIMIT_NOFILE, &nofile_limit) == 0) &&
+        (nofile_limit.rlim_max != RLIM_INFINITY) &&
+        (nofile_limit.rlim_max < index_size)) {
+        index_size = nofile_limit.rlim_max;
+    }
 
-    err = lib_commu_db_mutex_deinit();
-    lib_commu_bail_error(err);
+    handle_index = (struct handle_info **)calloc(index_size,
+                                                 sizeof(*handle_index));
+    if (handle_index == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate handle index[%u]\n",
+                (uint32_t)index_size);
+        lib_commu_bail_force(ENOMEM);
+    }
+    handle_index_size = index_size;
 
 bail:
     return err;
 }
 
-/**
- *  This function initialize the udp database
- *
- * @return 0 if operation completes successfully.
- * @return EPERM if Handle type doesn't exist.
- */
-static int
-lib_commu_db_udp_session_db_init(void)
+static void
+handle_index_deinit(void)
 {
-    int err = 0;
+    handle_index_size = 0;
+    safe_free(handle_index);
+}
 
-    err = reset_handle_db(UDP_HANDLE_DB, INVALID_SERVER_ID);
-    lib_commu_bail_error(err);
+static void
+handle_index_set(struct handle_info *handle_info_st)
+{
+    if ((handle_info_st->handle >= 0) &&
+        ((uint32_t)handle_info_st->handle < handle_index_size)) {
+        __atomic_store_n(&handle_index[handle_info_st->handle], handle_info_st,
+                         __ATOMIC_RELEASE);
+    }
+}
 
-bail:
-    return err;
+static void
+handle_index_clear(struct handle_info *handle_info_st)
+{
+    /* the fd may already be reused by a newer entry */
+    if ((handle_info_st->handle >= 0) &&
+        ((uint32_t)handle_info_st->handle < handle_index_size) &&
+        (handle_index[handle_info_st->handle] == handle_info_st)) {
+        __atomic_store_n(&handle_index[handle_info_st->handle], NULL,
+                         __ATOMIC_RELEASE);
+    }
 }
 
-/**
- *  This function deinitialize the udp database
- *
- * @return 0 if operation completes successfully.
- * @return err!=0 if operation completes unsuccessfully.
- */
-static int
-lib_commu_db_udp_session_db_deinit(void)
+static struct handle_info *
+handle_index_lookup(handle_t handle)
 {
-    int err = 0;
+    struct handle_info *handle_info_st = NULL;
 
-    err = reset_handle_db(UDP_HANDLE_DB, INVALID_SERVER_ID);
-    lib_commu_bail_error(err);
+    if ((handle >= 0) && ((uint32_t)handle < handle_index_size)) {
+        handle_info_st = __atomic_load_n(&handle_index[handle],
+                                         __ATOMIC_ACQUIRE);
+    }
 
-bail:
-    return err;
+    return handle_info_st;
 }
 
+static struct handle_info *
+handle_info_lookup(handle_t handle, enum db_type handle_db_type)
+{
+    struct handle_info *entry = handle_index_lookup(handle);
+
+    if ((entry == NULL) || (entry->handle != handle) ||
+        ((handle_db_type != ANY_HANLDE_DB) &&
+         (handle_db_type != entry->db_type))) {
+        return NULL;
+    }
+
+    return entry;
+}
+
+static int
+handle_info_closing_set(handle_t handle, int is_tcp,
+                        struct handle_info **handle_info_st)
+{
+    int err = 0;
+    int is_db_locked = 0;
+    struct handle_info *entry = NULL;
+
+    err = pthread_mutex_lock(&lock_handles_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    /* another closer took it already */
+    entry = handle_info_lookup(handle, ANY_HANLDE_DB);
+    if ((entry == NULL) || entry->is_closing) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] not found", handle);
+        lib_commu_bail_force(ENOKEY);
+    }
+
+    if (is_tcp != (entry->db_type != UDP_HANDLE_DB)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid handle type[%d]", entry->db_type);
+        lib_commu_bail_force(EPERM);
+    }
+
+    /* pairs with the users check of lib_commu_db_handle_info_hold */
+    __atomic_store_n(&entry->is_closing, 1, __ATOMIC_SEQ_CST);
+    *handle_info_st = entry;
+
+bail:
+    if (is_db_locked) {
+        /* keep the error which led to bail */
+        pthread_mutex_unlock(&lock_handles_db_access);
+    }
+    return err;
+}
+
+static int
+handle_info_delete(struct handle_info *handle_info_st)
+{
+    int err = 0;
+    int is_db_locked = 0;
+    struct handle_info_table *table = NULL;
+    enum db_type handle_db_type = handle_info_st->db_type;
+    uint16_t server_id = handle_info_st->server_id;
+
+    err = pthread_mutex_lock(&lock_handles_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    table = handle_table_get(handle_db_type, server_id);
+    if (table == NULL) {
+        /* unsupported DB type */
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid handle type[%d]", handle_db_type);
+        lib_commu_bail_force(EPERM);
+    }
+
+    /* programming error: number of handles must be > 0 else no handle can be delete */
+    if (table->used_num == 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "#handles must be > 0\n");
+        lib_commu_bail_force(EINVAL);
+    }
+
+    /* reset handle DB */
+    handle_info_reset(handle_info_st);
+    table->used_num--;
+
+    /* if handle initiated by server --> update it's DB */
+    if (handle_db_type == TCP_SERVER_HANDLE_DB) {
+        server_db_arr[server_id]->status.clients_num = table->used_num;
+    }
+
+bail:
+    if (is_db_locked) {
+        /* keep the error which led to bail */
+        pthread_mutex_unlock(&lock_handles_db_access);
+    }
+    return err;
+}
+
+/************************************************
+ *  Function implementations
+ ***********************************************/
 
 /**
- *  This function initialize the tcp database
+ *  This function initialize the database
+ *
+ * @param[in] limits - the tables limits
  *
  * @return 0 if operation completes successfully.
- * @return err!=0 if operation completes unsuccessfully.
+ * @return ENOMEM if failed to allocate the tables.
  */
-static int
-lib_commu_db_tcp_all_session_db_init(void)
+int
+lib_commu_db_init(const struct lib_commu_db_limits *limits)
 {
     int err = 0;
 
-    err = reset_all_tcp_servers_status_db();
+    lib_commu_bail_null(limits);
+
+    memcpy(&db_limits, limits, sizeof(db_limits));
+
+    err = handle_index_init();
     lib_commu_bail_error(err);
 
-    err = reset_handle_db(TCP_CLIENT_HANDLE_DB, INVALID_SERVER_ID);
+    err = handle_table_init(&udp_handle_table, db_limits.max_udp_sessions);
     lib_commu_bail_error(err);
 
-    err = init_listner_exit_event_info();
+    err = handle_table_init(&client_tcp_handle_table,
+                            db_limits.max_tcp_clients);
     lib_commu_bail_error(err);
 
+    server_db_arr = (struct server_db **)calloc(db_limits.max_servers,
+                                                sizeof(*server_db_arr));
+    if (server_db_arr == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate servers DB\n");
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    err = listener_sessions_init();
+    lib_commu_bail_error(err);
+
+    err = lib_commu_db_mutex_init();
+    lib_commu_bail_error(err);
 
 bail:
+    if (err) {
+        listener_sessions_deinit();
+        safe_free(server_db_arr);
+        handle_table_deinit(&client_tcp_handle_table);
+        handle_table_deinit(&udp_handle_table);
+        handle_index_deinit();
+    }
     return err;
 }
 
 /**
- *  This function deinitialize the all tcp database
+ *  This function deinitialize the database
  *
  * @return 0 if operation completes successfully.
- * @return err!=0 if operation completes unsuccessfully.
+ * @return EPERM if Handle type doesn't exist.
  */
-static int
-lib_commu_db_tcp_all_session_db_deinit(void)
+int
+lib_commu_db_deinit(void)
 {
     int err = 0;
 
-    err = reset_all_tcp_servers_status_db();
-    lib_commu_bail_error(err);
+    handle_table_deinit(&udp_handle_table);
+    handle_table_deinit(&client_tcp_handle_table);
+    server_db_free_all();
+    listener_sessions_deinit();
 
-    err = reset_handle_db(TCP_CLIENT_HANDLE_DB, INVALID_SERVER_ID);
+    err = lib_commu_db_mutex_deinit();
     lib_commu_bail_error(err);
 
+    handle_index_deinit();
+
 bail:
     return err;
 }
@@ -600,14 +918,25 @@ int
 lib_commu_db_tcp_session_db_deinit(uint16_t server_id)
 {
     int err = 0;
+    int is_db_locked = 0;
+    struct server_db *server = NULL;
 
-    err = reset_server_status(server_id);
+    err = pthread_mutex_lock(&lock_handles_db_access);
     lib_commu_bail_error(err);
+    is_db_locked = 1;
 
-    err = reset_handle_db(TCP_SERVER_HANDLE_DB, server_id);
+    err = server_db_lookup(server_id, &server);
     lib_commu_bail_error(err);
 
+    handle_table_reset(&server->handles);
+    server->status.clients_num = 0;
+    server->status.listener_handle = INVALID_HANDLE_ID;
+    server->status.listener_status = HANDLE_STATUS_DOWN;
+
 bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_handles_db_access);
+    }
     return err;
 }
 
@@ -668,36 +997,402 @@ bail:
 }
 
 /**
- *  This function updates handle_info with new entries
+ *  This function updates handle_info with new entries
+ *
+ * @param[in] handle - socket handle
+ * @param[in] params - udp parameters needed initialize the session
+ * @param[in] local_magic - the magic identifier of the socket
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOBUFS if no space left in udp_handle_info DB.
+ * @return EPERM if operation failed.
+ */
+int
+lib_commu_db_udp_handle_info_set(handle_t handle,
+                                 const struct ip_udp_params const *params,
+                                 uint32_t local_magic)
+{
+    int err = 0;
+
+    struct addr_info local_info;
+    struct addr_info peer_info;
+
+    memset(&local_info, 0, sizeof(local_info));
+    memset(&peer_info, 0, sizeof(peer_info));
+
+    local_info.ipv4_addr = params->session_params.port;
+    local_info.port = params->session_params.port;
+
+    err = handle_info_set(UDP_HANDLE_DB, INVALID_SERVER_ID,handle,
+                          params->session_params.msg_type,
+                          local_info, peer_info, params->is_single_peer,
+                          local_magic);
+    lib_commu_bail_error(err);
+
+bail:
+    return err;
+}
+
+
+/**
+ *  This function updates server tcp handle_info with new entries created by
+ *  listener socket
+ *
+ * @param[in] server_id - the server id
+ * @param[in] handle - socket handle
+ * @param[in] msg_type - type of message to send/receive on the socket
+ * @param[in] port - port number bounded to the socket
+ * @param[in] local_magic - the magic identifier of the socket
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOBUFS if no space left in udp_handle_info DB.
+ * @return EPERM if operation failed.
+ */
+int
+lib_commu_db_tcp_server_handle_info_set(uint16_t server_id, handle_t handle,
+                                            uint16_t msg_type,
+                                            struct addr_info local_info,
+                                            struct addr_info peer_info,
+                                            uint32_t local_magic)
+{
+    int err = 0;
+
+    err = handle_info_set(TCP_SERVER_HANDLE_DB, server_id, handle, msg_type,
+                          local_info, peer_info, 1, local_magic);
+    lib_commu_bail_error(err);
+
+bail:
+    return err;
+}
+
+
+/**
+ *  This function updates server tcp handle_info with new entries
+ *  initiated by client
+ *
+ * @param[in] handle - socket handle
+ * @param[in] msg_type - type of message to send/receive on the socket
+ * @param[in] port - port number bounded to the socket
+ * @param[in] local_magic - the magic identifier of the socket
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOBUFS if no space left in udp_handle_info DB.
+ * @return EPERM if operation failed.
+ */
+int
+lib_commu_db_tcp_client_handle_info_set(handle_t handle, uint16_t msg_type,
+                                            struct addr_info local_info,
+                                            struct addr_info peer_info,
+                                            uint32_t local_magic)
+{
+    int err = 0;
+
+    err = handle_info_set(TCP_CLIENT_HANDLE_DB, INVALID_SERVER_ID, handle,
+                          msg_type, local_info, peer_info, 1, local_magic);
+    lib_commu_bail_error(err);
+
+bail:
+    return err;
+}
+
+/**
+ *  This function set the listener handle
+ *
+ * @param[in] listener_handle - listener socket handle.
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if server_id is out of bound.
+ * @return ENOMEM if failed to allocate the server DB.
+ */
+int
+lib_commu_db_server_status_listener_set(uint16_t server_id,
+                                            handle_t listener_handle,
+                                            enum handle_op_status is_enabled)
+{
+    int err = 0;
+    struct server_db *server = NULL;
+
+    err = pthread_mutex_lock(&lock_handles_db_access);
+    lib_commu_bail_error(err);
+
+    err = server_db_get(server_id, &server);
+    if (err == 0) {
+        server->status.listener_handle = listener_handle;
+        server->status.listener_status = is_enabled;
+    }
+
+    pthread_mutex_unlock(&lock_handles_db_access);
+
+bail:
+    return err;
+}
+
+
+/**
+ *  This function fill up the server status struct
+ *  client_status holds the first MAX_CONNECTION_NUM clients of the server.
+ *
+ * @param[out] server_status - the server status, owned by the caller
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if server does not exist
+ */
+int
+lib_commu_db_tcp_server_status_get(struct server_status *server_status,
+                                   uint16_t server_idx)
+{
+    int err = 0;
+    int is_db_locked = 0;
+    uint32_t i = 0, j = 0;
+    uint32_t len = 0;
+    struct server_db *server = NULL;
+    struct handle_info *handle_info_st = NULL;
+
+    lib_commu_bail_null(server_status);
+
+    err = pthread_mutex_lock(&lock_handles_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    err = server_db_lookup(server_idx, &server);
+    lib_commu_bail_error(err);
+
+    server_status->clients_num = server->status.clients_num;
+    server_status->listener_handle = server->status.listener_handle;
+    server_status->listener_status = server->status.listener_status;
+
+    len = handle_table_len(&server->handles);
+    for (i = 0; (i < len) && (j < MAX_CONNECTION_NUM); i++) {
+        handle_info_st = handle_table_entry(&server->handles, i);
+        if (handle_info_st->handle != INVALID_HANDLE_ID) {
+            connection_status_fill(handle_info_st,
+                                   &server_status->client_status[j++]);
+        }
+    }
+    for (; j < MAX_CONNECTION_NUM; j++) {
+        memset(&server_status->client_status[j], 0,
+               sizeof(server_status->client_status[j]));
+        server_status->client_status[j].handle = INVALID_HANDLE_ID;
+    }
+
+bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_handles_db_access);
+    }
+    return err;
+}
+
+
+/**
+ *  This function gets a page of the clients status of the server
+ *
+ * @param[in] server_idx - the server id
+ * @param[in] offset - #clients to skip
+ * @param[out] status_arr - the clients status
+ * @param[in,out] status_num - size of status_arr, filled with #clients returned
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if status_arr == NULL or status_num == NULL
+ * @return ENOKEY if server does not exist
+ */
+int
+lib_commu_db_tcp_server_clients_status_get(uint16_t server_idx,
+                                           uint32_t offset,
+                                           struct connection_status *status_arr,
+                                           uint32_t *status_num)
+{
+    int err = 0;
+    uint32_t i = 0, j = 0, k = 0;
+    uint32_t len = 0;
+    int is_db_locked = 0;
+    struct server_db *server = NULL;
+    struct handle_info *handle_info_st = NULL;
+
+    lib_commu_bail_null(status_arr);
+    lib_commu_bail_null(status_num);
+
+    err = pthread_mutex_lock(&lock_handles_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    err = server_db_lookup(server_idx, &server);
+    lib_commu_bail_error(err);
+
+    len = handle_table_len(&server->handles);
+    for (i = 0; (i < len) && (j < *status_num); i++) {
+        handle_info_st = handle_table_entry(&server->handles, i);
+        if (handle_info_st->handle == INVALID_HANDLE_ID) {
+            continue;
+        }
+        if (k++ < offset) {
+            continue;
+        }
+        connection_status_fill(handle_info_st, &status_arr[j++]);
+    }
+
+bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_handles_db_access);
+    }
+    if (status_num != NULL) {
+        *status_num = j;
+    }
+    return err;
+}
+
+
+/**
+ *  This function gets the handles of the server clients
+ *
+ * @param[in] server_idx - the server id
+ * @param[in] offset - #clients to skip
+ * @param[out] handle_arr - the clients handles
+ * @param[in,out] handle_num - size of handle_arr, filled with #handles returned
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if handle_arr == NULL or handle_num == NULL
+ * @return ENOKEY if server does not exist
+ */
+int
+lib_commu_db_tcp_server_handles_get(uint16_t server_idx, uint32_t offset,
+                                    handle_t *handle_arr, uint32_t *handle_num)
+{
+    int err = 0;
+    uint32_t i = 0, j = 0, k = 0;
+    uint32_t len = 0;
+    int is_db_locked = 0;
+    struct server_db *server = NULL;
+    struct handle_info *handle_info_st = NULL;
+
+    lib_commu_bail_null(handle_arr);
+    lib_commu_bail_null(handle_num);
+
+    err = pthread_mutex_lock(&lock_handles_db_access);
+    lib_commu_bail_error(err);
+    is_db_locked = 1;
+
+    err = server_db_lookup(server_idx, &server);
+    lib_commu_bail_error(err);
+
+    len = handle_table_len(&server->handles);
+    for (i = 0; (i < len) && (j < *handle_num); i++) {
+        handle_info_st = handle_table_entry(&server->handles, i);
+        if (handle_info_st->handle == INVALID_HANDLE_ID) {
+            continue;
+        }
+        if (k++ < offset) {
+            continue;
+        }
+        handle_arr[j++] = handle_info_st->handle;
+    }
+
+bail:
+    if (is_db_locked) {
+        pthread_mutex_unlock(&lock_handles_db_access);
+    }
+    if (handle_num != NULL) {
+        *handle_num = j;
+    }
+    return err;
+}
+
+
+/**
+ *  This function gets an unoccupied slot in listener sessions array
+ *
+ * @param[in,out] idx - the unoccupied index in the array.
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOBUFS - if can't find unoccupied listener in DB
+ */
+int
+lib_commu_db_unoccupied_listener_thread_get(uint16_t *idx)
+{
+    int err = 0;
+    uint32_t i = 0;
+
+    lib_commu_bail_null(idx);
+
+    for (i = 0; i < db_limits.max_servers; i++) {
+        if (listener_sessions[i] == NULL) {
+            *idx = i;
+            goto bail;
+        }
+    }
+
+    LCM_LOG(LCOMMU_LOG_ERROR, "No empty slot in listeners DB[%u]\n",
+            db_limits.max_servers);
+    lib_commu_bail_force(ENOBUFS);
+
+bail:
+    return err;
+}
+
+
+/**
+ *  This function returns the maximum number of servers
+ *
+ * @return the maximum number of servers
+ */
+uint16_t
+lib_commu_db_max_servers_get(void)
+{
+    return (uint16_t)db_limits.max_servers;
+}
+
+
+/**
+ *  This function deletes udp handle_info by key handle
+ *  It waits for the calls holding the entry to release it.
+ *
+ * @param[in] handle - socket handle
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+lib_commu_db_udp_handle_info_delete(handle_t handle)
+{
+    int err = 0;
+    struct handle_info *handle_info_st = NULL;
+
+    err = handle_info_closing_set(handle, 0, &handle_info_st);
+    lib_commu_bail_error(err);
+
+    lib_commu_db_handle_info_users_wait(handle_info_st);
+
+    err = handle_info_delete(handle_info_st);
+    lib_commu_bail_error(err);
+
+bail:
+    return err;
+}
+
+
+/**
+ *  This function deletes tcp handle_info by key handle
+ *  The supported DB types: TCP_CLIENT_HANDLE_DB && TCP_SERVER_HANDLE_DB
+ *  It waits for the calls holding the entry to release it.
  *
  * @param[in] handle - socket handle
- * @param[in] params - udp parameters needed initialize the session
- * @param[in] local_magic - the magic identifier of the socket
  *
  * @return 0 if operation completes successfully.
- * @return ENOBUFS if no space left in udp_handle_info DB.
- * @return EPERM if operation failed.
+ * @return ENOKEY if didn't found handle in DB.
+ * @return EINVAL if can't find this handle
+ * @return EPERM unsupported DB type
  */
 int
-lib_commu_db_udp_handle_info_set(handle_t handle,
-                                 const struct ip_udp_params const *params,
-                                 uint32_t local_magic)
+lib_commu_db_tcp_handle_info_delete(handle_t handle)
 {
     int err = 0;
+    struct handle_info *handle_info_st = NULL;
 
-    struct addr_info local_info;
-    struct addr_info peer_info;
-
-    memset(&local_info, 0, sizeof(local_info));
-    memset(&peer_info, 0, sizeof(peer_info));
+    err = handle_info_closing_set(handle, 1, &handle_info_st);
+    lib_commu_bail_error(err);
 
-    local_info.ipv4_addr = params->session_params.port;
-    local_info.port = params->session_params.port;
+    lib_commu_db_handle_info_users_wait(handle_info_st);
 
-    err = handle_info_set(UDP_HANDLE_DB, INVALID_SERVER_ID,handle,
-                          params->session_params.msg_type,
-                          local_info, peer_info, params->is_single_peer,
-                          local_magic);
+    err = handle_info_delete(handle_info_st);
     lib_commu_bail_error(err);
 
 bail:
@@ -706,30 +1401,25 @@ bail:
 
 
 /**
- *  This function updates server tcp handle_info with new entries created by
- *  listener socket
+ *  This function marks a udp handle_info closing, no new call holds it and
+ *  the calls holding it keep it till they release it. Only one closer takes
+ *  an entry, the others get ENOKEY.
  *
- * @param[in] server_id - the server id
  * @param[in] handle - socket handle
- * @param[in] msg_type - type of message to send/receive on the socket
- * @param[in] port - port number bounded to the socket
- * @param[in] local_magic - the magic identifier of the socket
+ * @param[out] handle_info_st - the entry
  *
  * @return 0 if operation completes successfully.
- * @return ENOBUFS if no space left in udp_handle_info DB.
- * @return EPERM if operation failed.
+ * @return ENOKEY if didn't found handle in DB.
  */
 int
-lib_commu_db_tcp_server_handle_info_set(uint16_t server_id, handle_t handle,
-                                            uint8_t msg_type,
-                                            struct addr_info local_info,
-                                            struct addr_info peer_info,
-                                            uint32_t local_magic)
+lib_commu_db_udp_handle_info_closing_set(handle_t handle,
+                                       struct handle_info **handle_info_st)
 {
     int err = 0;
 
-    err = handle_info_set(TCP_SERVER_HANDLE_DB, server_id, handle, msg_type,
-                          local_info, peer_info, 1, local_magic);
+    lib_commu_bail_null(handle_info_st);
+
+    err = handle_info_closing_set(handle, 0, handle_info_st);
     lib_commu_bail_error(err);
 
 bail:
@@ -738,52 +1428,67 @@ bail:
 
 
 /**
- *  This function updates server tcp handle_info with new entries
- *  initiated by client
+ *  This function marks a tcp handle_info closing, no new call holds it and
+ *  the calls holding it keep it till they release it. Only one closer takes
+ *  an entry, the others get ENOKEY.
  *
  * @param[in] handle - socket handle
- * @param[in] msg_type - type of message to send/receive on the socket
- * @param[in] port - port number bounded to the socket
- * @param[in] local_magic - the magic identifier of the socket
+ * @param[out] handle_info_st - the entry
  *
  * @return 0 if operation completes successfully.
- * @return ENOBUFS if no space left in udp_handle_info DB.
- * @return EPERM if operation failed.
+ * @return ENOKEY if didn't found handle in DB.
+ * @return EPERM unsupported DB type
  */
 int
-lib_commu_db_tcp_client_handle_info_set(handle_t handle, uint8_t msg_type,
-                                            struct addr_info local_info,
-                                            struct addr_info peer_info,
-                                            uint32_t local_magic)
+lib_commu_db_tcp_handle_info_closing_set(handle_t handle,
+                                       struct handle_info **handle_info_st)
 {
     int err = 0;
 
-    err = handle_info_set(TCP_CLIENT_HANDLE_DB, INVALID_SERVER_ID, handle,
-                          msg_type, local_info, peer_info, 1, local_magic);
+    lib_commu_bail_null(handle_info_st);
+
+    err = handle_info_closing_set(handle, 1, handle_info_st);
     lib_commu_bail_error(err);
 
 bail:
     return err;
 }
 
+
 /**
- *  This function set the listener handle
+ *  This function waits for the calls holding a closing handle_info
+ *  to release it
  *
- * @param[in] listener_handle - listener socket handle.
+ * @param[in] handle_info_st - the entry
+ */
+void
+lib_commu_db_handle_info_users_wait(struct handle_info *handle_info_st)
+{
+    while (__atomic_load_n(&handle_info_st->users, __ATOMIC_SEQ_CST) > 0) {
+        usleep(HANDLE_USERS_WAIT_USEC);
+    }
+}
+
+
+/**
+ *  This function deletes a closing handle_info once no call holds it,
+ *  its state is freed
+ *
+ * @param[in] handle_info_st - the entry
  *
  * @return 0 if operation completes successfully.
+ * @return EINVAL if the table of the entry holds no handles
+ * @return EPERM unsupported DB type
  */
 int
-lib_commu_db_server_status_listener_set(uint16_t server_id,
-                                            handle_t listener_handle,
-                                            enum handle_op_status is_enabled)
+lib_commu_db_handle_info_delete(struct handle_info *handle_info_st)
 {
     int err = 0;
 
-    server_status_st[server_id].listener_handle = listener_handle;
-    server_status_st[server_id].listener_status = is_enabled;
+    lib_commu_bail_null(handle_info_st);
 
-    goto bail; /*for compilation propose*/
+    err = handle_info_delete(handle_info_st);
+    lib_commu_bail_error(err);
 
 bail:
     return err;
@@ -791,311 +1496,276 @@ bail:
 
 
 /**
- *  This function set new client into server DB
+ *  This function gets handle_info by key handle and holds it, it isn't
+ *  deleted before lib_commu_db_handle_info_release is called.
+ *
+ * @param[in] handle - socket handle
+ * @param[out] handle_info_st - the information on the handle
+ * @param[in,out] handle_db_type - if the handle_db_type is ANY then it will
+ *                                 return the type of the DB holding the handle
+ *                                 else - the handle must be in the specific DB
+ * @param[in,out] server_id - the server id filled if the  handle_db_type == TCP_SERVER_HANDLE_DB
+ *                            may be NULL
  *
- * @param[in] handle - client socket handle, which connected to server.
- * @param[in] clientaddr - client information
- * @param[in] s_ipv4_addr - source ipv4 (local)
- * @param[in] s_port - source port
- * @param[in] server_idx - server id
  * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
  */
 int
-lib_cummo_db_server_status_client_set(handle_t handle,
-                                          struct sockaddr_in *clientaddr,
-                                          uint32_t s_ipv4_addr,
-                                          uint16_t s_port,
-                                          uint16_t server_idx)
+lib_commu_db_handle_info_hold(handle_t handle,
+                              struct handle_info **handle_info_st,
+                              enum db_type *handle_db_type,
+                              uint16_t *server_id)
 {
     int err = 0;
-    uint16_t handle_idx = 0;
-    err =
-        find_empty_slot(TCP_SERVER_STATUS_HANDLE_DB, server_idx, &handle_idx);
-    lib_commu_bail_error(err);
+    struct handle_info *entry = NULL;
 
-    server_status_st[server_idx].clients_num += 1;
-    server_status_st[server_idx].client_status[handle_idx].handle = handle;
-    server_status_st[server_idx].client_status[handle_idx].handle_status =
-            HANDLE_STATUS_UP;
-    server_status_st[server_idx].client_status[handle_idx].local_ipv4_addr =
-        s_ipv4_addr;
-    server_status_st[server_idx].client_status[handle_idx].local_port = s_port;
-    server_status_st[server_idx].client_status[handle_idx].peer_ipv4_addr =
-            clientaddr->sin_addr.s_addr;
-    server_status_st[server_idx].client_status[handle_idx].peer_port =
-            clientaddr->sin_port;
+    lib_commu_bail_null(handle_info_st);
+    lib_commu_bail_null(handle_db_type);
+
+    entry = handle_info_lookup(handle, *handle_db_type);
+    if (entry != NULL) {
+        /* a closer marks the entry before it checks users, so either it
+         * waits for us or we see the mark. The entry may have been reused
+         * meanwhile if it was deleted */
+        __atomic_add_fetch(&entry->users, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&entry->is_closing, __ATOMIC_SEQ_CST) ||
+            (handle_info_lookup(handle, *handle_db_type) != entry)) {
+            __atomic_sub_fetch(&entry->users, 1, __ATOMIC_SEQ_CST);
+            entry = NULL;
+        }
+    }
+    if (entry == NULL) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] not found", handle);
+        lib_commu_bail_force(ENOKEY);
+    }
 
+    *handle_info_st = entry;
+    *handle_db_type = entry->db_type;
+    if ((entry->db_type == TCP_SERVER_HANDLE_DB) && (server_id != NULL)) {
+        *server_id = entry->server_id;
+    }
 
 bail:
     return err;
 }
 
+
 /**
- *  This function fill up the server status struct
+ *  This function releases a handle_info held by
+ *  lib_commu_db_handle_info_hold
+ *
+ * @param[in] handle_info_st - the entry, may be NULL
+ */
+void
+lib_commu_db_handle_info_release(struct handle_info *handle_info_st)
+{
+    if (handle_info_st != NULL) {
+        __atomic_sub_fetch(&handle_info_st->users, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+
+/**
+ *  This function gets handle_info by key handle
+ *  The handle is looked up in the fd indexed table without taking the DB lock.
  *
- * @param[in,out] server_status - the server status
+ * @param[in] handle - socket handle
+ * @param[in,out] handle_info - the information on the handle
+ * @param[in,out] handle_db_type - if the handle_db_type is ANY then it will
+ *                                 return the type of the DB holding the handle
+ *                                 else - the handle must be in the specific DB
+ * @param[in,out] server_id - the server id filled if the  handle_db_type == TCP_SERVER_HANDLE_DB
+ *                            may be NULL
  *
  * @return 0 if operation completes successfully.
- * @return ENOKEY if server does not exist - id out of bound
+ * @return ENOKEY if didn't found handle in DB.
  */
 int
-lib_commu_db_tcp_server_status_get(
-        struct server_status const **server_status, uint16_t server_idx)
+lib_commu_db_hanlde_info_get(handle_t handle,
+                                 struct handle_info **handle_info_st,
+                                 enum db_type *handle_db_type,
+                                 uint16_t *server_id)
 {
     int err = 0;
-    int peer_err = 0;
-    int i = 0;
-    struct sockaddr_in client_addr;
-    socklen_t addr_len = sizeof(client_addr);
+    struct handle_info *entry = NULL;
 
-    lib_commu_bail_null(server_status);
+    lib_commu_bail_null(handle_info_st);
+    lib_commu_bail_null(handle_db_type);
 
-    if(server_idx >= SERVER_STATUS_ARR_LENGTH) {
-        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid parameter [server_idx]\n");
+    /* a miss isn't logged, the internal probes expect it */
+    entry = handle_info_lookup(handle, *handle_db_type);
+    if (entry == NULL) {
         lib_commu_bail_force(ENOKEY);
     }
 
-
-    for (i = 0; i < MAX_CONNECTION_NUM; i++) {
-        if (server_status_st[server_idx].client_status[i].handle !=
-            INVALID_HANDLE_ID) {
-            peer_err = getpeername(
-                    server_status_st[server_idx].client_status[i].handle,
-                    (struct sockaddr *) &client_addr, &addr_len);
-            if (peer_err != 0) {
-                if (errno == ENOTCONN) {
-                    server_status_st[server_idx].client_status[i].handle_status
-                        = HANDLE_STATUS_DOWN;
-                    continue;
-                }
-                LCM_LOG(LCOMMU_LOG_ERROR, "getpeername() failed with err(%d)\n", peer_err);
-                lib_commu_bail_force(peer_err);
-            }
-            server_status_st[server_idx].client_status[i].handle_status =
-                    HANDLE_STATUS_UP;
-        }
+    *handle_info_st = entry;
+    *handle_db_type = entry->db_type;
+    if ((entry->db_type == TCP_SERVER_HANDLE_DB) && (server_id != NULL)) {
+        *server_id = entry->server_id;
     }
 
-
-    *server_status = &(server_status_st[server_idx]);
-
 bail:
     return err;
 }
 
+
 /**
- *  This function gets an unoccupied slot in listener thread array
+ *  This function update the total rx bytes received on handle
  *
- * @param[in,out] idx - the unoccupied index in the array.
+ * @param[in] handle - socket handle
+ * @param[in] handle_db_type - the handle type {TCP(client/server), UDP}
+ * @param[in] rx_bytes - number of bytes to add to total_rx
  *
  * @return 0 if operation completes successfully.
- * @return ENOBUFS - if can't find unoccupied listener in DB
+ * @return ENOKEY if didn't found handle in DB.
  */
 int
-lib_commu_db_unoccupied_listener_thread_get(uint16_t *idx)
+handle_total_rx_update(handle_t handle, enum db_type *handle_db_type,
+                       unsigned long long rx_bytes)
 {
     int err = 0;
 
-    lib_commu_bail_null(idx);
+    struct handle_info *handle_info_st = NULL;
 
-    err = find_empty_slot(LISTENER_THREAD_DB, INVALID_SERVER_ID ,idx);
+    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st, handle_db_type,
+                                       NULL);
     lib_commu_bail_error(err);
 
+    __sync_fetch_and_add(&handle_info_st->socekt_info.total_sum_bytes_rx,
+                         rx_bytes);
+
 bail:
     return err;
 }
 
+
 /**
- *  This function deletes udp handle_info by key handle
+ *  This function update the total tx bytes sent on handle
  *
  * @param[in] handle - socket handle
+ * @param[in] handle_db_type - the handle type {TCP(client/server), UDP}
+ * @param[in] tx_bytes - number of bytes to add to total_tx
  *
  * @return 0 if operation completes successfully.
  * @return ENOKEY if didn't found handle in DB.
  */
 int
-lib_commu_db_udp_handle_info_delete(handle_t handle)
+handle_total_tx_update(handle_t handle, enum db_type *handle_db_type,
+                       unsigned long long tx_bytes)
 {
     int err = 0;
-    uint16_t idx = 0;
-    int is_db_locked = 0;
 
-    err = find_handle_idx(UDP_HANDLE_DB, INVALID_SERVER_ID, handle, &idx);
-    lib_commu_bail_error(err);
+    struct handle_info *handle_info_st = NULL;
 
-    err = pthread_mutex_lock(&lock_handles_db_access);
+    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st, handle_db_type,
+                                       NULL);
     lib_commu_bail_error(err);
-    is_db_locked = 1;
 
-    memset(&udp_handle_info[idx], 0, sizeof(udp_handle_info[idx]));
-    udp_handle_info[idx].handle = INVALID_HANDLE_ID;
-    udp_handle_info[idx].socekt_info.peer_magic = INVALID_MAGIC;
+    __sync_fetch_and_add(&handle_info_st->socekt_info.total_sum_bytes_tx,
+                         tx_bytes);
 
 bail:
-    if (is_db_locked) {
-        err = pthread_mutex_unlock(&lock_handles_db_access);
-        lib_commu_return_from_bail(err);
-    }
     return err;
 }
 
 
 /**
- *  This function deletes tcp handle_info by key handle
- *  The supported DB types: TCP_CLIENT_HANDLE_DB && TCP_SERVER_HANDLE_DB
+ *  This function adds to a traffic counter of the handle
  *
  * @param[in] handle - socket handle
+ * @param[in] counter - the counter to update
+ * @param[in] value - the value to add
  *
  * @return 0 if operation completes successfully.
  * @return ENOKEY if didn't found handle in DB.
- * @return EINVAL if can't find this handle
- * @return EPERM unsupported DB type
  */
 int
-lib_commu_db_tcp_handle_info_delete(handle_t handle)
+handle_stats_counter_add(handle_t handle, enum handle_stats_counter counter,
+                         unsigned long long value)
 {
     int err = 0;
-    uint16_t server_id = 0;
-    uint16_t idx = 0;
-    int is_db_locked = 0;
+
     struct handle_info *handle_info_st = NULL;
     enum db_type handle_db_type = ANY_HANLDE_DB;
 
-    err = pthread_mutex_lock(&lock_handles_db_access);
-    lib_commu_bail_error(err);
-    is_db_locked = 1;
+    if (counter >= HANDLE_STATS_COUNTERS_NUM) {
+        lib_commu_bail_force(EINVAL);
+    }
 
-    /* 1. get handle info */
     err = lib_commu_db_hanlde_info_get(handle, &handle_info_st,
-                                       &handle_db_type,
-                                       &server_id);
+                                       &handle_db_type, NULL);
     lib_commu_bail_error(err);
-    lib_commu_bail_null(handle_info_st);
-
-    if ((handle_db_type == TCP_CLIENT_HANDLE_DB) ||
-            (handle_db_type == TCP_SERVER_HANDLE_DB)) {
-        /* reset handle DB */
-        memset((char*) handle_info_st, 0, sizeof(*handle_info_st));
-        handle_info_st->handle = INVALID_HANDLE_ID;
-        handle_info_st->socekt_info.peer_magic = INVALID_MAGIC;
-
-        /* if handle initiated by server --> update it's DB */
-        if (handle_db_type == TCP_SERVER_HANDLE_DB) {
-            if (server_status_st[server_id].clients_num > 0) {
-                server_status_st[server_id].clients_num--;
-                err = find_handle_idx(TCP_SERVER_STATUS_HANDLE_DB, server_id,
-                                      handle, &idx);
-                lib_commu_bail_error(err);
-                memset(&server_status_st[server_id].client_status[idx], 0,
-                       sizeof(server_status_st[server_id].client_status[idx]));
-                server_status_st[server_id].client_status[idx].handle =
-                        INVALID_HANDLE_ID;
-            }
-            else { /* programming error: number of clients must be > 0 else no handle can be delete */
-                LCM_LOG(LCOMMU_LOG_ERROR, "#clients must be > 0\n");
-                lib_commu_bail_error(EINVAL);
-            }
-        }
-
-        /* finish reset all DB --> goto bail */
-        goto bail;
-    }
-
-    /* unsupported DB type */
-    LCM_LOG(LCOMMU_LOG_ERROR, "Invalid handle type[%d]", handle_db_type);
-    lib_commu_bail_force(EPERM);
 
+    __sync_fetch_and_add(&handle_info_st->stats[counter], value);
 
 bail:
-    if (is_db_locked) {
-        err = pthread_mutex_unlock(&lock_handles_db_access);
-        lib_commu_return_from_bail(err);
-    }
     return err;
 }
 
 
 /**
- *  This function gets handle_info by key handle
+ *  This function gets the traffic counters of the handle
  *
  * @param[in] handle - socket handle
- * @param[in,out] handle_info - the information on the handle
- * @param[in,out] handle_db_type - if the handle_db_type is ANY then it will
- *                                 search in all handle DB and will return the type
- *                                 else - the specific DB
- * @param[in,out] server_id - the server id filled if the  handle_db_type == TCP_SERVER_HANDLE_DB
- *                            may be NULL
+ * @param[out] stats - the handle counters
  *
  * @return 0 if operation completes successfully.
+ * @return EINVAL if stats == NULL.
  * @return ENOKEY if didn't found handle in DB.
  */
 int
-lib_commu_db_hanlde_info_get(handle_t handle,
-                                 struct handle_info **handle_info_st,
-                                 enum db_type *handle_db_type,
-                                 uint16_t *server_id)
+lib_commu_db_handle_stats_get(handle_t handle, struct handle_stats *stats)
 {
     int err = 0;
-    int i = 0, j = 0;
 
-    lib_commu_bail_null(handle_info_st);
-    lib_commu_bail_null(handle_db_type);
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
 
-    switch(*handle_db_type) {
+    lib_commu_bail_null(stats);
 
-        case ANY_HANLDE_DB:
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
+    lib_commu_bail_error(err);
 
-        case TCP_CLIENT_HANDLE_DB:
-            for (i = 0; i < TCP_HANDLE_ARR_LENGTH; i++) {
-                if (client_tcp_handle_info[i].handle == handle) {
-                    *handle_info_st = &(client_tcp_handle_info[i]);
-                    *handle_db_type = TCP_CLIENT_HANDLE_DB;
-                    goto bail;
-                }
-            }
-            if(*handle_db_type != ANY_HANLDE_DB) {
-                break;
-            }
+    handle_stats_fill(handle_info_st, stats);
 
-        case TCP_SERVER_HANDLE_DB:
-            for (j = 0; j < SERVER_STATUS_ARR_LENGTH; j++) {
-                if (server_status_st[j].clients_num > 0) {
-                    for (i = 0; i < TCP_HANDLE_ARR_LENGTH; i++) {
-                        if (server_tcp_handle_info[j][i].handle == handle) {
-                            *handle_info_st = &(server_tcp_handle_info[j][i]);
-                            *handle_db_type = TCP_SERVER_HANDLE_DB;
-                            if(server_id != NULL) { /*sometimes server_id is not needed */
-                                *server_id = j;
-                            }
-                            goto bail;
-                        }
-                    }
-                }
-            }
-            if (*handle_db_type != ANY_HANLDE_DB) {
-                break;
-            }
+bail:
+    lib_commu_db_handle_info_release(handle_info_st);
+    return err;
+}
 
-        case UDP_HANDLE_DB:
-            for (i = 0; i < UDP_HANDLE_ARR_LENGTH; i++) {
-                if (udp_handle_info[i].handle == handle) {
-                    *handle_info_st = &(udp_handle_info[i]);
-                    *handle_db_type = UDP_HANDLE_DB;
-                    goto bail;
-                }
-            }
-            if(*handle_db_type != ANY_HANLDE_DB) {
-                break;
-            }
 
-        default:
-            LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] not found", handle);
-            lib_commu_bail_force(EINVAL);
-            break;
-    }
+/**
+ *  This function adds the values of one send/recv call
+ *  to the histograms of the handle
+ *
+ * @param[in] handle - socket handle
+ * @param[in] is_rx - update the receive histograms, else the send ones
+ * @param[in] time_ns - nsec spent in the call
+ * @param[in] bytes - bytes transferred by the call
+ * @param[in] retries - repeated send/recv of the call
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+handle_io_hists_update(handle_t handle, int is_rx, unsigned long long time_ns,
+                       unsigned long long bytes, unsigned long long retries)
+{
+    int err = 0;
+
+    struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+
+    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st,
+                                       &handle_db_type, NULL);
+    lib_commu_bail_error(err);
 
-    LCM_LOG(LCOMMU_LOG_ERROR, "handle[%d] not found", handle);
-    lib_commu_bail_error(ENOKEY);
+    handle_hist_add(&handle_info_st->hist[is_rx ? HANDLE_HIST_RX_TIME :
+                                          HANDLE_HIST_TX_TIME], time_ns);
+    handle_hist_add(&handle_info_st->hist[is_rx ? HANDLE_HIST_RX_SIZE :
+                                          HANDLE_HIST_TX_SIZE], bytes);
+    handle_hist_add(&handle_info_st->hist[HANDLE_HIST_RETRIES], retries);
 
 bail:
     return err;
@@ -1103,28 +1773,75 @@ bail:
 
 
 /**
- *  This function update the total rx bytes received on handle
+ *  This function adds a received traced message to the latency histogram
+ *  and the gaps/reorders counters of the handle
  *
  * @param[in] handle - socket handle
- * @param[in] handle_db_type - the handle type {TCP(client/server), UDP}
- * @param[in] rx_bytes - number of bytes to add to total_rx
+ * @param[in] peer_magic - magic of the sender, a new sender restarts the sequence
+ * @param[in] peer_ipv4_addr - address of the sender (network order)
+ * @param[in] seq - sequence number of the message
+ * @param[in] latency_ns - nsec from the send of the message, meaningful
+ *                         only if the sender is on the same host
  *
  * @return 0 if operation completes successfully.
  * @return ENOKEY if didn't found handle in DB.
  */
 int
-handle_total_rx_update(handle_t handle, enum db_type *handle_db_type,
-                       unsigned long long rx_bytes)
+handle_trace_rx_update(handle_t handle, uint32_t peer_magic,
+                       uint32_t peer_ipv4_addr, uint32_t seq,
+                       long long latency_ns)
 {
     int err = 0;
 
     struct handle_info *handle_info_st = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
+    uint64_t state = 0, new_state = 0;
+    int32_t diff = 0;
 
-    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st, handle_db_type,
-                                       NULL);
+    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st,
+                                       &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    handle_info_st->socekt_info.total_sum_bytes_rx += rx_bytes;
+    /* the peer accepts MSG_TRACE_VERSION */
+    if (!__atomic_load_n(&handle_info_st->is_peer_traced, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&handle_info_st->is_peer_traced, 1, __ATOMIC_RELAXED);
+    }
+
+    /* the CLOCK_MONOTONIC times of peers on other hosts aren't comparable */
+    if (trace_peer_is_local(handle_info_st, peer_ipv4_addr)) {
+        if (latency_ns < 0) {
+            __sync_fetch_and_add(&handle_info_st->stats[HANDLE_STATS_RX_CLOCK_SKEWS],
+                                 1);
+        }
+        else {
+            handle_hist_add(&handle_info_st->hist[HANDLE_HIST_RX_LATENCY],
+                            (unsigned long long)latency_ns);
+        }
+    }
+
+    /* concurrent receivers of the handle race on the expected sequence */
+    state = __atomic_load_n(&handle_info_st->trace_rx_state, __ATOMIC_RELAXED);
+    do {
+        diff = 0;
+        new_state = ((uint64_t)peer_magic << 32) | (uint32_t)(seq + 1);
+        if ((state >> 32) == peer_magic) {
+            diff = (int32_t)(seq - (uint32_t)state);
+            if (diff < 0) {
+                break;  /* a late message keeps the expected one */
+            }
+        }
+    } while (!__atomic_compare_exchange_n(&handle_info_st->trace_rx_state,
+                                          &state, new_state, 0,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    if (diff > 0) {
+        __sync_fetch_and_add(&handle_info_st->stats[HANDLE_STATS_RX_GAPS],
+                             (unsigned long long)diff);
+    }
+    else if (diff < 0) {
+        __sync_fetch_and_add(&handle_info_st->stats[HANDLE_STATS_RX_REORDERS],
+                             1);
+    }
 
 bail:
     return err;
@@ -1132,29 +1849,43 @@ bail:
 
 
 /**
- *  This function update the total tx bytes sent on handle
+ *  This function gets the histograms of the handle
  *
  * @param[in] handle - socket handle
- * @param[in] handle_db_type - the handle type {TCP(client/server), UDP}
- * @param[in] tx_bytes - number of bytes to add to total_tx
+ * @param[out] hists - the handle histograms
  *
  * @return 0 if operation completes successfully.
+ * @return EINVAL if hists == NULL.
  * @return ENOKEY if didn't found handle in DB.
  */
 int
-handle_total_tx_update(handle_t handle, enum db_type *handle_db_type,
-                       unsigned long long tx_bytes)
+lib_commu_db_handle_histograms_get(handle_t handle,
+                                   struct handle_histograms *hists)
 {
     int err = 0;
-
+    uint32_t i = 0, j = 0;
     struct handle_info *handle_info_st = NULL;
+    struct handle_hist *hist = NULL;
+    enum db_type handle_db_type = ANY_HANLDE_DB;
 
-    err = lib_commu_db_hanlde_info_get(handle, &handle_info_st, handle_db_type,
-                                       NULL);
+    lib_commu_bail_null(hists);
+
+    err = lib_commu_db_handle_info_hold(handle, &handle_info_st,
+                                        &handle_db_type, NULL);
     lib_commu_bail_error(err);
 
-    handle_info_st->socekt_info.total_sum_bytes_tx += tx_bytes;
+    /* each value is read atomically, the histogram as a whole is not a snapshot */
+    for (i = 0; i < HANDLE_HIST_NUM; i++) {
+        hist = &handle_info_st->hist[i];
+        hists->hist[i].count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+        hists->hist[i].sum = __atomic_load_n(&hist->sum, __ATOMIC_RELAXED);
+        for (j = 0; j < HANDLE_HIST_BUCKETS_NUM; j++) {
+            hists->hist[i].buckets[j] = __atomic_load_n(&hist->buckets[j],
+                                                        __ATOMIC_RELAXED);
+        }
+    }
 
 bail:
+    lib_commu_db_handle_info_release(handle_info_st);
     return err;
 }
@@ -24,13 +24,12 @@
  *  Local Defines
  ***********************************************/
 
-#define UDP_HANDLE_ARR_LENGTH       (16)
-#define TCP_HANDLE_ARR_LENGTH       (16)
-#define NUM_OF_LISTENER_THREADS     (16)
-#define SERVER_STATUS_ARR_LENGTH    NUM_OF_LISTENER_THREADS
 #define INVALID_MAGIC               UINT32_MAX
-#define SOCKET_PATH_LEN             (50)
-#define INVALID_SERVER_ID           SERVER_STATUS_ARR_LENGTH+1
+#define INVALID_SERVER_ID           UINT16_MAX
+#define HANDLE_TABLE_CHUNK_SIZE     (64) /* #entries allocated at once when a handle table grows */
+#define HANDLE_INDEX_MAX_SIZE       (1024 * 1024) /* bound of the fd indexed handle table */
+#define HANDLE_USERS_WAIT_USEC      (1000) /* poll interval of a closer waiting for the calls using a handle */
+#define HANDLE_CLOSE_PENDING_CLOSED (0x80000000) /* close_pending flag, set once the closer is done */
 
 /************************************************
  *  Local Macros
@@ -49,6 +48,45 @@ enum db_type {
     ANY_HANLDE_DB                         /**< any kind of DB - not specified*/
 };
 
+/**
+ * handle_stats_counter enum is used to index
+ * the traffic counters of a handle
+ */
+enum handle_stats_counter {
+    HANDLE_STATS_RX_MSGS = 0,   /**< messages received, the bytes are counted by socekt_info */
+    HANDLE_STATS_TX_MSGS,       /**< messages sent */
+    HANDLE_STATS_RX_ERRORS,     /**< failed receive calls and dropped messages */
+    HANDLE_STATS_TX_ERRORS,     /**< failed send calls */
+    HANDLE_STATS_RETRIES,       /**< repeated send/recv on partial transfer, EINTR or EAGAIN */
+    HANDLE_STATS_ZEROCOPY_SENDS,  /**< sendmsg() calls with MSG_ZEROCOPY */
+    HANDLE_STATS_ZEROCOPY_COPIED, /**< MSG_ZEROCOPY completions the kernel copied */
+    HANDLE_STATS_RX_GAPS,       /**< traced messages skipped */
+    HANDLE_STATS_RX_REORDERS,   /**< traced messages received late */
+    HANDLE_STATS_RX_CLOCK_SKEWS, /**< traced messages received before their send time */
+    HANDLE_STATS_COUNTERS_NUM
+};
+
+/**
+ * rx_stream structure is used to buffer bytes received on a
+ * TCP handle which were not parsed into messages yet
+ */
+struct rx_stream {
+    uint8_t *buffer;    /**< allocated on first use, RX_STREAM_BUFFER_SIZE */
+    uint32_t head;      /**< offset of the first unparsed byte */
+    uint32_t tail;      /**< offset of the end of the received bytes */
+    int is_failed;      /**< set once a message failed midway, the stream is out of sync */
+};
+
+struct tx_queue;
+struct tx_coalesce;
+struct tcp_zerocopy;
+struct tcp_channels;
+struct rx_callback;
+struct handle_reactor;
+struct udp_reassembly;
+struct udp_reliable;
+struct lib_commu_shm_link;
+
 /**
  * handle_info structure is used to store
  * Information for each connection
@@ -57,11 +95,52 @@ struct handle_info {
     handle_t handle;                            /**< the udp/tcp handle   */
     struct connection_info conn_info;           /**< message type to send   */
     struct socket_connection_info socekt_info;  /**< message type to send   */
+    struct rx_stream rx_stream;                 /**< received bytes not parsed yet */
+    enum db_type db_type;                       /**< the DB holding the handle */
+    uint16_t server_id;                         /**< the server id of TCP_SERVER_HANDLE_DB handles */
+    unsigned long long stats[HANDLE_STATS_COUNTERS_NUM]; /**< traffic counters, updated atomically */
+    struct handle_hist hist[HANDLE_HIST_NUM];   /**< histograms, updated atomically */
+    struct tx_queue *tx_queue;                  /**< async send queue, allocated on first async send */
+    struct lib_commu_shm_link *shm_link;        /**< shm session rings, NULL for sockets */
+    struct tx_coalesce *tx_coalesce;            /**< small messages buffer, NULL if not coalescing */
+    uint32_t zerocopy_min_bytes;                /**< MSG_ZEROCOPY sends from this size, 0 if disabled */
+    struct tcp_zerocopy *tcp_zerocopy;          /**< MSG_ZEROCOPY sends state, allocated on first enable */
+    struct tcp_channels *tcp_channels;          /**< msg_type channels, allocated on first channel call */
+    struct rx_callback *rx_callback;            /**< receive callback, NULL if received by the user threads */
+    struct handle_reactor *handle_reactor;      /**< reactor registration of the callback and the async queue */
+    struct udp_reassembly *udp_reassembly;      /**< large UDP messages being reassembled, allocated on first large receive */
+    uint32_t udp_tx_seq;                        /**< sequence number of the last large UDP message sent */
+    uint32_t is_udp_gso_unsupported;            /**< set once a UDP_SEGMENT send of the handle failed */
+    struct udp_reliable *udp_reliable;          /**< reliable peers, NULL if delivered unreliably */
+    enum msg_trace_mode trace_mode;             /**< when the messages are sent with a msg_trace */
+    uint32_t is_peer_traced;                    /**< set once a traced message was received */
+    uint32_t trace_tx_seq;                      /**< sequence number of the next traced message sent */
+    uint64_t trace_rx_state;                    /**< sender magic (high) and next sequence number (low) of the traced messages received */
+    uint32_t is_closing;                        /**< set once a closer took the handle, no new call holds it */
+    uint32_t close_pending;                     /**< #reactor registrations not released yet, the last one closes the handle */
+    uint32_t users;                             /**< #calls holding the entry, kept on reset - must be the last field */
 };
 
-struct listner_exit_event_info {
-        int event_fd[NUM_OF_LISTENER_THREADS];
-        char event_socket_path[NUM_OF_LISTENER_THREADS][SOCKET_PATH_LEN];
+/**
+ * handle_info_table structure is used to store the handles
+ * of one kind. Entries are allocated in chunks of HANDLE_TABLE_CHUNK_SIZE
+ * on demand and are not freed before deinit, so lock free readers
+ * holding an entry stay valid.
+ */
+struct handle_info_table {
+    struct handle_info **chunks;    /**< allocated chunks of entries */
+    uint32_t chunks_num;            /**< #allocated chunks */
+    uint32_t max_len;               /**< maximum #entries */
+    uint32_t used_num;              /**< #entries in use */
+};
+
+/**
+ * server_db structure is used to store
+ * the status and the handles of a tcp server
+ */
+struct server_db {
+    struct server_status status;        /**< the server status */
+    struct handle_info_table handles;   /**< handles accepted by the server */
 };
 
 #endif
@@ -90,12 +169,24 @@ struct listner_exit_event_info {
  *  Type definitions
  ***********************************************/
 
+/**
+ * lib_commu_db_limits structure is used to size
+ * the DB tables
+ */
+struct lib_commu_db_limits {
+    uint32_t max_udp_sessions;          /**< maximum #udp handles */
+    uint32_t max_tcp_clients;           /**< maximum #tcp client handles */
+    uint32_t max_servers;               /**< maximum #tcp servers */
+    uint32_t max_server_connections;    /**< maximum #handles accepted per server */
+};
+
 /************************************************
  *  Global variables
  ***********************************************/
 
-extern pthread_t listener_threads[NUM_OF_LISTENER_THREADS];
-extern struct listner_exit_event_info listner_exit_event_info_st;
+struct listener_session;
+
+extern struct listener_session **listener_sessions;
 
 /************************************************
  *  Function declarations
@@ -144,7 +235,7 @@ lib_commu_db_udp_handle_info_set(handle_t handle,
  */
 int
 lib_commu_db_tcp_server_handle_info_set(uint16_t server_id, handle_t handle,
-                                            uint8_t msg_type,
+                                            uint16_t msg_type,
                                             struct addr_info local_info,
                                             struct addr_info peer_info,
                                             uint32_t local_magic);
@@ -164,7 +255,7 @@ lib_commu_db_tcp_server_handle_info_set(uint16_t server_id, handle_t handle,
  * @return EPERM if operation failed.
  */
 int
-lib_commu_db_tcp_client_handle_info_set(handle_t handle, uint8_t msg_type,
+lib_commu_db_tcp_client_handle_info_set(handle_t handle, uint16_t msg_type,
                                             struct addr_info local_info,
                                             struct addr_info peer_info,
                                             uint32_t local_magic);
@@ -176,6 +267,8 @@ lib_commu_db_tcp_client_handle_info_set(handle_t handle, uint8_t msg_type,
  * @param[in] listener_handle - listener socket handle.
  *
  * @return 0 if operation completes successfully.
+ * @return ENOKEY if server_id is out of bound.
+ * @return ENOMEM if failed to allocate the server DB.
  */
 int
 lib_commu_db_server_status_listener_set(uint16_t server_id,
@@ -184,37 +277,58 @@ lib_commu_db_server_status_listener_set(uint16_t server_id,
 
 
 /**
- *  This function set new client into server DB
+ *  This function fill up the server status struct
+ *  client_status holds the first MAX_CONNECTION_NUM clients of the server.
+ *
+ * @param[out] server_status - the server status, owned by the caller
  *
- * @param[in] handle - client socket handle, which connected to server.
- * @param[in] clientaddr - client information
- * @param[in] s_ipv4_addr - source ipv4 (local)
- * @param[in] s_port - source port
- * @param[in] server_idx - server id
  * @return 0 if operation completes successfully.
+ * @return ENOKEY if server does not exist
+ * @return err != 0 if fails
  */
 int
-lib_cummo_db_server_status_client_set(handle_t handle,
-                                      struct sockaddr_in *clientaddr,
-                                      uint32_t s_ipv4_addr, uint16_t s_port,
-                                      uint16_t server_idx);
+lib_commu_db_tcp_server_status_get(struct server_status *server_status,
+                                   uint16_t server_idx);
 
 
 /**
- *  This function fill up the server status struct
+ *  This function gets a page of the clients status of the server
  *
- * @param[in,out] server_status - the server status
+ * @param[in] server_idx - the server id
+ * @param[in] offset - #clients to skip
+ * @param[out] status_arr - the clients status
+ * @param[in,out] status_num - size of status_arr, filled with #clients returned
  *
  * @return 0 if operation completes successfully.
- * @return err != 0 if fails
+ * @return EINVAL if status_arr == NULL or status_num == NULL
+ * @return ENOKEY if server does not exist
  */
 int
-lib_commu_db_tcp_server_status_get(
-        struct server_status const **server_status, uint16_t server_idx);
+lib_commu_db_tcp_server_clients_status_get(uint16_t server_idx,
+                                           uint32_t offset,
+                                           struct connection_status *status_arr,
+                                           uint32_t *status_num);
 
 
 /**
- *  This function gets an unoccupied slot in listener thread array
+ *  This function gets the handles of the server clients
+ *
+ * @param[in] server_idx - the server id
+ * @param[in] offset - #clients to skip
+ * @param[out] handle_arr - the clients handles
+ * @param[in,out] handle_num - size of handle_arr, filled with #handles returned
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if handle_arr == NULL or handle_num == NULL
+ * @return ENOKEY if server does not exist
+ */
+int
+lib_commu_db_tcp_server_handles_get(uint16_t server_idx, uint32_t offset,
+                                    handle_t *handle_arr, uint32_t *handle_num);
+
+
+/**
+ *  This function gets an unoccupied slot in listener sessions array
  *
  * @param[in,out] idx - the unoccupied index in the array.
  *
@@ -225,8 +339,18 @@ int
 lib_commu_db_unoccupied_listener_thread_get(uint16_t *idx);
 
 
+/**
+ *  This function returns the maximum number of servers
+ *
+ * @return the maximum number of servers
+ */
+uint16_t
+lib_commu_db_max_servers_get(void);
+
+
 /**
  *  This function deletes handle_info by key handle
+ *  It waits for the calls holding the entry to release it.
  *
  * @param[in] handle - socket handle
  *
@@ -240,6 +364,7 @@ lib_commu_db_udp_handle_info_delete(handle_t handle);
 
 /**
  *  This function deletes udp handle_info by key handle
+ *  It waits for the calls holding the entry to release it.
  *
  * @param[in] handle - socket handle
  *
@@ -250,15 +375,106 @@ int
 lib_commu_db_tcp_handle_info_delete(handle_t handle);
 
 
+/**
+ *  This function marks a udp handle_info closing, no new call holds it and
+ *  the calls holding it keep it till they release it. Only one closer takes
+ *  an entry, the others get ENOKEY.
+ *
+ * @param[in] handle - socket handle
+ * @param[out] handle_info_st - the entry
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+lib_commu_db_udp_handle_info_closing_set(handle_t handle,
+                                         struct handle_info **handle_info_st);
+
+
+/**
+ *  This function marks a tcp handle_info closing, no new call holds it and
+ *  the calls holding it keep it till they release it. Only one closer takes
+ *  an entry, the others get ENOKEY.
+ *
+ * @param[in] handle - socket handle
+ * @param[out] handle_info_st - the entry
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ * @return EPERM unsupported DB type
+ */
+int
+lib_commu_db_tcp_handle_info_closing_set(handle_t handle,
+                                         struct handle_info **handle_info_st);
+
+
+/**
+ *  This function waits for the calls holding a closing handle_info
+ *  to release it
+ *
+ * @param[in] handle_info_st - the entry
+ */
+void
+lib_commu_db_handle_info_users_wait(struct handle_info *handle_info_st);
+
+
+/**
+ *  This function deletes a closing handle_info once no call holds it,
+ *  its state is freed
+ *
+ * @param[in] handle_info_st - the entry
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if the table of the entry holds no handles
+ * @return EPERM unsupported DB type
+ */
+int
+lib_commu_db_handle_info_delete(struct handle_info *handle_info_st);
+
+
+/**
+ *  This function gets handle_info by key handle and holds it, it isn't
+ *  deleted before lib_commu_db_handle_info_release is called.
+ *
+ * @param[in] handle - socket handle
+ * @param[out] handle_info_st - the information on the handle
+ * @param[in,out] handle_db_type - if the handle_db_type is ANY then it will
+ *                                 return the type of the DB holding the handle
+ *                                 else - the handle must be in the specific DB
+ * @param[in,out] server_id - the server id filled if the  handle_db_type == TCP_SERVER_HANDLE_DB
+ *                            may be NULL
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+lib_commu_db_handle_info_hold(handle_t handle,
+                              struct handle_info **handle_info_st,
+                              enum db_type *handle_db_type,
+                              uint16_t *server_id);
+
+
+/**
+ *  This function releases a handle_info held by
+ *  lib_commu_db_handle_info_hold
+ *
+ * @param[in] handle_info_st - the entry, may be NULL
+ */
+void
+lib_commu_db_handle_info_release(struct handle_info *handle_info_st);
+
+
 
 /**
  *  This function gets handle_info by key handle
+ *  The handle is looked up in the fd indexed table without taking the DB lock.
+ *  A miss isn't logged, the entry isn't held - the internal probes use it.
  *
  * @param[in] handle - socket handle
  * @param[in] handle_info - the information on the handle
  * @param[in,out] handle_db_type - if the handle_db_type is ANY then it will
- *                                 search in all handle DB and will return the type
- *                                 else - the specific DB
+ *                                 return the type of the DB holding the handle
+ *                                 else - the handle must be in the specific DB
  * @param[in,out] server_id - the server id filled if the  handle_db_type == TCP_SERVER_HANDLE_DB
  *
  * @return 0 if operation completes successfully.
@@ -273,11 +489,13 @@ lib_commu_db_hanlde_info_get(handle_t handle,
 /**
  *  This function initialize the database
  *
+ * @param[in] limits - the tables limits
+ *
  * @return 0 if operation completes successfully.
- * @return EPERM if Handle type doesn't exist.
+ * @return ENOMEM if failed to allocate the tables.
  */
 int
-lib_commu_db_init(void);
+lib_commu_db_init(const struct lib_commu_db_limits *limits);
 
 /**
  *  This function deinitialize the database
@@ -327,4 +545,89 @@ int
 handle_total_tx_update(handle_t handle, enum db_type *handle_db_type,
                        unsigned long long tx_bytes);
 
+
+/**
+ *  This function adds to a traffic counter of the handle
+ *  The counter is updated atomically without taking the DB lock.
+ *
+ * @param[in] handle - socket handle
+ * @param[in] counter - the counter to update
+ * @param[in] value - the value to add
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+handle_stats_counter_add(handle_t handle, enum handle_stats_counter counter,
+                         unsigned long long value);
+
+
+/**
+ *  This function gets the traffic counters of the handle
+ *
+ * @param[in] handle - socket handle
+ * @param[out] stats - the handle counters
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if stats == NULL.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+lib_commu_db_handle_stats_get(handle_t handle, struct handle_stats *stats);
+
+
+/**
+ *  This function adds the values of one send/recv call
+ *  to the histograms of the handle
+ *  The histograms are updated atomically without taking the DB lock.
+ *
+ * @param[in] handle - socket handle
+ * @param[in] is_rx - update the receive histograms, else the send ones
+ * @param[in] time_ns - nsec spent in the call
+ * @param[in] bytes - bytes transferred by the call
+ * @param[in] retries - repeated send/recv of the call
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+handle_io_hists_update(handle_t handle, int is_rx, unsigned long long time_ns,
+                       unsigned long long bytes, unsigned long long retries);
+
+
+/**
+ *  This function adds a received traced message to the latency histogram
+ *  and the gaps/reorders counters of the handle
+ *  The state is updated atomically without taking the DB lock.
+ *
+ * @param[in] handle - socket handle
+ * @param[in] peer_magic - magic of the sender, a new sender restarts the sequence
+ * @param[in] peer_ipv4_addr - address of the sender (network order)
+ * @param[in] seq - sequence number of the message
+ * @param[in] latency_ns - nsec from the send of the message, meaningful
+ *                         only if the sender is on the same host
+ *
+ * @return 0 if operation completes successfully.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+handle_trace_rx_update(handle_t handle, uint32_t peer_magic,
+                       uint32_t peer_ipv4_addr, uint32_t seq,
+                       long long latency_ns);
+
+
+/**
+ *  This function gets the histograms of the handle
+ *
+ * @param[in] handle - socket handle
+ * @param[out] hists - the handle histograms
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if hists == NULL.
+ * @return ENOKEY if didn't found handle in DB.
+ */
+int
+lib_commu_db_handle_histograms_get(handle_t handle,
+                                   struct handle_histograms *hists);
+
 #endif /* LIB_COMMU_DB_H_ */
@@ -0,0 +1,251 @@
+/* Copyright (c) 2014  Mellanox Technologies, Ltd. All rights reserved.
+ *
+ * This software is available to you under BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define LIB_COMMU_POOL_C_
+
+#include "lib_commu_pool.h"
+#include "lib_commu_bail.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#undef  __MODULE__
+#define __MODULE__ LIB_COMMU_POOL
+
+/************************************************
+ *  Local variables
+ ***********************************************/
+
+static struct pool_class pool_classes[POOL_CLASSES_NUM];
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
+    LCOMMU_VERBOSITY_LEVEL_NOTICE;
+
+/************************************************
+ *  Local function declarations
+ ***********************************************/
+
+static void pool_classes_init(void);
+
+static uint32_t pool_class_idx_get(uint32_t size);
+
+/************************************************
+ *  Local function implementations
+ ***********************************************/
+
+static void
+pool_classes_init(void)
+{
+    uint32_t i = 0;
+    uint32_t class_size = 0;
+
+    memset(pool_classes, 0, sizeof(pool_classes));
+    for (i = 0; i < POOL_CLASSES_NUM; i++) {
+        class_size = 1U << (POOL_MIN_CLASS_SHIFT + i);
+        pthread_mutex_init(&pool_classes[i].lock, NULL);
+        pool_classes[i].free_max = POOL_CLASS_CACHE_BYTES / class_size;
+        if (pool_classes[i].free_max < POOL_CLASS_CACHE_MIN) {
+            pool_classes[i].free_max = POOL_CLASS_CACHE_MIN;
+        }
+    }
+}
+
+static uint32_t
+pool_class_idx_get(uint32_t size)
+{
+    uint32_t idx = 0;
+
+    while ((idx < POOL_CLASSES_NUM) &&
+           ((1U << (POOL_MIN_CLASS_SHIFT + idx)) < size)) {
+        idx++;
+    }
+
+    return idx;
+}
+
+/************************************************
+ *  Function implementations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library pool module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_pool_verbosity_level_set(enum lib_commu_verbosity_level verbosity)
+{
+    int err = 0;
+
+    if ((verbosity > LCOMMU_VERBOSITY_LEVEL_MIN) &&
+        (verbosity <= LCOMMU_VERBOSITY_LEVEL_MAX)) {
+        LOG_VAR_NAME(__MODULE__) = verbosity;
+    }
+    else {
+        LCM_LOG(LCOMMU_LOG_ERROR, "verbosity[%d] is out of range <%d-%d>\n",
+                verbosity, LCOMMU_VERBOSITY_LEVEL_MIN,
+                LCOMMU_VERBOSITY_LEVEL_MAX);
+        lib_commu_bail_force(EINVAL);
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function gets a buffer of at least size bytes from the pool.
+ *  The buffer is taken from the smallest size class fitting size.
+ *
+ * @param[in] size - #bytes needed
+ * @param[out] buffer - the buffer
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if buffer is NULL
+ * @return EOVERFLOW if size is above the largest class
+ * @return ENOMEM if failed to allocate the buffer
+ */
+int
+lib_commu_pool_buffer_get(uint32_t size, uint8_t **buffer)
+{
+    int err = 0;
+    uint32_t idx = 0;
+    struct pool_class *pool_class = NULL;
+    struct pool_buffer_hdr *hdr = NULL;
+
+    lib_commu_bail_null(buffer);
+
+    pthread_once(&pool_once, pool_classes_init);
+
+    idx = pool_class_idx_get(size);
+    if (idx == POOL_CLASSES_NUM) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid buffer size [%u]\n", size);
+        lib_commu_bail_force(EOVERFLOW);
+    }
+    pool_class = &pool_classes[idx];
+
+    pthread_mutex_lock(&pool_class->lock);
+    hdr = pool_class->free_list;
+    if (hdr != NULL) {
+        pool_class->free_list = hdr->next;
+        pool_class->free_num--;
+    }
+    pthread_mutex_unlock(&pool_class->lock);
+
+    if (hdr == NULL) {
+        hdr = (struct pool_buffer_hdr *)malloc(sizeof(*hdr) +
+                                               (1U << (POOL_MIN_CLASS_SHIFT + idx)));
+        if (hdr == NULL) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "Failed to allocate buffer of [%u] bytes\n",
+                    size);
+            lib_commu_bail_force(ENOMEM);
+        }
+        hdr->class_idx = idx;
+    }
+
+    hdr->magic = POOL_BUFFER_MAGIC;
+    hdr->next = NULL;
+    *buffer = (uint8_t*)(hdr + 1);
+
+bail:
+    return err;
+}
+
+/**
+ *  This function returns a buffer to the pool
+ *
+ * @param[in] buffer - a buffer got by lib_commu_pool_buffer_get
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if buffer is NULL or wasn't got from the pool
+ */
+int
+lib_commu_pool_buffer_put(uint8_t *buffer)
+{
+    int err = 0;
+    struct pool_buffer_hdr *hdr = NULL;
+    struct pool_class *pool_class = NULL;
+
+    lib_commu_bail_null(buffer);
+
+    hdr = (struct pool_buffer_hdr *)buffer - 1;
+    if ((hdr->magic != POOL_BUFFER_MAGIC) ||
+        (hdr->class_idx >= POOL_CLASSES_NUM)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "buffer[%p] isn't a pool buffer or was already released\n",
+                buffer);
+        lib_commu_bail_force(EINVAL);
+    }
+    hdr->magic = 0;
+
+    pool_class = &pool_classes[hdr->class_idx];
+
+    pthread_mutex_lock(&pool_class->lock);
+    if (pool_class->free_num < pool_class->free_max) {
+        hdr->next = pool_class->free_list;
+        pool_class->free_list = hdr;
+        pool_class->free_num++;
+        hdr = NULL;
+    }
+    pthread_mutex_unlock(&pool_class->lock);
+
+    free(hdr);
+
+bail:
+    return err;
+}
+
+/**
+ *  This function frees the buffers cached by the pool.
+ *  Buffers still handed out can be returned later.
+ */
+void
+lib_commu_pool_flush(void)
+{
+    uint32_t i = 0;
+    struct pool_buffer_hdr *hdr = NULL;
+    struct pool_buffer_hdr *next = NULL;
+
+    pthread_once(&pool_once, pool_classes_init);
+
+    for (i = 0; i < POOL_CLASSES_NUM; i++) {
+        pthread_mutex_lock(&pool_classes[i].lock);
+        hdr = pool_classes[i].free_list;
+        pool_classes[i].free_list = NULL;
+        pool_classes[i].free_num = 0;
+        pthread_mutex_unlock(&pool_classes[i].lock);
+
+        while (hdr != NULL) {
+            next = hdr->next;
+            free(hdr);
+            hdr = next;
+        }
+    }
+}
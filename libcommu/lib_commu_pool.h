@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) Mellanox Technologies, Ltd. 2001-2014. ALL RIGHTS RESERVED.
+ *
+ * This software product is a proprietary product of Mellanox Technologies, Ltd.
+ * (the "Company") and all right, title, and interest in and to the software product,
+ * including all associated intellectual property rights, are and shall
+ * remain exclusively with the Company.
+ *
+ * This software product is governed by the End User License Agreement
+ * provided with the software product.
+ *
+ */
+
+
+#ifndef LIB_COMMU_POOL_H_
+#define LIB_COMMU_POOL_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "lib_commu_log.h"
+
+#ifdef LIB_COMMU_POOL_C_
+
+/************************************************
+ *  Local Defines
+ ***********************************************/
+
+#define POOL_MIN_CLASS_SHIFT        (7)  /* smallest buffer - 128 bytes */
+#define POOL_MAX_CLASS_SHIFT        (21) /* largest buffer - 2 MB, above MAX_JUMBO_TCP_PAYLOAD */
+#define POOL_CLASSES_NUM            (POOL_MAX_CLASS_SHIFT - POOL_MIN_CLASS_SHIFT + 1)
+#define POOL_CLASS_CACHE_BYTES      (4 * 1024 * 1024) /* released bytes kept per class */
+#define POOL_CLASS_CACHE_MIN        (4) /* released buffers kept per class at least */
+#define POOL_BUFFER_MAGIC           (0x6c63706fU)
+
+/************************************************
+ *  Local Macros
+ ***********************************************/
+
+/************************************************
+ *  Local Type definitions
+ ***********************************************/
+
+/**
+ * pool_buffer_hdr structure is placed before
+ * each buffer handed out by the pool
+ */
+struct pool_buffer_hdr {
+    uint32_t magic;                 /**< POOL_BUFFER_MAGIC while handed out */
+    uint32_t class_idx;             /**< the size class of the buffer */
+    struct pool_buffer_hdr *next;   /**< next free buffer of the class */
+} __attribute__((aligned(16)));
+
+/**
+ * pool_class structure is used to cache
+ * the released buffers of one size
+ */
+struct pool_class {
+    pthread_mutex_t lock;           /**< protects the free list */
+    struct pool_buffer_hdr *free_list; /**< released buffers */
+    uint32_t free_num;              /**< #buffers on free_list */
+    uint32_t free_max;              /**< #buffers kept on free_list at most */
+};
+
+#endif
+
+/************************************************
+ *  Defines
+ ***********************************************/
+
+/************************************************
+ *  Macros
+ ***********************************************/
+
+/************************************************
+ *  Type definitions
+ ***********************************************/
+
+/************************************************
+ *  Global variables
+ ***********************************************/
+
+/************************************************
+ *  Function declarations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library pool module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_pool_verbosity_level_set(enum lib_commu_verbosity_level verbosity);
+
+/**
+ *  This function gets a buffer of at least size bytes from the pool.
+ *  The buffer is taken from the smallest size class fitting size.
+ *
+ * @param[in] size - #bytes needed
+ * @param[out] buffer - the buffer
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if buffer is NULL
+ * @return EOVERFLOW if size is above the largest class
+ * @return ENOMEM if failed to allocate the buffer
+ */
+int
+lib_commu_pool_buffer_get(uint32_t size, uint8_t **buffer);
+
+/**
+ *  This function returns a buffer to the pool
+ *
+ * @param[in] buffer - a buffer got by lib_commu_pool_buffer_get
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if buffer is NULL or wasn't got from the pool
+ */
+int
+lib_commu_pool_buffer_put(uint8_t *buffer);
+
+/**
+ *  This function frees the buffers cached by the pool.
+ *  Buffers still handed out can be returned later.
+ */
+void
+lib_commu_pool_flush(void);
+
+#endif /* LIB_COMMU_POOL_H_ */
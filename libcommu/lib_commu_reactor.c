@@ -0,0 +1,592 @@
+/* Copyright (c) 2014  Mellanox Technologies, Ltd. All rights reserved.
+ *
+ * This software is available to you under BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define LIB_COMMU_REACTOR_C_
+
+#include "lib_commu_reactor.h"
+#include "lib_commu.h"
+#include "lib_commu_bail.h"
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#undef  __MODULE__
+#define __MODULE__ LIB_COMMU_REACTOR
+
+/************************************************
+ *  Local Type definitions
+ ***********************************************/
+
+/**
+ * lib_commu_reactor structure is used to store
+ * the state of one epoll thread
+ */
+struct lib_commu_reactor {
+    pthread_t thread;                           /**< the epoll thread */
+    int epoll_fd;                               /**< the epoll instance */
+    int exit_fd;                                /**< eventfd signaled on deinit */
+    struct lib_commu_reactor_item exit_item;    /**< exit_fd registration */
+    int wake_fd;                                /**< eventfd signaled on remove requests */
+    struct lib_commu_reactor_item wake_item;    /**< wake_fd registration */
+    pthread_mutex_t requests_lock;              /**< protects remove_requests */
+    struct lib_commu_reactor_item *remove_requests; /**< items to remove, posted by other threads */
+    struct lib_commu_reactor_item *removed_list; /**< items to release after the batch */
+};
+
+/************************************************
+ *  Local variables
+ ***********************************************/
+
+static struct lib_commu_reactor reactors[MAX_REACTOR_THREADS_NUM];
+static uint32_t reactors_num = 0;
+static uint32_t next_reactor_id = 0;
+static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
+    LCOMMU_VERBOSITY_LEVEL_NOTICE;
+
+/************************************************
+ *  Local function declarations
+ ***********************************************/
+
+static void * reactor_main_thread(void *args);
+
+static void reactor_removed_items_release(struct lib_commu_reactor *reactor);
+
+static void reactor_remove_requests_handle(struct lib_commu_reactor *reactor);
+
+static void reactor_item_removed_add(struct lib_commu_reactor *reactor,
+                                     struct lib_commu_reactor_item *item);
+
+static int reactor_resources_init(struct lib_commu_reactor *reactor);
+
+static void reactor_resources_deinit(struct lib_commu_reactor *reactor);
+
+/************************************************
+ *  Local function implementations
+ ***********************************************/
+
+static void
+reactor_removed_items_release(struct lib_commu_reactor *reactor)
+{
+    struct lib_commu_reactor_item *item = NULL;
+
+    while (reactor->removed_list != NULL) {
+        item = reactor->removed_list;
+        reactor->removed_list = item->next_removed;
+        item->next_removed = NULL;
+        if (item->release != NULL) {
+            item->release(item);
+        }
+    }
+}
+
+/* the item was deleted from the epoll set, it's released after the batch */
+static void
+reactor_item_removed_add(struct lib_commu_reactor *reactor,
+                         struct lib_commu_reactor_item *item)
+{
+    item->is_removed = 1;
+    item->next_removed = reactor->removed_list;
+    reactor->removed_list = item;
+}
+
+static void
+reactor_remove_requests_handle(struct lib_commu_reactor *reactor)
+{
+    struct lib_commu_reactor_item *item = NULL;
+    uint64_t wake_cnt = 0;
+
+    if (read(reactor->wake_fd, &wake_cnt, sizeof(wake_cnt)) < 0) {
+        /* nothing to read - the requests are taken below anyway */
+    }
+
+    pthread_mutex_lock(&reactor->requests_lock);
+    item = reactor->remove_requests;
+    reactor->remove_requests = NULL;
+    pthread_mutex_unlock(&reactor->requests_lock);
+
+    while (item != NULL) {
+        struct lib_commu_reactor_item *next = item->next_request;
+
+        item->next_request = NULL;
+        reactor_item_removed_add(reactor, item);
+        item = next;
+    }
+}
+
+static void*
+reactor_main_thread(void *args)
+{
+    struct lib_commu_reactor *reactor = (struct lib_commu_reactor*)args;
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    struct lib_commu_reactor_item *item = NULL;
+    int is_exit = 0;
+    int n_events = 0;
+    int i = 0;
+
+    while (!is_exit) {
+        n_events = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS,
+                              -1);
+        if (n_events < 0) {
+            if (errno == EINTR) { /* if epoll_wait caught signal --> don't exit with error */
+                continue;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR, "epoll_wait() failed with err(%d): %s\n",
+                    errno, strerror(errno));
+            break;
+        }
+
+        for (i = 0; i < n_events; i++) {
+            item = (struct lib_commu_reactor_item*)events[i].data.ptr;
+            if (item == &reactor->exit_item) {
+                is_exit = 1;
+                continue;
+            }
+            if (item == &reactor->wake_item) {
+                reactor_remove_requests_handle(reactor);
+                continue;
+            }
+            /* removed earlier in this batch */
+            if (item->is_removed) {
+                continue;
+            }
+            item->handler(item, events[i].events);
+        }
+
+        reactor_removed_items_release(reactor);
+    }
+
+    /* the items removed meanwhile may own resources freed on release */
+    reactor_remove_requests_handle(reactor);
+    reactor_removed_items_release(reactor);
+
+    LCM_LOG(LCOMMU_LOG_NOTICE, "Exit from reactor thread[%lu]\n",
+            pthread_self());
+    return NULL;
+}
+
+static int
+reactor_resources_init(struct lib_commu_reactor *reactor)
+{
+    int err = 0;
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+
+    pthread_mutex_init(&reactor->requests_lock, NULL);
+    reactor->remove_requests = NULL;
+
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (reactor->epoll_fd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "epoll_create1() failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    reactor->exit_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reactor->exit_fd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "eventfd() failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    reactor->exit_item.fd = reactor->exit_fd;
+    event.events = EPOLLIN;
+    event.data.ptr = &reactor->exit_item;
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->exit_fd,
+                  &event) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "epoll_ctl() failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    reactor->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (reactor->wake_fd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "eventfd() failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    reactor->wake_item.fd = reactor->wake_fd;
+    event.events = EPOLLIN;
+    event.data.ptr = &reactor->wake_item;
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->wake_fd,
+                  &event) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "epoll_ctl() failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+bail:
+    return err;
+}
+
+static void
+reactor_resources_deinit(struct lib_commu_reactor *reactor)
+{
+    if (reactor->wake_fd != INVALID_HANDLE_ID) {
+        close(reactor->wake_fd);
+        reactor->wake_fd = INVALID_HANDLE_ID;
+    }
+    if (reactor->exit_fd != INVALID_HANDLE_ID) {
+        close(reactor->exit_fd);
+        reactor->exit_fd = INVALID_HANDLE_ID;
+    }
+    if (reactor->epoll_fd != INVALID_HANDLE_ID) {
+        close(reactor->epoll_fd);
+        reactor->epoll_fd = INVALID_HANDLE_ID;
+    }
+    pthread_mutex_destroy(&reactor->requests_lock);
+}
+
+/************************************************
+ *  Function implementations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library reactor module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_reactor_verbosity_level_set(enum lib_commu_verbosity_level verbosity)
+{
+    int err = 0;
+
+    if ((verbosity > LCOMMU_VERBOSITY_LEVEL_MIN) &&
+        (verbosity <= LCOMMU_VERBOSITY_LEVEL_MAX)) {
+        LOG_VAR_NAME(__MODULE__) = verbosity;
+    }
+    else {
+        LCM_LOG(LCOMMU_LOG_ERROR, "verbosity[%d] is out of range <%d-%d>\n",
+                verbosity, LCOMMU_VERBOSITY_LEVEL_MIN,
+                LCOMMU_VERBOSITY_LEVEL_MAX);
+        lib_commu_bail_force(EINVAL);
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function starts the reactor threads
+ *
+ * @param[in] threads_num - number of epoll threads to start
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if threads_num is out of range.
+ * @return errno codes of native epoll_create/eventfd/pthread_create functions
+ */
+int
+lib_commu_reactor_init(uint32_t threads_num)
+{
+    int err = 0;
+    uint32_t i = 0;
+
+    if ((threads_num == 0) || (threads_num > MAX_REACTOR_THREADS_NUM)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "reactor threads num[%u] is out of range <1-%u>\n",
+                threads_num, MAX_REACTOR_THREADS_NUM);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    memset(reactors, 0, sizeof(reactors));
+    for (i = 0; i < MAX_REACTOR_THREADS_NUM; i++) {
+        reactors[i].epoll_fd = INVALID_HANDLE_ID;
+        reactors[i].exit_fd = INVALID_HANDLE_ID;
+        reactors[i].wake_fd = INVALID_HANDLE_ID;
+    }
+    next_reactor_id = 0;
+
+    for (i = 0; i < threads_num; i++) {
+        err = reactor_resources_init(&reactors[i]);
+        if (err) {
+            reactor_resources_deinit(&reactors[i]);
+            lib_commu_bail_force(err);
+        }
+
+        err = pthread_create(&reactors[i].thread, NULL, reactor_main_thread,
+                             &reactors[i]);
+        if (err != 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed to create reactor thread err(%u):\n", err);
+            reactor_resources_deinit(&reactors[i]);
+            lib_commu_bail_force(err);
+        }
+        reactors_num++;
+    }
+
+bail:
+    if (err) {
+        lib_commu_reactor_deinit();
+    }
+    return err;
+}
+
+/**
+ *  This function stops and joins the reactor threads.
+ *  Items which are still registered are not released, the removed ones are.
+ *
+ * @return 0 if operation completes successfully.
+ */
+int
+lib_commu_reactor_deinit(void)
+{
+    int err = 0;
+    uint32_t i = 0;
+    uint64_t exit_code = 1;
+
+    for (i = 0; i < reactors_num; i++) {
+        if (write(reactors[i].exit_fd, &exit_code, sizeof(exit_code)) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "Failed to signal reactor thread err(%d): %s\n", errno,
+                    strerror(errno));
+            err = errno;
+            continue;
+        }
+        pthread_join(reactors[i].thread, NULL);
+        reactor_resources_deinit(&reactors[i]);
+    }
+
+    reactors_num = 0;
+
+    return err;
+}
+
+/**
+ *  This function registers an item in the reactor
+ *
+ * @param[in,out] item - the item to register, item->reactor_id is updated
+ * @param[in] events - EPOLL* events to wait for
+ * @param[in] reactor_id - the reactor thread to use, or REACTOR_ANY_THREAD
+ *                         to pick one round robin
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if item is NULL or reactor_id is out of range
+ * @return EPERM if the reactor isn't running
+ * @return errno codes of native epoll_ctl function
+ */
+int
+lib_commu_reactor_item_add(struct lib_commu_reactor_item *item,
+                           uint32_t events, uint32_t reactor_id)
+{
+    int err = 0;
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+
+    lib_commu_bail_null(item);
+    lib_commu_bail_null(item->handler);
+
+    if (reactors_num == 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Reactor isn't running\n");
+        lib_commu_bail_force(EPERM);
+    }
+
+    if (reactor_id == REACTOR_ANY_THREAD) {
+        reactor_id = __sync_fetch_and_add(&next_reactor_id, 1) % reactors_num;
+    }
+    else if (reactor_id >= reactors_num) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid reactor id[%u]\n", reactor_id);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    item->reactor_id = reactor_id;
+    item->is_removed = 0;
+    item->next_removed = NULL;
+    item->next_request = NULL;
+
+    event.events = events;
+    event.data.ptr = item;
+    if (epoll_ctl(reactors[reactor_id].epoll_fd, EPOLL_CTL_ADD, item->fd,
+                  &event) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "epoll_ctl(ADD) fd[%d] failed with err(%d): %s\n", item->fd,
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function removes an item from the reactor.
+ *  Must be called from the reactor thread serving the item (i.e. from a
+ *  handler). item->release is called once the current batch is done.
+ *
+ * @param[in] item - the item to remove
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native epoll_ctl function
+ */
+int
+lib_commu_reactor_item_remove(struct lib_commu_reactor_item *item)
+{
+    int err = 0;
+    struct lib_commu_reactor *reactor = NULL;
+
+    lib_commu_bail_null(item);
+
+    if (item->is_removed) {
+        goto bail;
+    }
+
+    reactor = &reactors[item->reactor_id];
+
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, item->fd, NULL) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "epoll_ctl(DEL) fd[%d] failed with err(%d): %s\n", item->fd,
+                errno, strerror(errno));
+        err = errno;
+        /* release the item anyway, it will not be referenced again */
+    }
+
+    reactor_item_removed_add(reactor, item);
+
+bail:
+    return err;
+}
+
+/**
+ *  This function changes the events an item waits for.
+ *  Can be called from any thread.
+ *
+ * @param[in] item - a registered item
+ * @param[in] events - EPOLL* events to wait for
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if item is NULL
+ * @return errno codes of native epoll_ctl function
+ */
+int
+lib_commu_reactor_item_modify(struct lib_commu_reactor_item *item,
+                              uint32_t events)
+{
+    int err = 0;
+    struct epoll_event event;
+
+    memset(&event, 0, sizeof(event));
+
+    lib_commu_bail_null(item);
+
+    event.events = events;
+    event.data.ptr = item;
+    if (epoll_ctl(reactors[item->reactor_id].epoll_fd, EPOLL_CTL_MOD,
+                  item->fd, &event) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "epoll_ctl(MOD) fd[%d] failed with err(%d): %s\n", item->fd,
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function asks the reactor thread serving the item to remove it.
+ *  Can be called from any thread. The fd is deleted from the epoll set before
+ *  it returns, a handler call already in progress or due in the current batch
+ *  of events may still follow. item->release is called from the reactor
+ *  thread after them.
+ *
+ * @param[in] item - a registered item
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if item is NULL
+ * @return errno codes of native write function
+ */
+int
+lib_commu_reactor_item_remove_async(struct lib_commu_reactor_item *item)
+{
+    int err = 0;
+    struct lib_commu_reactor *reactor = NULL;
+    uint64_t wake_cnt = 1;
+
+    lib_commu_bail_null(item);
+
+    reactor = &reactors[item->reactor_id];
+
+    /* the caller may close the fd once it returns */
+    if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, item->fd, NULL) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "epoll_ctl(DEL) fd[%d] failed with err(%d): %s\n", item->fd,
+                errno, strerror(errno));
+        /* release the item anyway, it will not be referenced again */
+    }
+
+    pthread_mutex_lock(&reactor->requests_lock);
+    item->next_request = reactor->remove_requests;
+    reactor->remove_requests = item;
+    pthread_mutex_unlock(&reactor->requests_lock);
+
+    if (write(reactor->wake_fd, &wake_cnt, sizeof(wake_cnt)) < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "Failed to signal reactor thread err(%d): %s\n", errno,
+                strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function tells whether the caller is a reactor thread, which must not
+ *  wait for an item to be released as it may be the one to release it
+ *
+ * @return 1 if called from a reactor thread, 0 otherwise
+ */
+int
+lib_commu_reactor_thread_is_current(void)
+{
+    pthread_t self = pthread_self();
+    uint32_t i = 0;
+
+    for (i = 0; i < reactors_num; i++) {
+        if (pthread_equal(reactors[i].thread, self)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ *  This function returns the number of running reactor threads
+ *
+ * @return #reactor threads, 0 if the reactor isn't running
+ */
+uint32_t
+lib_commu_reactor_threads_num_get(void)
+{
+    return reactors_num;
+}
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) Mellanox Technologies, Ltd. 2001-2014. ALL RIGHTS RESERVED.
+ *
+ * This software product is a proprietary product of Mellanox Technologies, Ltd.
+ * (the "Company") and all right, title, and interest in and to the software product,
+ * including all associated intellectual property rights, are and shall
+ * remain exclusively with the Company.
+ *
+ * This software product is governed by the End User License Agreement
+ * provided with the software product.
+ *
+ */
+
+#ifndef LIB_COMMU_REACTOR_H_
+#define LIB_COMMU_REACTOR_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "lib_commu_log.h"
+
+#ifdef LIB_COMMU_REACTOR_C_
+
+/************************************************
+ *  Local Defines
+ ***********************************************/
+
+#define REACTOR_MAX_EVENTS          (64)
+
+/************************************************
+ *  Local Macros
+ ***********************************************/
+
+/************************************************
+ *  Local Type definitions
+ ***********************************************/
+
+#endif
+
+/************************************************
+ *  Defines
+ ***********************************************/
+
+#define REACTOR_ANY_THREAD          UINT32_MAX
+
+/************************************************
+ *  Macros
+ ***********************************************/
+
+/************************************************
+ *  Type definitions
+ ***********************************************/
+
+struct lib_commu_reactor_item;
+
+/**
+ * Called from the reactor thread when the item's fd is ready.
+ * events holds the ready EPOLL* events.
+ */
+typedef void (*lib_commu_reactor_handler_t)(struct lib_commu_reactor_item *item,
+                                            uint32_t events);
+
+/**
+ * Called from the reactor thread once an item removed by
+ * lib_commu_reactor_item_remove can't be referenced by the reactor anymore,
+ * i.e. after the batch of events in which it was removed.
+ */
+typedef void (*lib_commu_reactor_release_t)(struct lib_commu_reactor_item *item);
+
+/**
+ * lib_commu_reactor_item structure is used to register
+ * a file descriptor in the reactor. The item is owned by the caller and
+ * must stay valid until it is released.
+ */
+struct lib_commu_reactor_item {
+    int fd;                                 /**< the file descriptor to wait on */
+    lib_commu_reactor_handler_t handler;    /**< called on ready events */
+    lib_commu_reactor_release_t release;    /**< called after removal, may be NULL */
+    void *ctx;                              /**< user context */
+    uint32_t reactor_id;                    /**< the reactor thread serving the item */
+    uint8_t is_removed;                     /**< set once the item was removed */
+    struct lib_commu_reactor_item *next_removed; /**< internal - release list */
+    struct lib_commu_reactor_item *next_request; /**< internal - remove requests list */
+};
+
+/************************************************
+ *  Global variables
+ ***********************************************/
+
+/************************************************
+ *  Function declarations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library reactor module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_reactor_verbosity_level_set(enum lib_commu_verbosity_level verbosity);
+
+/**
+ *  This function starts the reactor threads
+ *
+ * @param[in] threads_num - number of epoll threads to start
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if threads_num is out of range.
+ * @return errno codes of native epoll_create/eventfd/pthread_create functions
+ */
+int
+lib_commu_reactor_init(uint32_t threads_num);
+
+/**
+ *  This function stops and joins the reactor threads.
+ *  Items which are still registered are not released, the removed ones are.
+ *
+ * @return 0 if operation completes successfully.
+ */
+int
+lib_commu_reactor_deinit(void);
+
+/**
+ *  This function registers an item in the reactor
+ *
+ * @param[in,out] item - the item to register, item->reactor_id is updated
+ * @param[in] events - EPOLL* events to wait for
+ * @param[in] reactor_id - the reactor thread to use, or REACTOR_ANY_THREAD
+ *                         to pick one round robin
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if item is NULL or reactor_id is out of range
+ * @return EPERM if the reactor isn't running
+ * @return errno codes of native epoll_ctl function
+ */
+int
+lib_commu_reactor_item_add(struct lib_commu_reactor_item *item,
+                           uint32_t events, uint32_t reactor_id);
+
+/**
+ *  This function removes an item from the reactor.
+ *  Must be called from the reactor thread serving the item (i.e. from a
+ *  handler). item->release is called once the current batch is done.
+ *
+ * @param[in] item - the item to remove
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native epoll_ctl function
+ */
+int
+lib_commu_reactor_item_remove(struct lib_commu_reactor_item *item);
+
+/**
+ *  This function changes the events an item waits for.
+ *  Can be called from any thread.
+ *
+ * @param[in] item - a registered item
+ * @param[in] events - EPOLL* events to wait for
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if item is NULL
+ * @return errno codes of native epoll_ctl function
+ */
+int
+lib_commu_reactor_item_modify(struct lib_commu_reactor_item *item,
+                              uint32_t events);
+
+/**
+ *  This function asks the reactor thread serving the item to remove it.
+ *  Can be called from any thread. The fd is deleted from the epoll set before
+ *  it returns, a handler call already in progress or due in the current batch
+ *  of events may still follow. item->release is called from the reactor
+ *  thread after them.
+ *
+ * @param[in] item - a registered item
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if item is NULL
+ * @return errno codes of native write function
+ */
+int
+lib_commu_reactor_item_remove_async(struct lib_commu_reactor_item *item);
+
+/**
+ *  This function tells whether the caller is a reactor thread, which must not
+ *  wait for an item to be released as it may be the one to release it
+ *
+ * @return 1 if called from a reactor thread, 0 otherwise
+ */
+int
+lib_commu_reactor_thread_is_current(void);
+
+/**
+ *  This function returns the number of running reactor threads
+ *
+ * @return #reactor threads, 0 if the reactor isn't running
+ */
+uint32_t
+lib_commu_reactor_threads_num_get(void);
+
+#endif /* LIB_COMMU_REACTOR_H_ */
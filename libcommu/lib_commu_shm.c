@@ -0,0 +1,810 @@
+/* Copyright (c) 2014  Mellanox Technologies, Ltd. All rights reserved.
+ *
+ * This software is available to you under BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define LIB_COMMU_SHM_C_
+
+#include "lib_commu_shm.h"
+#include "lib_commu_bail.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <complib/cl_shared_memory.h>
+
+#undef  __MODULE__
+#define __MODULE__ LIB_COMMU_SHM
+
+/************************************************
+ *  Local variables
+ ***********************************************/
+
+static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
+    LCOMMU_VERBOSITY_LEVEL_NOTICE;
+
+/************************************************
+ *  Local function declarations
+ ***********************************************/
+
+static void shm_futex_wait(uint32_t *addr, uint32_t value);
+
+static void shm_futex_wake(uint32_t *addr);
+
+static int shm_is_peer_closed(const struct lib_commu_shm_link *link);
+
+static int shm_is_closed(const struct lib_commu_shm_link *link);
+
+static int shm_pid_is_gone(pid_t pid);
+
+static void shm_peer_check(const struct lib_commu_shm_link *link);
+
+static void shm_ring_pos_publish(uint32_t *pos, uint32_t value,
+                                 uint32_t *waiting);
+
+static int shm_ring_space_wait(struct lib_commu_shm_link *link, uint32_t tail,
+                               uint32_t *head);
+
+static int shm_ring_data_wait(struct lib_commu_shm_link *link, uint32_t head,
+                              uint32_t *tail);
+
+static void shm_ring_copy_in(struct lib_commu_shm_link *link, uint32_t pos,
+                             const uint8_t *src, uint32_t len);
+
+static void shm_ring_copy_out(struct lib_commu_shm_link *link, uint32_t pos,
+                              uint8_t *dst, uint32_t len);
+
+static int shm_segment_size_wait(struct lib_commu_shm_link *link);
+
+static int shm_segment_reclaim(struct lib_commu_shm_link *link,
+                               uint32_t attached);
+
+static int shm_segment_attach(struct lib_commu_shm_link *link,
+                              uint32_t ring_size, int is_stale);
+
+static int shm_segment_open(struct lib_commu_shm_link *link,
+                            uint32_t ring_size, int is_stale,
+                            int *is_created);
+
+static void shm_segment_unmap(struct lib_commu_shm_link *link);
+
+/************************************************
+ *  Local function implementations
+ ***********************************************/
+
+/* the words are in memory shared between processes - no FUTEX_PRIVATE_FLAG */
+static void
+shm_futex_wait(uint32_t *addr, uint32_t value)
+{
+    struct timespec timeout;
+
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = SHM_FUTEX_WAIT_MSEC * 1000000L;
+    (void)syscall(SYS_futex, addr, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+static void
+shm_futex_wake(uint32_t *addr)
+{
+    (void)syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static int
+shm_is_peer_closed(const struct lib_commu_shm_link *link)
+{
+    return (__atomic_load_n(&link->segment->closed, __ATOMIC_SEQ_CST) &
+            (1U << (link->side ^ 1))) != 0;
+}
+
+/* either side closed the link, the waiters of both sides give up */
+static int
+shm_is_closed(const struct lib_commu_shm_link *link)
+{
+    return __atomic_load_n(&link->is_shutdown, __ATOMIC_SEQ_CST) ||
+           shm_is_peer_closed(link);
+}
+
+/* the pid of a process in another pid namespace is taken as gone */
+static int
+shm_pid_is_gone(pid_t pid)
+{
+    return (pid != 0) && (kill(pid, 0) < 0) && (errno == ESRCH);
+}
+
+/* a peer whose process died without closing the link is closed for it,
+ * the waiters of both sides give up */
+static void
+shm_peer_check(const struct lib_commu_shm_link *link)
+{
+    uint32_t peer_side = link->side ^ 1;
+    uint32_t closed = 0;
+
+    if (!shm_pid_is_gone(__atomic_load_n(&link->segment->pids[peer_side],
+                                         __ATOMIC_ACQUIRE))) {
+        return;
+    }
+
+    closed = __atomic_fetch_or(&link->segment->closed, 1U << peer_side,
+                               __ATOMIC_SEQ_CST);
+    if (!(closed & (1U << peer_side))) {
+        LCM_LOG(LCOMMU_LOG_NOTICE, "The peer process of %s is gone\n",
+                link->path);
+    }
+}
+
+static void
+shm_ring_pos_publish(uint32_t *pos, uint32_t value, uint32_t *waiting)
+{
+    __atomic_store_n(pos, value, __ATOMIC_RELEASE);
+    /* pairs with the sleeper, which sets waiting before it checks pos again */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+        shm_futex_wake(pos);
+    }
+}
+
+static int
+shm_ring_space_wait(struct lib_commu_shm_link *link, uint32_t tail,
+                    uint32_t *head)
+{
+    int err = 0;
+    uint32_t spins = 0;
+    struct shm_ring *ring = link->tx_ring;
+
+    while (1) {
+        *head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if ((tail - *head) <= link->ring_mask) {
+            break;
+        }
+        if (shm_is_closed(link)) {
+            lib_commu_bail_force(EPIPE);
+        }
+        if (spins < SHM_SPIN_NUM) {
+            spins++;
+            continue;
+        }
+        /* a crashed peer never frees the space */
+        shm_peer_check(link);
+        __atomic_store_n(&ring->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == *head) {
+            shm_futex_wait(&ring->head, *head);
+        }
+        __atomic_store_n(&ring->producer_waiting, 0, __ATOMIC_RELAXED);
+    }
+
+bail:
+    return err;
+}
+
+static int
+shm_ring_data_wait(struct lib_commu_shm_link *link, uint32_t head,
+                   uint32_t *tail)
+{
+    int err = 0;
+    uint32_t spins = 0;
+    struct shm_ring *ring = link->rx_ring;
+
+    while (1) {
+        *tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (*tail != head) {
+            break;
+        }
+        if (shm_is_closed(link)) {
+            /* the peer publishes its last bytes before it closes */
+            *tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+            if (*tail != head) {
+                break;
+            }
+            lib_commu_bail_force(ECONNRESET);
+        }
+        if (spins < SHM_SPIN_NUM) {
+            spins++;
+            continue;
+        }
+        /* a crashed peer never publishes data */
+        shm_peer_check(link);
+        __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == head) {
+            shm_futex_wait(&ring->tail, head);
+        }
+        __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+    }
+
+bail:
+    return err;
+}
+
+static void
+shm_ring_copy_in(struct lib_commu_shm_link *link, uint32_t pos,
+                 const uint8_t *src, uint32_t len)
+{
+    uint32_t offset = pos & link->ring_mask;
+    uint32_t first_len = link->ring_mask + 1 - offset;
+
+    if (first_len > len) {
+        first_len = len;
+    }
+    memcpy(link->tx_data + offset, src, first_len);
+    memcpy(link->tx_data, src + first_len, len - first_len);
+}
+
+static void
+shm_ring_copy_out(struct lib_commu_shm_link *link, uint32_t pos,
+                  uint8_t *dst, uint32_t len)
+{
+    uint32_t offset = pos & link->ring_mask;
+    uint32_t first_len = link->ring_mask + 1 - offset;
+
+    if (first_len > len) {
+        first_len = len;
+    }
+    memcpy(dst, link->rx_data + offset, first_len);
+    memcpy(dst + first_len, link->rx_data, len - first_len);
+}
+
+/* the creator sizes the segment right after creating it. Once it didn't
+ * in time it died, the segment is sized here so its state is seen */
+static int
+shm_segment_size_wait(struct lib_commu_shm_link *link)
+{
+    int err = 0;
+    uint32_t waited_msec = 0;
+    struct stat shm_stat;
+
+    memset(&shm_stat, 0, sizeof(shm_stat));
+
+    while (1) {
+        if (fstat(link->fd, &shm_stat) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "fstat() on %s failed with err(%d): %s\n",
+                    link->path, errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+        if ((size_t)shm_stat.st_size == link->map_len) {
+            break;
+        }
+        if (shm_stat.st_size != 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "%s size [%lld] isn't [%zu]\n",
+                    link->path, (long long)shm_stat.st_size, link->map_len);
+            lib_commu_bail_force(EPROTO);
+        }
+        if (waited_msec++ == SHM_ATTACH_WAIT_MSEC) {
+            if (ftruncate(link->fd, link->map_len) < 0) {
+                LCM_LOG(LCOMMU_LOG_ERROR,
+                        "ftruncate() on %s failed with err(%d): %s\n",
+                        link->path, errno, strerror(errno));
+                lib_commu_bail_force(errno);
+            }
+            break;
+        }
+        usleep(1000);
+    }
+
+bail:
+    return err;
+}
+
+/* removes the name of a stale segment once, the openers which find it
+ * meanwhile open the path again. Returns EAGAIN */
+static int
+shm_segment_reclaim(struct lib_commu_shm_link *link, uint32_t attached)
+{
+    if (__atomic_compare_exchange_n(&link->segment->attached, &attached,
+                                    SHM_ATTACHED_STALE, 0, __ATOMIC_SEQ_CST,
+                                    __ATOMIC_SEQ_CST)) {
+        LCM_LOG(LCOMMU_LOG_NOTICE, "Removing stale shared memory %s\n",
+                link->path);
+        (void)cl_shm_destroy(link->path);
+    }
+    return EAGAIN;
+}
+
+/* attaches as the second side. EAGAIN is returned to open the path again
+ * once the segment is removed: its creator died before a peer attached,
+ * or the sides didn't remove the name though is_stale */
+static int
+shm_segment_attach(struct lib_commu_shm_link *link, uint32_t ring_size,
+                   int is_stale)
+{
+    int err = 0;
+    uint32_t waited_msec = 0;
+    uint32_t attached = 1;
+    struct shm_segment *segment = link->segment;
+
+    while (__atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) !=
+           SHM_LINK_MAGIC) {
+        if (waited_msec++ == SHM_ATTACH_WAIT_MSEC) {
+            LCM_LOG(LCOMMU_LOG_NOTICE, "%s creator didn't init it\n",
+                    link->path);
+            err = shm_segment_reclaim(link, __atomic_load_n(&segment->attached,
+                                                            __ATOMIC_SEQ_CST));
+            goto bail;
+        }
+        usleep(1000);
+    }
+
+    if ((segment->version != SHM_LINK_VERSION) ||
+        (segment->ring_size != ring_size)) {
+        LCM_LOG(LCOMMU_LOG_ERROR,
+                "%s version [%u] ring size [%u] don't match [%u] [%u]\n",
+                link->path, segment->version, segment->ring_size,
+                SHM_LINK_VERSION, ring_size);
+        lib_commu_bail_force(EPROTO);
+    }
+
+    if (shm_pid_is_gone(__atomic_load_n(&segment->pids[0],
+                                        __ATOMIC_ACQUIRE))) {
+        LCM_LOG(LCOMMU_LOG_NOTICE, "%s creator is gone\n", link->path);
+        err = shm_segment_reclaim(link, attached);
+        goto bail;
+    }
+
+    /* the sides remove the name right after they attach or close */
+    if (!__atomic_compare_exchange_n(&segment->attached, &attached, 2, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        if (is_stale && (attached != SHM_ATTACHED_STALE)) {
+            LCM_LOG(LCOMMU_LOG_NOTICE, "%s wasn't removed, attached [%u]\n",
+                    link->path, attached);
+            err = shm_segment_reclaim(link, attached);
+            goto bail;
+        }
+        lib_commu_bail_force(EAGAIN);
+    }
+
+    __atomic_store_n(&segment->pids[1], getpid(), __ATOMIC_RELEASE);
+
+    /* both sides hold the mapping, free the name for a new pair */
+    (void)cl_shm_destroy(link->path);
+
+bail:
+    return err;
+}
+
+/* creates the segment of the path, or attaches to it as the second side */
+static int
+shm_segment_open(struct lib_commu_shm_link *link, uint32_t ring_size,
+                 int is_stale, int *is_created)
+{
+    int err = 0;
+    void *map = MAP_FAILED;
+
+    *is_created = 0;
+
+    if (cl_shm_create(link->path, &link->fd) == CL_SUCCESS) {
+        *is_created = 1;
+        link->side = 0;
+        if (ftruncate(link->fd, link->map_len) < 0) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "ftruncate() on %s failed with err(%d): %s\n",
+                    link->path, errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+    }
+    else if (errno == EEXIST) {
+        if (cl_shm_open(link->path, &link->fd) != CL_SUCCESS) {
+            /* removed meanwhile */
+            if (errno == ENOENT) {
+                lib_commu_bail_force(EAGAIN);
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "shm_open() on %s failed with err(%d): %s\n",
+                    link->path, errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+        link->side = 1;
+        err = shm_segment_size_wait(link);
+        lib_commu_bail_error(err);
+    }
+    else {
+        LCM_LOG(LCOMMU_LOG_ERROR, "shm_open() on %s failed with err(%d): %s\n",
+                link->path, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    map = mmap(NULL, link->map_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+               link->fd, 0);
+    if (map == MAP_FAILED) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "mmap() on %s failed with err(%d): %s\n",
+                link->path, errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+    link->segment = (struct shm_segment*)map;
+
+    if (*is_created) {
+        /* ftruncate zeroed the segment */
+        link->segment->version = SHM_LINK_VERSION;
+        link->segment->ring_size = ring_size;
+        link->segment->attached = 1;
+        link->segment->pids[0] = getpid();
+        __atomic_store_n(&link->segment->magic, SHM_LINK_MAGIC,
+                         __ATOMIC_RELEASE);
+    }
+    else {
+        err = shm_segment_attach(link, ring_size, is_stale);
+        lib_commu_bail_error(err);
+    }
+
+bail:
+    return err;
+}
+
+static void
+shm_segment_unmap(struct lib_commu_shm_link *link)
+{
+    if (link->segment != NULL) {
+        munmap(link->segment, link->map_len);
+        link->segment = NULL;
+    }
+    if (link->fd >= 0) {
+        close(link->fd);
+        link->fd = -1;
+    }
+}
+
+/************************************************
+ *  Function implementations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library shared memory module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_shm_verbosity_level_set(enum lib_commu_verbosity_level verbosity)
+{
+    int err = 0;
+
+    if ((verbosity > LCOMMU_VERBOSITY_LEVEL_MIN) &&
+        (verbosity <= LCOMMU_VERBOSITY_LEVEL_MAX)) {
+        LOG_VAR_NAME(__MODULE__) = verbosity;
+    }
+    else {
+        LCM_LOG(LCOMMU_LOG_ERROR, "verbosity[%d] is out of range <%d-%d>\n",
+                verbosity, LCOMMU_VERBOSITY_LEVEL_MIN,
+                LCOMMU_VERBOSITY_LEVEL_MAX);
+        lib_commu_bail_force(EINVAL);
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function opens a link of two rings over the shared memory path.
+ *
+ * @param[in] path - the shared memory name
+ * @param[in] ring_size - data bytes of each ring, a power of 2
+ * @param[out] link - the link
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if path or link is NULL or ring_size isn't a power of 2
+ * @return EBUSY if both sides of the segment are attached already
+ * @return EPROTO if the segment was created with other parameters
+ * @return ENOMEM if failed to allocate the link
+ * @return errno codes of native shm_open/ftruncate/mmap functions
+ */
+int
+lib_commu_shm_link_open(const char *path, uint32_t ring_size,
+                        struct lib_commu_shm_link **link)
+{
+    int err = 0;
+    int is_created = 0;
+    uint32_t retries = 0;
+    uint8_t *data = NULL;
+    struct lib_commu_shm_link *link_st = NULL;
+
+    lib_commu_bail_null(path);
+    lib_commu_bail_null(link);
+
+    if ((ring_size == 0) || (ring_size & (ring_size - 1)) ||
+        (ring_size > (1U << 30))) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "Invalid ring size [%u]\n", ring_size);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    link_st = (struct lib_commu_shm_link*)calloc(1, sizeof(*link_st));
+    lib_commu_bail_null(link_st);
+
+    link_st->fd = -1;
+    link_st->ring_mask = ring_size - 1;
+    link_st->map_len = sizeof(struct shm_segment) + 2 * (size_t)ring_size;
+    if ((size_t)snprintf(link_st->path, sizeof(link_st->path), "%s", path) >=
+        sizeof(link_st->path)) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "shared memory name %s is too long\n", path);
+        lib_commu_bail_force(EINVAL);
+    }
+
+    /* the sides of a segment remove its name in a moment, a stale one is
+     * removed once the retries took SHM_ATTACH_WAIT_MSEC */
+    while (1) {
+        err = shm_segment_open(link_st, ring_size,
+                               retries >= SHM_ATTACH_WAIT_MSEC, &is_created);
+        if (err != EAGAIN) {
+            break;
+        }
+        shm_segment_unmap(link_st);
+        if (retries++ == 2 * SHM_ATTACH_WAIT_MSEC) {
+            LCM_LOG(LCOMMU_LOG_ERROR, "%s has no free side\n",
+                    link_st->path);
+            lib_commu_bail_force(EBUSY);
+        }
+        usleep(1000);
+    }
+    lib_commu_bail_error(err);
+
+    data = (uint8_t*)link_st->segment + sizeof(struct shm_segment);
+    link_st->tx_ring = &link_st->segment->rings[link_st->side];
+    link_st->tx_data = data + link_st->side * (size_t)ring_size;
+    link_st->rx_ring = &link_st->segment->rings[link_st->side ^ 1];
+    link_st->rx_data = data + (link_st->side ^ 1) * (size_t)ring_size;
+    pthread_mutex_init(&link_st->tx_lock, NULL);
+    pthread_mutex_init(&link_st->rx_lock, NULL);
+
+    LCM_LOG(LCOMMU_LOG_INFO, "Opened shared memory link %s on side %u\n",
+            link_st->path, link_st->side);
+
+    *link = link_st;
+
+bail:
+    if (err && (link_st != NULL)) {
+        shm_segment_unmap(link_st);
+        if (is_created) {
+            (void)cl_shm_destroy(link_st->path);
+        }
+        free(link_st);
+    }
+    return err;
+}
+
+/**
+ *  This function closes a link, a peer blocked on it gets
+ *  ECONNRESET/EPIPE. The fd of the link is closed.
+ *
+ * @param[in] link - the link
+ */
+void
+lib_commu_shm_link_close(struct lib_commu_shm_link *link)
+{
+    uint32_t attached = 1;
+
+    if (link == NULL) {
+        return;
+    }
+
+    __atomic_or_fetch(&link->segment->closed, 1U << link->side,
+                      __ATOMIC_SEQ_CST);
+    shm_futex_wake(&link->tx_ring->tail);
+    shm_futex_wake(&link->rx_ring->head);
+
+    /* no peer attached, no one else would remove the name */
+    if ((link->side == 0) &&
+        __atomic_compare_exchange_n(&link->segment->attached, &attached, 0, 0,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        (void)cl_shm_destroy(link->path);
+    }
+
+    munmap(link->segment, link->map_len);
+    close(link->fd);
+    pthread_mutex_destroy(&link->tx_lock);
+    pthread_mutex_destroy(&link->rx_lock);
+    free(link);
+}
+
+/**
+ *  This function shuts a link down without releasing it. The users blocked
+ *  on it in this process get ECONNRESET/EPIPE, and so does the peer.
+ *
+ * @param[in] link - the link
+ */
+void
+lib_commu_shm_link_shutdown(struct lib_commu_shm_link *link)
+{
+    if (link == NULL) {
+        return;
+    }
+
+    __atomic_store_n(&link->is_shutdown, 1, __ATOMIC_SEQ_CST);
+    __atomic_or_fetch(&link->segment->closed, 1U << link->side,
+                      __ATOMIC_SEQ_CST);
+    /* the peer waiters, then ours */
+    shm_futex_wake(&link->tx_ring->tail);
+    shm_futex_wake(&link->rx_ring->head);
+    shm_futex_wake(&link->tx_ring->head);
+    shm_futex_wake(&link->rx_ring->tail);
+}
+
+/**
+ *  This function returns the fd of the link
+ *
+ * @param[in] link - the link
+ *
+ * @return the shared memory fd
+ */
+int
+lib_commu_shm_link_fd_get(const struct lib_commu_shm_link *link)
+{
+    return link->fd;
+}
+
+/**
+ *  This function returns whether the peer closed the link, or its
+ *  process is gone
+ *
+ * @param[in] link - the link
+ *
+ * @return 1 if the peer closed the link, else 0
+ */
+int
+lib_commu_shm_link_is_peer_closed(const struct lib_commu_shm_link *link)
+{
+    shm_peer_check(link);
+    return shm_is_peer_closed(link);
+}
+
+/**
+ *  This function copies the buffers into the tx ring.
+ *
+ * @param[in] link - the link
+ * @param[in] iov - the buffers to send
+ * @param[in] iov_num - #buffers
+ * @param[in,out] buffer_len - #bytes to send / #bytes sent
+ *
+ * @return 0 if operation completes successfully.
+ * @return EPIPE if the link was shut down or the peer closed it
+ */
+int
+lib_commu_shm_send(struct lib_commu_shm_link *link, const struct iovec *iov,
+                   uint32_t iov_num, uint32_t *buffer_len)
+{
+    int err = 0;
+    uint32_t tail = 0, head = 0;
+    uint32_t free_len = 0, copy_len = 0;
+    uint32_t total_len = 0, sent_len = 0;
+    uint32_t iov_idx = 0;
+    size_t iov_offset = 0;
+
+    lib_commu_bail_null(link);
+    lib_commu_bail_null(iov);
+    lib_commu_bail_null(buffer_len);
+
+    for (iov_idx = 0; iov_idx < iov_num; iov_idx++) {
+        total_len += iov[iov_idx].iov_len;
+    }
+    iov_idx = 0;
+
+    pthread_mutex_lock(&link->tx_lock);
+
+    if (shm_is_closed(link)) {
+        pthread_mutex_unlock(&link->tx_lock);
+        lib_commu_bail_force(EPIPE);
+    }
+
+    tail = __atomic_load_n(&link->tx_ring->tail, __ATOMIC_RELAXED);
+    while (sent_len < total_len) {
+        err = shm_ring_space_wait(link, tail, &head);
+        if (err) {
+            break;
+        }
+
+        /* fill the free space, then publish it at once */
+        free_len = link->ring_mask + 1 - (tail - head);
+        while ((free_len > 0) && (iov_idx < iov_num)) {
+            copy_len = iov[iov_idx].iov_len - iov_offset;
+            if (copy_len > free_len) {
+                copy_len = free_len;
+            }
+            shm_ring_copy_in(link, tail,
+                             (const uint8_t*)iov[iov_idx].iov_base + iov_offset,
+                             copy_len);
+            tail += copy_len;
+            free_len -= copy_len;
+            sent_len += copy_len;
+            iov_offset += copy_len;
+            if (iov_offset == iov[iov_idx].iov_len) {
+                iov_idx++;
+                iov_offset = 0;
+            }
+        }
+        shm_ring_pos_publish(&link->tx_ring->tail, tail,
+                             &link->tx_ring->consumer_waiting);
+    }
+
+    pthread_mutex_unlock(&link->tx_lock);
+
+    *buffer_len = sent_len;
+
+bail:
+    return err;
+}
+
+/**
+ *  This function copies bytes out of the rx ring.
+ *
+ * @param[in] link - the link
+ * @param[in] buffer - the buffer to fill
+ * @param[in,out] buffer_len - size of buffer / #bytes received
+ * @param[in] is_exact - wait for buffer_len bytes, else return the bytes
+ *                       available (at least one)
+ *
+ * @return 0 if operation completes successfully.
+ * @return ECONNRESET if the link was shut down or the peer closed it and
+ *         the ring is empty
+ */
+int
+lib_commu_shm_recv(struct lib_commu_shm_link *link, uint8_t *buffer,
+                   uint32_t *buffer_len, int is_exact)
+{
+    int err = 0;
+    uint32_t head = 0, tail = 0;
+    uint32_t copy_len = 0, recv_len = 0;
+
+    lib_commu_bail_null(link);
+    lib_commu_bail_null(buffer);
+    lib_commu_bail_null(buffer_len);
+
+    pthread_mutex_lock(&link->rx_lock);
+
+    head = __atomic_load_n(&link->rx_ring->head, __ATOMIC_RELAXED);
+    while (recv_len < *buffer_len) {
+        err = shm_ring_data_wait(link, head, &tail);
+        if (err) {
+            break;
+        }
+
+        copy_len = tail - head;
+        if (copy_len > *buffer_len - recv_len) {
+            copy_len = *buffer_len - recv_len;
+        }
+        shm_ring_copy_out(link, head, buffer + recv_len, copy_len);
+        head += copy_len;
+        recv_len += copy_len;
+        shm_ring_pos_publish(&link->rx_ring->head, head,
+                             &link->rx_ring->producer_waiting);
+
+        if (!is_exact) {
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&link->rx_lock);
+
+    *buffer_len = recv_len;
+
+bail:
+    return err;
+}
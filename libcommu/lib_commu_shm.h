@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) Mellanox Technologies, Ltd. 2001-2014. ALL RIGHTS RESERVED.
+ *
+ * This software product is a proprietary product of Mellanox Technologies, Ltd.
+ * (the "Company") and all right, title, and interest in and to the software product,
+ * including all associated intellectual property rights, are and shall
+ * remain exclusively with the Company.
+ *
+ * This software product is governed by the End User License Agreement
+ * provided with the software product.
+ *
+ */
+
+
+#ifndef LIB_COMMU_SHM_H_
+#define LIB_COMMU_SHM_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include "lib_commu_log.h"
+
+#ifdef LIB_COMMU_SHM_C_
+
+/************************************************
+ *  Local Defines
+ ***********************************************/
+
+#define SHM_LINK_MAGIC              (0x6c63736dU)
+#define SHM_LINK_VERSION            (2)
+#define SHM_LINK_PATH_LEN           (64)
+#define SHM_CACHE_LINE_SIZE         (64)
+#define SHM_SPIN_NUM                (1024) /* polls of an empty/full ring before sleeping on the futex */
+#define SHM_FUTEX_WAIT_MSEC         (100)  /* sleep bound, the peer state is checked again after it */
+#define SHM_ATTACH_WAIT_MSEC        (1000) /* time an opener waits for the creator to init the segment */
+#define SHM_ATTACHED_STALE          (3) /* shm_segment attached once an opener removes the stale name */
+
+/************************************************
+ *  Local Macros
+ ***********************************************/
+
+/************************************************
+ *  Local Type definitions
+ ***********************************************/
+
+/**
+ * shm_ring structure is used to store the state of
+ * one direction of the link. The positions are free running byte
+ * counters, the producer and consumer sides sit on separate cache lines.
+ */
+struct shm_ring {
+    uint32_t tail __attribute__((aligned(SHM_CACHE_LINE_SIZE))); /**< written by the producer */
+    uint32_t consumer_waiting;      /**< set while the consumer sleeps on tail */
+    uint32_t head __attribute__((aligned(SHM_CACHE_LINE_SIZE))); /**< written by the consumer */
+    uint32_t producer_waiting;      /**< set while the producer sleeps on head */
+};
+
+/**
+ * shm_segment structure is placed at the start of the shared
+ * memory, followed by the data of rings[0] and rings[1]
+ */
+struct shm_segment {
+    uint32_t magic;         /**< SHM_LINK_MAGIC once the creator initialized the segment */
+    uint32_t version;       /**< SHM_LINK_VERSION */
+    uint32_t ring_size;     /**< data bytes of each ring, a power of 2 */
+    uint32_t attached;      /**< #sides attached, 0 once the creator gave up its peer,
+                             *   SHM_ATTACHED_STALE once an opener removed the name */
+    uint32_t closed;        /**< bit per side, set once the side closed the link,
+                             *   or by the peer once the side's process is gone */
+    pid_t pids[2];          /**< process of each side, 0 until it attached */
+    struct shm_ring rings[2]; /**< rings[i] is written by side i */
+} __attribute__((aligned(SHM_CACHE_LINE_SIZE)));
+
+/**
+ * lib_commu_shm_link structure is used to store
+ * the process local view of a link
+ */
+struct lib_commu_shm_link {
+    int fd;                         /**< the shared memory fd */
+    uint32_t side;                  /**< 0 - created the segment, 1 - opened it */
+    char path[SHM_LINK_PATH_LEN];   /**< the shared memory name */
+    struct shm_segment *segment;    /**< the mapping */
+    size_t map_len;                 /**< #bytes mapped */
+    uint32_t ring_mask;             /**< ring_size - 1 */
+    struct shm_ring *tx_ring;
+    uint8_t *tx_data;
+    struct shm_ring *rx_ring;
+    uint8_t *rx_data;
+    pthread_mutex_t tx_lock;        /**< one producer per process */
+    pthread_mutex_t rx_lock;        /**< one consumer per process */
+    uint32_t is_shutdown;           /**< set once this side shut the link down */
+};
+
+#endif
+
+/************************************************
+ *  Defines
+ ***********************************************/
+
+/************************************************
+ *  Macros
+ ***********************************************/
+
+/************************************************
+ *  Type definitions
+ ***********************************************/
+
+struct lib_commu_shm_link;
+
+/************************************************
+ *  Global variables
+ ***********************************************/
+
+/************************************************
+ *  Function declarations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library shared memory module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_shm_verbosity_level_set(enum lib_commu_verbosity_level verbosity);
+
+/**
+ *  This function opens a link of two rings over the shared memory path.
+ *  The first side creates the segment, the second side attaches to it and
+ *  removes the path, so it can be used by a new pair. A segment left by a
+ *  process which died before the pair attached is removed and created
+ *  again. Both sides must share the pid namespace, a side whose process
+ *  is gone is taken as closed.
+ *
+ * @param[in] path - the shared memory name
+ * @param[in] ring_size - data bytes of each ring, a power of 2
+ * @param[out] link - the link
+ *
+ * @return 0 if operation completes successfully.
+ * @return EINVAL if path or link is NULL or ring_size isn't a power of 2
+ * @return EBUSY if both sides of the segment are attached already
+ * @return EPROTO if the segment was created with other parameters
+ * @return ENOMEM if failed to allocate the link
+ * @return errno codes of native shm_open/ftruncate/mmap functions
+ */
+int
+lib_commu_shm_link_open(const char *path, uint32_t ring_size,
+                        struct lib_commu_shm_link **link);
+
+/**
+ *  This function closes a link, a peer blocked on it gets
+ *  ECONNRESET/EPIPE. The fd of the link is closed.
+ *
+ * @param[in] link - the link
+ */
+void
+lib_commu_shm_link_close(struct lib_commu_shm_link *link);
+
+/**
+ *  This function shuts a link down without releasing it. The users blocked
+ *  on it in this process get ECONNRESET/EPIPE, and so does the peer.
+ *
+ * @param[in] link - the link
+ */
+void
+lib_commu_shm_link_shutdown(struct lib_commu_shm_link *link);
+
+/**
+ *  This function returns the fd of the link
+ *
+ * @param[in] link - the link
+ *
+ * @return the shared memory fd
+ */
+int
+lib_commu_shm_link_fd_get(const struct lib_commu_shm_link *link);
+
+/**
+ *  This function returns whether the peer closed the link, or its
+ *  process is gone
+ *
+ * @param[in] link - the link
+ *
+ * @return 1 if the peer closed the link, else 0
+ */
+int
+lib_commu_shm_link_is_peer_closed(const struct lib_commu_shm_link *link);
+
+/**
+ *  This function copies the buffers into the tx ring.
+ *  Blocks while the ring is full, the peer is woken only if it sleeps.
+ *
+ * @param[in] link - the link
+ * @param[in] iov - the buffers to send
+ * @param[in] iov_num - #buffers
+ * @param[in,out] buffer_len - #bytes to send / #bytes sent
+ *
+ * @return 0 if operation completes successfully.
+ * @return EPIPE if the link was shut down or the peer closed it
+ */
+int
+lib_commu_shm_send(struct lib_commu_shm_link *link, const struct iovec *iov,
+                   uint32_t iov_num, uint32_t *buffer_len);
+
+/**
+ *  This function copies bytes out of the rx ring.
+ *  Blocks while the ring is empty.
+ *
+ * @param[in] link - the link
+ * @param[in] buffer - the buffer to fill
+ * @param[in,out] buffer_len - size of buffer / #bytes received
+ * @param[in] is_exact - wait for buffer_len bytes, else return the bytes
+ *                       available (at least one)
+ *
+ * @return 0 if operation completes successfully.
+ * @return ECONNRESET if the link was shut down or the peer closed it and
+ *         the ring is empty
+ */
+int
+lib_commu_shm_recv(struct lib_commu_shm_link *link, uint8_t *buffer,
+                   uint32_t *buffer_len, int is_exact);
+
+#endif /* LIB_COMMU_SHM_H_ */
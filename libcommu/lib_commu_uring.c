@@ -0,0 +1,587 @@
+/* Copyright (c) 2014  Mellanox Technologies, Ltd. All rights reserved.
+ *
+ * This software is available to you under BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define LIB_COMMU_URING_C_
+
+#include "lib_commu_uring.h"
+#include "lib_commu_bail.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#undef  __MODULE__
+#define __MODULE__ LIB_COMMU_URING
+
+/************************************************
+ *  Local variables
+ ***********************************************/
+
+static enum lib_commu_verbosity_level LOG_VAR_NAME(__MODULE__) =
+    LCOMMU_VERBOSITY_LEVEL_NOTICE;
+
+static pthread_key_t uring_key;
+static int is_uring_key_created = 0;
+static pthread_mutex_t lock_urings = PTHREAD_MUTEX_INITIALIZER;
+static struct lib_commu_uring *urings = NULL;
+
+/************************************************
+ *  Local function declarations
+ ***********************************************/
+
+static int uring_open(struct lib_commu_uring **uring);
+
+static void uring_close(struct lib_commu_uring *uring);
+
+static void uring_thread_release(void *arg);
+
+static int uring_get(struct lib_commu_uring **uring);
+
+static size_t uring_op_len(const struct lib_commu_uring_op *op);
+
+static void uring_op_sqe_set(const struct lib_commu_uring_op *op,
+                             uint32_t op_idx, struct io_uring_sqe *sqe);
+
+static int uring_submit_wait(struct lib_commu_uring_op *ops, uint32_t ops_num);
+
+/************************************************
+ *  Local function implementations
+ ***********************************************/
+
+static int
+uring_open(struct lib_commu_uring **uring)
+{
+    int err = 0;
+    struct io_uring_params params;
+    struct lib_commu_uring *ring = NULL;
+    uint8_t *sq_ptr = NULL;
+    uint8_t *cq_ptr = NULL;
+
+    memset(&params, 0, sizeof(params));
+
+    ring = (struct lib_commu_uring *)calloc(1, sizeof(*ring));
+    if (ring == NULL) {
+        lib_commu_bail_force(ENOMEM);
+    }
+
+    ring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES_NUM, &params);
+    if (ring->fd < 0) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "io_uring_setup() failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    ring->sq_map_len = params.sq_off.array +
+                       params.sq_entries * sizeof(uint32_t);
+    ring->cq_map_len = params.cq_off.cqes +
+                       params.cq_entries * sizeof(struct io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) &&
+        (ring->cq_map_len > ring->sq_map_len)) {
+        ring->sq_map_len = ring->cq_map_len;
+    }
+
+    sq_ptr = mmap(NULL, ring->sq_map_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "mmap() of the SQ ring failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+    ring->sq_map = sq_ptr;
+
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cq_ptr = sq_ptr;
+    }
+    else {
+        cq_ptr = mmap(NULL, ring->cq_map_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "mmap() of the CQ ring failed with err(%d): %s\n",
+                    errno, strerror(errno));
+            lib_commu_bail_force(errno);
+        }
+        ring->cq_map = cq_ptr;
+    }
+
+    ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        LCM_LOG(LCOMMU_LOG_ERROR, "mmap() of the SQEs failed with err(%d): %s\n",
+                errno, strerror(errno));
+        lib_commu_bail_force(errno);
+    }
+
+    ring->sq_head = (uint32_t *)(sq_ptr + params.sq_off.head);
+    ring->sq_tail = (uint32_t *)(sq_ptr + params.sq_off.tail);
+    ring->sq_mask = *(uint32_t *)(sq_ptr + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t *)(sq_ptr + params.sq_off.array);
+    ring->cq_head = (uint32_t *)(cq_ptr + params.cq_off.head);
+    ring->cq_tail = (uint32_t *)(cq_ptr + params.cq_off.tail);
+    ring->cq_mask = *(uint32_t *)(cq_ptr + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+
+    *uring = ring;
+    ring = NULL;
+
+bail:
+    if (ring != NULL) {
+        uring_close(ring);
+    }
+    return err;
+}
+
+
+static void
+uring_close(struct lib_commu_uring *uring)
+{
+    if (uring->sqes != NULL) {
+        munmap(uring->sqes, uring->sqes_len);
+    }
+    if (uring->cq_map != NULL) {
+        munmap(uring->cq_map, uring->cq_map_len);
+    }
+    if (uring->sq_map != NULL) {
+        munmap(uring->sq_map, uring->sq_map_len);
+    }
+    if (uring->fd >= 0) {
+        close(uring->fd);
+    }
+    free(uring);
+}
+
+
+/* called on thread exit, and when an operation failed to keep the ring
+ * consistent */
+static void
+uring_thread_release(void *arg)
+{
+    struct lib_commu_uring *uring = (struct lib_commu_uring *)arg;
+
+    pthread_mutex_lock(&lock_urings);
+    if (uring->prev != NULL) {
+        uring->prev->next = uring->next;
+    }
+    else {
+        urings = uring->next;
+    }
+    if (uring->next != NULL) {
+        uring->next->prev = uring->prev;
+    }
+    pthread_mutex_unlock(&lock_urings);
+
+    uring_close(uring);
+}
+
+
+static int
+uring_get(struct lib_commu_uring **uring)
+{
+    int err = 0;
+    struct lib_commu_uring *ring = NULL;
+
+    if (!is_uring_key_created) {
+        lib_commu_bail_force(EPERM);
+    }
+
+    ring = (struct lib_commu_uring *)pthread_getspecific(uring_key);
+    if (ring == NULL) {
+        err = uring_open(&ring);
+        lib_commu_bail_error(err);
+
+        err = pthread_setspecific(uring_key, ring);
+        if (err) {
+            uring_close(ring);
+            lib_commu_bail_force(err);
+        }
+
+        pthread_mutex_lock(&lock_urings);
+        ring->next = urings;
+        if (urings != NULL) {
+            urings->prev = ring;
+        }
+        urings = ring;
+        pthread_mutex_unlock(&lock_urings);
+    }
+
+    *uring = ring;
+
+bail:
+    return err;
+}
+
+
+static size_t
+uring_op_len(const struct lib_commu_uring_op *op)
+{
+    size_t len = 0;
+    size_t i = 0;
+
+    if (op->type == LIB_COMMU_URING_OP_RECV) {
+        return op->len;
+    }
+    for (i = 0; i < (size_t)op->msg->msg_iovlen; i++) {
+        len += op->msg->msg_iov[i].iov_len;
+    }
+    return len;
+}
+
+
+static void
+uring_op_sqe_set(const struct lib_commu_uring_op *op, uint32_t op_idx,
+                 struct io_uring_sqe *sqe)
+{
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = op->fd;
+    sqe->msg_flags = op->flags;
+    sqe->user_data = op_idx;
+    if (op->is_linked) {
+        sqe->flags = IOSQE_IO_LINK;
+    }
+
+    if (op->type == LIB_COMMU_URING_OP_RECV) {
+        sqe->opcode = IORING_OP_RECV;
+        sqe->addr = (uint64_t)(uintptr_t)op->buffer;
+        sqe->len = op->len;
+    }
+    else {
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->addr = (uint64_t)(uintptr_t)op->msg;
+        sqe->len = 1;
+    }
+}
+
+
+/* submits up to URING_ENTRIES_NUM operations on the ring of the calling
+ * thread and waits for all their completions, with one io_uring_enter
+ * unless a signal interrupts the wait */
+static int
+uring_submit_wait(struct lib_commu_uring_op *ops, uint32_t ops_num)
+{
+    int err = 0;
+    int ret = 0;
+    uint32_t to_submit = ops_num;
+    uint32_t done_num = 0;
+    uint32_t tail = 0;
+    uint32_t head = 0;
+    uint32_t idx = 0;
+    uint32_t i = 0;
+    struct io_uring_cqe *cqe = NULL;
+    struct lib_commu_uring *ring = NULL;
+
+    /* nb < 0 marks an operation which didn't complete */
+    for (i = 0; i < ops_num; i++) {
+        ops[i].err = 0;
+        ops[i].nb = -1;
+    }
+
+    err = uring_get(&ring);
+    lib_commu_bail_error(err);
+
+    tail = *ring->sq_tail;
+    for (i = 0; i < ops_num; i++) {
+        idx = (tail + i) & ring->sq_mask;
+        uring_op_sqe_set(&ops[i], i, &ring->sqes[idx]);
+        ring->sq_array[idx] = idx;
+    }
+    /* a chain ends with the submission, lib_commu_uring_submit continues it */
+    ring->sqes[(tail + ops_num - 1) & ring->sq_mask].flags &= ~IOSQE_IO_LINK;
+    __atomic_store_n(ring->sq_tail, tail + ops_num, __ATOMIC_RELEASE);
+
+    while (done_num < ops_num) {
+        head = *ring->cq_head;
+        if (head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            cqe = &ring->cqes[head & ring->cq_mask];
+            i = (uint32_t)cqe->user_data;
+            if (cqe->res < 0) {
+                ops[i].err = -cqe->res;
+                ops[i].nb = 0;
+            }
+            else {
+                ops[i].nb = cqe->res;
+            }
+            __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+            done_num++;
+            continue;
+        }
+
+        /* submit and wait in one call, a signal may end the wait after
+         * the submission. The kernel doesn't wait if it submitted only
+         * part of the SQEs */
+        ret = syscall(__NR_io_uring_enter, ring->fd, to_submit,
+                      ops_num - done_num, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LCM_LOG(LCOMMU_LOG_ERROR,
+                    "io_uring_enter() failed with err(%d): %s\n",
+                    errno, strerror(errno));
+            err = errno;
+            /* the operations state is unknown, start over with a new ring */
+            pthread_setspecific(uring_key, NULL);
+            uring_thread_release(ring);
+            goto bail;
+        }
+        to_submit -= ((uint32_t)ret < to_submit) ? (uint32_t)ret : to_submit;
+    }
+
+bail:
+    if (err) {
+        for (i = 0; i < ops_num; i++) {
+            if (ops[i].nb < 0) {
+                ops[i].err = err;
+                ops[i].nb = 0;
+            }
+        }
+    }
+    return err;
+}
+
+/************************************************
+ *  Function implementations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library io_uring module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_uring_verbosity_level_set(enum lib_commu_verbosity_level verbosity)
+{
+    int err = 0;
+
+    if ((verbosity > LCOMMU_VERBOSITY_LEVEL_MIN) &&
+        (verbosity <= LCOMMU_VERBOSITY_LEVEL_MAX)) {
+        LOG_VAR_NAME(__MODULE__) = verbosity;
+    }
+    else {
+        LCM_LOG(LCOMMU_LOG_ERROR, "verbosity[%d] is out of range <%d-%d>\n",
+                verbosity, LCOMMU_VERBOSITY_LEVEL_MIN,
+                LCOMMU_VERBOSITY_LEVEL_MAX);
+        lib_commu_bail_force(EINVAL);
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function checks that the kernel supports io_uring, rings are
+ *  created on the first operation of each thread.
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native io_uring_setup/mmap/pthread_key_create functions
+ */
+int
+lib_commu_uring_init(void)
+{
+    int err = 0;
+    struct lib_commu_uring *ring = NULL;
+
+    /* fail the init rather than the first send */
+    err = uring_open(&ring);
+    lib_commu_bail_error(err);
+    uring_close(ring);
+
+    err = pthread_key_create(&uring_key, uring_thread_release);
+    if (err) {
+        LCM_LOG(LCOMMU_LOG_ERROR, "pthread_key_create() failed with err(%d)\n",
+                err);
+        lib_commu_bail_force(err);
+    }
+    is_uring_key_created = 1;
+
+bail:
+    return err;
+}
+
+/**
+ *  This function closes the rings of all the threads.
+ *  Must not be called concurrently with the operations.
+ */
+void
+lib_commu_uring_deinit(void)
+{
+    struct lib_commu_uring *ring = NULL;
+
+    if (!is_uring_key_created) {
+        return;
+    }
+
+    /* the destructors of a deleted key aren't called */
+    pthread_key_delete(uring_key);
+    is_uring_key_created = 0;
+
+    pthread_mutex_lock(&lock_urings);
+    while (urings != NULL) {
+        ring = urings;
+        urings = ring->next;
+        uring_close(ring);
+    }
+    pthread_mutex_unlock(&lock_urings);
+}
+
+/**
+ *  This function submits the operations through the ring of the calling
+ *  thread with one io_uring_enter per URING_ENTRIES_NUM operations,
+ *  blocking until all of them complete. The operations run concurrently,
+ *  except that an operation following one with is_linked set starts only
+ *  after that one completed, and fails with ECANCELED if it fell short.
+ *
+ * @param[in,out] ops - the operations, their err/nb are set
+ * @param[in] ops_num - #operations
+ *
+ * @return 0 if operation completes successfully, see the err of each op.
+ * @return errno codes of native io_uring_setup/io_uring_enter functions,
+ *         the ops which didn't complete get it as err
+ */
+int
+lib_commu_uring_submit(struct lib_commu_uring_op *ops, uint32_t ops_num)
+{
+    int err = 0;
+    uint32_t first = 0;
+    uint32_t num = 0;
+    uint32_t i = 0;
+
+    while (first < ops_num) {
+        /* the kernel cancels the rest of a chain within a submission, a
+         * chain split between submissions is canceled here */
+        if ((first > 0) && ops[first - 1].is_linked &&
+            ((ops[first - 1].err != 0) ||
+             ((size_t)ops[first - 1].nb != uring_op_len(&ops[first - 1])))) {
+            ops[first].err = ECANCELED;
+            ops[first].nb = 0;
+            first++;
+            continue;
+        }
+
+        num = ops_num - first;
+        if (num > URING_ENTRIES_NUM) {
+            num = URING_ENTRIES_NUM;
+        }
+        err = uring_submit_wait(&ops[first], num);
+        if (err) {
+            for (i = first + num; i < ops_num; i++) {
+                ops[i].err = err;
+                ops[i].nb = 0;
+            }
+            goto bail;
+        }
+        first += num;
+    }
+
+bail:
+    return err;
+}
+
+/**
+ *  This function sends a message through the ring of the calling thread,
+ *  blocking until it completes. With MSG_WAITALL the kernel retries short
+ *  sends of a stream socket (linux 5.19) before completing.
+ *
+ * @param[in] fd - the socket
+ * @param[in] msg - the message, as for sendmsg()
+ * @param[in] flags - sendmsg() flags
+ * @param[out] nb_sent - #bytes sent
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native io_uring_setup/io_uring_enter/sendmsg functions
+ */
+int
+lib_commu_uring_sendmsg(int fd, const struct msghdr *msg, int flags,
+                        ssize_t *nb_sent)
+{
+    int err = 0;
+    struct lib_commu_uring_op op;
+
+    memset(&op, 0, sizeof(op));
+    op.type = LIB_COMMU_URING_OP_SENDMSG;
+    op.fd = fd;
+    op.flags = flags;
+    op.msg = msg;
+
+    err = lib_commu_uring_submit(&op, 1);
+    lib_commu_bail_error(err);
+    lib_commu_bail_error(op.err);
+
+    *nb_sent = op.nb;
+
+bail:
+    return err;
+}
+
+/**
+ *  This function receives into a buffer through the ring of the calling
+ *  thread, blocking until it completes. With MSG_WAITALL the kernel retries
+ *  short receives until len bytes arrive or the peer closes.
+ *
+ * @param[in] fd - the socket
+ * @param[in] buffer - the buffer to fill
+ * @param[in] len - size of buffer
+ * @param[in] flags - recv() flags
+ * @param[out] nb_recvd - #bytes received, 0 if the peer closed
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native io_uring_setup/io_uring_enter/recv functions
+ */
+int
+lib_commu_uring_recv(int fd, void *buffer, size_t len, int flags,
+                     ssize_t *nb_recvd)
+{
+    int err = 0;
+    struct lib_commu_uring_op op;
+
+    memset(&op, 0, sizeof(op));
+    op.type = LIB_COMMU_URING_OP_RECV;
+    op.fd = fd;
+    op.flags = flags;
+    op.buffer = buffer;
+    op.len = len;
+
+    err = lib_commu_uring_submit(&op, 1);
+    lib_commu_bail_error(err);
+    lib_commu_bail_error(op.err);
+
+    *nb_recvd = op.nb;
+
+bail:
+    return err;
+}
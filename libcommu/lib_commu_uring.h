@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) Mellanox Technologies, Ltd. 2001-2014. ALL RIGHTS RESERVED.
+ *
+ * This software product is a proprietary product of Mellanox Technologies, Ltd.
+ * (the "Company") and all right, title, and interest in and to the software product,
+ * including all associated intellectual property rights, are and shall
+ * remain exclusively with the Company.
+ *
+ * This software product is governed by the End User License Agreement
+ * provided with the software product.
+ *
+ */
+
+
+#ifndef LIB_COMMU_URING_H_
+#define LIB_COMMU_URING_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include "lib_commu_log.h"
+
+#ifdef LIB_COMMU_URING_C_
+
+/************************************************
+ *  Local Defines
+ ***********************************************/
+
+#define URING_ENTRIES_NUM           (64) /* a ring serves the blocking calls of one thread, max #operations per io_uring_enter */
+
+/************************************************
+ *  Local Macros
+ ***********************************************/
+
+/************************************************
+ *  Local Type definitions
+ ***********************************************/
+
+/**
+ * lib_commu_uring structure is used to store
+ * the mapped io_uring of one thread
+ */
+struct lib_commu_uring {
+    int fd;                             /**< the io_uring fd */
+    void *sq_map;                       /**< SQ ring mapping (and CQ ring, if single mmap) */
+    size_t sq_map_len;
+    void *cq_map;                       /**< CQ ring mapping */
+    size_t cq_map_len;
+    struct io_uring_sqe *sqes;          /**< SQ entries mapping */
+    size_t sqes_len;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t sq_mask;
+    uint32_t *sq_array;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe *cqes;
+    struct lib_commu_uring *prev;       /**< rings of all threads, for deinit */
+    struct lib_commu_uring *next;
+};
+
+#endif
+
+/************************************************
+ *  Defines
+ ***********************************************/
+
+/************************************************
+ *  Macros
+ ***********************************************/
+
+/************************************************
+ *  Type definitions
+ ***********************************************/
+
+/**
+ * lib_commu_uring_op_type enumerates the operations of lib_commu_uring_submit
+ */
+enum lib_commu_uring_op_type {
+    LIB_COMMU_URING_OP_SENDMSG = 0, /**< sendmsg(fd, msg, flags) */
+    LIB_COMMU_URING_OP_RECV,        /**< recv(fd, buffer, len, flags) */
+};
+
+/**
+ * lib_commu_uring_op structure is used to pass
+ * an operation to lib_commu_uring_submit
+ */
+struct lib_commu_uring_op {
+    enum lib_commu_uring_op_type type;
+    int fd;
+    int flags;                  /**< sendmsg()/recv() flags, MSG_WAITALL to link the operation */
+    int is_linked;              /**< the next operation starts only after this one transferred all its bytes */
+    const struct msghdr *msg;   /**< LIB_COMMU_URING_OP_SENDMSG */
+    void *buffer;               /**< LIB_COMMU_URING_OP_RECV */
+    size_t len;                 /**< LIB_COMMU_URING_OP_RECV */
+    int err;                    /**< out: 0, errno of the operation, ECANCELED if a linked one before it fell short */
+    ssize_t nb;                 /**< out: #bytes transferred */
+};
+
+/************************************************
+ *  Global variables
+ ***********************************************/
+
+/************************************************
+ *  Function declarations
+ ***********************************************/
+
+/**
+ * Sets verbosity level of communication library io_uring module
+ *
+ * @param[in] verbosity - verbosity level
+ *
+ * @return 0 if operation completes successfully
+ * @return EINVAL - Invalid argument - param out of range
+ */
+int
+lib_commu_uring_verbosity_level_set(enum lib_commu_verbosity_level verbosity);
+
+/**
+ *  This function checks that the kernel supports io_uring, rings are
+ *  created on the first operation of each thread.
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native io_uring_setup/mmap/pthread_key_create functions
+ */
+int
+lib_commu_uring_init(void);
+
+/**
+ *  This function closes the rings of all the threads.
+ *  Must not be called concurrently with the operations.
+ */
+void
+lib_commu_uring_deinit(void);
+
+/**
+ *  This function submits the operations through the ring of the calling
+ *  thread with one io_uring_enter per URING_ENTRIES_NUM operations,
+ *  blocking until all of them complete. The operations run concurrently,
+ *  except that an operation following one with is_linked set starts only
+ *  after that one completed, and fails with ECANCELED if it fell short.
+ *
+ * @param[in,out] ops - the operations, their err/nb are set
+ * @param[in] ops_num - #operations
+ *
+ * @return 0 if operation completes successfully, see the err of each op.
+ * @return errno codes of native io_uring_setup/io_uring_enter functions,
+ *         the ops which didn't complete get it as err
+ */
+int
+lib_commu_uring_submit(struct lib_commu_uring_op *ops, uint32_t ops_num);
+
+/**
+ *  This function sends a message through the ring of the calling thread,
+ *  blocking until it completes. With MSG_WAITALL the kernel retries short
+ *  sends of a stream socket (linux 5.19) before completing.
+ *
+ * @param[in] fd - the socket
+ * @param[in] msg - the message, as for sendmsg()
+ * @param[in] flags - sendmsg() flags
+ * @param[out] nb_sent - #bytes sent
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native io_uring_setup/io_uring_enter/sendmsg functions
+ */
+int
+lib_commu_uring_sendmsg(int fd, const struct msghdr *msg, int flags,
+                        ssize_t *nb_sent);
+
+/**
+ *  This function receives into a buffer through the ring of the calling
+ *  thread, blocking until it completes. With MSG_WAITALL the kernel retries
+ *  short receives until len bytes arrive or the peer closes.
+ *
+ * @param[in] fd - the socket
+ * @param[in] buffer - the buffer to fill
+ * @param[in] len - size of buffer
+ * @param[in] flags - recv() flags
+ * @param[out] nb_recvd - #bytes received, 0 if the peer closed
+ *
+ * @return 0 if operation completes successfully.
+ * @return errno codes of native io_uring_setup/io_uring_enter/recv functions
+ */
+int
+lib_commu_uring_recv(int fd, void *buffer, size_t len, int flags,
+                     ssize_t *nb_recvd);
+
+#endif /* LIB_COMMU_URING_H_ */